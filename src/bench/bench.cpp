@@ -0,0 +1,485 @@
+// Microbenchmarks for the routing, reachability, matching, movement and persistence hot paths.
+// Every scenario is generated from a fixed seed so runs are comparable, and the
+// results are printed as JSON for regression tracking.
+//
+// Usage: SmartRideBench.exe [--seed N] [--max-nodes N] [--out results.json]
+
+#include "../modules/graphgen.h"
+#include "../modules/pathfinder.h"
+#include "../modules/routebatch.h"
+#include "../modules/routecache.h"
+#include "../modules/matching.h"
+#include "../modules/histogram.h"
+#include "../modules/quietconsole.h"
+#include "../modules/driver.h"
+#include "../modules/vehicle.h"
+#include "../modules/trafficqueue.h"
+#include "../modules/reachability.h"
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <unordered_set>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::ordered_json;
+using Clock = chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+static uint64_t nanosecondsSince(Clock::time_point start)
+{
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+// Progress goes straight to stderr, cout/cerr are silenced while benchmarks run
+static void progress(const string& what)
+{
+    fprintf(stderr, "[bench] %s\n", what.c_str());
+}
+
+static json latencyJson(const LatencyHistogram& histogram)
+{
+    return {
+        {"count", histogram.getCount()},
+        {"mean_ns", histogram.getMean()},
+        {"p50_ns", histogram.percentile(50)},
+        {"p90_ns", histogram.percentile(90)},
+        {"p99_ns", histogram.percentile(99)},
+        {"max_ns", histogram.getMax()}
+    };
+}
+
+static json graphJson(const GeneratedGraph& graph)
+{
+    return { {"kind", graph.kind}, {"nodes", graph.nodes.size()}, {"edges", graph.edgeCount} };
+}
+
+static vector<pair<Node*, Node*>> randomPairs(const GeneratedGraph& graph, size_t count, mt19937_64& random)
+{
+    uniform_int_distribution<size_t> pick(0, graph.nodes.size() - 1);
+    vector<pair<Node*, Node*>> pairs;
+    pairs.reserve(count);
+    while (pairs.size() < count)
+    {
+        Node* start = graph.nodes[pick(random)];
+        Node* goal = graph.nodes[pick(random)];
+        if (start != goal)
+        {
+            pairs.push_back({ start, goal });
+        }
+    }
+    return pairs;
+}
+
+// Single-threaded A* throughput, stops early once the time budget is spent
+static json benchAStar(const GeneratedGraph& graph, mt19937_64& random)
+{
+    const size_t queries = 2000;
+    const double budgetSeconds = 3.0;
+    vector<pair<Node*, Node*>> pairs = randomPairs(graph, queries, random);
+
+    SearchWorkspace workspace;
+    LatencyHistogram latency;
+    size_t done = 0;
+    size_t found = 0;
+    auto start = Clock::now();
+    for (const auto& query : pairs)
+    {
+        auto queryStart = Clock::now();
+        found += !aStar(query.first, query.second, workspace).empty();
+        latency.record(nanosecondsSince(queryStart));
+        done++;
+        if (secondsSince(start) > budgetSeconds)
+        {
+            break;
+        }
+    }
+    double elapsed = secondsSince(start);
+
+    return {
+        {"benchmark", "astar"},
+        {"graph", graphJson(graph)},
+        {"queries", done},
+        {"paths_found", found},
+        {"queries_per_second", done / elapsed},
+        {"latency", latencyJson(latency)}
+    };
+}
+
+// A* towards unreachable goals until the budget is spent; returns queries run
+static size_t timeUnroutable(const vector<pair<Node*, Node*>>& pairs, LatencyHistogram& latency, size_t& found)
+{
+    const double budgetSeconds = 3.0;
+    SearchWorkspace workspace;
+    size_t done = 0;
+    auto start = Clock::now();
+    for (const auto& query : pairs)
+    {
+        auto queryStart = Clock::now();
+        found += !aStar(query.first, query.second, workspace).empty();
+        latency.record(nanosecondsSince(queryStart));
+        done++;
+        if (secondsSince(start) > budgetSeconds)
+        {
+            break;
+        }
+    }
+    return done;
+}
+
+// Reachability index build and lookups, then an island cut off by road
+// closures and routed to with and without the index
+static json benchReachability(const GeneratedGraph& graph, mt19937_64& random)
+{
+    auto buildStart = Clock::now();
+    reachability.attach(graph.nodes);
+    double buildSeconds = secondsSince(buildStart);
+    size_t components = reachability.getStats().components;
+
+    const size_t lookups = 100000;
+    vector<pair<Node*, Node*>> pairs = randomPairs(graph, lookups, random);
+    size_t reachablePairs = 0;
+    auto lookupStart = Clock::now();
+    for (const auto& query : pairs)
+    {
+        reachablePairs += reachability.reachable(query.first, query.second);
+    }
+    double lookupSeconds = secondsSince(lookupStart);
+
+    // Grow an island breadth first around a random node and close every road leaving it
+    const size_t islandSize = 25;
+    uniform_int_distribution<size_t> pick(0, graph.nodes.size() - 1);
+    vector<Node*> island = { graph.nodes[pick(random)] };
+    unordered_set<Node*> inIsland(island.begin(), island.end());
+    for (size_t i = 0; i < island.size() && island.size() < islandSize; i++)
+    {
+        for (Node* neighbor : island[i]->neighbors)
+        {
+            if (island.size() < islandSize && inIsland.insert(neighbor).second)
+            {
+                island.push_back(neighbor);
+            }
+        }
+    }
+    vector<pair<Node*, Node*>> cut;
+    for (Node* node : island)
+    {
+        for (Node* neighbor : node->neighbors)
+        {
+            if (!inIsland.count(neighbor))
+            {
+                cut.push_back({ node, neighbor });
+            }
+        }
+    }
+    LatencyHistogram closeLatency;
+    for (const auto& road : cut)
+    {
+        auto closeStart = Clock::now();
+        reachability.closeRoad(road.first, road.second);
+        closeLatency.record(nanosecondsSince(closeStart));
+    }
+
+    vector<pair<Node*, Node*>> unroutable;
+    while (unroutable.size() < 200 && inIsland.size() < graph.nodes.size())
+    {
+        Node* start = graph.nodes[pick(random)];
+        if (!inIsland.count(start))
+        {
+            unroutable.push_back({ start, island[unroutable.size() % island.size()] });
+        }
+    }
+
+    LatencyHistogram indexed, unindexed;
+    size_t found = 0;
+    size_t indexedQueries = timeUnroutable(unroutable, indexed, found);
+    reachability.detach();
+    size_t unindexedQueries = timeUnroutable(unroutable, unindexed, found);
+
+    // Reopening restores one component; every road goes back as it was
+    reachability.attach(graph.nodes);
+    LatencyHistogram openLatency;
+    for (const auto& road : cut)
+    {
+        auto openStart = Clock::now();
+        reachability.openRoad(road.first, road.second);
+        openLatency.record(nanosecondsSince(openStart));
+    }
+    ReachabilityStats stats = reachability.getStats();
+    reachability.detach();
+    routeCache.clear();
+
+    return {
+        {"benchmark", "reachability"},
+        {"graph", graphJson(graph)},
+        {"build_ms", buildSeconds * 1e3},
+        {"components", components},
+        {"lookup_ns", lookupSeconds * 1e9 / lookups},
+        {"reachable_share", static_cast<double>(reachablePairs) / lookups},
+        {"roads_closed", cut.size()},
+        {"close_latency", latencyJson(closeLatency)},
+        {"open_latency", latencyJson(openLatency)},
+        {"rebuilds", stats.rebuilds},
+        {"closure_patches", stats.closurePatches},
+        {"local_checks", stats.localChecks},
+        {"unroutable_paths_found", found},
+        {"unroutable_astar_indexed", latencyJson(indexed)},
+        {"unroutable_astar_unindexed", latencyJson(unindexed)},
+        {"unroutable_queries", { indexedQueries, unindexedQueries }}
+    };
+}
+
+// The same pairs routed as one RouteBatch on the shared pool
+static json benchRouteBatch(const GeneratedGraph& graph, mt19937_64& random)
+{
+    size_t queries = graph.nodes.size() > 100000 ? 200 : 1000;
+    vector<pair<Node*, Node*>> pairs = randomPairs(graph, queries, random);
+
+    RouteBatch batch(defaultThreadPool(), false);
+    for (const auto& query : pairs)
+    {
+        batch.add(query.first, query.second);
+    }
+    auto start = Clock::now();
+    batch.solve();
+    double elapsed = secondsSince(start);
+
+    return {
+        {"benchmark", "route_batch"},
+        {"graph", graphJson(graph)},
+        {"workers", defaultThreadPool().size()},
+        {"queries", queries},
+        {"queries_per_second", queries / elapsed}
+    };
+}
+
+struct Fleet
+{
+    vector<Driver*> drivers;
+    vector<Vehicle*> vehicles;
+
+    ~Fleet()
+    {
+        for (Vehicle* vehicle : vehicles)
+            delete vehicle;
+        for (Driver* driver : drivers)
+            delete driver;
+    }
+};
+
+// Drivers parked on random nodes, vehicle types spread evenly
+static void parkFleet(Fleet& fleet, const GeneratedGraph& graph, size_t size, mt19937_64& random)
+{
+    uniform_int_distribution<size_t> pick(0, graph.nodes.size() - 1);
+    for (size_t i = 0; i < size; i++)
+    {
+        string type = vehicleClassName(static_cast<VehicleClass>(i % 4));
+        Node* node = graph.nodes[pick(random)];
+        Driver* driver = new Driver(30, "Bench driver", "bench" + to_string(i) + "@bench", true, "", "", 1, type, node);
+        Vehicle* vehicle = new Vehicle(static_cast<int>(i), type, node, node, {});
+        driver->assignedVehicle = vehicle;
+        fleet.drivers.push_back(driver);
+        fleet.vehicles.push_back(vehicle);
+    }
+}
+
+static json benchFindNearestDriver(const GeneratedGraph& graph, size_t fleetSize, mt19937_64& random)
+{
+    Fleet fleet;
+    parkFleet(fleet, graph, fleetSize, random);
+
+    uniform_int_distribution<size_t> pick(0, graph.nodes.size() - 1);
+    LatencyHistogram latency;
+    const int lookups = 2000;
+    size_t hits = 0;
+    for (int i = 0; i < lookups; i++)
+    {
+        Node* user = graph.nodes[pick(random)];
+        auto start = Clock::now();
+        hits += findNearestDriver(user, fleet.drivers, VehicleClass::Car) != nullptr;
+        latency.record(nanosecondsSince(start));
+    }
+
+    return {
+        {"benchmark", "find_nearest_driver"},
+        {"graph", graphJson(graph)},
+        {"fleet", fleetSize},
+        {"lookups", lookups},
+        {"matches", hits},
+        {"latency", latencyJson(latency)}
+    };
+}
+
+// Cost of one simulation tick of moveVehicle over the whole fleet
+static json benchMoveVehicle(const GeneratedGraph& graph, size_t fleetSize, mt19937_64& random)
+{
+    vector<pair<Node*, Node*>> trips = randomPairs(graph, fleetSize, random);
+    vector<vector<Edge*>> paths = RouteBatch::solveAll(trips);
+
+    // Unroutable trips would re-run A* every tick and measure routing instead
+    vector<Vehicle> vehicles;
+    vehicles.reserve(fleetSize);
+    for (size_t i = 0; i < fleetSize; i++)
+    {
+        if (paths[i].empty())
+        {
+            continue;
+        }
+        vehicles.emplace_back(static_cast<int>(i), "Car", trips[i].first, trips[i].second, move(paths[i]));
+        vehicles.back().speed = 5.0f;
+    }
+
+    const int ticks = 300;
+    LatencyHistogram tickLatency;
+    auto start = Clock::now();
+    for (int tick = 0; tick < ticks; tick++)
+    {
+        auto tickStart = Clock::now();
+        for (Vehicle& vehicle : vehicles)
+        {
+            if (!vehicle.hasReachedDestination)
+            {
+                vehicle.moveVehicle();
+            }
+        }
+        tickLatency.record(nanosecondsSince(tickStart));
+    }
+    double elapsed = secondsSince(start);
+    traffic.clear(); // The graph is freed after this benchmark
+
+    return {
+        {"benchmark", "move_vehicle"},
+        {"graph", graphJson(graph)},
+        {"fleet", fleetSize},
+        {"routed", vehicles.size()},
+        {"ticks", ticks},
+        {"ns_per_vehicle_tick", vehicles.empty() ? 0.0 : elapsed * 1e9 / (static_cast<double>(ticks) * vehicles.size())},
+        {"tick_latency", latencyJson(tickLatency)}
+    };
+}
+
+// saveDriver rewrites drivers.json on every call; run inside a scratch directory
+static json benchPersistence(size_t driverCount, mt19937_64& random)
+{
+    filesystem::path previous = filesystem::current_path();
+    filesystem::path scratch = filesystem::temp_directory_path() / ("smartride-bench-" + to_string(random()));
+    filesystem::create_directories(scratch);
+    filesystem::current_path(scratch);
+
+    vector<Driver> drivers;
+    for (size_t i = 0; i < driverCount; i++)
+    {
+        drivers.emplace_back(30, "Bench driver", "bench" + to_string(i) + "@bench", true, "03000000000", "LIC" + to_string(i), 3, "Car", nullptr);
+    }
+
+    auto saveStart = Clock::now();
+    for (const Driver& driver : drivers)
+    {
+        driver.saveDriver();
+    }
+    double saveSeconds = secondsSince(saveStart);
+
+    auto loadStart = Clock::now();
+    const int loads = 20;
+    size_t loaded = 0;
+    for (int i = 0; i < loads; i++)
+    {
+        loaded += Driver::loadAllDrivers().size();
+    }
+    double loadSeconds = secondsSince(loadStart);
+
+    filesystem::current_path(previous);
+    filesystem::remove_all(scratch);
+
+    return {
+        {"benchmark", "driver_persistence"},
+        {"drivers", driverCount},
+        {"saves_per_second", driverCount / saveSeconds},
+        {"load_all_per_second", loads / loadSeconds},
+        {"drivers_loaded_per_second", loaded / loadSeconds}
+    };
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long long seed = 12345;
+    size_t maxNodes = 110000; // The 1k, 10k and 100k tiers (317 x 317 is 100489 nodes)
+    string outPath;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--max-nodes" && i + 1 < argc)
+            maxNodes = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--out" && i + 1 < argc)
+            outPath = argv[++i];
+    }
+
+    json results = json::array();
+    {
+        QuietConsole quiet; // Routing and persistence still print on failure paths
+
+        for (int side : { 32, 100, 317, 1000 })
+        {
+            if (static_cast<size_t>(side) * side > maxNodes)
+            {
+                break;
+            }
+            for (const string kind : { "grid", "geometric" })
+            {
+                mt19937_64 random(seed + side);
+                GeneratedGraph graph = kind == "grid" ? makeGridGraph(side, side) : makeRandomGeometricGraph(side * side, 6.0, random);
+
+                string label = kind + " " + to_string(graph.nodes.size());
+                progress("astar on " + label);
+                results.push_back(benchAStar(graph, random));
+                progress("route_batch on " + label);
+                results.push_back(benchRouteBatch(graph, random));
+                progress("reachability on " + label);
+                results.push_back(benchReachability(graph, random));
+                for (size_t fleetSize : { 100, 1000, 10000 })
+                {
+                    progress("find_nearest_driver on " + label + ", fleet " + to_string(fleetSize));
+                    results.push_back(benchFindNearestDriver(graph, fleetSize, random));
+                    progress("move_vehicle on " + label + ", fleet " + to_string(fleetSize));
+                    results.push_back(benchMoveVehicle(graph, fleetSize, random));
+                }
+                freeGraph(graph);
+                routeCache.clear();
+            }
+        }
+
+        mt19937_64 random(seed);
+        for (size_t driverCount : { 100, 500 })
+        {
+            progress("driver_persistence, " + to_string(driverCount) + " drivers");
+            results.push_back(benchPersistence(driverCount, random));
+        }
+    }
+
+    json report = {
+        {"seed", seed},
+        {"max_nodes", maxNodes},
+        {"results", results}
+    };
+
+    if (outPath.empty())
+    {
+        cout << report.dump(2) << endl;
+    }
+    else
+    {
+        ofstream out(outPath);
+        out << report.dump(2) << endl;
+        cout << "Wrote " << results.size() << " benchmark results to " << outPath << endl;
+    }
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include <set>
 #include <queue>
 #include <climits>      // For INT_MAX
+#include <cstdio>       // For sscanf()
 #include <algorithm>    // For reverse()
 #include "modules/user.h"
 #include <limits>
@@ -11,6 +12,26 @@
 #include <strings.h>
 #include "modules/vehicle.h"
 #include "modules/edge.h"
+#include "modules/routecache.h"
+#include "modules/routebatch.h"
+#include "modules/matching.h"
+#include "modules/dispatch.h"
+#include "modules/loadgen.h"
+#include "modules/metrics.h"
+#include "modules/logger.h"
+#include "modules/tripevents.h"
+#include "modules/snapshot.h"
+#include "modules/simrandom.h"
+#include "modules/replay.h"
+#include "modules/maprenderer.h"
+#include "modules/congestion.h"
+#include "modules/flowmodel.h"
+#include "modules/pricing.h"
+#include "modules/sharding.h"
+#include "modules/reachability.h"
+#include "modules/mapmatch.h"
+#include "modules/ingest.h"
+#include "modules/rideserver.h"
 #include <functional>
 
 using namespace std;
@@ -19,65 +40,33 @@ vector<Node*> arrayOfNodes;
 
 Driver* createRandomDriver(int age, string name, string email, bool gender, string phoneNumber, string licenseNumber, int yearsOfExperience, string vehicleType);
 
-vector<Edge*> aStar(Node* start, Node* goal) {
-    if (!start || !goal) {
-        cout << "Error: Invalid start or goal node!" << endl;
-        return {};
-    }
-
-    using QueueElement = pair<float, Node*>; // {f_score, Node*}
-    priority_queue<QueueElement, vector<QueueElement>, greater<>> openSet;
-
-    unordered_map<Node*, float> gScore;
-    unordered_map<Node*, Edge*> cameFromEdge;
-    unordered_map<Node*, float> fScore;
-
-    gScore[start] = 0;
-    fScore[start] = Node::heuristic(start, goal);
-    openSet.push({ fScore[start], start });
-
-    while (!openSet.empty()) {
-        Node* current = openSet.top().second;
-        openSet.pop();
-
-        if (current == goal) {
-            // Goal found, reconstruct path
-            vector<Edge*> path;
-            while (cameFromEdge.find(current) != cameFromEdge.end()) {
-                Edge* edge = cameFromEdge[current];
-                path.push_back(edge);
-                current = (edge->node1 == current) ? edge->node2 : edge->node1;
-            }
-            reverse(path.begin(), path.end());
-            return path; // Return the full path as a vector of edges
-        }
-
-        // Explore neighbors
-        for (size_t i = 0; i < current->neighbors.size(); ++i) {
-            Node* neighbor = current->neighbors[i];
-            Edge* edge = current->edges[i];
-            float tentative_gScore = gScore[current] + Node::cost(current, neighbor);
-
-            if (!gScore.count(neighbor) || tentative_gScore < gScore[neighbor]) {
-                cameFromEdge[neighbor] = edge;
-                gScore[neighbor] = tentative_gScore;
-                float fScore = tentative_gScore + Node::heuristic(neighbor, goal);
-                openSet.push({ fScore, neighbor });
-            }
-        }
-    }
-
-    // If we reach here, no path was found
-    cout << "Error: No path found from " << start->id << " to " << goal->id << "!" << endl;
-    return {}; // Return an empty path if no path exists
-}
-
-
-
 void DrawIntersectionCircles(int thickness, Color color, int X, int Y) {
     const int radius = 5;
 }
 
+// Live hot-path timings, toggled with F3
+void drawMetricsOverlay(int x, int y) {
+    vector<MetricSnapshot> snapshots = snapshotMetrics();
+    int lines = static_cast<int>(snapshots.size()) + static_cast<int>(Counter::Count) + 1;
+    DrawRectangle(x - 10, y - 10, 470, lines * 20 + 20, Fade(BLACK, 0.75f));
+
+    DrawText("Metrics (F2 dumps metrics.prom/.json)", x, y, 18, WHITE);
+    y += 22;
+    for (const MetricSnapshot& snapshot : snapshots) {
+        const LatencyHistogram& latency = snapshot.latency;
+        DrawText(TextFormat("%-24s %8llu  p50 %7.1fus  p99 %7.1fus", metricName(snapshot.metric),
+                            static_cast<unsigned long long>(snapshot.calls), latency.percentile(50) / 1000.0, latency.percentile(99) / 1000.0),
+                 x, y, 16, GREEN);
+        y += 20;
+    }
+    for (int c = 0; c < static_cast<int>(Counter::Count); c++) {
+        DrawText(TextFormat("%-24s %8llu", counterName(static_cast<Counter>(c)),
+                            static_cast<unsigned long long>(snapshotCounter(static_cast<Counter>(c)))),
+                 x, y, 16, YELLOW);
+        y += 20;
+    }
+}
+
 bool areEdgesEqual(Edge* edge1, Edge* edge2) {
     // Check if the two edges connect the same two nodes (in any order)
     return (edge1->node1 == edge2->node1 && edge1->node2 == edge2->node2) ||
@@ -176,46 +165,10 @@ Driver signInDriver() {
     return driver;
 }
 
- 
-// Find the nearest driver to the user
-struct DriverDistance {
-    Driver* driver;
-    float distance;
-
-    bool operator>(const DriverDistance& other) const {
-        return distance > other.distance;
-    }
-};
-
-
-// std::priority_queue<DriverDistance, std::vector<DriverDistance>, std::greater<DriverDistance>> driverQueue;
-
-float calculateDistance(Node* node1, Node* node2) {
-    float dx = node1->x - node2->x;
-    float dy = node1->y - node2->y;
-    return sqrt(dx * dx + dy * dy);
-}
-
-Driver* findNearestDriver(Node* userLocation, const std::vector<Driver*>& drivers, const string& vehicleType) {
-    std::priority_queue<DriverDistance, std::vector<DriverDistance>, std::greater<DriverDistance>> driverQueue;
-
-    for (Driver* driver : drivers) {
-        if (driver->availability && driver->assignedVehicle->type == vehicleType) {
-            float distance = calculateDistance(userLocation, driver->assignedVehicle->currentNode);
-            driverQueue.push({driver, distance});
-        }
-    }
-
-    if (!driverQueue.empty()) {
-        return driverQueue.top().driver;
-    }
-
-    return nullptr; // No available drivers
-}
 
 // create random driver
 Driver* createRandomDriver(int age, string name, string email, bool gender, string phoneNumber, string licenseNumber, int yearsOfExperience, string vehicleType) {
-    Node* currentNode = arrayOfNodes[rand() % arrayOfNodes.size()];
+    Node* currentNode = arrayOfNodes[simRandom.index(RandomStream::Drivers, arrayOfNodes.size())];
     Driver * driver = new Driver(age, name, email, gender, phoneNumber, licenseNumber, yearsOfExperience, vehicleType, currentNode);
     driver->saveDriver();
     return driver;
@@ -224,27 +177,111 @@ Driver* createRandomDriver(int age, string name, string email, bool gender, stri
 // Create random vehicle
 Vehicle createRandomVehicle(const std::vector<Node*>& nodes) 
 {
-    Node* currentLocation = nodes[rand() % nodes.size()];
-    string vehicleType = Vehicle::vehicleTypes[rand() % 4]; // Random vehicle type
-    return Vehicle(rand() % 1000 + 1, vehicleType, nodes);
+    Node* currentLocation = nodes[simRandom.index(RandomStream::Vehicles, nodes.size())];
+    string vehicleType = vehicleClassName(static_cast<VehicleClass>(simRandom.index(RandomStream::Vehicles, 4))); // Random vehicle type
+    return Vehicle(static_cast<int>(simRandom.index(RandomStream::Vehicles, 1000)) + 1, vehicleType, nodes);
 }
 
-// Calculate the cost of the path
-float getCost(Vehicle* nearestVehicle, Vehicle* newVehicle) {
-    Node* mid = nearestVehicle->goalNode;
-    Node* end = newVehicle->goalNode;
+// Create several random vehicles at once, routing them in one parallel batch.
+// An empty vehicleType picks a random type per vehicle.
+vector<Vehicle> createRandomVehicles(const std::vector<Node*>& nodes, int count, string vehicleType = "")
+{
+    vector<pair<Node*, Node*>> trips;
+    trips.reserve(count);
+    for (int i = 0; i < count; i++) {
+        size_t k = simRandom.index(RandomStream::Vehicles, nodes.size());
+        size_t j = k;
+        while (j == k) {
+            j = simRandom.index(RandomStream::Vehicles, nodes.size());
+        }
+        trips.push_back({ nodes[k], nodes[j] });
+    }
 
-    float cost = Node::cost(mid, end)/10000000;
+    vector<vector<Edge*>> paths = RouteBatch::solveAll(trips);
+
+    vector<Vehicle> spawned;
+    spawned.reserve(count);
+    for (int i = 0; i < count; i++) {
+        string type = vehicleType.empty() ? vehicleClassName(static_cast<VehicleClass>(simRandom.index(RandomStream::Vehicles, 4))) : vehicleType;
+        spawned.emplace_back(static_cast<int>(simRandom.index(RandomStream::Vehicles, 1000)) + 1, type, trips[i].first, trips[i].second, move(paths[i]));
+    }
+    countMetric(Counter::VehiclesSpawned, spawned.size());
+    return spawned;
+}
 
-    return cost;
+// Print trips folded from the event stream, oldest first
+void printRideHistory(const vector<TripSummary>& trips, const vector<Node*>& nodes) {
+    if (trips.empty()) {
+        cout << "No rides yet.\n";
+        return;
+    }
+    auto nodeName = [&](int id) -> string {
+        for (Node* node : nodes) {
+            if (node->id == id) {
+                return node->name;
+            }
+        }
+        return "?";
+    };
+    for (const TripSummary& trip : trips) {
+        time_t requested = static_cast<time_t>((trip.requestedAt ? trip.requestedAt : trip.pickupAt) / 1000);
+        char when[32] = "";
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M", localtime(&requested));
+        cout << "Ride #" << trip.tripId << " " << when << ": " << nodeName(trip.originNode) << " -> " << nodeName(trip.destinationNode);
+        cout << " | driver " << (trip.driver.empty() ? "-" : trip.driver) << " | rider " << trip.user;
+        if (trip.dropoffAt) {
+            cout << " | fare " << trip.fare;
+        } else {
+            cout << " | not completed";
+        }
+        if (trip.rating >= 0) {
+            cout << " | rated " << trip.rating;
+        }
+        cout << "\n";
+    }
 }
 
 
-int main()
+int main(int argc, char** argv)
 {
+    // Seed the simulation. --record <file> captures the console answers and
+    // button presses of this run, --replay <file> reruns a recording headless.
+    // Both belong to the console run: the headless modes parse their own flags
+    // (for --loadtest, --replay is a demand CSV).
+    const char* headlessModes[] = { "--loadtest", "--flowmodel", "--sharded", "--mapmatch", "--ingest", "--ingest-gen", "--serve" };
+    bool headless = false;
+    for (const char* mode : headlessModes) {
+        if (argc > 1 && string(argv[1]) == mode) {
+            headless = true;
+        }
+    }
+    uint64_t seed = freshSeed();
+    string recordPath, replayPath;
+    for (int a = 1; a + 1 < argc; a++) {
+        string flag = argv[a];
+        if (flag == "--seed") {
+            seed = strtoull(argv[a + 1], nullptr, 10);
+        } else if (flag == "--record" && !headless) {
+            recordPath = argv[a + 1];
+        } else if (flag == "--replay" && !headless) {
+            replayPath = argv[a + 1];
+        }
+    }
+    InputRecorder recorder;
+    if (!replayPath.empty()) {
+        string error;
+        if (!recorder.replay(replayPath, error)) {
+            cerr << "Could not replay " << replayPath << ": " << error << endl;
+            return 1;
+        }
+        seed = recorder.getSeed();
+    } else if (!recordPath.empty() && !recorder.record(recordPath, seed)) {
+        return 1;
+    }
+    simRandom.seed(seed);
+    LOG_INFO("Simulation seed %llu", static_cast<unsigned long long>(seed));
+
     // Create city
-    // Seed the random number generator
-    srand(static_cast<unsigned int>(time(0)));
 
     /*
     "Planeet Namek", "The Abyss", "Crystal Peak", "Colloseum of Fools", "Deepnest", 
@@ -421,7 +458,6 @@ int main()
 
     Vector2 buttonPosition = {120, 950};
     Vector2 buttonSize = {150, 50}; 
-    bool buttonPressed = false;
 
 
     for (Node* node : arrayOfNodes)
@@ -444,7 +480,90 @@ int main()
     }
 
     for (Edge* edge : uniqueEdges) {
-        edge->no_of_agents = edge->max_traffic-(rand()%6);
+        edge->no_of_agents = edge->max_traffic - static_cast<int>(simRandom.index(RandomStream::Occupancy, 6));
+    }
+    routeCache.bumpEpoch(); // Occupancy was overwritten wholesale, drop routes planned before
+
+    // Snapshots cover the graph, signals, vehicles and drivers; F5 saves one
+    vector<TrafficIntersection*> signalNodes(begin(intersections), end(intersections));
+    WorldRefs world{ arrayOfNodes, signalNodes, vehicles, drivers };
+    SnapshotWriter snapshotWriter;
+    for (int a = 1; a + 1 < argc; a++) {
+        if (string(argv[a]) == "--restore") {
+            SnapshotFile snapshot(argv[a + 1]);
+            string error;
+            if (!restoreWorld(snapshot, world, error)) {
+                cerr << "Could not restore " << argv[a + 1] << ": " << error << endl;
+                return 1;
+            }
+            cout << "Restored world from " << argv[a + 1] << endl;
+        }
+    }
+
+    // Congestion aggregates follow the restored or generated counts from here on
+    congestion.attach(arrayOfNodes);
+
+    // Routes to an unreachable goal fail at once from here on. --close-road <id>:<id>
+    // shuts both directions of a road before the run.
+    reachability.attach(arrayOfNodes);
+    for (int a = 1; a + 1 < argc; a++) {
+        if (string(argv[a]) == "--close-road") {
+            int from = 0, to = 0;
+            auto byId = [&](int id) -> Node* {
+                auto found = find_if(arrayOfNodes.begin(), arrayOfNodes.end(), [id](Node* node) { return node->id == id; });
+                return found != arrayOfNodes.end() ? *found : nullptr;
+            };
+            if (sscanf(argv[a + 1], "%d:%d", &from, &to) != 2 || !byId(from) || !byId(to) || !reachability.closeRoad(byId(from), byId(to))) {
+                cerr << "No road " << argv[a + 1] << " to close" << endl;
+                return 1;
+            }
+        }
+    }
+
+    // Headless load test against the dispatch path, no console menu
+    if (argc > 1 && string(argv[1]) == "--loadtest") {
+        return runLoadTest(argc, argv, arrayOfNodes);
+    }
+
+    // Headless macroscopic run over an OD matrix
+    if (argc > 1 && string(argv[1]) == "--flowmodel") {
+        return runFlowModel(argc, argv, arrayOfNodes);
+    }
+
+    // Headless run split over regions on separate threads or processes
+    if (argc > 1 && string(argv[1]) == "--sharded") {
+        return runShardedSim(argc, argv, arrayOfNodes);
+    }
+
+    // Headless map matching of recorded or synthetic position traces
+    if (argc > 1 && string(argv[1]) == "--mapmatch") {
+        return runMapMatch(argc, argv, arrayOfNodes);
+    }
+
+    // Headless ingestion of an external position feed (or writing a synthetic one)
+    if (argc > 1 && (string(argv[1]) == "--ingest" || string(argv[1]) == "--ingest-gen")) {
+        return runIngest(argc, argv, arrayOfNodes);
+    }
+
+    // Rider endpoints over HTTP instead of the console menu, simulation on its own thread
+    if (argc > 1 && string(argv[1]) == "--serve") {
+        return runServer(argc, argv, arrayOfNodes);
+    }
+
+    // Ride requests are matched and routed off the main thread
+    DispatchPipeline dispatcher(drivers);
+    dispatcher.start();
+
+    // Ride lifecycle and vehicle positions, written in the background
+    TripEventLog tripLog(recorder.isReplaying() ? "replay.events" : "trips.events"); // Keep replays out of the ride history
+    tripLog.start();
+
+    // Surge counters start from the drivers available now
+    pricing.attach(arrayOfNodes);
+    for (Driver* driver : drivers) {
+        if (driver->availability) {
+            pricing.driverIdle(driver->currentNode);
+        }
     }
 
     //cout << "Welcome to the Traffic Congestion Control System\n";
@@ -620,6 +739,7 @@ int main()
                 cout << "You selected the starting point: " << locations[start - 1] << "\n";
                 cout << "You selected the destination point: " << locations[end - 1] << "\n";
 
+                VehicleClass requestedClass = vehicleClassOf(vehicleTypes[vehicle - 1]);
                 Vehicle v1(12, vehicleTypes[vehicle - 1], arrayOfNodes);
                 Driver* d6 = createRandomDriver(27, "Arham", "arham@driver.com", true, "03001234567", "ABC123", 10, vehicleTypes[vehicle - 1]);
                 // v1.color = ORANGE;
@@ -627,19 +747,35 @@ int main()
                 vehicles.push_back(v1);
                 d6->assignedVehicle = &v1;
                 drivers.push_back(d6);
+                pricing.driverIdle(d6->currentNode);
 
 
-                Driver* nearestDriver = findNearestDriver(arrayOfNodes[start - 1], drivers, vehicleTypes[vehicle - 1]);
+                uint32_t tripId = 0;
+                FareQuote quote;
+                bool requested = false;
+                uint32_t riderId = tripLog.intern(currentUser.email);
+                Driver* nearestDriver = findNearestDriver(arrayOfNodes[start - 1], drivers, requestedClass);
                 if (nearestDriver != nullptr) 
                 {
                 char choice;
                 cout << "Nearest driver found: " << nearestDriver->name << endl;
                 nearestDriver->display();
+                quote = pricing.quote(arrayOfNodes[start - 1], arrayOfNodes[end - 1], requestedClass);
+                cout << "Estimated fare: " << quote.fare;
+                if (quote.multiplier > 1.01f) {
+                    cout << " (surge x" << quote.multiplier << ")";
+                }
+                cout << endl;
                 cout << "Do you want to request the ride? (Y/N): ";
                 cin >> choice;
                 cin.ignore();
                 if (choice == 'Y' || choice == 'y') {
+                    requested = true;
                     currentUser.requestRide(arrayOfNodes[start - 1], arrayOfNodes[end - 1]);
+                    tripId = tripLog.nextTripId();
+                    Node* origin = arrayOfNodes[start - 1];
+                    tripLog.record(TripEvent{ tripClockMillis(), TripEventType::Requested, tripId, -1, origin->id, origin->x, origin->y, 0, 0, riderId });
+                    pricing.requestOpened(origin);
                 }
                 }
                 else 
@@ -648,35 +784,78 @@ int main()
                     return 0;
                 }
 
-                Vehicle* nearestVehicle = nearestDriver->acceptRide(currentUser);
+                // A declined fare never reaches the pipeline
+                if (!requested) {
+                    cout << "Ride not requested." << endl;
+                    return 0;
+                }
+
+                // The pipeline claims a driver and plans the pickup route on the roads as they are now
+                dispatcher.publishOccupancy();
+                DispatchRequest dispatched;
+                if (!dispatcher.submit(currentUser, requestedClass) || !dispatcher.waitForResult(dispatched)) {
+                    cout << "The dispatcher is not responding, please try again later." << endl;
+                    pricing.requestClosed(arrayOfNodes[start - 1]);
+                    return 0;
+                }
+                pricing.requestClosed(arrayOfNodes[start - 1]);
+                if (dispatched.vehicle == nullptr) {
+                    cout << "Driver unavailable or invalid ride request!" << endl;
+                    return 0;
+                }
+                nearestDriver = dispatched.driver;
+                Vehicle* nearestVehicle = dispatched.vehicle;
+                pricing.driverBusy(nearestDriver->currentNode);
+                uint32_t driverId = tripLog.intern(nearestDriver->email);
+                tripLog.record(TripEvent{ tripClockMillis(), TripEventType::Accepted, tripId, nearestVehicle->id, currentUser.currentLocation->id,
+                                          nearestVehicle->x, nearestVehicle->y, 0, driverId, riderId });
+                size_t pickupVehicle = vehicles.size(); // Index in vehicles of the vehicle driving to the user
                 vehicles.push_back(*nearestVehicle);
                 // nearestDriver->assignedVehicle->color = ORANGE;
-                cout << "Ride color changed for " << nearestDriver->assignedVehicle->type << endl;
+                LOG_DEBUG("Ride color changed for %s", nearestDriver->assignedVehicle->type.c_str());
 
                 if (nearestDriver->assignedVehicle->goalNode == nullptr) {
-                cout << "goal node is null" << endl;
+                LOG_ERROR("goal node is null");
                 }
                 if (nearestDriver->assignedVehicle->userGoalNode == nullptr) {
-                cout << "user goal node is null" << endl;
+                LOG_ERROR("user goal node is null");
                 }
 
-                cout << "path of driver: " << nearestDriver->assignedVehicle->currentNode->name << " to " << nearestDriver->assignedVehicle->goalNode->name << " to " << nearestDriver->assignedVehicle->userGoalNode->name << endl;
-
-                // Raylib window
-                InitWindow(1920, 1080, "Ride Sharing App");
-
-                Image trafficLight = LoadImage("src\\utils\\light.png");
-                Texture2D textureLight = LoadTextureFromImage(trafficLight);
+                LOG_DEBUG("path of driver: %s to %s to %s", nearestDriver->assignedVehicle->currentNode->name.c_str(), nearestDriver->assignedVehicle->goalNode->name.c_str(), nearestDriver->assignedVehicle->userGoalNode->name.c_str());
 
-                SetTargetFPS(60);
+                // Raylib window, not opened when replaying
                 int offsetX = -37;
                 int offsetY = -50;
-                int i = 0;
+                MapRenderer mapRenderer(offsetX, offsetY);
+                if (!recorder.isReplaying()) {
+                    InitWindow(1920, 1080, "Ride Sharing App");
+
+                    Image trafficLight = LoadImage("src\\utils\\light.png");
+                    Texture2D textureLight = LoadTextureFromImage(trafficLight);
+                    mapRenderer.load(arrayOfNodes, uniqueEdges, signalNodes, textureLight);
+
+                    SetTargetFPS(60);
+                }
+                int i = world.lightTick;
 
                 Vehicle* newVehicle = nullptr;
                 bool userReachedDestination = false; // New flag to track if the user has reached the destination
-
-                while (!WindowShouldClose()) {
+                bool showMetrics = false;
+                bool showCongestion = false;
+                uint64_t dropoffAt = 0;
+                size_t rideVehicle = 0;  // Index in vehicles of the vehicle carrying the user
+                uint64_t rideStartTick = 0;
+                uint64_t rideEndTick = 0;
+                int sampleTick = 0;
+                vector<TripEvent> positionSamples;
+
+                // One simulation step: signals, spawns, movement, ride progress.
+                // Shared by the window and the headless replay, so both advance
+                // the world identically.
+                auto simulateTick = [&](int carsToAdd) {
+                    ScopedTimer tickTimer(Metric::SimulationTick, false);
+                    congestion.advance();
+                    pricing.advance(1.0 / 60);
                     i++;
                     if (i == 100) {
                         for (TrafficIntersection* intersection : intersections) {
@@ -684,93 +863,157 @@ int main()
                         }
                         i = 0;
                     }
-                    BeginDrawing();
-                    ClearBackground(LIGHTGRAY);  // Clear the screen
-
-                    // Draw the traffic lights
-                    for (TrafficIntersection* intersection : intersections) {
-                        DrawTextureEx(textureLight, Vector2{ intersection->x + offsetX - 20, intersection->y + offsetY + 5 }, 0.0f, 0.09, WHITE);
-                    }
-
-                    // Check mouse and button interactions
-                    Vector2 mousePosition = GetMousePosition();
-                    bool isMouseOverButton = CheckCollisionPointRec(mousePosition, Rectangle{buttonPosition.x, buttonPosition.y, buttonSize.x, buttonSize.y});
 
-                    if (isMouseOverButton && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                        buttonPressed = true;
-                    }
-
-                    if (isMouseOverButton) {
-                        DrawRectangle(buttonPosition.x, buttonPosition.y, buttonSize.x, buttonSize.y, LIGHTGRAY);
-                    } else {
-                        DrawRectangle(buttonPosition.x, buttonPosition.y, buttonSize.x, buttonSize.y, DARKGRAY);
-                    }
-
-                    // Draw button text
-                    DrawText("Add car", buttonPosition.x + 37, buttonPosition.y + 15, 20, RED);
-
-                    // Display the result of button press
-                    if (buttonPressed) {
-                        int k = rand() % 24;
-                        int j = k;
-                        while (j == k) {
-                            j = rand() % 24;
+                    if (carsToAdd > 0) {
+                        for (Vehicle& vehicle : createRandomVehicles(arrayOfNodes, carsToAdd, "Car")) {
+                            vehicles.push_back(vehicle);
                         }
-                        Vehicle vehicle(1, "Car", arrayOfNodes[k], arrayOfNodes[j]);
-                        vehicles.push_back(vehicle);
-                        buttonPressed = false;
-                    }
-
-                    // Draw the nodes and edges
-                    for (Node* node : arrayOfNodes) {
-                        DrawCircle(node->x + offsetX, node->y + offsetY, 5, RED);
-                        const char* name = node->name.c_str();
-                        DrawText(name, node->x + offsetX - 30, node->y + offsetY - 20, 20, PINK);
-                    }
-
-                    for (Edge* edge : uniqueEdges) {
-                        DrawLine(edge->node1->x + offsetX, edge->node1->y + offsetY, edge->node2->x + offsetX, edge->node2->y + offsetY, RED);
-                        float midpointX = (edge->node1->x + edge->node2->x) / 2.0f;
-                        float midpointY = (edge->node1->y + edge->node2->y) / 2.0f;
-                        string congestionString = to_string(edge->no_of_agents);
-                        const char* congestion = congestionString.c_str();
-                        DrawText(congestion, midpointX + offsetX, midpointY + offsetY - 20, 25, BLACK);
                     }
 
-                    for (Vehicle& v : vehicles) {
+                    // By index: starting the ride appends to vehicles, which
+                    // may reallocate; the new vehicle moves from the next tick
+                    size_t moving = vehicles.size();
+                    for (size_t k = 0; k < moving; k++) {
+                        Vehicle& v = vehicles[k];
                         if (!v.hasReachedDestination) {
-                            DrawRectangle(v.x + offsetX, v.y + offsetY, 25, 30, v.color);
-
                             if (v.moveVehicle()) {
-                                cout << "Vehicle reached destination" << v.id << endl;
+                                LOG_INFO("Vehicle %d reached destination", v.id);
                                 v.hasReachedDestination = true;
                                 nearestDriver->availability = true;
                             }
                         } else if (v.id == 0 && nearestDriver->availability && !nearestDriver->reachedDestination) {
-                            cout << "Starting ride" << endl;
+                            LOG_INFO("Starting ride");
+                            tripLog.record(TripEvent{ tripClockMillis(), TripEventType::Pickup, tripId, v.id, currentUser.currentLocation->id,
+                                                      v.x, v.y, 0, driverId, riderId });
                             newVehicle = nearestDriver->startRide(currentUser);
                             nearestDriver->assignedVehicle = newVehicle;
+                            rideVehicle = vehicles.size();
+                            rideStartTick = congestion.getTick();
                             vehicles.push_back(*newVehicle);
                         }
                     }
+                    tickTimer.stop();
+
+                    // Sample every vehicle still moving twice a second
+                    if (++sampleTick == 30) {
+                        sampleTick = 0;
+                        uint64_t now = tripClockMillis();
+                        positionSamples.clear();
+                        for (const Vehicle& v : vehicles) {
+                            if (!v.hasReachedDestination) {
+                                bool onRide = v.id == 0;
+                                positionSamples.push_back(TripEvent{ now, TripEventType::Position, onRide ? tripId : 0, v.id, -1, v.x, v.y, 0,
+                                                                     onRide ? driverId : 0, onRide ? riderId : 0 });
+                            }
+                        }
+                        tripLog.record(positionSamples);
+                    }
 
                     // Check if the nearest driver has reached the destination
                     if (nearestDriver->reachedDestination && !userReachedDestination && newVehicle->hasReachedDestination) {
                         userReachedDestination = true; // Set the flag
+                        dropoffAt = tripClockMillis();
+                        rideEndTick = congestion.getTick();
                     }
+                    recorder.endTick();
+                };
+
+                while (recorder.isReplaying() ? !recorder.closeDue() : !WindowShouldClose()) {
+                    if (recorder.isReplaying()) {
+                        simulateTick(recorder.addCars(0));
+                        continue;
+                    }
+
+                    if (IsKeyPressed(KEY_F3)) {
+                        showMetrics = !showMetrics;
+                    }
+                    if (IsKeyPressed(KEY_F5)) {
+                        world.lightTick = i;
+                        snapshotWriter.save(world, "world.snap");
+                    }
+                    if (IsKeyPressed(KEY_F2)) {
+                        writeMetricsFile("metrics.prom");
+                        writeMetricsFile("metrics.json");
+                    }
+                    if (IsKeyPressed(KEY_F6)) {
+                        congestion.writeRoadsCsv("congestion-roads.csv");
+                        congestion.writeGridCsv("congestion-grid.csv");
+                    }
+                    if (IsKeyPressed(KEY_C)) {
+                        showCongestion = !showCongestion;
+                    }
+
+                    // Check mouse and button interactions
+                    Vector2 mousePosition = GetMousePosition();
+                    bool isMouseOverButton = CheckCollisionPointRec(mousePosition, Rectangle{buttonPosition.x, buttonPosition.y, buttonSize.x, buttonSize.y});
+
+                    int carsToAdd = 0;
+                    if (isMouseOverButton && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+                        carsToAdd = 1;
+                    }
+                    if (isMouseOverButton && IsMouseButtonPressed(MOUSE_RIGHT_BUTTON)) {
+                        carsToAdd = 50; // Right click spawns a whole batch
+                    }
+
+                    simulateTick(recorder.addCars(carsToAdd));
+
+                    // Drawing only: the tick has its own metric, and EndDrawing waits for the frame limiter
+                    ScopedTimer renderTimer(Metric::RenderFrame, false);
+                    BeginDrawing();
+                    ClearBackground(LIGHTGRAY);  // Clear the screen
+
+                    // Roads, names and signal posts come from a cached layer
+                    mapRenderer.handleInput(!isMouseOverButton);
+                    mapRenderer.drawMap();
+                    if (showCongestion) {
+                        mapRenderer.drawCongestion(congestion);
+                    }
+
+                    if (isMouseOverButton) {
+                        DrawRectangle(buttonPosition.x, buttonPosition.y, buttonSize.x, buttonSize.y, LIGHTGRAY);
+                    } else {
+                        DrawRectangle(buttonPosition.x, buttonPosition.y, buttonSize.x, buttonSize.y, DARKGRAY);
+                    }
+
+                    // Draw button text
+                    DrawText("Add car", buttonPosition.x + 37, buttonPosition.y + 15, 20, RED);
+
+                    mapRenderer.drawLabels();
+                    mapRenderer.drawVehicles(vehicles);
+                    mapRenderer.drawStatus(20, 1050);
 
                     // Display the message when the user has reached the destination
                     if (userReachedDestination) {
                         DrawText("You have reached your destination!", 800, 500, 30, GREEN);
                     }
 
+                    if (showMetrics) {
+                        drawMetricsOverlay(1420, 20);
+                    }
+
+                    renderTimer.stop();
                     EndDrawing();
                 }
-                CloseWindow();
+                world.lightTick = i;
+                recorder.windowClosed(worldDigest(world));
+                if (!recorder.isReplaying()) {
+                    mapRenderer.unload();
+                    CloseWindow();
+                }
 
                 cout << "VEHICLE REACHED DESTINATION..." << endl;
-                float cost = getCost(nearestVehicle, newVehicle);
+                // Metered on the edges the ride vehicle drove and the simulated ride time, at the quoted surge
+                float distance = newVehicle ? vehicles[rideVehicle].odometer : 0;
+                uint64_t meteredTo = rideEndTick ? rideEndTick : congestion.getTick(); // Window closed mid-ride
+                double rideSeconds = newVehicle && meteredTo > rideStartTick ? (meteredTo - rideStartTick) / 60.0 : 0;
+                float cost = pricing.fare(quote, distance, rideSeconds, nearestDriver->vehicleClass);
                 cout << "Total cost of the ride: " << cost << endl;
+                Node* destination = arrayOfNodes[end - 1];
+                tripLog.record(TripEvent{ dropoffAt ? dropoffAt : tripClockMillis(), TripEventType::Dropoff, tripId, 0, destination->id,
+                                          destination->x, destination->y, cost, driverId, riderId });
+                routeCache.display();
+                reachability.display();
+                dispatcher.display();
 
 
                 // Prompt user for rating
@@ -788,8 +1031,12 @@ int main()
 
                     // Update and save driver rating
                     nearestDriver->takeRating(rating);
+                    tripLog.record(TripEvent{ tripClockMillis(), TripEventType::Rating, tripId, 0, -1, 0, 0, static_cast<float>(rating), driverId, riderId });
+                    // The driver waits where the ride ended: the dropoff, or wherever the window was closed
+                    nearestDriver->currentNode = vehicles[newVehicle ? rideVehicle : pickupVehicle].currentNode;
                     nearestDriver->availability = true;
                     nearestDriver->reachedDestination = false;
+                    pricing.driverIdle(nearestDriver->currentNode);
                     nearestDriver->saveDriver();
 
                     // Print updated driver ratings
@@ -814,8 +1061,14 @@ int main()
             }
             break;
         case 2:
+        {
             cout << "Viewing ride history...\n";
+            tripLog.flush();
+            TripQuery query;
+            query.user = currentUser.email;
+            printRideHistory(summarizeTrips("trips.events", query), arrayOfNodes);
             break;
+        }
         case 3:
             cout << "Exiting the program...\n";
             return 0;
@@ -843,8 +1096,14 @@ int main()
             cout << "Accepting a ride...\n";
             break;
         case 2:
+        {
             cout << "Viewing ride history...\n";
+            tripLog.flush();
+            TripQuery query;
+            query.driver = currentDriver.email;
+            printRideHistory(summarizeTrips("trips.events", query), arrayOfNodes);
             break;
+        }
         case 3:
             cout << "Exiting the program...\n";
             return 0;
@@ -0,0 +1,315 @@
+#include "congestion.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+CongestionMap congestion;
+
+CongestionMap::CongestionMap(uint32_t bucketTicks, double emaTicks)
+    : bucketTicks(max(bucketTicks, 1u)), emaTicks(emaTicks), now(0), minX(0), minY(0), cellSize(1), columns(0), rows(0), totalAgents(0), totalCapacity(0) {}
+
+void CongestionMap::attach(const vector<Node*>& nodes)
+{
+    roads.clear();
+    for (Node* node : nodes)
+    {
+        for (Edge* edge : node->edges)
+        {
+            edge->congestionSlot = -1;
+        }
+    }
+
+    // One road per node pair, whichever direction is seen first owns the count
+    float maxX = 0, maxY = 0;
+    minX = minY = 0;
+    for (Node* node : nodes)
+    {
+        for (Edge* edge : node->edges)
+        {
+            if (edge->congestionSlot >= 0)
+            {
+                continue;
+            }
+            Edge* reverse = Node::findEdge(edge->node2, edge->node1);
+            edge->congestionSlot = static_cast<int>(roads.size());
+            if (reverse)
+            {
+                reverse->congestionSlot = edge->congestionSlot;
+            }
+            roads.push_back(Road{ edge, reverse, 0, static_cast<float>(max(edge->max_traffic, 1)), 0 });
+
+            float x = (edge->node1->x + edge->node2->x) / 2;
+            float y = (edge->node1->y + edge->node2->y) / 2;
+            if (roads.size() == 1)
+            {
+                minX = maxX = x;
+                minY = maxY = y;
+            }
+            minX = min(minX, x);
+            minY = min(minY, y);
+            maxX = max(maxX, x);
+            maxY = max(maxY, y);
+        }
+    }
+
+    // Heatmap cells of about 16 roads each, at most 128 a side
+    float extent = max(max(maxX - minX, maxY - minY), 1.0f);
+    int side = max(1, min(128, static_cast<int>(sqrt(roads.size() / 16.0))));
+    cellSize = extent / side * 1.0001f; // Keeps the far edge inside the last cell
+    columns = max(1, static_cast<int>(ceil((maxX - minX) / cellSize + 1e-6)));
+    rows = max(1, static_cast<int>(ceil((maxY - minY) / cellSize + 1e-6)));
+    cellCapacity.assign(static_cast<size_t>(columns) * rows, 0);
+    for (Road& road : roads)
+    {
+        float x = (road.forward->node1->x + road.forward->node2->x) / 2;
+        float y = (road.forward->node1->y + road.forward->node2->y) / 2;
+        int cx = min(columns - 1, static_cast<int>((x - minX) / cellSize));
+        int cy = min(rows - 1, static_cast<int>((y - minY) / cellSize));
+        road.cell = cy * columns + cx;
+        cellCapacity[road.cell] += road.capacity;
+    }
+    resync();
+}
+
+void CongestionMap::resync()
+{
+    Series fresh;
+    fresh.updatedAt = now;
+    fresh.bucket = now / bucketTicks;
+
+    roadSeries.assign(roads.size(), fresh);
+    cellAgents.assign(cellCapacity.size(), 0);
+    cellSeries.assign(cellCapacity.size(), fresh);
+    networkSeries = fresh;
+    totalAgents = 0;
+    totalCapacity = 0;
+    for (size_t slot = 0; slot < roads.size(); slot++)
+    {
+        Road& road = roads[slot];
+        road.agents = road.forward->no_of_agents;
+        roadSeries[slot].value = roadSeries[slot].ema = road.agents / road.capacity;
+        cellAgents[road.cell] += road.agents;
+        totalAgents += road.agents;
+        totalCapacity += road.capacity;
+    }
+    for (size_t cell = 0; cell < cellSeries.size(); cell++)
+    {
+        float value = cellCapacity[cell] > 0 ? cellAgents[cell] / cellCapacity[cell] : 0;
+        cellSeries[cell].value = cellSeries[cell].ema = value;
+    }
+    networkSeries.value = networkSeries.ema = totalCapacity > 0 ? totalAgents / totalCapacity : 0;
+}
+
+void CongestionMap::copyAgents(vector<int>& agents) const
+{
+    agents.resize(roads.size());
+    for (size_t slot = 0; slot < roads.size(); slot++)
+    {
+        agents[slot] = roads[slot].agents;
+    }
+}
+
+int CongestionMap::slotOf(const Edge* edge) const
+{
+    // Edges of graphs that were never attached (or were replaced) are ignored
+    int slot = edge ? edge->congestionSlot : -1;
+    if (slot < 0 || slot >= static_cast<int>(roads.size()) || (roads[slot].forward != edge && roads[slot].backward != edge))
+    {
+        return -1;
+    }
+    return slot;
+}
+
+void CongestionMap::bringForward(Series& series) const
+{
+    uint64_t at = series.updatedAt;
+    if (at >= now)
+    {
+        return;
+    }
+    series.ema = static_cast<float>(series.value + (series.ema - series.value) * exp(-static_cast<double>(now - at) / emaTicks));
+
+    while (at < now)
+    {
+        uint64_t bucketEnd = (series.bucket + 1) * bucketTicks;
+        uint64_t stop = min(now, bucketEnd);
+        series.bucketArea += static_cast<double>(series.value) * (stop - at);
+        at = stop;
+        if (at < bucketEnd)
+        {
+            break;
+        }
+        series.buckets[series.bucket % bucketCount] = static_cast<float>(series.bucketArea / bucketTicks);
+        series.filled = min<uint32_t>(series.filled + 1, bucketCount);
+        series.bucket++;
+        series.bucketArea = 0;
+
+        // Idle for longer than the ring: every bucket holds the constant value
+        if (now - at >= static_cast<uint64_t>(bucketTicks) * bucketCount)
+        {
+            fill(begin(series.buckets), end(series.buckets), series.value);
+            series.filled = bucketCount;
+            series.bucket = now / bucketTicks;
+            at = series.bucket * bucketTicks;
+        }
+    }
+    series.updatedAt = now;
+}
+
+void CongestionMap::set(Series& series, float value) const
+{
+    bringForward(series);
+    series.value = value;
+}
+
+void CongestionMap::noteOccupancyChange(const Edge* edge, int delta)
+{
+    int slot = delta != 0 ? slotOf(edge) : -1;
+    if (slot < 0)
+    {
+        return;
+    }
+    // The owning direction's count is the road's, whichever direction moved
+    Road& road = roads[slot];
+    int change = road.forward->no_of_agents - road.agents;
+    if (change == 0)
+    {
+        return;
+    }
+    road.agents += change;
+    set(roadSeries[slot], road.agents / road.capacity);
+
+    cellAgents[road.cell] += change;
+    set(cellSeries[road.cell], cellAgents[road.cell] / cellCapacity[road.cell]);
+
+    totalAgents += change;
+    set(networkSeries, totalAgents / totalCapacity);
+}
+
+float CongestionMap::ratio(const Edge* edge) const
+{
+    int slot = slotOf(edge);
+    return slot < 0 ? 0 : roadSeries[slot].value;
+}
+
+float CongestionMap::average(const Edge* edge) const
+{
+    int slot = slotOf(edge);
+    if (slot < 0)
+    {
+        return 0;
+    }
+    bringForward(roadSeries[slot]);
+    return roadSeries[slot].ema;
+}
+
+vector<float> CongestionMap::historyOf(Series& series) const
+{
+    bringForward(series);
+    vector<float> values;
+    values.reserve(series.filled);
+    for (uint32_t k = series.filled; k > 0; k--)
+    {
+        values.push_back(series.buckets[(series.bucket - k) % bucketCount]);
+    }
+    return values;
+}
+
+vector<float> CongestionMap::history(const Edge* edge) const
+{
+    int slot = slotOf(edge);
+    return slot < 0 ? vector<float>() : historyOf(roadSeries[slot]);
+}
+
+void CongestionMap::cellBounds(int cx, int cy, float& x, float& y, float& size) const
+{
+    x = minX + cx * cellSize;
+    y = minY + cy * cellSize;
+    size = cellSize;
+}
+
+float CongestionMap::cellRatio(int cx, int cy) const
+{
+    return cellSeries[static_cast<size_t>(cy) * columns + cx].value;
+}
+
+float CongestionMap::cellAverage(int cx, int cy) const
+{
+    Series& series = cellSeries[static_cast<size_t>(cy) * columns + cx];
+    bringForward(series);
+    return series.ema;
+}
+
+float CongestionMap::networkRatio() const
+{
+    return networkSeries.value;
+}
+
+float CongestionMap::networkAverage() const
+{
+    bringForward(networkSeries);
+    return networkSeries.ema;
+}
+
+vector<float> CongestionMap::networkHistory() const
+{
+    return historyOf(networkSeries);
+}
+
+bool CongestionMap::writeRoadsCsv(const string& path) const
+{
+    ofstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    file << "tick,from,to,agents,capacity,ratio,average";
+    for (int b = bucketCount; b > 0; b--)
+    {
+        file << ",bucket-" << b; // bucket-1 is the most recent
+    }
+    file << "\n";
+    for (size_t slot = 0; slot < roads.size(); slot++)
+    {
+        const Road& road = roads[slot];
+        vector<float> buckets = historyOf(roadSeries[slot]);
+        file << now << "," << road.forward->node1->id << "," << road.forward->node2->id << "," << road.agents << "," << road.capacity << ","
+             << roadSeries[slot].value << "," << roadSeries[slot].ema;
+        for (size_t b = buckets.size(); b < bucketCount; b++)
+        {
+            file << ",";
+        }
+        for (float value : buckets)
+        {
+            file << "," << value;
+        }
+        file << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+bool CongestionMap::writeGridCsv(const string& path) const
+{
+    ofstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    file << "tick,column,row,x,y,size,agents,capacity,ratio,average\n";
+    for (int cy = 0; cy < rows; cy++)
+    {
+        for (int cx = 0; cx < columns; cx++)
+        {
+            size_t cell = static_cast<size_t>(cy) * columns + cx;
+            if (cellCapacity[cell] <= 0)
+            {
+                continue;
+            }
+            float x, y, size;
+            cellBounds(cx, cy, x, y, size);
+            file << now << "," << cx << "," << cy << "," << x << "," << y << "," << size << "," << cellAgents[cell] << "," << cellCapacity[cell] << ","
+                 << cellSeries[cell].value << "," << cellAverage(cx, cy) << "\n";
+        }
+    }
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,113 @@
+#ifndef CONGESTION_H
+#define CONGESTION_H
+
+#include "edge.h"
+#include "node.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Live congestion aggregates, kept up to date from the agent count deltas of
+// Vehicle::updateEdgeAgentCount instead of rescanning edges:
+//   per road   occupancy ratio (agents / max_traffic), its exponential moving
+//              average over simulation ticks, and the mean ratio of each of
+//              the last bucketCount time buckets
+//   per cell   the same for a coarse grid over the map (the heatmap)
+//   network    the same for the whole graph
+// Both directions of a road share one entry, as they share one count. Signals
+// are piecewise constant between changes, so averages are brought forward
+// lazily when an entry changes or is read. Simulation thread only.
+class CongestionMap
+{
+public:
+    static const int bucketCount = 12;
+
+    CongestionMap(uint32_t bucketTicks = 600, double emaTicks = 300);
+
+    // Registers the roads of a graph, replacing any previous one, and reads
+    // their current counts. Call again after counts were set wholesale.
+    void attach(const vector<Node*>& nodes);
+    void resync();
+
+    // One simulation tick passed
+    void advance() { now++; }
+    uint64_t getTick() const { return now; }
+
+    // Called after an edge's agent count changed
+    void noteOccupancyChange(const Edge* edge, int delta);
+
+    float ratio(const Edge* edge) const;
+    float average(const Edge* edge) const;
+    // Mean ratio per finished bucket, oldest first (fewer before they fill)
+    vector<float> history(const Edge* edge) const;
+
+    int getColumns() const { return columns; }
+    int getRows() const { return rows; }
+    void cellBounds(int cx, int cy, float& x, float& y, float& size) const;
+    float cellRatio(int cx, int cy) const;
+    float cellAverage(int cx, int cy) const;
+
+    float networkRatio() const;
+    float networkAverage() const;
+    vector<float> networkHistory() const;
+
+    size_t roadCount() const { return roads.size(); }
+
+    // Agent count of every road by Edge::congestionSlot, for routing off the
+    // simulation thread on a copy that stays consistent while vehicles move
+    void copyAgents(vector<int>& agents) const;
+
+    // Analytics exports: one row per road / per occupied grid cell
+    bool writeRoadsCsv(const string& path) const;
+    bool writeGridCsv(const string& path) const;
+
+private:
+    // A ratio signal with its lazily advanced average and bucket ring
+    struct Series
+    {
+        float value = 0;
+        float ema = 0;
+        uint64_t updatedAt = 0;
+        double bucketArea = 0;  // Sum of value over the ticks of the open bucket
+        uint64_t bucket = 0;    // Index of the open bucket
+        uint32_t filled = 0;    // Finished buckets in the ring, up to bucketCount
+        float buckets[bucketCount] = {};
+    };
+
+    struct Road
+    {
+        const Edge* forward;
+        const Edge* backward;
+        int agents;
+        float capacity;
+        int cell;
+    };
+
+    void bringForward(Series& series) const;
+    void set(Series& series, float value) const;
+    int slotOf(const Edge* edge) const;
+    vector<float> historyOf(Series& series) const;
+
+    uint32_t bucketTicks;
+    double emaTicks;
+    uint64_t now;
+
+    vector<Road> roads;
+    mutable vector<Series> roadSeries;
+
+    float minX, minY, cellSize;
+    int columns, rows;
+    vector<int> cellAgents;
+    vector<float> cellCapacity;
+    mutable vector<Series> cellSeries;
+
+    int totalAgents;
+    float totalCapacity;
+    mutable Series networkSeries;
+};
+
+extern CongestionMap congestion;
+
+#endif
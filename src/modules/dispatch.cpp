@@ -0,0 +1,247 @@
+#include "dispatch.h"
+#include "routebatch.h"
+#include "congestion.h"
+#include <algorithm>
+#include <chrono>
+
+uint64_t nowNanoseconds()
+{
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Spin briefly, then yield, then sleep so idle stages do not burn a core
+static void backoff(int& idleRounds)
+{
+    idleRounds++;
+    if (idleRounds < 64)
+    {
+        return;
+    }
+    if (idleRounds < 128)
+    {
+        this_thread::yield();
+        return;
+    }
+    this_thread::sleep_for(chrono::microseconds(100));
+}
+
+DispatchPipeline::DispatchPipeline(vector<Driver*>& drivers, size_t queueCapacity, size_t maxCandidates, size_t routeBatchSize)
+    : drivers(drivers), maxCandidates(maxCandidates), routeBatchSize(routeBatchSize),
+      intake(queueCapacity), searched(queueCapacity), matched(queueCapacity), completed(queueCapacity),
+      running(false), nextId(1), submitted(0), delivered(0) {}
+
+DispatchPipeline::~DispatchPipeline()
+{
+    stop();
+}
+
+void DispatchPipeline::start()
+{
+    if (running.exchange(true))
+    {
+        return;
+    }
+    stages.emplace_back(&DispatchPipeline::searchStage, this);
+    stages.emplace_back(&DispatchPipeline::matchStage, this);
+    stages.emplace_back(&DispatchPipeline::routeStage, this);
+}
+
+void DispatchPipeline::stop()
+{
+    running.store(false);
+    for (thread& stage : stages)
+    {
+        stage.join();
+    }
+    stages.clear();
+}
+
+bool DispatchPipeline::submit(const User& user, VehicleClass vehicleClass, uint64_t* requestId)
+{
+    DispatchRequest request;
+    request.id = nextId.fetch_add(1, memory_order_relaxed);
+    request.user = user;
+    request.vehicleClass = vehicleClass;
+    request.submittedAt = nowNanoseconds();
+
+    uint64_t id = request.id;
+    if (!intake.tryPush(move(request)))
+    {
+        return false;
+    }
+    submitted.fetch_add(1, memory_order_release);
+    if (requestId)
+    {
+        *requestId = id;
+    }
+    return true;
+}
+
+void DispatchPipeline::publishOccupancy()
+{
+    lock_guard<mutex> guard(occupancyLock);
+    congestion.copyAgents(publishedOccupancy);
+    occupancyFresh = true;
+}
+
+bool DispatchPipeline::poll(DispatchRequest& result)
+{
+    if (!completed.tryPop(result))
+    {
+        return false;
+    }
+    delivered.fetch_add(1, memory_order_release);
+    return true;
+}
+
+bool DispatchPipeline::waitForResult(DispatchRequest& result, int timeoutMillis)
+{
+    uint64_t deadline = nowNanoseconds() + static_cast<uint64_t>(max(timeoutMillis, 0)) * 1000000;
+    int idleRounds = 0;
+    while (!poll(result))
+    {
+        if (inFlight() == 0 || !running.load(memory_order_relaxed) || nowNanoseconds() >= deadline)
+        {
+            return false;
+        }
+        backoff(idleRounds);
+    }
+    return true;
+}
+
+bool DispatchPipeline::forward(SpscQueue<DispatchRequest>& queue, DispatchRequest& request)
+{
+    int idleRounds = 0;
+    while (!queue.tryPush(move(request)))
+    {
+        if (!running.load(memory_order_relaxed))
+        {
+            return false;
+        }
+        backoff(idleRounds);
+    }
+    return true;
+}
+
+void DispatchPipeline::searchStage()
+{
+    DispatchRequest request;
+    int idleRounds = 0;
+    while (running.load(memory_order_relaxed))
+    {
+        if (!intake.tryPop(request))
+        {
+            backoff(idleRounds);
+            continue;
+        }
+        idleRounds = 0;
+
+        if (partitions.driverCount() != drivers.size())
+        {
+            partitions.assign(drivers); // The vector only changes between requests
+        }
+        request.candidates = findCandidateDrivers(request.user.currentLocation, partitions.of(request.vehicleClass), request.vehicleClass, maxCandidates);
+        request.searchedAt = nowNanoseconds();
+        searchLatency.record(request.searchedAt - request.submittedAt);
+        forward(searched, request);
+    }
+}
+
+void DispatchPipeline::matchStage()
+{
+    DispatchRequest request;
+    int idleRounds = 0;
+    while (running.load(memory_order_relaxed))
+    {
+        if (!searched.tryPop(request))
+        {
+            backoff(idleRounds);
+            continue;
+        }
+        idleRounds = 0;
+
+        // The claim is atomic: the simulation thread may take or free drivers meanwhile
+        if (request.user.rideState == RideState::Requested)
+        {
+            for (const DriverDistance& candidate : request.candidates)
+            {
+                if (candidate.driver->availability.claim())
+                {
+                    request.driver = candidate.driver;
+                    break;
+                }
+            }
+        }
+        request.matchedAt = nowNanoseconds();
+        matchLatency.record(request.matchedAt - request.searchedAt);
+        forward(matched, request);
+    }
+}
+
+void DispatchPipeline::routeStage()
+{
+    vector<DispatchRequest> group;
+    group.reserve(routeBatchSize);
+    RouteBatch batch(defaultThreadPool(), false); // The cache holds routes on live counts
+    batch.setOccupancy(&routeOccupancy);
+    int idleRounds = 0;
+
+    while (running.load(memory_order_relaxed))
+    {
+        DispatchRequest request;
+        while (group.size() < routeBatchSize && matched.tryPop(request))
+        {
+            group.push_back(move(request));
+        }
+        if (group.empty())
+        {
+            backoff(idleRounds);
+            continue;
+        }
+        idleRounds = 0;
+
+        {
+            lock_guard<mutex> guard(occupancyLock);
+            if (occupancyFresh)
+            {
+                routeOccupancy.swap(publishedOccupancy);
+                occupancyFresh = false;
+            }
+        }
+        batch.clear();
+        for (DispatchRequest& pending : group)
+        {
+            if (pending.driver)
+            {
+                batch.add(pending.driver->currentNode, pending.user.currentLocation);
+            }
+        }
+        vector<vector<Edge*>> paths = batch.solve();
+
+        size_t next = 0;
+        for (DispatchRequest& pending : group)
+        {
+            if (pending.driver)
+            {
+                pending.vehicle = pending.driver->assignRide(pending.user, move(paths[next++]));
+            }
+            pending.routedAt = nowNanoseconds();
+            routeLatency.record(pending.routedAt - pending.matchedAt);
+            totalLatency.record(pending.routedAt - pending.submittedAt);
+            if (!forward(completed, pending))
+            {
+                break;
+            }
+        }
+        group.clear();
+    }
+}
+
+void DispatchPipeline::display() const
+{
+    cout << "Dispatch pipeline: " << submitted.load() << " submitted, " << delivered.load() << " delivered, " << inFlight() << " in flight" << endl;
+    cout << "  search: " << searchLatency.summary() << endl;
+    cout << "  match:  " << matchLatency.summary() << endl;
+    cout << "  route:  " << routeLatency.summary() << endl;
+    cout << "  total:  " << totalLatency.summary() << endl;
+}
@@ -0,0 +1,115 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "user.h"
+#include "driver.h"
+#include "matching.h"
+#include "histogram.h"
+#include "spscqueue.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+// A ride request as it travels through the dispatch pipeline
+struct DispatchRequest
+{
+    uint64_t id = 0;
+    User user;                          // Copy of the rider, rideState must be Requested
+    VehicleClass vehicleClass = VehicleClass::Car;
+    vector<DriverDistance> candidates;  // Filled by the search stage, nearest first
+    Driver* driver = nullptr;           // Claimed by the matching stage, nullptr if none was free
+    Vehicle* vehicle = nullptr;         // Pickup vehicle built by the routing stage
+
+    // Steady clock timestamps in nanoseconds
+    uint64_t submittedAt = 0;
+    uint64_t searchedAt = 0;
+    uint64_t matchedAt = 0;
+    uint64_t routedAt = 0;
+};
+
+// Ride requests flow intake -> candidate search -> matching -> routing, each
+// stage on its own thread with a bounded lock-free queue in between. Matching
+// claims drivers through their atomic availability flag, so it never races
+// the simulation taking or freeing them. Routing drains matched requests in
+// groups and plans their pickup paths as one RouteBatch, against the edge
+// occupancy the simulation last published rather than the live counts. A full
+// queue stalls the stage feeding it, so submit() fails once the pipeline is
+// saturated.
+//
+// submit(), poll() and publishOccupancy() must be called from the simulation
+// thread, and the drivers vector must not change while requests are in flight.
+class DispatchPipeline
+{
+public:
+    DispatchPipeline(vector<Driver*>& drivers, size_t queueCapacity = 1024, size_t maxCandidates = 8, size_t routeBatchSize = 64);
+    ~DispatchPipeline();
+
+    void start();
+    void stop();
+
+    // Queue a request; returns false when intake is full (backpressure)
+    bool submit(const User& user, VehicleClass vehicleClass, uint64_t* requestId = nullptr);
+
+    // Copy the road occupancy (from the congestion map) for routing; call
+    // between ticks. Until the first call pickups are routed on empty roads.
+    void publishOccupancy();
+
+    // Take one finished request if any
+    bool poll(DispatchRequest& result);
+
+    // Block until the next finished request arrives; false when nothing is in
+    // flight, the pipeline stopped, or timeoutMillis passed without a result
+    bool waitForResult(DispatchRequest& result, int timeoutMillis = 5000);
+
+    uint64_t inFlight() const { return submitted.load(memory_order_acquire) - delivered.load(memory_order_acquire); }
+
+    const LatencyHistogram& getSearchLatency() const { return searchLatency; }
+    const LatencyHistogram& getMatchLatency() const { return matchLatency; }
+    const LatencyHistogram& getRouteLatency() const { return routeLatency; }
+    const LatencyHistogram& getTotalLatency() const { return totalLatency; }
+
+    void display() const;
+
+private:
+    void searchStage();
+    void matchStage();
+    void routeStage();
+
+    // Push downstream, waiting while the next stage is full
+    bool forward(SpscQueue<DispatchRequest>& queue, DispatchRequest& request);
+
+    vector<Driver*>& drivers;
+    FleetPartitions partitions; // Search stage only, rebuilt when drivers are added
+    size_t maxCandidates;
+    size_t routeBatchSize;
+
+    SpscQueue<DispatchRequest> intake;
+    SpscQueue<DispatchRequest> searched;
+    SpscQueue<DispatchRequest> matched;
+    SpscQueue<DispatchRequest> completed;
+
+    mutex occupancyLock;            // Guards publishedOccupancy and occupancyFresh
+    vector<int> publishedOccupancy;
+    bool occupancyFresh = false;
+    vector<int> routeOccupancy;     // Route stage's copy, swapped in when fresh
+
+    vector<thread> stages;
+    atomic<bool> running;
+    atomic<uint64_t> nextId;
+    atomic<uint64_t> submitted;
+    atomic<uint64_t> delivered;
+
+    LatencyHistogram searchLatency;  // Submit to candidates found
+    LatencyHistogram matchLatency;   // Candidates found to driver claimed
+    LatencyHistogram routeLatency;   // Driver claimed to pickup routed
+    LatencyHistogram totalLatency;   // Submit to routed
+};
+
+uint64_t nowNanoseconds();
+
+#endif
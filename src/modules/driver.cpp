@@ -1,4 +1,8 @@
 #include "driver.h"
+#include "routecache.h"
+#include "metrics.h"
+#include "logger.h"
+#include "simrandom.h"
 #include <fstream>
 #include <nlohmann/json.hpp>
 
@@ -6,11 +10,12 @@
 
 Driver::Driver() : Person(), licenseNumber(""), yearsOfExperience(0), averageRating(0.0), numberOfRidesCompleted(0), availability(true), currentNode(nullptr) {}
 
-Driver::Driver(vector<Node*> nodes) : Person(), licenseNumber(""), yearsOfExperience(0), averageRating(0.0), numberOfRidesCompleted(0), availability(true), currentNode(nodes[rand() % nodes.size()]) {}
+Driver::Driver(vector<Node*> nodes) : Person(), licenseNumber(""), yearsOfExperience(0), averageRating(0.0), numberOfRidesCompleted(0), availability(true), currentNode(nodes[simRandom.index(RandomStream::Drivers, nodes.size())]) {}
 
 Driver::Driver(int age, string name, string email, bool gender, string phoneNumber, string licenseNumber, int yearsOfExperience, string vehicleType, Node* currentNode) 
     : Person(age, name, email, gender, phoneNumber), licenseNumber(licenseNumber), yearsOfExperience(yearsOfExperience),
-        averageRating(0.0), numberOfRidesCompleted(0), availability(true), assignedVehicle(nullptr), vehicleType(vehicleType), currentNode(currentNode) {}
+        averageRating(0.0), numberOfRidesCompleted(0), availability(true), assignedVehicle(nullptr), vehicleType(vehicleType),
+        vehicleClass(vehicleClassOf(vehicleType)), currentNode(currentNode) {}
 
 void Driver::setLicenseNumber(string newLicenseNumber) { licenseNumber = newLicenseNumber; }
 void Driver::setYearsOfExperience(int newYearsOfExperience) { yearsOfExperience = newYearsOfExperience; }
@@ -18,33 +23,35 @@ void Driver::setAvailability(bool newAvailability) { availability = newAvailabil
 
 Vehicle* Driver::acceptRide(const User& user) 
 {
-    if (availability && user.rideStatus == "Requested") 
+    if (user.rideState == RideState::Requested && availability.claim()) 
     {
-        availability = false;
-        cout << "Driver " << name << " accepted the ride for " << user.name << "." << endl;
-
-        Vehicle* vehicle = new Vehicle(0, vehicleType, currentNode, user.currentLocation);
-        vehicle->color = ORANGE; // Change vehicle color to orange
-        vehicle->userGoalNode = user.goalLocation; // Set user's goal location
-        assignedVehicle = vehicle;
-
-        return vehicle;
-        // Compute path from vehicle's current location to user's location, then to user's goal location
-        // assignedVehicle->path = aStar(assignedVehicle->currentNode, assignedVehicle->goalNode); // Compute path
+        return assignRide(user, routeCache.findRoute(currentNode, user.currentLocation));
     } 
     else 
     {
-        cout << "Driver unavailable or invalid ride request!" << endl;
+        LOG_WARN("Driver %s unavailable or invalid ride request!", email.c_str());
     }
     return nullptr;
 }
 
+// Build the pickup vehicle once the driver is claimed and the route to the user is known
+Vehicle* Driver::assignRide(const User& user, vector<Edge*> pickupPath) 
+{
+    LOG_INFO("Driver %s accepted the ride for %s.", name.c_str(), user.name.c_str());
+
+    Vehicle* vehicle = new Vehicle(0, vehicleType, currentNode, user.currentLocation, move(pickupPath));
+    vehicle->color = ORANGE; // Change vehicle color to orange
+    vehicle->userGoalNode = user.goalLocation; // Set user's goal location
+    assignedVehicle = vehicle;
+
+    return vehicle;
+}
+
 Vehicle* Driver::startRide(const User& user) 
 {
-    if (availability) 
+    if (availability.claim()) 
     {
-        availability = false;
-        cout << "Driver " << name << " accepted the ride for " << user.name << "." << endl;
+        LOG_INFO("Driver %s accepted the ride for %s.", name.c_str(), user.name.c_str());
 
         Vehicle* vehicle = new Vehicle(0, vehicleType, user.currentLocation, user.goalLocation);
         vehicle->color = ORANGE; // Change vehicle color to orange
@@ -58,7 +65,7 @@ Vehicle* Driver::startRide(const User& user)
     } 
     else 
     {
-        cout << "Driver unavailable or invalid ride request!" << endl;
+        LOG_WARN("Driver %s unavailable or invalid ride request!", email.c_str());
     }
     return nullptr;
 }
@@ -70,14 +77,9 @@ void Driver::takeRating(double newRating)
         cout << "Invalid rating! Ratings must be between 0 and 5." << endl;
         return;
     }
-    ratings.push_back(newRating);
+    ratings.add(newRating);
     numberOfRidesCompleted++;
-    averageRating = 0; // Reset the averageRating
-    for (double rating : ratings) 
-    {
-        averageRating += rating; // Sum all ratings
-    }
-    averageRating /= ratings.size(); // Calculate average
+    averageRating = ratings.getMean();
 }
 
 void Driver::display() const 
@@ -88,13 +90,55 @@ void Driver::display() const
     cout << "Years of Experience: " << yearsOfExperience << endl;
     cout << "Number of Rides Completed: " << numberOfRidesCompleted << endl;
     cout << "Average Rating: " << averageRating << endl;
+    if (ratings.getWindowCount() > 0)
+    {
+        cout << "Recent Rating: " << ratings.getWindowMean() << " over the last " << ratings.getWindowCount() << " rides (10th percentile "
+             << ratings.windowPercentile(10) << ")" << endl;
+    }
     cout << "Availability: " << (availability ? "Available" : "Unavailable") << endl;
     cout << "-----------------------------------" << endl;
 }
 
 using json = nlohmann::json;
 
+// Ratings are stored as their aggregate, the recent window as one character
+// per rating ('0' + tenths of a star), so the record stays a fixed size
+static json ratingsToJson(const RatingStats& ratings)
+{
+    string recent;
+    recent.reserve(ratings.getWindowCount());
+    for (size_t i = 0; i < ratings.getWindowCount(); i++)
+    {
+        recent += static_cast<char>('0' + ratings.windowTenths(i));
+    }
+    return { {"count", ratings.getCount()}, {"mean", ratings.getMean()}, {"m2", ratings.getM2()}, {"recent", recent} };
+}
+
+static void loadRatings(Driver& driver, const json& item)
+{
+    if (!item.contains("ratings"))
+    {
+        // Older records only kept the average
+        if (driver.numberOfRidesCompleted > 0)
+        {
+            driver.ratings.restore(static_cast<uint64_t>(driver.numberOfRidesCompleted), driver.averageRating, 0, nullptr, 0);
+        }
+        return;
+    }
+    const json& ratings = item["ratings"];
+    string recent = ratings.value("recent", "");
+    vector<uint8_t> tenths;
+    tenths.reserve(recent.size());
+    for (char c : recent)
+    {
+        tenths.push_back(static_cast<uint8_t>(c - '0'));
+    }
+    driver.ratings.restore(ratings.value("count", 0ULL), ratings.value("mean", 0.0), ratings.value("m2", 0.0), tenths.data(), tenths.size());
+}
+
 void Driver::saveDriver() const {
+    METRIC_SCOPE(Metric::PersistenceSave);
+
     std::ifstream inputFile("drivers.json");
     json driversJson;
 
@@ -121,7 +165,8 @@ void Driver::saveDriver() const {
         {"yearsOfExperience", yearsOfExperience},
         {"averageRating", averageRating},
         {"numberOfRidesCompleted", numberOfRidesCompleted},
-        {"availability", availability}
+        {"ratings", ratingsToJson(ratings)},
+        {"availability", availability.load()}
     };
 
     std::ofstream outputFile("drivers.json");
@@ -129,13 +174,15 @@ void Driver::saveDriver() const {
         outputFile << driversJson.dump(4) << std::endl; // Pretty print with 4 spaces
         outputFile.close();
     } else {
-        std::cerr << "Error opening file for writing." << std::endl;
+        LOG_ERROR("Error opening drivers.json for writing.");
     }
 }
 
 // Load driver
 Driver Driver::loadDriver(const std::string& email) 
 {
+    METRIC_SCOPE(Metric::PersistenceLoad);
+
     Driver driver;
     ifstream driverFile("drivers.json");
     if (driverFile.is_open()) 
@@ -151,23 +198,27 @@ Driver Driver::loadDriver(const std::string& email)
             driver.phoneNumber = item.value("phone", "");
             driver.age = item.value("age", 0);
             driver.vehicleType = item.value("vehicleType", "");
+            driver.vehicleClass = vehicleClassOf(driver.vehicleType);
             driver.licenseNumber = item.value("licenseNumber", "");
             driver.yearsOfExperience = item.value("yearsOfExperience", 0);
             driver.averageRating = item.value("averageRating", 0.0);
             driver.numberOfRidesCompleted = item.value("numberOfRidesCompleted", 0);
             driver.availability = item.value("availability", true);
+            loadRatings(driver, item);
         }
         driverFile.close();
     } 
     else 
     {
-        cerr << "Error opening file for reading." << endl;
+        LOG_ERROR("Error opening drivers.json for reading.");
     }
     return driver;
 }
 
 // Function to load all drivers from the drivers.json file
 std::vector<Driver> Driver::loadAllDrivers() {
+    METRIC_SCOPE(Metric::PersistenceLoad);
+
     std::vector<Driver> drivers;
     std::ifstream driverFile("drivers.json");
     if (driverFile.is_open()) {
@@ -182,16 +233,18 @@ std::vector<Driver> Driver::loadAllDrivers() {
             driver.phoneNumber = item.value("phone", "");
             driver.age = item.value("age", 0);
             driver.vehicleType = item.value("vehicleType", "");
+            driver.vehicleClass = vehicleClassOf(driver.vehicleType);
             driver.licenseNumber = item.value("licenseNumber", "");
             driver.yearsOfExperience = item.value("yearsOfExperience", 0);
             driver.averageRating = item.value("averageRating", 0.0);
             driver.numberOfRidesCompleted = item.value("numberOfRidesCompleted", 0);
             driver.availability = item.value("availability", true);
+            loadRatings(driver, item);
             drivers.push_back(driver);
         }
         driverFile.close();
     } else {
-        std::cerr << "Error opening file for reading." << std::endl;
+        LOG_ERROR("Error opening drivers.json for reading.");
     }
     return drivers;
 }
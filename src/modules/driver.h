@@ -4,9 +4,35 @@
 #include "user.h"
 #include "node.h"
 #include "vehicle.h"
+#include "pathfinder.h"
+#include "ratingstats.h"
+#include <atomic>
 #include <vector>
 
-vector<Edge*> aStar(Node* start, Node* goal);
+// Driver availability. Dispatch threads claim drivers while the simulation
+// thread reads and releases them, so the flag is atomic; copies of a driver
+// take its value at the time.
+class AvailabilityFlag
+{
+public:
+    AvailabilityFlag(bool available = true) : value(available) {}
+    AvailabilityFlag(const AvailabilityFlag& other) : value(other.load()) {}
+    AvailabilityFlag& operator=(const AvailabilityFlag& other) { value.store(other.load(), memory_order_release); return *this; }
+    AvailabilityFlag& operator=(bool available) { value.store(available, memory_order_release); return *this; }
+
+    bool load() const { return value.load(memory_order_acquire); }
+    operator bool() const { return load(); }
+
+    // Takes the driver if still available; of concurrent claims only one wins
+    bool claim()
+    {
+        bool expected = true;
+        return value.compare_exchange_strong(expected, false, memory_order_acq_rel);
+    }
+
+private:
+    atomic<bool> value;
+};
 
 // Driver class inheriting from Person
 class Driver : public Person 
@@ -16,11 +42,12 @@ public:
     int yearsOfExperience;
     double averageRating;
     int numberOfRidesCompleted;
-    vector<double> ratings;
-    bool availability;
+    RatingStats ratings;      // averageRating mirrors its lifetime mean
+    AvailabilityFlag availability;
     string vehicleType;
+    VehicleClass vehicleClass = VehicleClass::Car; // Parsed from vehicleType
     Node* currentNode;
-    Vehicle* assignedVehicle;
+    Vehicle* assignedVehicle = nullptr;
     bool reachedDestination = false;
 
     Driver();
@@ -32,6 +59,7 @@ public:
     void setAvailability(bool newAvailability);
 
     Vehicle* acceptRide(const User& user);
+    Vehicle* assignRide(const User& user, vector<Edge*> pickupPath); // Driver already claimed, path already routed
     Vehicle* startRide(const User& user);
 
     void takeRating(double newRating);
@@ -17,6 +17,12 @@ public:
     int no_of_agents; // Number of agents on the edge
     float width;      // Width of the road
     int max_traffic;  // Maximum number of allowed traffic
+    int epochAgents;  // Agent count when the current route cache epoch began
+    unsigned long long epochStamp; // Route cache epoch epochAgents belongs to
+    int snapshotIndex; // Position in the last snapshot's edge table
+    int congestionSlot; // Road entry in the congestion map, shared by both directions
+    int laneSlot;       // Queue of the vehicles on this edge in the traffic queues
+    bool closed;        // Skipped by routing; toggle through the reachability index
 
     // Constructor with width parameter
     Edge(Node* n1, Node* n2, float road_width);
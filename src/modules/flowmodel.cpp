@@ -0,0 +1,691 @@
+#include "flowmodel.h"
+#include "graphgen.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <queue>
+#include <random>
+#include <sstream>
+
+namespace
+{
+    const size_t inlineLimit = 4096; // Items below which a phase skips the pool
+
+    // Weekday traffic: night lull, morning and evening peaks
+    const double weekdayProfile[24] = {
+        0.25, 0.15, 0.1, 0.1, 0.2, 0.5, 1.2, 2.0, 2.2, 1.5, 1.1, 1.1,
+        1.2, 1.1, 1.1, 1.3, 1.8, 2.2, 2.0, 1.4, 0.9, 0.7, 0.5, 0.35
+    };
+}
+
+FlowConfig FlowConfig::fromArgs(int argc, char** argv)
+{
+    FlowConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--od" && hasValue)
+            config.odFile = argv[++i];
+        else if (arg == "--hours" && hasValue)
+            config.hours = atof(argv[++i]);
+        else if (arg == "--step" && hasValue)
+            config.stepSeconds = atof(argv[++i]);
+        else if (arg == "--speed" && hasValue)
+            config.freeSpeed = atof(argv[++i]);
+        else if (arg == "--demand-scale" && hasValue)
+            config.demandScale = atof(argv[++i]);
+        else if (arg == "--pairs" && hasValue)
+            config.syntheticPairs = atoi(argv[++i]);
+        else if (arg == "--pair-rate" && hasValue)
+            config.syntheticRate = atof(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            config.seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--grid" && hasValue)
+        {
+            string spec = argv[++i];
+            size_t x = spec.find('x');
+            config.gridWidth = atoi(spec.substr(0, x).c_str());
+            config.gridHeight = x == string::npos ? config.gridWidth : atoi(spec.substr(x + 1).c_str());
+        }
+    }
+    return config;
+}
+
+void FlowReport::display() const
+{
+    cout << "-----------------------------------" << endl;
+    cout << "Flow model report" << endl;
+    cout << "Network: " << links << " links, " << cells << " cells" << endl;
+    cout << "Simulated time: " << simulatedSeconds / 3600 << " h in " << steps << " steps, wall time: " << wallSeconds << " s (routing "
+         << routingSeconds << " s)" << endl;
+    if (wallSeconds > 0)
+    {
+        cout << "Throughput: " << steps / wallSeconds << " steps/s, " << static_cast<double>(cells) * steps / wallSeconds / 1e6
+             << " M cell updates/s" << endl;
+    }
+    cout << fixed << setprecision(0);
+    cout << "Vehicles: entered " << entered << ", exited " << exited << ", in network " << inNetwork << ", waiting at origins " << waiting << endl;
+    if (unroutable > 0)
+    {
+        cout << "Unroutable demand: " << unroutable << " vehicles/h" << endl;
+    }
+    cout << "Vehicle hours: " << vehicleHours << ", vehicle distance: " << vehicleDistance / 1000 << " km" << endl;
+    cout << setprecision(3) << "Conservation error: " << entered - exited - inNetwork << endl;
+    if (vehicleHours > 0)
+    {
+        cout << setprecision(1) << "Mean speed: " << vehicleDistance / (vehicleHours * 3600) << " units/s" << endl;
+    }
+    cout << setprecision(0);
+    cout << " hour   entered    exited  in network  mean speed" << endl;
+    for (size_t i = 0; i < hours.size(); i++)
+    {
+        const FlowHour& hour = hours[i];
+        double speed = hour.vehicleHours > 0 ? hour.vehicleDistance / (hour.vehicleHours * 3600) : 0;
+        cout << setw(5) << i << setw(10) << hour.entered << setw(10) << hour.exited << setw(12) << hour.inNetwork << setw(12) << setprecision(1)
+             << speed << setprecision(0) << endl;
+    }
+    cout << defaultfloat << setprecision(6);
+    cout << "-----------------------------------" << endl;
+}
+
+FlowModel::FlowModel(const vector<Node*>& nodes, FlowConfig config, ThreadPool& pool)
+    : nodes(nodes), config(config), pool(pool), time(0), steps(0), routingSeconds(0), unroutable(0), enteredTotal(0), exitedTotal(0),
+      vehicleHoursTotal(0), vehicleDistanceTotal(0)
+{
+    if (this->config.profile.empty())
+    {
+        this->config.profile.assign(begin(weekdayProfile), end(weekdayProfile));
+    }
+    double mean = 0;
+    for (double value : this->config.profile)
+    {
+        mean += value / this->config.profile.size();
+    }
+    for (double& value : this->config.profile)
+    {
+        value = mean > 0 ? value / mean : 1;
+    }
+    waveRatio = min(1.0, max(0.0, this->config.waveSpeedRatio));
+
+    unordered_map<const Node*, uint32_t> nodeIndex;
+    nodeIndex.reserve(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        nodeIndex[nodes[i]] = static_cast<uint32_t>(i);
+    }
+
+    // Links, cut into cells one free-flow step long
+    double stepLength = this->config.freeSpeed * this->config.stepSeconds;
+    uint32_t cellCount = 0;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        for (const Edge* edge : nodes[i]->edges)
+        {
+            auto to = nodeIndex.find(edge->node2);
+            if (edge->node1 != nodes[i] || to == nodeIndex.end())
+            {
+                continue;
+            }
+            Link link;
+            link.from = static_cast<uint32_t>(i);
+            link.to = to->second;
+            link.firstCell = cellCount;
+            link.cellCount = max(1u, static_cast<uint32_t>(lround(edge->length / stepLength)));
+            link.cellLength = max(1.0, static_cast<double>(edge->length)) / link.cellCount;
+            double lanes = max(1.0, round(edge->width / this->config.laneWidth));
+            link.cellVehicles = this->config.jamDensity * lanes * link.cellLength;
+            link.stepFlow = this->config.laneCapacity * lanes * this->config.stepSeconds;
+            linkOfEdge[edge] = static_cast<uint32_t>(links.size());
+            links.push_back(link);
+            cellCount += link.cellCount;
+        }
+    }
+    cells.assign(cellCount, 0);
+
+    // Junctions list their in- and out-links contiguously
+    vector<uint32_t> inCount(nodes.size(), 0), outCount(nodes.size(), 0);
+    for (const Link& link : links)
+    {
+        outCount[link.from]++;
+        inCount[link.to]++;
+    }
+    junctions.resize(nodes.size());
+    uint32_t inTotal = 0, outTotal = 0, turnTotal = 0;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        junctions[i] = { inTotal, 0, outTotal, 0, turnTotal };
+        inTotal += inCount[i];
+        outTotal += outCount[i];
+        turnTotal += (inCount[i] + 1) * (outCount[i] + 1);
+    }
+    inLinks.resize(inTotal);
+    outLinks.resize(outTotal);
+    for (uint32_t l = 0; l < links.size(); l++)
+    {
+        Junction& from = junctions[links[l].from];
+        outLinks[from.firstOut + from.outCount++] = l;
+        Junction& to = junctions[links[l].to];
+        inLinks[to.firstIn + to.inCount++] = l;
+    }
+    turns.assign(turnTotal, 0);
+
+    originRate.assign(nodes.size(), 0);
+    originQueue.assign(nodes.size(), 0);
+    sending.assign(links.size(), 0);
+    receiving.assign(links.size(), 0);
+    outflow.assign(links.size(), 0);
+    inflow.assign(links.size(), 0);
+}
+
+template <typename Body>
+void FlowModel::parallelFor(size_t count, Body body)
+{
+    size_t chunks = count < inlineLimit || pool.size() < 2 ? 1 : static_cast<size_t>(pool.size()) * 4;
+    if (partials.size() < chunks)
+    {
+        partials.resize(chunks);
+    }
+    if (chunks == 1)
+    {
+        body(size_t(0), count, size_t(0));
+        return;
+    }
+    size_t per = (count + chunks - 1) / chunks;
+    TaskGroup tasks(pool);
+    for (size_t chunk = 0; chunk < chunks; chunk++)
+    {
+        size_t first = chunk * per;
+        size_t last = min(count, first + per);
+        if (first >= last)
+        {
+            partials[chunk] = {};
+            continue;
+        }
+        tasks.submit([&body, first, last, chunk](int) { body(first, last, chunk); });
+    }
+    tasks.wait();
+}
+
+void FlowModel::setDemand(const vector<ODDemand>& demand)
+{
+    auto routingStart = chrono::steady_clock::now();
+    fill(originRate.begin(), originRate.end(), 0.0);
+    computeTurns(demand);
+    routingSeconds = chrono::duration<double>(chrono::steady_clock::now() - routingStart).count();
+}
+
+// Assigns every OD pair to its free-flow shortest path and counts how much of
+// the demand takes each turn. One Dijkstra tree per origin serves all of its
+// destinations; origins are spread over the pool and every worker accumulates
+// into its own turn table, summed at the end.
+void FlowModel::computeTurns(const vector<ODDemand>& demand)
+{
+    unordered_map<const Node*, uint32_t> nodeIndex;
+    nodeIndex.reserve(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        nodeIndex[nodes[i]] = static_cast<uint32_t>(i);
+    }
+
+    struct Pair
+    {
+        uint32_t origin, destination;
+        double rate;
+    };
+    vector<Pair> pairs;
+    pairs.reserve(demand.size());
+    for (const ODDemand& od : demand)
+    {
+        auto origin = nodeIndex.find(od.origin);
+        auto destination = nodeIndex.find(od.destination);
+        if (origin == nodeIndex.end() || destination == nodeIndex.end() || origin->second == destination->second || od.vehiclesPerHour <= 0)
+        {
+            continue;
+        }
+        pairs.push_back({ origin->second, destination->second, od.vehiclesPerHour * config.demandScale });
+    }
+    sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) { return a.origin < b.origin; });
+
+    vector<size_t> groupStart; // Pairs sharing an origin
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        if (i == 0 || pairs[i].origin != pairs[i - 1].origin)
+        {
+            groupStart.push_back(i);
+        }
+    }
+    groupStart.push_back(pairs.size());
+
+    struct Workspace
+    {
+        vector<double> turnFlow;
+        vector<double> distance;
+        vector<uint32_t> viaLink; // Last link on the best path, UINT32_MAX for none
+        vector<uint32_t> stamp;
+        vector<pair<double, uint32_t>> heap;
+        uint32_t generation = 0;
+        double unroutable = 0;
+    };
+    int workers = pool.size();
+    vector<Workspace> workspaces(workers);
+
+    // Column of a turn within its junction's table
+    auto turnOffset = [this](uint32_t node, uint32_t inLink, uint32_t outLink) {
+        const Junction& junction = junctions[node];
+        uint32_t row = junction.inCount, column = junction.outCount;
+        if (inLink != UINT32_MAX)
+        {
+            row = static_cast<uint32_t>(find(&inLinks[junction.firstIn], &inLinks[junction.firstIn] + junction.inCount, inLink) - &inLinks[junction.firstIn]);
+        }
+        if (outLink != UINT32_MAX)
+        {
+            column = static_cast<uint32_t>(find(&outLinks[junction.firstOut], &outLinks[junction.firstOut] + junction.outCount, outLink) - &outLinks[junction.firstOut]);
+        }
+        return junction.firstTurn + row * (junction.outCount + 1) + column;
+    };
+
+    size_t groups = groupStart.size() - 1;
+    size_t perTask = max<size_t>(1, groups / (static_cast<size_t>(workers) * 8));
+    TaskGroup tasks(pool);
+    for (size_t first = 0; first < groups; first += perTask)
+    {
+        size_t last = min(groups, first + perTask);
+        tasks.submit([&, first, last](int worker) {
+            Workspace& ws = workspaces[max(0, worker)];
+            if (ws.turnFlow.empty())
+            {
+                ws.turnFlow.assign(turns.size(), 0);
+                ws.distance.assign(nodes.size(), 0);
+                ws.viaLink.assign(nodes.size(), UINT32_MAX);
+                ws.stamp.assign(nodes.size(), 0);
+            }
+            for (size_t group = first; group < last; group++)
+            {
+                uint32_t origin = pairs[groupStart[group]].origin;
+                uint32_t generation = ++ws.generation;
+                ws.heap.clear();
+                ws.stamp[origin] = generation;
+                ws.distance[origin] = 0;
+                ws.viaLink[origin] = UINT32_MAX;
+                ws.heap.push_back({ 0.0, origin });
+                auto later = [](const pair<double, uint32_t>& a, const pair<double, uint32_t>& b) { return a.first > b.first; };
+                while (!ws.heap.empty())
+                {
+                    pop_heap(ws.heap.begin(), ws.heap.end(), later);
+                    auto [dist, node] = ws.heap.back();
+                    ws.heap.pop_back();
+                    if (dist > ws.distance[node])
+                    {
+                        continue;
+                    }
+                    const Junction& junction = junctions[node];
+                    for (uint32_t k = 0; k < junction.outCount; k++)
+                    {
+                        uint32_t l = outLinks[junction.firstOut + k];
+                        uint32_t next = links[l].to;
+                        double candidate = dist + links[l].cellLength * links[l].cellCount;
+                        if (ws.stamp[next] != generation || candidate < ws.distance[next])
+                        {
+                            ws.stamp[next] = generation;
+                            ws.distance[next] = candidate;
+                            ws.viaLink[next] = l;
+                            ws.heap.push_back({ candidate, next });
+                            push_heap(ws.heap.begin(), ws.heap.end(), later);
+                        }
+                    }
+                }
+
+                for (size_t p = groupStart[group]; p < groupStart[group + 1]; p++)
+                {
+                    const Pair& od = pairs[p];
+                    if (ws.stamp[od.destination] != generation)
+                    {
+                        ws.unroutable += od.rate;
+                        continue;
+                    }
+                    // Walk back from the destination: sink turn, through turns, source turn
+                    uint32_t node = od.destination;
+                    uint32_t after = UINT32_MAX;
+                    while (true)
+                    {
+                        uint32_t before = ws.viaLink[node];
+                        ws.turnFlow[turnOffset(node, before, after)] += od.rate;
+                        if (before == UINT32_MAX)
+                        {
+                            break;
+                        }
+                        after = before;
+                        node = links[before].from;
+                    }
+                }
+            }
+        });
+    }
+    tasks.wait();
+
+    fill(turns.begin(), turns.end(), 0.0);
+    unroutable = 0;
+    for (const Workspace& ws : workspaces)
+    {
+        unroutable += ws.unroutable;
+        for (size_t t = 0; t < ws.turnFlow.size(); t++)
+        {
+            turns[t] += ws.turnFlow[t];
+        }
+    }
+
+    // Source rows give the origin rates; every row is normalized to fractions
+    // and rows no route uses send everything to the sink
+    for (size_t j = 0; j < junctions.size(); j++)
+    {
+        const Junction& junction = junctions[j];
+        uint32_t columns = junction.outCount + 1;
+        for (uint32_t row = 0; row <= junction.inCount; row++)
+        {
+            double* fractions = &turns[junction.firstTurn + row * columns];
+            double total = 0;
+            for (uint32_t c = 0; c < columns; c++)
+            {
+                total += fractions[c];
+            }
+            if (row == junction.inCount)
+            {
+                originRate[j] = total / 3600;
+            }
+            for (uint32_t c = 0; c < columns; c++)
+            {
+                fractions[c] = total > 0 ? fractions[c] / total : (c == junction.outCount ? 1 : 0);
+            }
+        }
+    }
+}
+
+double FlowModel::demandMultiplier() const
+{
+    size_t hour = static_cast<size_t>(time / 3600);
+    return config.profile[hour % config.profile.size()];
+}
+
+void FlowModel::step()
+{
+    double dt = config.stepSeconds;
+
+    // Links: what the last cell can send and the first cell can take
+    parallelFor(links.size(), [this](size_t first, size_t last, size_t) {
+        for (size_t l = first; l < last; l++)
+        {
+            const Link& link = links[l];
+            double tail = cells[link.firstCell + link.cellCount - 1];
+            double head = cells[link.firstCell];
+            sending[l] = min(tail, link.stepFlow);
+            receiving[l] = min(link.stepFlow, waveRatio * (link.cellVehicles - head));
+        }
+    });
+
+    // Nodes: each out-link scales down the demand aimed at it to what it can
+    // receive, and every row moves at the tightest ratio among the out-links
+    // it feeds, so a blocked turn holds back the whole queue behind it (FIFO).
+    // The sink never blocks.
+    double arriving = config.stepSeconds * demandMultiplier();
+    parallelFor(junctions.size(), [this, arriving](size_t first, size_t last, size_t chunk) {
+        double entered = 0, exited = 0;
+        double ratio[64];
+        for (size_t j = first; j < last; j++)
+        {
+            const Junction& junction = junctions[j];
+            originQueue[j] += originRate[j] * arriving;
+            uint32_t columns = junction.outCount + 1;
+            const double* table = &turns[junction.firstTurn];
+            double* ratios = ratio;
+            vector<double> spill;
+            if (junction.outCount > 64)
+            {
+                spill.resize(junction.outCount);
+                ratios = spill.data();
+            }
+            for (uint32_t k = 0; k < junction.outCount; k++)
+            {
+                double demand = originQueue[j] * table[junction.inCount * columns + k];
+                for (uint32_t r = 0; r < junction.inCount; r++)
+                {
+                    demand += sending[inLinks[junction.firstIn + r]] * table[r * columns + k];
+                }
+                double supply = receiving[outLinks[junction.firstOut + k]];
+                ratios[k] = demand > supply ? max(0.0, supply) / demand : 1;
+                inflow[outLinks[junction.firstOut + k]] = 0;
+            }
+            for (uint32_t r = 0; r <= junction.inCount; r++)
+            {
+                bool source = r == junction.inCount;
+                double send = source ? originQueue[j] : sending[inLinks[junction.firstIn + r]];
+                const double* fractions = &table[r * columns];
+                double scale = 1;
+                for (uint32_t k = 0; k < junction.outCount; k++)
+                {
+                    if (fractions[k] > 0)
+                    {
+                        scale = min(scale, ratios[k]);
+                    }
+                }
+                double moved = send * scale;
+                for (uint32_t k = 0; k < junction.outCount; k++)
+                {
+                    inflow[outLinks[junction.firstOut + k]] += moved * fractions[k];
+                }
+                exited += moved * fractions[junction.outCount];
+                if (source)
+                {
+                    originQueue[j] -= moved;
+                    entered += moved;
+                }
+                else
+                {
+                    outflow[inLinks[junction.firstIn + r]] = moved;
+                }
+            }
+        }
+        partials[chunk].entered = entered;
+        partials[chunk].exited = exited;
+    });
+    for (size_t chunk = 0; chunk < partials.size(); chunk++)
+    {
+        current.entered += partials[chunk].entered;
+        current.exited += partials[chunk].exited;
+        enteredTotal += partials[chunk].entered;
+        exitedTotal += partials[chunk].exited;
+        partials[chunk] = {};
+    }
+
+    // Links: move vehicles cell to cell, last cell first so each boundary
+    // flow still sees the values from before the step
+    parallelFor(links.size(), [this, dt](size_t first, size_t last, size_t chunk) {
+        double vehicleSeconds = 0, distance = 0;
+        for (size_t l = first; l < last; l++)
+        {
+            const Link& link = links[l];
+            double* cell = &cells[link.firstCell];
+            double downstream = outflow[l];
+            double crossed = downstream;
+            for (uint32_t i = link.cellCount - 1; i > 0; i--)
+            {
+                double flow = min({ cell[i - 1], link.stepFlow, waveRatio * (link.cellVehicles - cell[i]) });
+                flow = max(0.0, flow);
+                cell[i] += flow - downstream;
+                vehicleSeconds += cell[i];
+                crossed += flow;
+                downstream = flow;
+            }
+            cell[0] += inflow[l] - downstream;
+            vehicleSeconds += cell[0];
+            distance += crossed * link.cellLength;
+        }
+        partials[chunk].vehicleSeconds = vehicleSeconds * dt;
+        partials[chunk].distance = distance;
+    });
+    for (size_t chunk = 0; chunk < partials.size(); chunk++)
+    {
+        current.vehicleHours += partials[chunk].vehicleSeconds / 3600;
+        current.vehicleDistance += partials[chunk].distance;
+        partials[chunk] = {};
+    }
+
+    time += dt;
+    steps++;
+}
+
+FlowReport FlowModel::run()
+{
+    FlowReport report;
+    report.links = static_cast<int>(links.size());
+    report.cells = static_cast<int>(cells.size());
+    report.routingSeconds = routingSeconds;
+    report.unroutable = unroutable;
+
+    long total = lround(config.hours * 3600 / config.stepSeconds);
+    long perHour = max(1L, lround(3600 / config.stepSeconds));
+    auto wallStart = chrono::steady_clock::now();
+    for (long s = 1; s <= total; s++)
+    {
+        step();
+        if (s % perHour == 0 || s == total)
+        {
+            double inNetwork = 0;
+            for (double vehicles : cells)
+            {
+                inNetwork += vehicles;
+            }
+            current.inNetwork = inNetwork;
+            vehicleHoursTotal += current.vehicleHours;
+            vehicleDistanceTotal += current.vehicleDistance;
+            report.hours.push_back(current);
+            current = FlowHour();
+        }
+    }
+    report.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+
+    report.steps = steps;
+    report.simulatedSeconds = time;
+    report.entered = enteredTotal;
+    report.exited = exitedTotal;
+    report.inNetwork = report.hours.empty() ? 0 : report.hours.back().inNetwork;
+    for (double queued : originQueue)
+    {
+        report.waiting += queued;
+    }
+    report.vehicleHours = vehicleHoursTotal;
+    report.vehicleDistance = vehicleDistanceTotal;
+    return report;
+}
+
+double FlowModel::linkVehicles(const Edge* edge) const
+{
+    auto found = linkOfEdge.find(edge);
+    if (found == linkOfEdge.end())
+    {
+        return 0;
+    }
+    const Link& link = links[found->second];
+    double vehicles = 0;
+    for (uint32_t i = 0; i < link.cellCount; i++)
+    {
+        vehicles += cells[link.firstCell + i];
+    }
+    return vehicles;
+}
+
+vector<ODDemand> loadODMatrix(const string& path, const vector<Node*>& nodes)
+{
+    vector<ODDemand> demand;
+    ifstream file(path);
+    if (!file)
+    {
+        cout << "Could not open OD matrix " << path << endl;
+        return demand;
+    }
+    unordered_map<int, Node*> byId;
+    for (Node* node : nodes)
+    {
+        byId[node->id] = node;
+    }
+
+    string line;
+    size_t skipped = 0;
+    while (getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        replace(line.begin(), line.end(), ',', ' ');
+        istringstream fields(line);
+        int origin, destination;
+        double rate;
+        if (!(fields >> origin >> destination >> rate))
+        {
+            continue; // Header row
+        }
+        auto from = byId.find(origin);
+        auto to = byId.find(destination);
+        if (from == byId.end() || to == byId.end())
+        {
+            skipped++;
+            continue;
+        }
+        demand.push_back({ from->second, to->second, rate });
+    }
+    if (skipped > 0)
+    {
+        cout << "Skipped " << skipped << " OD rows naming unknown nodes" << endl;
+    }
+    return demand;
+}
+
+vector<ODDemand> syntheticODMatrix(const vector<Node*>& nodes, int pairs, double vehiclesPerHour, unsigned long long seed)
+{
+    vector<ODDemand> demand;
+    if (nodes.size() < 2)
+    {
+        return demand;
+    }
+    mt19937_64 random(seed);
+    uniform_int_distribution<size_t> pick(0, nodes.size() - 1);
+    demand.reserve(pairs);
+    while (static_cast<int>(demand.size()) < pairs)
+    {
+        Node* origin = nodes[pick(random)];
+        Node* destination = nodes[pick(random)];
+        if (origin != destination)
+        {
+            demand.push_back({ origin, destination, vehiclesPerHour });
+        }
+    }
+    return demand;
+}
+
+int runFlowModel(int argc, char** argv, const vector<Node*>& nodes)
+{
+    FlowConfig config = FlowConfig::fromArgs(argc, argv);
+    GeneratedGraph grid;
+    if (config.gridWidth > 0 && config.gridHeight > 0)
+    {
+        grid = makeGridGraph(config.gridWidth, config.gridHeight);
+    }
+    const vector<Node*>& network = grid.nodes.empty() ? nodes : grid.nodes;
+
+    int pairs = config.syntheticPairs > 0 ? config.syntheticPairs : static_cast<int>(network.size()) * 4;
+    vector<ODDemand> demand = config.odFile.empty() ? syntheticODMatrix(network, pairs, config.syntheticRate, config.seed)
+                                                    : loadODMatrix(config.odFile, network);
+    cout << "Running flow model: " << network.size() << " nodes, " << demand.size() << " OD pairs, " << config.hours << " h in "
+         << config.stepSeconds << " s steps" << endl;
+
+    FlowModel model(network, config);
+    model.setDemand(demand);
+    FlowReport report = model.run();
+    report.display();
+
+    freeGraph(grid);
+    return 0;
+}
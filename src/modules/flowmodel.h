@@ -0,0 +1,169 @@
+#ifndef FLOWMODEL_H
+#define FLOWMODEL_H
+
+#include "edge.h"
+#include "node.h"
+#include "threadpool.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// One row of an origin-destination demand matrix
+struct ODDemand
+{
+    Node* origin;
+    Node* destination;
+    double vehiclesPerHour;
+};
+
+struct FlowConfig
+{
+    double stepSeconds = 2;        // Simulated time per step; cells are as long as a free-flow step
+    double hours = 24;
+    double freeSpeed = 13.9;       // Map units (read as meters) per second
+    double waveSpeedRatio = 0.5;   // Congestion wave speed over free speed
+    double laneCapacity = 0.5;     // Vehicles per second per lane (1800 per hour)
+    double jamDensity = 0.15;      // Vehicles per map unit per lane
+    double laneWidth = 3.2;        // Edge::width of one lane
+    double demandScale = 1;        // Multiplies every OD rate
+    vector<double> profile;        // Hourly demand multipliers, repeated; empty uses a weekday curve
+    string odFile;                 // CSV "originId,destinationId,vehiclesPerHour"; empty synthesizes
+    int syntheticPairs = 0;        // 0 picks four per node
+    double syntheticRate = 10;     // Vehicles per hour per synthetic pair
+    unsigned long long seed = 42;
+    int gridWidth = 0;             // Run on a generated grid instead of the city
+    int gridHeight = 0;
+
+    // Parse --od <file>, --hours, --step, --speed, --demand-scale, --pairs,
+    // --pair-rate, --seed and --grid <W>x<H>
+    static FlowConfig fromArgs(int argc, char** argv);
+};
+
+struct FlowHour
+{
+    double entered = 0;
+    double exited = 0;
+    double inNetwork = 0;      // At the end of the hour
+    double vehicleHours = 0;
+    double vehicleDistance = 0;
+};
+
+struct FlowReport
+{
+    int links = 0;
+    int cells = 0;
+    long steps = 0;
+    double simulatedSeconds = 0;
+    double wallSeconds = 0;
+    double routingSeconds = 0;
+    double entered = 0;
+    double exited = 0;
+    double inNetwork = 0;
+    double waiting = 0;        // Still queued at origins, blocked by full links
+    double vehicleHours = 0;
+    double vehicleDistance = 0;
+    double unroutable = 0;     // Vehicles per hour of demand with no path
+    vector<FlowHour> hours;
+
+    void display() const;
+};
+
+// Cell transmission model over the road graph. Every directed Edge is a link
+// cut into cells one free-flow step long; cells hold vehicle counts rather
+// than agents. Each step:
+//   links  compute what their last cell can send and first cell can receive
+//   nodes  split that flow over the outgoing links by turning fractions,
+//          holding back in-links whose targets are full (FIFO), and absorb
+//          the share that ends there
+//   links  move vehicles cell to cell
+// Links and nodes each write only their own state, so every phase runs in
+// parallel on the thread pool. Turning fractions come from assigning the OD
+// matrix to free-flow shortest paths; origins feed links from an unbounded
+// queue so blocked demand waits instead of disappearing.
+class FlowModel
+{
+public:
+    FlowModel(const vector<Node*>& nodes, FlowConfig config, ThreadPool& pool = defaultThreadPool());
+
+    // Routes the demand and derives turning fractions and origin rates
+    void setDemand(const vector<ODDemand>& demand);
+
+    void step();
+    FlowReport run(); // Runs config.hours from the current state
+
+    double linkVehicles(const Edge* edge) const;
+    double getTime() const { return time; }
+
+private:
+    struct Link
+    {
+        uint32_t from, to;     // Node indices
+        uint32_t firstCell;
+        uint32_t cellCount;
+        double cellLength;
+        double cellVehicles;   // Jam capacity of one cell
+        double stepFlow;       // Vehicles one cell boundary passes per step
+    };
+
+    // Turn table of one node: rows are its in-links then its source, columns
+    // its out-links then its sink
+    struct Junction
+    {
+        uint32_t firstIn, inCount;   // Into inLinks
+        uint32_t firstOut, outCount; // Into outLinks
+        uint32_t firstTurn;          // Into turns, (inCount + 1) * (outCount + 1) fractions
+    };
+
+    // Sums one parallel chunk adds up during a step
+    struct ChunkTotals
+    {
+        double entered, exited, vehicleSeconds, distance;
+    };
+
+    // Splits [0, count) into chunks and runs body(begin, end, chunk) on the
+    // pool; small ranges run inline since a pool round trip costs more
+    template <typename Body>
+    void parallelFor(size_t count, Body body);
+    void computeTurns(const vector<ODDemand>& demand);
+    double demandMultiplier() const;
+
+    const vector<Node*>& nodes;
+    FlowConfig config;
+    ThreadPool& pool;
+    double waveRatio;   // Backward over forward wave speed, capped at 1
+
+    vector<Link> links;
+    unordered_map<const Edge*, uint32_t> linkOfEdge;
+    vector<double> cells;
+    vector<Junction> junctions;
+    vector<uint32_t> inLinks;
+    vector<uint32_t> outLinks;
+    vector<double> turns;
+    vector<double> originRate;  // Vehicles per second entering at each node
+    vector<double> originQueue;
+
+    // Exchange between the phases of a step
+    vector<double> sending;
+    vector<double> receiving;
+    vector<double> outflow;
+    vector<double> inflow;
+    vector<ChunkTotals> partials;
+
+    double time;
+    long steps;
+    double routingSeconds;
+    double unroutable;
+    FlowHour current;
+    double enteredTotal, exitedTotal, vehicleHoursTotal, vehicleDistanceTotal;
+};
+
+vector<ODDemand> loadODMatrix(const string& path, const vector<Node*>& nodes);
+vector<ODDemand> syntheticODMatrix(const vector<Node*>& nodes, int pairs, double vehiclesPerHour, unsigned long long seed);
+
+// Entry point for "SmartRide --flowmodel ..."
+int runFlowModel(int argc, char** argv, const vector<Node*>& nodes);
+
+#endif
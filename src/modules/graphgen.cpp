@@ -0,0 +1,118 @@
+#include "graphgen.h"
+#include <cmath>
+#include <unordered_map>
+
+GeneratedGraph makeGridGraph(int width, int height, float spacing)
+{
+    GeneratedGraph graph;
+    graph.kind = "grid";
+    graph.nodes.reserve(static_cast<size_t>(width) * height);
+
+    for (int row = 0; row < height; row++)
+    {
+        for (int col = 0; col < width; col++)
+        {
+            graph.nodes.push_back(new Node(row * width + col + 1, col * spacing, row * spacing, ""));
+        }
+    }
+
+    for (int row = 0; row < height; row++)
+    {
+        for (int col = 0; col < width; col++)
+        {
+            Node* node = graph.nodes[row * width + col];
+            if (col + 1 < width)
+            {
+                node->addNeighbor(graph.nodes[row * width + col + 1]);
+                graph.edgeCount += 2;
+            }
+            if (row + 1 < height)
+            {
+                node->addNeighbor(graph.nodes[(row + 1) * width + col]);
+                graph.edgeCount += 2;
+            }
+        }
+    }
+    return graph;
+}
+
+GeneratedGraph makeRandomGeometricGraph(int count, double averageDegree, mt19937_64& random, float spacing)
+{
+    GeneratedGraph graph;
+    graph.kind = "geometric";
+    graph.nodes.reserve(count);
+
+    const double pi = 3.14159265358979323846;
+
+    // Same density as a grid with this spacing
+    double side = sqrt(static_cast<double>(count)) * spacing;
+    double radius = side * sqrt(averageDegree / (count * pi));
+    uniform_real_distribution<double> coordinate(0.0, side);
+
+    // Bucket nodes into radius-sized cells so only neighbouring cells are compared
+    int cells = max(1, static_cast<int>(side / radius));
+    double cellSize = side / cells;
+    unordered_map<long long, vector<Node*>> grid;
+    auto cellOf = [&](double value) { return min(cells - 1, static_cast<int>(value / cellSize)); };
+
+    for (int i = 0; i < count; i++)
+    {
+        Node* node = new Node(i + 1, static_cast<float>(coordinate(random)), static_cast<float>(coordinate(random)), "");
+        graph.nodes.push_back(node);
+        grid[static_cast<long long>(cellOf(node->x)) * cells + cellOf(node->y)].push_back(node);
+    }
+
+    double radiusSquared = radius * radius;
+    for (Node* node : graph.nodes)
+    {
+        int cx = cellOf(node->x);
+        int cy = cellOf(node->y);
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                int nx = cx + dx;
+                int ny = cy + dy;
+                if (nx < 0 || ny < 0 || nx >= cells || ny >= cells)
+                {
+                    continue;
+                }
+                auto bucket = grid.find(static_cast<long long>(nx) * cells + ny);
+                if (bucket == grid.end())
+                {
+                    continue;
+                }
+                for (Node* other : bucket->second)
+                {
+                    // Each pair once, addNeighbor creates both directions
+                    if (other->id <= node->id || node->edges.size() >= 255 || other->edges.size() >= 255)
+                    {
+                        continue;
+                    }
+                    double ddx = node->x - other->x;
+                    double ddy = node->y - other->y;
+                    if (ddx * ddx + ddy * ddy <= radiusSquared)
+                    {
+                        node->addNeighbor(other);
+                        graph.edgeCount += 2;
+                    }
+                }
+            }
+        }
+    }
+    return graph;
+}
+
+void freeGraph(GeneratedGraph& graph)
+{
+    for (Node* node : graph.nodes)
+    {
+        for (Edge* edge : node->edges)
+        {
+            delete edge;
+        }
+        delete node;
+    }
+    graph.nodes.clear();
+    graph.edgeCount = 0;
+}
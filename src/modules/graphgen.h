@@ -0,0 +1,29 @@
+#ifndef GRAPHGEN_H
+#define GRAPHGEN_H
+
+#include "node.h"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// A synthetic road network for benchmarks and load tests. Nodes and their
+// edges are heap allocated like the city built in main(); freeGraph releases them.
+struct GeneratedGraph
+{
+    string kind;
+    vector<Node*> nodes;
+    size_t edgeCount = 0; // Directed edges (each road adds two)
+};
+
+// width x height lattice with `spacing` between neighbouring intersections
+GeneratedGraph makeGridGraph(int width, int height, float spacing = 100.0f);
+
+// count nodes scattered uniformly, joined when closer than the radius that
+// gives the requested average degree
+GeneratedGraph makeRandomGeometricGraph(int count, double averageDegree, mt19937_64& random, float spacing = 100.0f);
+
+void freeGraph(GeneratedGraph& graph);
+
+#endif
@@ -0,0 +1,147 @@
+#include "histogram.h"
+#include <cstdio>
+
+LatencyHistogram::LatencyHistogram() : count(0), total(0), maxValue(0)
+{
+    for (atomic<uint64_t>& bucket : buckets)
+    {
+        bucket.store(0, memory_order_relaxed);
+    }
+}
+
+LatencyHistogram::LatencyHistogram(const LatencyHistogram& other) : LatencyHistogram()
+{
+    merge(other);
+}
+
+LatencyHistogram& LatencyHistogram::operator=(const LatencyHistogram& other)
+{
+    if (this != &other)
+    {
+        reset();
+        merge(other);
+    }
+    return *this;
+}
+
+int LatencyHistogram::bucketFor(uint64_t nanoseconds)
+{
+    if (nanoseconds < subBuckets)
+    {
+        return static_cast<int>(nanoseconds);
+    }
+    int exponent = 63 - __builtin_clzll(nanoseconds);                          // Position of the top bit
+    int sub = static_cast<int>((nanoseconds >> (exponent - 2)) & (subBuckets - 1)); // Next two bits
+    return (exponent - 1) * subBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int bucket)
+{
+    if (bucket < subBuckets)
+    {
+        return static_cast<uint64_t>(bucket);
+    }
+    int exponent = bucket / subBuckets + 1;
+    uint64_t sub = bucket % subBuckets;
+    uint64_t lower = (1ULL << exponent) + (sub << (exponent - 2));
+    return lower + (1ULL << (exponent - 2)) - 1;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+    buckets[bucketFor(nanoseconds)].fetch_add(1, memory_order_relaxed);
+    count.fetch_add(1, memory_order_relaxed);
+    total.fetch_add(nanoseconds, memory_order_relaxed);
+
+    uint64_t seen = maxValue.load(memory_order_relaxed);
+    while (nanoseconds > seen && !maxValue.compare_exchange_weak(seen, nanoseconds, memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for (int i = 0; i < bucketCount; i++)
+    {
+        buckets[i].fetch_add(other.bucketCountAt(i), memory_order_relaxed);
+    }
+    count.fetch_add(other.getCount(), memory_order_relaxed);
+    total.fetch_add(other.total.load(memory_order_relaxed), memory_order_relaxed);
+
+    uint64_t otherMax = other.getMax();
+    uint64_t seen = maxValue.load(memory_order_relaxed);
+    while (otherMax > seen && !maxValue.compare_exchange_weak(seen, otherMax, memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::absorb(const uint64_t* bucketCounts, uint64_t samples, uint64_t sum, uint64_t maximum)
+{
+    for (int i = 0; i < bucketCount; i++)
+    {
+        if (bucketCounts[i])
+        {
+            buckets[i].fetch_add(bucketCounts[i], memory_order_relaxed);
+        }
+    }
+    count.fetch_add(samples, memory_order_relaxed);
+    total.fetch_add(sum, memory_order_relaxed);
+
+    uint64_t seen = maxValue.load(memory_order_relaxed);
+    while (maximum > seen && !maxValue.compare_exchange_weak(seen, maximum, memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (atomic<uint64_t>& bucket : buckets)
+    {
+        bucket.store(0, memory_order_relaxed);
+    }
+    count.store(0, memory_order_relaxed);
+    total.store(0, memory_order_relaxed);
+    maxValue.store(0, memory_order_relaxed);
+}
+
+double LatencyHistogram::getMean() const
+{
+    uint64_t n = getCount();
+    return n ? static_cast<double>(total.load(memory_order_relaxed)) / n : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    uint64_t n = getCount();
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * n + 0.5);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (int i = 0; i < bucketCount; i++)
+    {
+        seen += bucketCountAt(i);
+        if (seen >= rank)
+        {
+            uint64_t bound = bucketUpperBound(i);
+            return bound < getMax() ? bound : getMax();
+        }
+    }
+    return getMax();
+}
+
+string LatencyHistogram::summary() const
+{
+    char line[160];
+    snprintf(line, sizeof(line), "n=%llu mean=%.1fus p50=%.1fus p90=%.1fus p99=%.1fus max=%.1fus",
+             static_cast<unsigned long long>(getCount()), getMean() / 1000.0,
+             percentile(50) / 1000.0, percentile(90) / 1000.0, percentile(99) / 1000.0, getMax() / 1000.0);
+    return line;
+}
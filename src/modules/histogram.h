@@ -0,0 +1,49 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+// Log-linear latency histogram in nanoseconds: every power of two is split
+// into four sub-buckets, so percentiles are accurate to about 19%. Recording
+// is a couple of relaxed atomic adds and safe from any number of threads.
+class LatencyHistogram
+{
+public:
+    static const int subBuckets = 4;
+    static const int bucketCount = 64 * subBuckets;
+
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram& other);            // Snapshot copy
+    LatencyHistogram& operator=(const LatencyHistogram& other);
+
+    void record(uint64_t nanoseconds);
+    void merge(const LatencyHistogram& other);
+    void absorb(const uint64_t* bucketCounts, uint64_t samples, uint64_t sum, uint64_t maximum); // Add raw buckets
+    void reset();
+
+    uint64_t getCount() const { return count.load(memory_order_relaxed); }
+    uint64_t getMax() const { return maxValue.load(memory_order_relaxed); }
+    double getMean() const;
+
+    // Upper bound of the bucket holding the p-th percentile (p in 0..100)
+    uint64_t percentile(double p) const;
+
+    uint64_t bucketCountAt(int bucket) const { return buckets[bucket].load(memory_order_relaxed); }
+    static uint64_t bucketUpperBound(int bucket);
+    static int bucketFor(uint64_t nanoseconds);
+
+    // "n=.. mean=.. p50=.. p90=.. p99=.. max=.." with values in microseconds
+    string summary() const;
+
+private:
+    atomic<uint64_t> buckets[bucketCount];
+    atomic<uint64_t> count;
+    atomic<uint64_t> total;
+    atomic<uint64_t> maxValue;
+};
+
+#endif
@@ -0,0 +1,936 @@
+#include "ingest.h"
+#include "graphgen.h"
+#include "spscqueue.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+
+static const char feedMagic[4] = {'S', 'R', 'P', 'U'};
+static const uint32_t feedVersion = 1;
+static const size_t feedHeaderBytes = 8;
+
+IngestConfig IngestConfig::fromArgs(int argc, char** argv)
+{
+    IngestConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--ingest" && hasValue)
+            config.source = argv[++i];
+        else if (arg == "--ingest-gen" && hasValue)
+            config.generatePath = argv[++i];
+        else if (arg == "--format" && hasValue)
+        {
+            string format = argv[++i];
+            config.format = format == "line" ? FeedFormat::Line : format == "binary" ? FeedFormat::Binary : FeedFormat::Auto;
+        }
+        else if (arg == "--buffer" && hasValue)
+            config.bufferBytes = max(4096LL, atoll(argv[++i]));
+        else if (arg == "--batch" && hasValue)
+            config.batchUpdates = max(1, atoi(argv[++i]));
+        else if (arg == "--queue" && hasValue)
+            config.queueBatches = max(2, atoi(argv[++i]));
+        else if (arg == "--connections" && hasValue)
+            config.connections = max(1, atoi(argv[++i]));
+        else if (arg == "--snap" && hasValue)
+            config.snapRadius = atof(argv[++i]);
+        else if (arg == "--updates" && hasValue)
+            config.generateUpdates = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--vehicles" && hasValue)
+            config.generateVehicles = max(1, atoi(argv[++i]));
+        else if (arg == "--hints" && hasValue)
+            config.hintShare = min(1.0, max(0.0, atof(argv[++i])));
+        else if (arg == "--seed" && hasValue)
+            config.seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--grid" && hasValue)
+        {
+            string spec = argv[++i];
+            size_t x = spec.find('x');
+            config.gridWidth = atoi(spec.substr(0, x).c_str());
+            config.gridHeight = x == string::npos ? config.gridWidth : atoi(spec.substr(x + 1).c_str());
+        }
+    }
+    return config;
+}
+
+// Parser
+
+static void skipSpaces(const char*& at, const char* end)
+{
+    while (at < end && (*at == ' ' || *at == '\t' || *at == '\r'))
+    {
+        at++;
+    }
+}
+
+static bool readInteger(const char*& at, const char* end, int64_t& value)
+{
+    skipSpaces(at, end);
+    bool negative = at < end && *at == '-';
+    at += negative;
+    const char* digits = at;
+    uint64_t magnitude = 0;
+    while (at < end && *at >= '0' && *at <= '9' && at - digits < 19)
+    {
+        magnitude = magnitude * 10 + (*at++ - '0');
+    }
+    value = negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+    return at > digits && (at == end || *at < '0' || *at > '9');
+}
+
+// Plain decimals only ("-12.5"); exponents are not part of the protocol
+static bool readDecimal(const char*& at, const char* end, float& value)
+{
+    static const double scale[] = { 1, 1e-1, 1e-2, 1e-3, 1e-4, 1e-5, 1e-6, 1e-7, 1e-8, 1e-9 };
+    skipSpaces(at, end);
+    bool negative = at < end && *at == '-';
+    at += negative;
+    const char* digits = at;
+    double whole = 0;
+    while (at < end && *at >= '0' && *at <= '9')
+    {
+        whole = whole * 10 + (*at++ - '0');
+    }
+    bool any = at > digits;
+    if (at < end && *at == '.')
+    {
+        const char* fraction = ++at;
+        uint64_t part = 0;
+        while (at < end && *at >= '0' && *at <= '9')
+        {
+            if (at - fraction < 9)
+            {
+                part = part * 10 + (*at - '0');
+            }
+            at++;
+        }
+        any = any || at > fraction;
+        whole += part * scale[min<ptrdiff_t>(at - fraction, 9)];
+    }
+    value = static_cast<float>(negative ? -whole : whole);
+    return any;
+}
+
+bool FeedParser::parseLine(const char* at, const char* end, FeedRecord& record)
+{
+    int64_t vehicle, timestamp, status = 0, from = -1, to = -1;
+    if (!readInteger(at, end, vehicle) || !readInteger(at, end, timestamp) || !readDecimal(at, end, record.x) ||
+        !readDecimal(at, end, record.y) || vehicle < 0 || vehicle > UINT32_MAX || timestamp < 0)
+    {
+        return false;
+    }
+    skipSpaces(at, end);
+    if (at < end && (!readInteger(at, end, status) || status < 0 || status >= static_cast<int>(FeedStatus::Count)))
+    {
+        return false;
+    }
+    skipSpaces(at, end);
+    if (at < end && (!readInteger(at, end, from) || !readInteger(at, end, to)))
+    {
+        return false;
+    }
+    skipSpaces(at, end);
+    if (at < end)
+    {
+        return false; // Trailing junk
+    }
+    record.vehicleId = static_cast<uint32_t>(vehicle);
+    record.status = static_cast<uint8_t>(status);
+    record.vehicleClass = static_cast<uint8_t>(VehicleClass::Car);
+    record.reserved = 0;
+    record.timestamp = static_cast<uint64_t>(timestamp);
+    record.fromNode = static_cast<int32_t>(from);
+    record.toNode = static_cast<int32_t>(to);
+    return true;
+}
+
+size_t FeedParser::parseLines(const char* data, size_t size, FeedRecord* out, size_t room, size_t& produced, bool atEnd)
+{
+    const char* at = data;
+    const char* end = data + size;
+    while (at < end && produced < room)
+    {
+        const char* newline = static_cast<const char*>(memchr(at, '\n', end - at));
+        if (!newline && !atEnd)
+        {
+            break; // Rest of the line still to come
+        }
+        const char* lineEnd = newline ? newline : end;
+        const char* first = at;
+        skipSpaces(first, lineEnd);
+        if (first < lineEnd && *first != '#')
+        {
+            if (parseLine(first, lineEnd, out[produced]))
+            {
+                produced++;
+            }
+            else
+            {
+                malformed++;
+            }
+        }
+        at = newline ? newline + 1 : end;
+    }
+    return at - data;
+}
+
+size_t FeedParser::parseBinary(const char* data, size_t size, FeedRecord* out, size_t room, size_t& produced)
+{
+    size_t used = 0;
+    for (; used + sizeof(FeedRecord) <= size && produced < room; used += sizeof(FeedRecord))
+    {
+        // Straight from the buffer into the batch; the buffer need not be aligned
+        FeedRecord& record = out[produced];
+        memcpy(&record, data + used, sizeof(FeedRecord));
+        if (record.status < static_cast<uint8_t>(FeedStatus::Count))
+        {
+            produced++;
+        }
+        else
+        {
+            malformed++;
+        }
+    }
+    return used;
+}
+
+size_t FeedParser::parse(const char* data, size_t size, FeedRecord* out, size_t room, size_t& produced, bool atEnd)
+{
+    produced = 0;
+    size_t used = 0;
+    if (rejected)
+    {
+        return size;
+    }
+    if (!headerRead)
+    {
+        if (size < feedHeaderBytes && !atEnd)
+        {
+            return 0;
+        }
+        bool magic = size >= feedHeaderBytes && memcmp(data, feedMagic, 4) == 0;
+        if (format == FeedFormat::Auto)
+        {
+            format = magic ? FeedFormat::Binary : FeedFormat::Line;
+        }
+        if (magic && format == FeedFormat::Binary)
+        {
+            uint32_t version;
+            memcpy(&version, data + 4, sizeof(version));
+            if (version != feedVersion)
+            {
+                // Records of another layout would decode as garbage positions
+                cerr << "Unsupported feed version " << version << endl;
+                rejected = true;
+                headerRead = true;
+                return size;
+            }
+            used = feedHeaderBytes;
+        }
+        headerRead = true;
+    }
+    if (format == FeedFormat::Binary)
+    {
+        return used + parseBinary(data + used, size - used, out, room, produced);
+    }
+    return used + parseLines(data + used, size - used, out, room, produced, atEnd);
+}
+
+// Fleet state
+
+static float project(const Edge* edge, float x, float y, float& offset)
+{
+    float ax = edge->node1->x, ay = edge->node1->y;
+    float dx = edge->node2->x - ax, dy = edge->node2->y - ay;
+    float length2 = dx * dx + dy * dy;
+    offset = length2 > 0 ? min(1.0f, max(0.0f, ((x - ax) * dx + (y - ay) * dy) / length2)) : 0;
+    float px = ax + offset * dx - x, py = ay + offset * dy - y;
+    return sqrt(px * px + py * py);
+}
+
+FleetFeed::FleetFeed(const vector<Node*>& graph, double snapRadius) : snapRadius(snapRadius), nodes(graph)
+{
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        int id = nodes[i]->id;
+        if (id < 0)
+        {
+            continue;
+        }
+        if (static_cast<size_t>(id) >= slotOfId.size())
+        {
+            slotOfId.resize(id + 1, -1);
+        }
+        slotOfId[id] = static_cast<int32_t>(i);
+    }
+
+    // One entry per road, both directions mapped to it: they share the count
+    GridBox bounds = { 0, 0, 0, 0 };
+    vector<GridBox> boxes;
+    unordered_map<const Edge*, int32_t> roadOfEdge;
+    for (Node* node : nodes)
+    {
+        for (Edge* edge : node->edges)
+        {
+            if (edge->node1 != node)
+            {
+                continue;
+            }
+            Edge* reverse = Node::findEdge(edge->node2, edge->node1);
+            if (reverse && edge->node2->id < node->id)
+            {
+                continue; // Listed from the other end
+            }
+            GridBox box = { min(edge->node1->x, edge->node2->x), min(edge->node1->y, edge->node2->y),
+                            max(edge->node1->x, edge->node2->x), max(edge->node1->y, edge->node2->y) };
+            bounds = boxes.empty() ? box : GridBox{ min(bounds.minX, box.minX), min(bounds.minY, box.minY),
+                                                    max(bounds.maxX, box.maxX), max(bounds.maxY, box.maxY) };
+            boxes.push_back(box);
+            int32_t road = static_cast<int32_t>(roads.size());
+            roadOfEdge[edge] = road;
+            if (reverse)
+            {
+                roadOfEdge[reverse] = road;
+            }
+            roads.push_back(edge);
+            reverseRoads.push_back(reverse);
+        }
+    }
+    roadGrid.reset(bounds, boxes.size());
+    roadGrid.buildBoxes(boxes);
+    roadDelta.assign(roads.size(), 0);
+
+    // Hinted updates resolve their edge and road from here without hashing
+    firstOut.assign(1, 0);
+    for (Node* node : nodes)
+    {
+        for (Edge* edge : node->edges)
+        {
+            auto road = roadOfEdge.find(edge);
+            if (edge->node1 == node && road != roadOfEdge.end())
+            {
+                outEdges.push_back({ edge, road->second });
+            }
+        }
+        firstOut.push_back(static_cast<uint32_t>(outEdges.size()));
+    }
+}
+
+int FleetFeed::slotOf(int id) const
+{
+    if (id < 0 || static_cast<size_t>(id) >= slotOfId.size())
+    {
+        return -1;
+    }
+    return slotOfId[id];
+}
+
+int32_t FleetFeed::hintedRoad(const FeedRecord& update, Edge*& edge) const
+{
+    int from = slotOf(update.fromNode);
+    int to = slotOf(update.toNode);
+    if (from < 0 || to < 0)
+    {
+        return -1;
+    }
+    for (uint32_t i = firstOut[from]; i < firstOut[from + 1]; i++)
+    {
+        if (outEdges[i].first->node2 == nodes[to])
+        {
+            edge = outEdges[i].first;
+            return outEdges[i].second;
+        }
+    }
+    return -1;
+}
+
+// Nearest road to the update, driven in the direction the vehicle moved
+int32_t FleetFeed::snap(const Vehicle& vehicle, const Tracked& track, float x, float y, Edge*& edge)
+{
+    float offset;
+    if (track.road >= 0 && vehicle.currentEdge && project(vehicle.currentEdge, x, y, offset) <= snapRadius * 0.5 && offset > 0 && offset < 1)
+    {
+        return track.road; // Still well inside its last road
+    }
+
+    float radius = static_cast<float>(snapRadius);
+    roadGrid.query(GridBox{ x - radius, y - radius, x + radius, y + radius }, roadIds);
+    int32_t best = -1;
+    float nearest = radius;
+    for (uint32_t road : roadIds)
+    {
+        float distance = project(roads[road], x, y, offset);
+        if (distance <= nearest)
+        {
+            nearest = distance;
+            best = static_cast<int32_t>(road);
+        }
+    }
+    if (best < 0)
+    {
+        return -1;
+    }
+
+    Edge* forward = roads[best];
+    Edge* reverse = reverseRoads[best];
+    edge = forward;
+    if (reverse && track.seen)
+    {
+        float along = (x - vehicle.x) * (forward->node2->x - forward->node1->x) + (y - vehicle.y) * (forward->node2->y - forward->node1->y);
+        if (along < 0 || (along == 0 && vehicle.currentEdge == reverse))
+        {
+            edge = reverse;
+        }
+    }
+    return best;
+}
+
+void FleetFeed::moveCount(int32_t from, int32_t to)
+{
+    if (from >= 0)
+    {
+        if (roadDelta[from] == 0)
+        {
+            touchedRoads.push_back(from);
+        }
+        roadDelta[from]--;
+    }
+    if (to >= 0)
+    {
+        if (roadDelta[to] == 0)
+        {
+            touchedRoads.push_back(to);
+        }
+        roadDelta[to]++;
+    }
+}
+
+void FleetFeed::flushCounts()
+{
+    for (int32_t road : touchedRoads)
+    {
+        if (roadDelta[road] != 0)
+        {
+            Vehicle::updateEdgeAgentCount(roads[road], roadDelta[road]);
+            roadDelta[road] = 0;
+            stats.occupancyCalls++;
+        }
+    }
+    touchedRoads.clear();
+}
+
+void FleetFeed::apply(const FeedRecord* updates, size_t count)
+{
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++)
+    {
+        const FeedRecord& update = updates[i];
+        auto inserted = vehicleSlot.emplace(update.vehicleId, static_cast<uint32_t>(vehicles.size()));
+        if (inserted.second)
+        {
+            VehicleClass vehicleClass = update.vehicleClass < static_cast<uint8_t>(VehicleClass::Count) ? static_cast<VehicleClass>(update.vehicleClass) : VehicleClass::Car;
+            vehicles.emplace_back();
+            vehicles.back().id = static_cast<int>(update.vehicleId);
+            vehicles.back().type = vehicleClassName(vehicleClass);
+            vehicles.back().setClassByType();
+            tracked.emplace_back();
+            stats.newVehicles++;
+        }
+        Vehicle& vehicle = vehicles[inserted.first->second];
+        Tracked& track = tracked[inserted.first->second];
+        if (track.seen && update.timestamp < track.timestamp)
+        {
+            stats.stale++;
+            continue;
+        }
+
+        FeedStatus status = static_cast<FeedStatus>(update.status);
+        Edge* edge = vehicle.currentEdge;
+        int32_t road = track.road;
+        if (status == FeedStatus::Offline)
+        {
+            edge = nullptr;
+            road = -1;
+        }
+        else
+        {
+            int32_t placed = update.fromNode >= 0 ? hintedRoad(update, edge) : -1;
+            if (placed >= 0)
+            {
+                stats.hinted++;
+            }
+            else if ((placed = snap(vehicle, track, update.x, update.y, edge)) >= 0)
+            {
+                stats.snapped++;
+            }
+            else
+            {
+                stats.offRoad++; // Keeps its last road
+            }
+            road = placed >= 0 ? placed : road;
+        }
+
+        if (road != track.road)
+        {
+            moveCount(track.road, road);
+            stats.roadChanges++;
+        }
+        vehicle.x = update.x;
+        vehicle.y = update.y;
+        vehicle.currentEdge = edge;
+        vehicle.currentNode = edge ? edge->node1 : nullptr;
+        vehicle.currentNodeToReach = edge ? edge->node2 : nullptr;
+        vehicle.pickingUp = status == FeedStatus::ToPickup;
+        track.timestamp = update.timestamp;
+        track.seen = true;
+        track.road = road;
+        track.status = status;
+        stats.applied++;
+    }
+    flushCounts();
+    stats.batches++;
+    stats.applyNanos += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+void FleetFeed::clearOccupancy()
+{
+    for (size_t i = 0; i < tracked.size(); i++)
+    {
+        moveCount(tracked[i].road, -1);
+        tracked[i].road = -1;
+        vehicles[i].currentEdge = nullptr;
+    }
+    flushCounts();
+}
+
+// Synthetic feed
+
+bool writeSyntheticFeed(const vector<Node*>& nodes, const IngestConfig& config)
+{
+    vector<Node*> starts;
+    for (Node* node : nodes)
+    {
+        if (!node->edges.empty())
+        {
+            starts.push_back(node);
+        }
+    }
+    FILE* file = fopen(config.generatePath.c_str(), "wb");
+    if (!file || starts.empty())
+    {
+        cerr << "Cannot write a feed to " << config.generatePath << endl;
+        if (file)
+        {
+            fclose(file);
+        }
+        return false;
+    }
+
+    mt19937_64 random(config.seed);
+    normal_distribution<float> noise(0, 3);
+    uniform_real_distribution<double> unit(0, 1);
+    struct Wanderer
+    {
+        Edge* edge;
+        double along;
+    };
+    vector<Wanderer> fleet;
+    for (int i = 0; i < config.generateVehicles; i++)
+    {
+        Node* start = starts[random() % starts.size()];
+        fleet.push_back({ start->edges[random() % start->edges.size()], unit(random) * 50 });
+    }
+
+    bool binary = config.format != FeedFormat::Line;
+    string out;
+    if (binary)
+    {
+        out.append(feedMagic, 4);
+        out.append(reinterpret_cast<const char*>(&feedVersion), sizeof(feedVersion));
+    }
+    const double stride = 14; // Map units per one second tick
+    char line[128];
+    for (uint64_t written = 0; written < config.generateUpdates; written++)
+    {
+        size_t index = written % fleet.size();
+        uint64_t tick = written / fleet.size();
+        Wanderer& vehicle = fleet[index];
+        vehicle.along += stride;
+        while (vehicle.along >= vehicle.edge->length)
+        {
+            vehicle.along -= vehicle.edge->length;
+            Node* next = vehicle.edge->node2;
+            if (next->edges.empty())
+            {
+                next = starts[random() % starts.size()];
+            }
+            // Turn anywhere but straight back, unless it is a dead end
+            Edge* turn = next->edges[random() % next->edges.size()];
+            if (turn->node2 == vehicle.edge->node1 && next->edges.size() > 1)
+            {
+                turn = next->edges[random() % next->edges.size()];
+            }
+            vehicle.edge = turn;
+        }
+        Edge* edge = vehicle.edge;
+        double share = edge->length > 0 ? vehicle.along / edge->length : 0;
+
+        FeedRecord record;
+        record.vehicleId = static_cast<uint32_t>(index + 1);
+        record.status = static_cast<uint8_t>((index + tick / 120) % 3); // A new ride phase every two minutes
+        record.vehicleClass = static_cast<uint8_t>(index % static_cast<size_t>(VehicleClass::Count));
+        record.reserved = 0;
+        record.timestamp = tick * 1000;
+        record.x = static_cast<float>(edge->node1->x + (edge->node2->x - edge->node1->x) * share) + noise(random);
+        record.y = static_cast<float>(edge->node1->y + (edge->node2->y - edge->node1->y) * share) + noise(random);
+        bool hint = config.hintShare > 0 && unit(random) < config.hintShare;
+        record.fromNode = hint ? edge->node1->id : -1;
+        record.toNode = hint ? edge->node2->id : -1;
+
+        if (binary)
+        {
+            out.append(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+        else
+        {
+            int length = hint ? snprintf(line, sizeof(line), "%u %llu %.2f %.2f %u %d %d\n", record.vehicleId, static_cast<unsigned long long>(record.timestamp),
+                                         record.x, record.y, record.status, record.fromNode, record.toNode)
+                              : snprintf(line, sizeof(line), "%u %llu %.2f %.2f %u\n", record.vehicleId, static_cast<unsigned long long>(record.timestamp),
+                                         record.x, record.y, record.status);
+            out.append(line, length);
+        }
+        if (out.size() >= (1 << 20))
+        {
+            fwrite(out.data(), 1, out.size(), file);
+            out.clear();
+        }
+    }
+    fwrite(out.data(), 1, out.size(), file);
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+// Reading
+
+namespace
+{
+struct FeedBatch
+{
+    vector<FeedRecord> updates;
+    size_t count = 0;
+};
+
+// The reader thread parses into free batches and hands full ones to the
+// applier; batches cycle between the two queues, so nothing is allocated
+// once the run has started
+class BatchPipe
+{
+public:
+    BatchPipe(size_t batchUpdates, size_t queueBatches) : full(queueBatches), empty(queueBatches)
+    {
+        for (size_t i = 0; i < queueBatches; i++)
+        {
+            owned.emplace_back(new FeedBatch());
+            owned.back()->updates.resize(batchUpdates);
+            FeedBatch* batch = owned.back().get();
+            empty.tryPush(move(batch));
+        }
+    }
+
+    // Reader side: parses every complete record of the data, returns the bytes used
+    size_t parse(FeedParser& parser, const char* data, size_t size, bool atEnd)
+    {
+        size_t used = 0;
+        for (;;)
+        {
+            if (!current)
+            {
+                while (!empty.tryPop(current))
+                {
+                    this_thread::yield(); // Applier behind: backpressure
+                }
+            }
+            size_t produced;
+            size_t room = current->updates.size() - current->count;
+            used += parser.parse(data + used, size - used, current->updates.data() + current->count, room, produced, atEnd);
+            current->count += produced;
+            if (current->count < current->updates.size())
+            {
+                return used;
+            }
+            publish();
+        }
+    }
+
+    // Reader side: hands over a partly filled batch, e.g. when the source goes quiet
+    void publish()
+    {
+        if (current && current->count > 0)
+        {
+            while (!full.tryPush(move(current)))
+            {
+                this_thread::yield();
+            }
+            current = nullptr;
+        }
+    }
+
+    void close()
+    {
+        publish();
+        done.store(true, memory_order_release);
+    }
+
+    // Applier side: false once the reader has closed and everything is taken
+    bool next(FeedBatch*& batch)
+    {
+        for (;;)
+        {
+            if (full.tryPop(batch))
+            {
+                return true;
+            }
+            if (done.load(memory_order_acquire))
+            {
+                return full.tryPop(batch);
+            }
+            this_thread::yield();
+        }
+    }
+
+    void recycle(FeedBatch* batch)
+    {
+        batch->count = 0;
+        empty.tryPush(move(batch));
+    }
+
+private:
+    SpscQueue<FeedBatch*> full;
+    SpscQueue<FeedBatch*> empty;
+    vector<unique_ptr<FeedBatch>> owned;
+    FeedBatch* current = nullptr;
+    atomic<bool> done{ false };
+};
+}
+
+// Reads a pipe or socket until end of stream, parsing out of one buffer
+static void pumpDescriptor(int fd, FeedParser& parser, BatchPipe& pipe, vector<char>& buffer, IngestStats& stats)
+{
+    size_t filled = 0;
+    for (;;)
+    {
+        ssize_t got = read(fd, buffer.data() + filled, buffer.size() - filled);
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        bool atEnd = got <= 0;
+        filled += atEnd ? 0 : static_cast<size_t>(got);
+        stats.bytes += atEnd ? 0 : static_cast<size_t>(got);
+        size_t used = pipe.parse(parser, buffer.data(), filled, atEnd);
+        if (used == 0 && filled == buffer.size())
+        {
+            stats.malformed++; // A line longer than the buffer
+            used = filled;
+        }
+        memmove(buffer.data(), buffer.data() + used, filled - used);
+        filled -= used;
+        pipe.publish(); // Keep latency low when the producer is slow
+        if (atEnd || parser.isRejected())
+        {
+            return;
+        }
+    }
+}
+
+// Regular files are mapped and parsed where they lie
+static bool pumpMapped(int fd, size_t size, FeedParser& parser, BatchPipe& pipe, IngestStats& stats)
+{
+    if (size == 0)
+    {
+        return true;
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        return false;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    pipe.parse(parser, static_cast<const char*>(mapped), size, true);
+    stats.bytes += size;
+    munmap(mapped, size);
+    return true;
+}
+
+static int listenUnix(const string& path)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        return -1;
+    }
+    strcpy(address.sun_path, path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 4) != 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+// Reader thread body: every source of the run, then closes the pipe
+static void readFeed(const IngestConfig& config, BatchPipe& pipe, IngestStats& stats, bool& failed)
+{
+    auto start = chrono::steady_clock::now();
+    FeedParser parser(config.format);
+    vector<char> buffer(config.bufferBytes);
+    failed = false;
+
+    if (config.source.compare(0, 5, "unix:") == 0)
+    {
+        string path = config.source.substr(5);
+        int listener = listenUnix(path);
+        failed = listener < 0;
+        for (int served = 0; !failed && served < config.connections; served++)
+        {
+            int client = accept(listener, nullptr, nullptr);
+            if (client < 0)
+            {
+                failed = errno != EINTR;
+                served--;
+                continue;
+            }
+            FeedParser connection(config.format); // Each producer starts its own stream
+            pumpDescriptor(client, connection, pipe, buffer, stats);
+            stats.malformed += connection.getMalformed();
+            failed = connection.isRejected();
+            close(client);
+        }
+        if (listener >= 0)
+        {
+            close(listener);
+            unlink(path.c_str());
+        }
+    }
+    else
+    {
+        int fd = config.source == "-" ? 0 : open(config.source.c_str(), O_RDONLY);
+        struct stat info;
+        failed = fd < 0 || fstat(fd, &info) != 0;
+        if (!failed && (!S_ISREG(info.st_mode) || !pumpMapped(fd, static_cast<size_t>(info.st_size), parser, pipe, stats)))
+        {
+            pumpDescriptor(fd, parser, pipe, buffer, stats);
+        }
+        failed = failed || parser.isRejected();
+        if (fd > 0)
+        {
+            close(fd);
+        }
+    }
+    stats.malformed += parser.getMalformed();
+    stats.readNanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    pipe.close();
+}
+
+int runIngest(int argc, char** argv, const vector<Node*>& nodes)
+{
+    IngestConfig config = IngestConfig::fromArgs(argc, argv);
+    GeneratedGraph grid;
+    if (config.gridWidth > 0 && config.gridHeight > 0)
+    {
+        grid = makeGridGraph(config.gridWidth, config.gridHeight);
+    }
+    const vector<Node*>& network = grid.nodes.empty() ? nodes : grid.nodes;
+
+    if (!config.generatePath.empty())
+    {
+        bool ok = writeSyntheticFeed(network, config);
+        if (ok)
+        {
+            cout << "Wrote " << config.generateUpdates << " updates of " << config.generateVehicles << " vehicles to " << config.generatePath << endl;
+        }
+        freeGraph(grid);
+        return ok ? 0 : 1;
+    }
+    if (config.source.empty())
+    {
+        cerr << "Usage: SmartRide --ingest <file|fifo|-|unix:path> [--format line|binary] [--batch N]" << endl;
+        freeGraph(grid);
+        return 1;
+    }
+
+    FleetFeed feed(network, config.snapRadius);
+    BatchPipe pipe(config.batchUpdates, config.queueBatches);
+    IngestStats readStats;
+    bool failed = false;
+    cout << "Ingesting " << config.source << " onto " << feed.getRoadCount() << " roads" << endl;
+
+    auto start = chrono::steady_clock::now();
+    thread reader(readFeed, cref(config), ref(pipe), ref(readStats), ref(failed));
+    FeedBatch* batch;
+    uint64_t records = 0;
+    while (pipe.next(batch))
+    {
+        feed.apply(batch->updates.data(), batch->count);
+        records += batch->count;
+        pipe.recycle(batch);
+    }
+    reader.join();
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (failed)
+    {
+        cerr << "Cannot read " << config.source << endl;
+        freeGraph(grid);
+        return 1;
+    }
+
+    const IngestStats& stats = feed.getStats();
+    size_t onRoad = 0;
+    for (const Vehicle& vehicle : feed.getVehicles())
+    {
+        onRoad += vehicle.currentEdge != nullptr;
+    }
+    int busiest = 0;
+    for (Node* node : network)
+    {
+        for (Edge* edge : node->edges)
+        {
+            busiest = max(busiest, edge->no_of_agents);
+        }
+    }
+
+    cout << "-----------------------------------" << endl;
+    cout << "Updates: " << records << " (" << readStats.bytes / 1e6 << " MB) in " << wallSeconds << " s: "
+         << records / max(wallSeconds, 1e-9) << " updates/s, " << readStats.bytes / 1e6 / max(wallSeconds, 1e-9) << " MB/s" << endl;
+    cout << "Reader: done after " << readStats.readNanos / 1e9 << " s, " << readStats.malformed << " malformed" << endl;
+    cout << "Applier: " << stats.applied / max(stats.applyNanos / 1e9, 1e-9) << " updates/s in " << stats.batches << " batches, "
+         << stats.stale << " stale, " << stats.hinted << " hinted, " << stats.snapped << " snapped, " << stats.offRoad << " off road" << endl;
+    cout << "Occupancy: " << stats.roadChanges << " road changes summed into " << stats.occupancyCalls << " edge count updates" << endl;
+    cout << "Fleet: " << stats.newVehicles << " vehicles, " << onRoad << " on a road, busiest road holds " << busiest << endl;
+    cout << "-----------------------------------" << endl;
+
+    freeGraph(grid);
+    return 0;
+}
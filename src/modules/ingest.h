@@ -0,0 +1,180 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include "node.h"
+#include "spatialgrid.h"
+#include "vehicle.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+enum class FeedStatus : uint8_t
+{
+    Available,
+    ToPickup,
+    OnTrip,
+    Offline, // Counted on no road
+    Count
+};
+
+enum class FeedFormat
+{
+    Auto,   // Binary when the stream starts with the feed magic, lines otherwise
+    Line,
+    Binary
+};
+
+// One position/status update of an external vehicle. The binary protocol is
+// an 8 byte header ("SRPU", version) followed by these records back to back,
+// raw in host order. The line protocol carries the same fields as text:
+//   <vehicle> <timestamp> <x> <y> [<status> [<from node> <to node>]]
+// with '#' starting a comment line.
+struct FeedRecord
+{
+    uint32_t vehicleId;
+    uint8_t status;        // FeedStatus
+    uint8_t vehicleClass;  // VehicleClass, used when the vehicle is first seen
+    uint16_t reserved;
+    uint64_t timestamp;    // Milliseconds; older than the vehicle's last update is dropped
+    float x, y;
+    int32_t fromNode;      // Node ids of the edge driven, -1 to snap from x, y
+    int32_t toNode;
+};
+
+static_assert(sizeof(FeedRecord) == 32, "FeedRecord layout is part of the binary protocol");
+
+struct IngestConfig
+{
+    string source;              // File, FIFO, "-" for stdin or "unix:<path>" to listen on
+    FeedFormat format = FeedFormat::Auto;
+    size_t bufferBytes = 1 << 20; // Read buffer for pipes and sockets; files are mapped
+    size_t batchUpdates = 8192;   // Updates applied per batch
+    size_t queueBatches = 8;      // Parsed batches in flight between reader and applier
+    int connections = 1;          // Producers served one after another on a socket
+    double snapRadius = 40;       // Roads further from an unhinted update are not snapped to
+
+    // Writing a synthetic feed instead of reading one
+    string generatePath;
+    uint64_t generateUpdates = 1000000;
+    int generateVehicles = 1000;
+    double hintShare = 0;         // Share of generated updates that carry node ids
+    unsigned long long seed = 42;
+    int gridWidth = 0;            // Run on a generated grid instead of the city
+    int gridHeight = 0;
+
+    // Parse --ingest <source>, --ingest-gen <path>, --format line|binary,
+    // --buffer, --batch, --queue, --connections, --snap, --updates,
+    // --vehicles, --hints, --seed and --grid <W>x<H>
+    static IngestConfig fromArgs(int argc, char** argv);
+};
+
+struct IngestStats
+{
+    uint64_t bytes = 0;
+    uint64_t malformed = 0;   // Lines that did not parse, or records of an unknown status
+    uint64_t batches = 0;
+    uint64_t applied = 0;
+    uint64_t stale = 0;       // Older than the vehicle's last update
+    uint64_t hinted = 0;      // Placed by the node ids they carried
+    uint64_t snapped = 0;     // Placed on the nearest road
+    uint64_t offRoad = 0;     // Neither: the vehicle keeps its last road
+    uint64_t newVehicles = 0;
+    uint64_t roadChanges = 0; // Vehicles counted onto another road (or off every road)
+    uint64_t occupancyCalls = 0; // Edge count updates after coalescing per road
+    uint64_t readNanos = 0;   // Reader thread: reading and parsing
+    uint64_t applyNanos = 0;
+};
+
+// Incremental parser over whatever bytes have arrived. Only complete records
+// and lines are consumed; the caller keeps the rest for the next call. Text
+// is parsed where it lies, without copying lines out or allocating.
+class FeedParser
+{
+public:
+    explicit FeedParser(FeedFormat format = FeedFormat::Auto) : format(format) {}
+
+    // Parses up to `room` updates into `out`, returns the bytes consumed.
+    // With `atEnd` a final line without a newline is parsed too.
+    size_t parse(const char* data, size_t size, FeedRecord* out, size_t room, size_t& produced, bool atEnd = false);
+
+    uint64_t getMalformed() const { return malformed; }
+
+    // Set on a binary stream of another version; nothing more is parsed
+    bool isRejected() const { return rejected; }
+
+private:
+    size_t parseBinary(const char* data, size_t size, FeedRecord* out, size_t room, size_t& produced);
+    size_t parseLines(const char* data, size_t size, FeedRecord* out, size_t room, size_t& produced, bool atEnd);
+    bool parseLine(const char* at, const char* end, FeedRecord& record);
+
+    FeedFormat format;
+    bool headerRead = false;
+    bool rejected = false;
+    uint64_t malformed = 0;
+};
+
+// External vehicles mirrored into Vehicle objects and the shared edge counts.
+// Updates are applied a batch at a time: each vehicle is placed on a road
+// (by the node ids it sent, or by snapping through a SpatialGrid, preferring
+// its last road), and the agent count changes are summed per road, so a batch
+// touches each road's count once however many vehicles crossed it. Tick
+// thread only.
+class FleetFeed
+{
+public:
+    explicit FleetFeed(const vector<Node*>& nodes, double snapRadius = 40);
+
+    void apply(const FeedRecord* updates, size_t count);
+
+    const vector<Vehicle>& getVehicles() const { return vehicles; }
+    const IngestStats& getStats() const { return stats; }
+    size_t getRoadCount() const { return roads.size(); }
+
+    // Takes every vehicle off its road again
+    void clearOccupancy();
+
+private:
+    struct Tracked
+    {
+        uint64_t timestamp = 0;
+        bool seen = false;     // Has a position to tell the driving direction from
+        int32_t road = -1;     // Counted on this road, -1 when on none
+        FeedStatus status = FeedStatus::Available;
+    };
+
+    int slotOf(int id) const;
+    int32_t hintedRoad(const FeedRecord& update, Edge*& edge) const;
+    int32_t snap(const Vehicle& vehicle, const Tracked& tracked, float x, float y, Edge*& edge);
+    void moveCount(int32_t from, int32_t to);
+    void flushCounts();
+
+    double snapRadius;
+    vector<Node*> nodes;
+    vector<int32_t> slotOfId;
+    vector<Edge*> roads;          // One direction of each road, indexed by the grid
+    vector<Edge*> reverseRoads;   // The other direction, nullptr for one-way roads
+    vector<uint32_t> firstOut;    // Per node slot into outEdges, nodes + 1 entries
+    vector<pair<Edge*, int32_t>> outEdges; // Edges leaving each node with their road
+    SpatialGrid roadGrid;
+
+    vector<Vehicle> vehicles;
+    vector<Tracked> tracked;      // Parallel to vehicles
+    unordered_map<uint32_t, uint32_t> vehicleSlot;
+
+    vector<int> roadDelta;        // Per road, summed over the batch
+    vector<int32_t> touchedRoads;
+    vector<uint32_t> roadIds;     // Grid query scratch
+    IngestStats stats;
+};
+
+// Writes a synthetic feed: vehicles wandering the network edge by edge
+bool writeSyntheticFeed(const vector<Node*>& nodes, const IngestConfig& config);
+
+// Entry point for "SmartRide --ingest <source> ..." and "--ingest-gen <path> ..."
+int runIngest(int argc, char** argv, const vector<Node*>& nodes);
+
+#endif
@@ -0,0 +1,674 @@
+#include "loadgen.h"
+#include "matching.h"
+#include "dispatch.h"
+#include "routecache.h"
+#include "quietconsole.h"
+#include "logger.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <unordered_map>
+
+DemandConfig DemandConfig::fromArgs(int argc, char** argv, const vector<Node*>& nodes)
+{
+    DemandConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--rate" && hasValue)
+            config.arrivalRate = atof(argv[++i]);
+        else if (arg == "--duration" && hasValue)
+            config.duration = atof(argv[++i]);
+        else if (arg == "--drain" && hasValue)
+            config.drainTime = atof(argv[++i]);
+        else if (arg == "--fleet" && hasValue)
+            config.fleetSize = atoi(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            config.seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--hotspot-share" && hasValue)
+            config.hotspotShare = atof(argv[++i]);
+        else if (arg == "--replay" && hasValue)
+            config.replayFile = argv[++i];
+        else if (arg == "--events" && hasValue)
+            config.eventsFile = argv[++i];
+        else if (arg == "--pooling")
+            config.pooling = true;
+        else if (arg == "--max-wait" && hasValue)
+            config.maxWait = atof(argv[++i]);
+        else if (arg == "--max-detour" && hasValue)
+            config.maxDetour = atof(argv[++i]);
+        else if (arg == "--rebalance" && hasValue)
+            config.rebalanceInterval = atof(argv[++i]);
+        else if (arg == "--hotspot" && hasValue)
+        {
+            string spec = argv[++i];
+            size_t colon = spec.find(':');
+            int id = atoi(spec.substr(0, colon).c_str());
+            double weight = colon == string::npos ? 1.0 : atof(spec.substr(colon + 1).c_str());
+            for (Node* node : nodes)
+            {
+                if (node->id == id)
+                {
+                    config.hotspots.push_back({ node, weight });
+                }
+            }
+        }
+    }
+    return config;
+}
+
+double LoadReport::pickupEtaPercentile(double p) const
+{
+    if (pickupEtas.empty())
+    {
+        return 0;
+    }
+    vector<double> sorted = pickupEtas;
+    sort(sorted.begin(), sorted.end());
+    size_t rank = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[rank];
+}
+
+void LoadReport::display() const
+{
+    cout << "-----------------------------------" << endl;
+    cout << "Load test report" << endl;
+    cout << "Requests: " << requests << " (matched " << matched << ", unmatched " << unmatched << ", completed " << completed << ")" << endl;
+    cout << "Simulated time: " << simulatedSeconds << " s, wall time: " << wallSeconds << " s" << endl;
+    if (dispatchSeconds > 0)
+    {
+        cout << "Dispatch throughput: " << requests / dispatchSeconds << " requests/s of dispatch time" << endl;
+    }
+    if (simulatedSeconds > 0)
+    {
+        cout << "Served: " << matched * 3600.0 / simulatedSeconds << " rides per simulated hour" << endl;
+    }
+    cout << "Match latency: " << matchLatency.summary() << endl;
+    cout << "Pickup ETA: p50=" << pickupEtaPercentile(50) << "s p90=" << pickupEtaPercentile(90) << "s p99=" << pickupEtaPercentile(99) << "s" << endl;
+    cout << "Fleet utilization: " << utilization * 100 << "%" << endl;
+    if (pooling)
+    {
+        cout << "Pooling: " << sharedRides << " of " << completed << " completed rides shared, ride time " << rideTimeRatio << "x the direct trip" << endl;
+        cout << "Insertion: " << insertionLatency.summary() << ", " << (requests ? positionsTried / requests : 0) << " positions tried per request" << endl;
+    }
+    if (requests > 0)
+    {
+        cout << "Pricing: mean fare " << (completed ? fares / completed : 0) << ", mean quoted surge x" << quotedSurge / requests << ", peak x"
+             << pricing.peakMultiplier << ", quote " << quoteLatency.summary() << endl;
+    }
+    if (rebalance.rounds > 0)
+    {
+        cout << "Rebalancing: " << rebalance.moves << " moves in " << rebalance.rounds << " rounds, solve " << rebalance.totalSolveMillis / rebalance.rounds
+             << " ms mean, " << rebalance.lastSolveMillis << " ms last, " << rebalance.budgetHits << " over budget" << endl;
+    }
+    if (eventsWritten > 0)
+    {
+        cout << "Trip events: " << eventsWritten << " written, " << eventBytes / eventsWritten << " bytes each" << endl;
+    }
+    cout << "-----------------------------------" << endl;
+}
+
+LoadGenerator::LoadGenerator(const vector<Node*>& nodes, DemandConfig config) : nodes(nodes), config(config), random(config.seed) {}
+
+LoadGenerator::~LoadGenerator()
+{
+    for (Driver* driver : drivers)
+    {
+        if (driver->assignedVehicle)
+        {
+            driver->assignedVehicle->leaveEdge();
+        }
+        delete driver->assignedVehicle;
+        delete driver;
+    }
+}
+
+Node* LoadGenerator::pickTripEnd()
+{
+    uniform_real_distribution<double> coin(0.0, 1.0);
+    if (!config.hotspots.empty() && coin(random) < config.hotspotShare)
+    {
+        vector<double> weights;
+        for (const Hotspot& hotspot : config.hotspots)
+        {
+            weights.push_back(hotspot.weight);
+        }
+        discrete_distribution<size_t> pick(weights.begin(), weights.end());
+        return config.hotspots[pick(random)].node;
+    }
+    uniform_int_distribution<size_t> uniform(0, nodes.size() - 1);
+    return nodes[uniform(random)];
+}
+
+Node* LoadGenerator::nodeById(int id) const
+{
+    for (Node* node : nodes)
+    {
+        if (node->id == id)
+        {
+            return node;
+        }
+    }
+    return nullptr;
+}
+
+vector<DemandEvent> LoadGenerator::synthesize()
+{
+    vector<DemandEvent> events;
+    exponential_distribution<double> gap(config.arrivalRate);
+    uniform_int_distribution<size_t> type(0, config.vehicleClasses.size() - 1);
+
+    for (double t = gap(random); t < config.duration; t += gap(random))
+    {
+        Node* origin = pickTripEnd();
+        Node* destination = pickTripEnd();
+        while (destination == origin)
+        {
+            destination = pickTripEnd();
+        }
+        events.push_back({ t, origin, destination, config.vehicleClasses[type(random)] });
+    }
+    return events;
+}
+
+vector<DemandEvent> LoadGenerator::loadReplay(const string& path) const
+{
+    vector<DemandEvent> events;
+    ifstream file(path);
+    if (!file.is_open())
+    {
+        LOG_ERROR("Error opening replay file %s", path.c_str());
+        return events;
+    }
+
+    string line;
+    while (getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        stringstream fields(line);
+        string time, origin, destination, type;
+        getline(fields, time, ',');
+        getline(fields, origin, ',');
+        getline(fields, destination, ',');
+        getline(fields, type);
+
+        Node* from = nodeById(atoi(origin.c_str()));
+        Node* to = nodeById(atoi(destination.c_str()));
+        if (from && to && from != to)
+        {
+            events.push_back({ atof(time.c_str()), from, to, vehicleClassOf(type) }); // Blank or unknown reads as a car
+        }
+    }
+    sort(events.begin(), events.end(), [](const DemandEvent& a, const DemandEvent& b) { return a.time < b.time; });
+    return events;
+}
+
+void LoadGenerator::createFleet()
+{
+    uniform_int_distribution<size_t> uniform(0, nodes.size() - 1);
+    for (int i = 0; i < config.fleetSize; i++)
+    {
+        string type = vehicleClassName(config.vehicleClasses[i % config.vehicleClasses.size()]);
+        Node* start = nodes[uniform(random)];
+        Driver* driver = new Driver(30, "Load driver " + to_string(i), "driver" + to_string(i) + "@loadtest", true, "", "", 1, type, start);
+        driver->assignedVehicle = new Vehicle(i + 1, type, start, start, {}); // Parked, no path
+        drivers.push_back(driver);
+        fleetByClass.add(driver);
+
+        FleetMember member;
+        member.driver = driver;
+        member.idleAt = start;
+        fleet.push_back(member);
+    }
+
+    surge.attach(nodes);
+    for (const FleetMember& member : fleet)
+    {
+        surge.driverIdle(member.idleAt);
+    }
+
+    if (config.pooling && !drivers.empty())
+    {
+        // Plans assume a little under free speed: vehicles stop, pull away and queue
+        const double planningShare = 0.8;
+        planningSpeed = drivers.front()->assignedVehicle->speed / config.tickSeconds * planningShare;
+        travelTimes.reset(new TravelTimes(nodes, planningSpeed));
+        ridePool.reset(new RidePool(*travelTimes, PoolConfig{ config.maxWait, config.maxDetour }));
+        for (Driver* driver : drivers)
+        {
+            ridePool->addVehicle(driver->currentNode, driver->vehicleClass);
+        }
+    }
+    if (config.rebalanceInterval > 0)
+    {
+        rebalancer.reset(new FleetRebalancer(nodes));
+    }
+}
+
+void LoadGenerator::recordEvent(TripEventType type, const FleetMember& member, double now, const Vehicle* vehicle, int nodeId, float value)
+{
+    if (!eventLog)
+    {
+        return;
+    }
+    TripEvent event;
+    event.timestamp = eventClockBase + static_cast<uint64_t>(now * 1000);
+    event.type = type;
+    event.tripId = member.tripId;
+    event.vehicleId = vehicle ? vehicle->id : -1;
+    event.nodeId = nodeId;
+    event.x = vehicle ? vehicle->x : 0;
+    event.y = vehicle ? vehicle->y : 0;
+    event.value = value;
+    event.driver = member.driverId;
+    event.user = member.riderId;
+    eventLog->record(event);
+}
+
+void LoadGenerator::advanceFleet(double now, LoadReport& report)
+{
+    for (FleetMember& member : fleet)
+    {
+        if (member.phase == TripPhase::Idle)
+        {
+            continue;
+        }
+
+        Driver* driver = member.driver;
+        Vehicle* vehicle = driver->assignedVehicle;
+        if (member.phase == TripPhase::Repositioning)
+        {
+            bool there = vehicle->moveVehicle();
+            driver->currentNode = vehicle->currentNode; // Matched from the last node passed
+            if (there)
+            {
+                member.phase = TripPhase::Idle;
+                surge.driverMoved(member.idleAt, vehicle->currentNode);
+                member.idleAt = vehicle->currentNode;
+            }
+            continue;
+        }
+
+        bool arrived = vehicle->moveVehicle() || (!vehicle->currentEdge && vehicle->path.empty());
+        if (!arrived)
+        {
+            continue;
+        }
+
+        driver->currentNode = vehicle->currentNode;
+        if (member.phase == TripPhase::ToPickup)
+        {
+            report.pickupEtas.push_back(now - member.acceptedAt);
+            member.pickedUpAt = now;
+            recordEvent(TripEventType::Pickup, member, now, vehicle, vehicle->currentNode->id);
+            Vehicle* trip = new Vehicle(vehicle->id, driver->vehicleType, member.rider.currentLocation, member.rider.goalLocation,
+                                        routeCache.findRoute(member.rider.currentLocation, member.rider.goalLocation));
+            trip->speed = vehicle->speed;
+            delete vehicle;
+            driver->assignedVehicle = trip;
+            member.phase = TripPhase::OnTrip;
+        }
+        else
+        {
+            report.completed++;
+            float fare = surge.fare(member.quote, vehicle->odometer, now - member.pickedUpAt, driver->vehicleClass);
+            report.fares += fare;
+            recordEvent(TripEventType::Dropoff, member, now, vehicle, vehicle->currentNode->id, fare);
+            member.rider.setRideState(RideState::None);
+            member.phase = TripPhase::Idle;
+            driver->availability = true;
+            member.idleAt = vehicle->currentNode;
+            surge.driverIdle(member.idleAt);
+        }
+    }
+}
+
+// Sends idle drivers toward zones where requests are expected; they stay
+// available and can be matched on the way
+void LoadGenerator::rebalanceFleet(double now)
+{
+    vector<IdleVehicle> idle;
+    for (size_t i = 0; i < fleet.size(); i++)
+    {
+        Vehicle* vehicle = fleet[i].driver->assignedVehicle;
+        if (fleet[i].phase == TripPhase::Idle && vehicle->laneEntry < 0)
+        {
+            idle.push_back({ static_cast<int>(i), vehicle->currentNode });
+        }
+    }
+    for (Reposition& move : rebalancer->plan(idle, now))
+    {
+        FleetMember& member = fleet[move.id];
+        member.driver->assignedVehicle->updateDestination(move.target, std::move(move.path));
+        member.phase = TripPhase::Repositioning;
+    }
+}
+
+// Inserts the request into the best plan among the vehicles of the requested
+// type. Moving vehicles are planned from the node they reach next.
+bool LoadGenerator::dispatchPooled(const DemandEvent& event, const User& rider, FleetMember& request, double now, LoadReport& report)
+{
+    uint64_t started = nowNanoseconds();
+    vector<int> candidates;
+    for (size_t i = 0; i < fleet.size(); i++)
+    {
+        Driver* driver = fleet[i].driver;
+        if (driver->vehicleClass != event.vehicleClass)
+        {
+            continue;
+        }
+        Vehicle* vehicle = driver->assignedVehicle;
+        if (vehicle->laneEntry >= 0)
+        {
+            float dx = vehicle->currentNodeToReach->x - vehicle->x;
+            float dy = vehicle->currentNodeToReach->y - vehicle->y;
+            ridePool->setPosition(static_cast<int>(i), travelTimes->indexOf(vehicle->currentNodeToReach), now + sqrt(dx * dx + dy * dy) / planningSpeed);
+        }
+        else
+        {
+            ridePool->setPosition(static_cast<int>(i), travelTimes->indexOf(vehicle->currentNode), now);
+        }
+        candidates.push_back(static_cast<int>(i));
+    }
+
+    PoolRequest poolRequest = ridePool->makeRequest(++lastRide, event.origin, event.destination, now);
+    Insertion insertion = candidates.empty() ? Insertion() : ridePool->bestInsertion(poolRequest, candidates);
+    if (insertion.vehicle >= 0)
+    {
+        ridePool->insert(insertion, poolRequest);
+    }
+    uint64_t finished = nowNanoseconds();
+    report.insertionLatency.record(finished - started);
+    report.matchLatency.record(finished - started);
+    report.dispatchSeconds += (finished - started) / 1e9;
+    if (insertion.vehicle < 0)
+    {
+        return false;
+    }
+
+    PooledRide& ride = pooledRides[poolRequest.ride];
+    ride.rider = rider;
+    ride.tripId = request.tripId;
+    ride.riderId = request.riderId;
+    ride.requestedAt = now;
+    ride.directTime = poolRequest.directTime;
+    ride.quote = request.quote;
+
+    FleetMember& member = fleet[insertion.vehicle];
+    Vehicle* vehicle = member.driver->assignedVehicle;
+    if (insertion.pickupAt == 0)
+    {
+        vehicle->updateDestination(event.origin); // New first stop
+    }
+    if (member.phase == TripPhase::Idle)
+    {
+        member.acceptedAt = now;
+        surge.driverBusy(member.idleAt);
+        member.idleAt = nullptr;
+    }
+    member.phase = TripPhase::OnTrip;
+    member.driver->availability = false;
+    member.tripId = request.tripId;
+    member.riderId = request.riderId;
+    recordEvent(TripEventType::Accepted, member, now, vehicle, event.origin->id);
+    return true;
+}
+
+// Moves every vehicle with a plan and works off the stops it reaches
+void LoadGenerator::advancePooled(double now, LoadReport& report)
+{
+    for (size_t i = 0; i < fleet.size(); i++)
+    {
+        FleetMember& member = fleet[i];
+        if (member.phase == TripPhase::Idle)
+        {
+            continue;
+        }
+        int index = static_cast<int>(i);
+        Vehicle* vehicle = member.driver->assignedVehicle;
+        if (!vehicle->moveVehicle())
+        {
+            continue;
+        }
+
+        int at = travelTimes->indexOf(vehicle->currentNode);
+        while (!ridePool->stopsOf(index).empty() && ridePool->stopsOf(index).front().node == at)
+        {
+            int aboard = ridePool->onboard(index);
+            PoolStop stop = ridePool->completeStop(index, now);
+            PooledRide& ride = pooledRides[stop.ride];
+            member.tripId = ride.tripId;
+            member.riderId = ride.riderId;
+            if (stop.kind == StopKind::Pickup)
+            {
+                ride.pickedUpAt = now;
+                ride.odometerAtPickup = vehicle->odometer;
+                report.pickupEtas.push_back(now - ride.requestedAt);
+                recordEvent(TripEventType::Pickup, member, now, vehicle, vehicle->currentNode->id);
+                if (aboard > 0)
+                {
+                    // Everyone already aboard now shares with this rider
+                    ride.shared = true;
+                    for (const PoolStop& later : ridePool->stopsOf(index))
+                    {
+                        auto other = pooledRides.find(later.ride);
+                        if (later.kind == StopKind::Dropoff && other != pooledRides.end() && other->second.pickedUpAt >= 0)
+                        {
+                            other->second.shared = true;
+                        }
+                    }
+                }
+                continue;
+            }
+
+            report.completed++;
+            report.sharedRides += ride.shared;
+            if (ride.directTime > 0)
+            {
+                report.rideTimeRatio += (now - ride.pickedUpAt) / ride.directTime;
+            }
+            float fare = surge.fare(ride.quote, vehicle->odometer - ride.odometerAtPickup, now - ride.pickedUpAt, member.driver->vehicleClass);
+            report.fares += fare;
+            recordEvent(TripEventType::Dropoff, member, now, vehicle, vehicle->currentNode->id, fare);
+            ride.rider.setRideState(RideState::None);
+            pooledRides.erase(stop.ride);
+        }
+
+        member.driver->currentNode = vehicle->currentNode;
+        if (ridePool->stopsOf(index).empty())
+        {
+            member.phase = TripPhase::Idle;
+            member.driver->availability = true;
+            member.idleAt = vehicle->currentNode;
+            surge.driverIdle(member.idleAt);
+        }
+        else
+        {
+            vehicle->updateDestination(travelTimes->nodeAt(ridePool->stopsOf(index).front().node));
+        }
+    }
+}
+
+LoadReport LoadGenerator::run()
+{
+    LoadReport report;
+    vector<DemandEvent> events = config.replayFile.empty() ? synthesize() : loadReplay(config.replayFile);
+    double demandEnd = events.empty() ? 0 : max(config.duration, events.back().time);
+
+    if (!config.eventsFile.empty())
+    {
+        eventLog.reset(new TripEventLog(config.eventsFile));
+        if (!eventLog->start())
+        {
+            eventLog.reset();
+        }
+        eventClockBase = tripClockMillis();
+    }
+    long long sampleTicks = max(1LL, llround(1.0 / config.tickSeconds)); // One position sample per simulated second
+
+    auto wallStart = chrono::steady_clock::now();
+    double busyTicks = 0;
+    long long ticks = 0;
+    size_t next = 0;
+    {
+        QuietConsole quiet;
+        createFleet();
+        unordered_map<Driver*, FleetMember*> memberOf;
+        for (FleetMember& member : fleet)
+        {
+            memberOf[member.driver] = &member;
+            member.driverId = eventLog ? eventLog->intern(member.driver->email) : 0;
+        }
+
+        double now = 0;
+        double nextRebalance = config.rebalanceInterval;
+        for (; now < demandEnd + config.drainTime; now += config.tickSeconds, ticks++)
+        {
+            while (next < events.size() && events[next].time <= now)
+            {
+                const DemandEvent& event = events[next++];
+                report.requests++;
+                if (rebalancer)
+                {
+                    rebalancer->noteRequest(event.origin, now);
+                }
+                uint64_t quoted = nowNanoseconds();
+                FareQuote quote = surge.quote(event.origin, event.destination, event.vehicleClass);
+                report.quoteLatency.record(nowNanoseconds() - quoted);
+                report.quotedSurge += quote.multiplier;
+                surge.requestOpened(event.origin);
+
+                if (ridePool)
+                {
+                    User rider(25, "Load rider", "rider" + to_string(next) + "@loadtest", true, "");
+                    rider.requestRide(event.origin, event.destination);
+                    FleetMember request;
+                    if (eventLog)
+                    {
+                        request.tripId = eventLog->nextTripId();
+                        request.riderId = eventLog->intern(rider.email);
+                        recordEvent(TripEventType::Requested, request, now, nullptr, event.origin->id);
+                    }
+                    request.quote = quote;
+                    if (dispatchPooled(event, rider, request, now, report))
+                        report.matched++;
+                    else
+                        report.unmatched++;
+                    surge.requestClosed(event.origin);
+                    continue;
+                }
+
+                uint64_t started = nowNanoseconds();
+                User rider(25, "Load rider", "rider" + to_string(next) + "@loadtest", true, "");
+                rider.requestRide(event.origin, event.destination);
+                Driver* driver = findNearestDriver(event.origin, fleetByClass.of(event.vehicleClass), event.vehicleClass);
+                Vehicle* parked = driver ? driver->assignedVehicle : nullptr;
+                Vehicle* vehicle = driver ? driver->acceptRide(rider) : nullptr;
+                uint64_t finished = nowNanoseconds();
+                report.matchLatency.record(finished - started);
+                report.dispatchSeconds += (finished - started) / 1e9;
+
+                FleetMember request;
+                if (eventLog)
+                {
+                    request.tripId = eventLog->nextTripId();
+                    request.riderId = eventLog->intern(rider.email);
+                    recordEvent(TripEventType::Requested, request, now, nullptr, event.origin->id);
+                }
+
+                surge.requestClosed(event.origin); // Matched or given up at once
+                if (!vehicle)
+                {
+                    report.unmatched++;
+                    continue;
+                }
+                vehicle->speed = parked->speed;
+                parked->leaveEdge(); // Still on the road when it was repositioning
+                delete parked;
+
+                report.matched++;
+                FleetMember* member = memberOf[driver];
+                member->phase = TripPhase::ToPickup;
+                member->rider = rider;
+                member->acceptedAt = now;
+                member->tripId = request.tripId;
+                member->riderId = request.riderId;
+                member->quote = quote;
+                surge.driverBusy(member->idleAt);
+                member->idleAt = nullptr;
+                recordEvent(TripEventType::Accepted, *member, now, vehicle, event.origin->id);
+            }
+
+            surge.advance(config.tickSeconds);
+            if (ridePool)
+                advancePooled(now, report);
+            else
+                advanceFleet(now, report);
+
+            if (rebalancer && now >= nextRebalance)
+            {
+                rebalanceFleet(now);
+                nextRebalance += config.rebalanceInterval;
+            }
+
+            if (eventLog && ticks % sampleTicks == 0)
+            {
+                for (const FleetMember& member : fleet)
+                {
+                    if (member.phase != TripPhase::Idle)
+                    {
+                        recordEvent(TripEventType::Position, member, now, member.driver->assignedVehicle, -1);
+                    }
+                }
+            }
+
+            int busy = 0;
+            for (const FleetMember& member : fleet)
+            {
+                busy += member.phase == TripPhase::ToPickup || member.phase == TripPhase::OnTrip;
+            }
+            busyTicks += fleet.empty() ? 0 : static_cast<double>(busy) / fleet.size();
+        }
+        report.simulatedSeconds = now;
+    }
+
+    report.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+    report.utilization = ticks ? busyTicks / ticks : 0;
+    if (ridePool)
+    {
+        report.pooling = true;
+        report.positionsTried = ridePool->getPositionsTried();
+        report.rideTimeRatio = report.completed ? report.rideTimeRatio / report.completed : 0;
+    }
+    if (rebalancer)
+    {
+        report.rebalance = rebalancer->getStats();
+    }
+    report.pricing = surge.getStats();
+    if (eventLog)
+    {
+        eventLog->stop();
+        report.eventsWritten = eventLog->getEventsWritten();
+        report.eventBytes = eventLog->getBytesWritten();
+    }
+    return report;
+}
+
+int runLoadTest(int argc, char** argv, const vector<Node*>& nodes)
+{
+    DemandConfig config = DemandConfig::fromArgs(argc, argv, nodes);
+    cout << "Running load test: rate " << config.arrivalRate << "/s for " << config.duration << " s, fleet of " << config.fleetSize
+         << (config.replayFile.empty() ? "" : ", replaying " + config.replayFile) << (config.pooling ? ", pooled rides" : "") << endl;
+
+    LoadGenerator generator(nodes, config);
+    LoadReport report = generator.run();
+    report.display();
+    return 0;
+}
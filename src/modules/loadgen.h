@@ -0,0 +1,165 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include "user.h"
+#include "driver.h"
+#include "histogram.h"
+#include "tripevents.h"
+#include "pooling.h"
+#include "pricing.h"
+#include "rebalance.h"
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Weighted pickup/drop-off attractor (airport, station...)
+struct Hotspot
+{
+    Node* node;
+    double weight;
+};
+
+// One ride request of a synthetic or replayed workload
+struct DemandEvent
+{
+    double time;        // Seconds since the start of the run
+    Node* origin;
+    Node* destination;
+    VehicleClass vehicleClass;
+};
+
+struct DemandConfig
+{
+    unsigned long long seed = 42;
+    double arrivalRate = 0.5;       // Mean requests per simulated second (Poisson process)
+    double duration = 600;          // Simulated seconds to generate demand for
+    double drainTime = 600;         // Extra seconds to let trips in progress finish
+    double tickSeconds = 1.0 / 60;  // Simulated time per movement tick (one frame)
+    double hotspotShare = 0.6;      // Fraction of trip ends drawn from hotspots
+    int fleetSize = 20;             // Synthetic drivers, vehicle types spread evenly
+    vector<Hotspot> hotspots;       // Empty means uniform demand
+    vector<VehicleClass> vehicleClasses = { VehicleClass::Car, VehicleClass::Rickshaw, VehicleClass::Bike, VehicleClass::Bus };
+    string replayFile;              // CSV "seconds,originId,destinationId,vehicleType" replaces synthesis
+    string eventsFile;              // Append the run's trip events and positions to this file
+    bool pooling = false;           // Shared rides through a RidePool instead of one rider per driver
+    double maxWait = 300;           // Pooling: seconds from request to pickup
+    double maxDetour = 0.5;         // Pooling: extra ride time allowed, share of the direct trip
+    double rebalanceInterval = 0;   // Seconds between idle fleet rebalancing rounds, 0 disables
+
+    // Parse --rate, --duration, --drain, --fleet, --seed, --hotspot-share,
+    // --hotspot <nodeId>:<weight> (repeatable), --replay <file>, --events <file>,
+    // --pooling, --max-wait, --max-detour and --rebalance <seconds>
+    static DemandConfig fromArgs(int argc, char** argv, const vector<Node*>& nodes);
+};
+
+struct LoadReport
+{
+    int requests = 0;
+    int matched = 0;
+    int unmatched = 0;
+    int completed = 0;
+    double wallSeconds = 0;        // Wall time of the whole run
+    double dispatchSeconds = 0;    // Wall time spent inside the request/match/accept path
+    double simulatedSeconds = 0;
+    double utilization = 0;        // Mean fraction of the fleet busy per tick
+    LatencyHistogram matchLatency; // requestRide + findNearestDriver + acceptRide
+    vector<double> pickupEtas;     // Simulated seconds from acceptance to pickup
+    uint64_t eventsWritten = 0;
+    uint64_t eventBytes = 0;
+    bool pooling = false;
+    LatencyHistogram insertionLatency; // Pooling: bestInsertion per request
+    uint64_t positionsTried = 0;       // Pooling: pickup/dropoff positions evaluated
+    int sharedRides = 0;               // Pooling: completed rides that had company aboard
+    double rideTimeRatio = 0;          // Pooling: mean ride time over the direct trip time
+    RebalanceStats rebalance;          // Zero rounds when rebalancing is off
+    LatencyHistogram quoteLatency;     // Fare quote at request time
+    double fares = 0;                  // Charged on completed rides
+    double quotedSurge = 0;            // Sum of the multipliers quoted, per request
+    PricingStats pricing;
+
+    double pickupEtaPercentile(double p) const;
+    void display() const;
+};
+
+// Drives the requestRide -> findNearestDriver -> acceptRide flow from a
+// generated or replayed request stream, moving the fleet tick by tick with
+// console output suppressed, and reports throughput and latency.
+class LoadGenerator
+{
+public:
+    LoadGenerator(const vector<Node*>& nodes, DemandConfig config);
+    ~LoadGenerator();
+
+    vector<DemandEvent> synthesize();
+    vector<DemandEvent> loadReplay(const string& path) const;
+
+    LoadReport run();
+
+private:
+    enum class TripPhase { Idle, ToPickup, OnTrip, Repositioning }; // Repositioning drivers stay available
+
+    struct FleetMember
+    {
+        Driver* driver;
+        TripPhase phase = TripPhase::Idle;
+        User rider;
+        double acceptedAt = 0;
+        uint32_t tripId = 0;
+        uint32_t driverId = 0; // Interned in the event log
+        uint32_t riderId = 0;
+        Node* idleAt = nullptr; // Where the surge counters hold it idle, null while busy
+        FareQuote quote;
+        double pickedUpAt = 0;
+    };
+
+    // A pooled rider between request and dropoff
+    struct PooledRide
+    {
+        User rider;
+        uint32_t tripId = 0;
+        uint32_t riderId = 0;
+        double requestedAt = 0;
+        double pickedUpAt = -1;
+        float directTime = 0;
+        bool shared = false;
+        FareQuote quote;
+        float odometerAtPickup = 0; // Riders pay for the distance they were aboard
+    };
+
+    Node* pickTripEnd();
+    Node* nodeById(int id) const;
+    void createFleet();
+    void advanceFleet(double now, LoadReport& report);
+    bool dispatchPooled(const DemandEvent& event, const User& rider, FleetMember& request, double now, LoadReport& report);
+    void advancePooled(double now, LoadReport& report);
+    void rebalanceFleet(double now);
+    void recordEvent(TripEventType type, const FleetMember& member, double now, const Vehicle* vehicle, int nodeId, float value = 0);
+
+    const vector<Node*>& nodes;
+    DemandConfig config;
+    mt19937_64 random;
+    vector<FleetMember> fleet;
+    vector<Driver*> drivers;
+    FleetPartitions fleetByClass;    // drivers split by vehicle class for matching
+    unique_ptr<TripEventLog> eventLog; // Only with --events
+    uint64_t eventClockBase = 0;     // Wall clock at simulated time 0
+
+    // Pooling only; fleet member i is pool vehicle i
+    unique_ptr<TravelTimes> travelTimes;
+    unique_ptr<RidePool> ridePool;
+    double planningSpeed = 0;        // Units per second the plans assume
+    unordered_map<uint32_t, PooledRide> pooledRides;
+    uint32_t lastRide = 0;
+
+    unique_ptr<FleetRebalancer> rebalancer; // Only with --rebalance
+    SurgePricing surge;
+};
+
+// Entry point for "SmartRide --loadtest ..."
+int runLoadTest(int argc, char** argv, const vector<Node*>& nodes);
+
+#endif
@@ -0,0 +1,326 @@
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+atomic<int> logThreshold(static_cast<int>(LogLevel::Info));
+
+static uint64_t steadyNanoseconds()
+{
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+const char* logLevelName(LogLevel level)
+{
+    static const char* names[] = {"DEBUG", "INFO", "WARN", "ERROR", "OFF"};
+    return names[static_cast<int>(level)];
+}
+
+void setLogLevel(LogLevel level)
+{
+    logThreshold.store(static_cast<int>(level), memory_order_relaxed);
+}
+
+LogLevel getLogLevel()
+{
+    return static_cast<LogLevel>(logThreshold.load(memory_order_relaxed));
+}
+
+LogSite::LogSite(LogLevel level, const char* path, int line)
+    : level(level), file(strrchr(path, '/') ? strrchr(path, '/') + 1 : path), line(line), windowStart(0), windowCount(0), suppressed(0)
+{
+}
+
+bool LogSite::admit(uint64_t now, uint32_t& suppressedBefore)
+{
+    // Fixed one-second windows; racing threads may let a record or two
+    // extra through at a window edge, which is fine for a log limiter
+    uint64_t second = now / 1000000000ull;
+    uint64_t start = windowStart.load(memory_order_relaxed);
+    if (start != second && windowStart.compare_exchange_strong(start, second, memory_order_relaxed))
+    {
+        windowCount.store(0, memory_order_relaxed);
+    }
+
+    if (windowCount.fetch_add(1, memory_order_relaxed) < maxPerSecond)
+    {
+        suppressedBefore = suppressed.exchange(0, memory_order_relaxed);
+        return true;
+    }
+    suppressed.fetch_add(1, memory_order_relaxed);
+    return false;
+}
+
+// A formatted record waiting for the writer. Fixed size so producers
+// format in place and nothing is allocated per message.
+struct LogRecord
+{
+    static const int textSize = 232;
+
+    atomic<uint64_t> sequence;
+    uint64_t timestamp;
+    const LogSite* site;
+    uint32_t suppressed;
+    char text[textSize];
+};
+
+// Bounded multi-producer ring (sequence-numbered slots) drained by one
+// background thread
+class LogWriter
+{
+public:
+    static const uint64_t capacity = 4096; // Power of two
+
+    LogWriter() : slots(new LogRecord[capacity]), enqueuePos(0), dequeuePos(0), flushedPos(0), dropped(0), reportedDrops(0),
+                  running(true), sink(stderr), startTime(steadyNanoseconds())
+    {
+        for (uint64_t i = 0; i < capacity; i++)
+        {
+            slots[i].sequence.store(i, memory_order_relaxed);
+        }
+        worker = thread(&LogWriter::run, this);
+    }
+
+    void write(LogSite& site, const char* format, va_list args)
+    {
+        uint64_t now = steadyNanoseconds();
+        uint32_t suppressed = 0;
+        if (!site.admit(now, suppressed))
+        {
+            return;
+        }
+
+        if (!running.load(memory_order_acquire))
+        {
+            // Shut down at exit: write synchronously
+            LogRecord record;
+            record.timestamp = now;
+            record.site = &site;
+            record.suppressed = suppressed;
+            vsnprintf(record.text, LogRecord::textSize, format, args);
+            lock_guard<mutex> guard(sinkLock);
+            emit(record);
+            fflush(sink);
+            return;
+        }
+
+        uint64_t position;
+        LogRecord* slot = claim(position);
+        if (!slot)
+        {
+            dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        slot->timestamp = now;
+        slot->site = &site;
+        slot->suppressed = suppressed;
+        vsnprintf(slot->text, LogRecord::textSize, format, args);
+        slot->sequence.store(position + 1, memory_order_release);
+    }
+
+    void flush()
+    {
+        uint64_t target = enqueuePos.load(memory_order_acquire);
+        while (running.load(memory_order_acquire) && flushedPos.load(memory_order_acquire) < target)
+        {
+            this_thread::sleep_for(chrono::microseconds(200));
+        }
+        lock_guard<mutex> guard(sinkLock);
+        fflush(sink);
+    }
+
+    bool setFile(const string& path)
+    {
+        FILE* next = stderr;
+        if (!path.empty())
+        {
+            next = fopen(path.c_str(), "a");
+            if (!next)
+            {
+                return false;
+            }
+        }
+        flush();
+        lock_guard<mutex> guard(sinkLock);
+        if (sink != stderr)
+        {
+            fclose(sink);
+        }
+        sink = next;
+        return true;
+    }
+
+    void shutdown()
+    {
+        if (running.exchange(false))
+        {
+            worker.join();
+        }
+    }
+
+    uint64_t droppedCount() const { return dropped.load(memory_order_relaxed); }
+
+private:
+    LogRecord* claim(uint64_t& position)
+    {
+        position = enqueuePos.load(memory_order_relaxed);
+        while (true)
+        {
+            LogRecord* slot = &slots[position & (capacity - 1)];
+            uint64_t sequence = slot->sequence.load(memory_order_acquire);
+            if (sequence == position)
+            {
+                if (enqueuePos.compare_exchange_weak(position, position + 1, memory_order_relaxed))
+                {
+                    return slot;
+                }
+            }
+            else if (sequence < position)
+            {
+                return nullptr; // Full: the writer has not freed this slot yet
+            }
+            else
+            {
+                position = enqueuePos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    // Writer side: moves ready records into the buffer, returns how many
+    size_t drain(string& buffer)
+    {
+        size_t count = 0;
+        uint64_t position = dequeuePos.load(memory_order_relaxed);
+        while (true)
+        {
+            LogRecord* slot = &slots[position & (capacity - 1)];
+            if (slot->sequence.load(memory_order_acquire) != position + 1)
+            {
+                break;
+            }
+            format(*slot, buffer);
+            slot->sequence.store(position + capacity, memory_order_release);
+            position++;
+            count++;
+        }
+        dequeuePos.store(position, memory_order_release);
+        return count;
+    }
+
+    void format(const LogRecord& record, string& buffer)
+    {
+        char line[LogRecord::textSize + 128];
+        double seconds = (record.timestamp - startTime) / 1e9;
+        int length = snprintf(line, sizeof(line), "[%10.6f] %-5s %s:%d %s", seconds, logLevelName(record.site->level),
+                              record.site->file, record.site->line, record.text);
+        buffer.append(line, min(length, static_cast<int>(sizeof(line)) - 1));
+        if (record.suppressed > 0)
+        {
+            buffer += " (+" + to_string(record.suppressed) + " suppressed)";
+        }
+        buffer += '\n';
+    }
+
+    void emit(const LogRecord& record)
+    {
+        string buffer;
+        format(record, buffer);
+        fwrite(buffer.data(), 1, buffer.size(), sink);
+    }
+
+    void run()
+    {
+        string buffer;
+        buffer.reserve(64 * 1024);
+        while (true)
+        {
+            bool stopping = !running.load(memory_order_acquire);
+            size_t written = drain(buffer);
+
+            uint64_t drops = dropped.load(memory_order_relaxed);
+            if (drops != reportedDrops)
+            {
+                buffer += "[log] " + to_string(drops - reportedDrops) + " records dropped, ring full\n";
+                reportedDrops = drops;
+            }
+
+            if (!buffer.empty())
+            {
+                lock_guard<mutex> guard(sinkLock);
+                fwrite(buffer.data(), 1, buffer.size(), sink);
+                buffer.clear();
+            }
+
+            if (written == 0)
+            {
+                // Idle: make what we have visible and mark it flushed
+                uint64_t position = dequeuePos.load(memory_order_relaxed);
+                if (flushedPos.load(memory_order_relaxed) != position)
+                {
+                    lock_guard<mutex> guard(sinkLock);
+                    fflush(sink);
+                    flushedPos.store(position, memory_order_release);
+                }
+                if (stopping)
+                {
+                    break;
+                }
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+        }
+    }
+
+    LogRecord* slots;
+    alignas(64) atomic<uint64_t> enqueuePos;
+    alignas(64) atomic<uint64_t> dequeuePos;
+    atomic<uint64_t> flushedPos;
+    atomic<uint64_t> dropped;
+    uint64_t reportedDrops;
+    atomic<bool> running;
+
+    mutex sinkLock;
+    FILE* sink;
+    uint64_t startTime;
+    thread worker;
+};
+
+// Never destroyed: records may still arrive from static destructors, which
+// are written synchronously once the worker has been stopped at exit
+static LogWriter& logWriter()
+{
+    static LogWriter* writer = []
+    {
+        LogWriter* created = new LogWriter();
+        atexit([] { logWriter().shutdown(); });
+        return created;
+    }();
+    return *writer;
+}
+
+void logWrite(LogSite& site, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    logWriter().write(site, format, args);
+    va_end(args);
+}
+
+void flushLog()
+{
+    logWriter().flush();
+}
+
+bool setLogFile(const string& path)
+{
+    return logWriter().setFile(path);
+}
+
+uint64_t droppedLogRecords()
+{
+    return logWriter().droppedCount();
+}
@@ -0,0 +1,89 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+enum class LogLevel
+{
+    Debug,
+    Info,
+    Warn,
+    Error,
+    Off
+};
+
+// Levels below this are compiled out entirely. Release builds (NDEBUG)
+// drop debug logs; override with -DLOG_COMPILE_LEVEL=n.
+#ifndef LOG_COMPILE_LEVEL
+#ifdef NDEBUG
+#define LOG_COMPILE_LEVEL 1
+#else
+#define LOG_COMPILE_LEVEL 0
+#endif
+#endif
+
+// One per call site. Holds the rate limit window: at most
+// maxPerSecond records per second, the rest are counted and reported
+// with the next record that gets through.
+struct LogSite
+{
+    static const uint32_t maxPerSecond = 10;
+
+    LogSite(LogLevel level, const char* file, int line);
+
+    bool admit(uint64_t now, uint32_t& suppressedBefore);
+
+    const LogLevel level;
+    const char* const file; // Basename of the source file
+    const int line;
+
+    atomic<uint64_t> windowStart;
+    atomic<uint32_t> windowCount;
+    atomic<uint32_t> suppressed;
+};
+
+// Runtime threshold, checked before anything is formatted
+extern atomic<int> logThreshold;
+
+inline bool logEnabled(LogLevel level)
+{
+    return static_cast<int>(level) >= logThreshold.load(memory_order_relaxed);
+}
+
+void setLogLevel(LogLevel level);
+LogLevel getLogLevel();
+
+// Send output to a file instead of stderr; an empty path restores stderr
+bool setLogFile(const string& path);
+
+// Formats straight into a ring slot; the background writer does the I/O
+void logWrite(LogSite& site, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+// Blocks until everything logged so far has been written out
+void flushLog();
+
+// Records dropped because the ring was full
+uint64_t droppedLogRecords();
+
+const char* logLevelName(LogLevel level);
+
+#define LOG_AT(level, ...)                                                        \
+    do                                                                            \
+    {                                                                             \
+        if (static_cast<int>(level) >= LOG_COMPILE_LEVEL && logEnabled(level))    \
+        {                                                                         \
+            static LogSite logSite(level, __FILE__, __LINE__);                    \
+            logWrite(logSite, __VA_ARGS__);                                       \
+        }                                                                         \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,839 @@
+#include "mapmatch.h"
+#include "graphgen.h"
+#include "pathfinder.h"
+#include "tripevents.h"
+#include "vehicle.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+
+static const double unreachable = numeric_limits<double>::infinity();
+
+MatchConfig MatchConfig::fromArgs(int argc, char** argv)
+{
+    MatchConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--trace" && hasValue)
+            config.tracePath = argv[++i];
+        else if (arg == "--synthetic" && hasValue)
+            config.syntheticVehicles = max(0, atoi(argv[++i]));
+        else if (arg == "--duration" && hasValue)
+            config.syntheticSeconds = atof(argv[++i]);
+        else if (arg == "--interval" && hasValue)
+            config.sampleSeconds = max(0.001, atof(argv[++i]));
+        else if (arg == "--noise" && hasValue)
+            config.noise = atof(argv[++i]);
+        else if (arg == "--speed" && hasValue)
+            config.speed = atof(argv[++i]);
+        else if (arg == "--sigma" && hasValue)
+            config.sigma = max(0.1, atof(argv[++i]));
+        else if (arg == "--radius" && hasValue)
+            config.searchRadius = atof(argv[++i]);
+        else if (arg == "--candidates" && hasValue)
+            config.maxCandidates = max(1, atoi(argv[++i]));
+        else if (arg == "--beta" && hasValue)
+            config.beta = max(0.1, atof(argv[++i]));
+        else if (arg == "--max-route" && hasValue)
+            config.maxRouteDistance = atof(argv[++i]);
+        else if (arg == "--lag" && hasValue)
+            config.maxLag = max(1, atoi(argv[++i]));
+        else if (arg == "--batch" && hasValue)
+            config.batchSamples = max(1, atoi(argv[++i]));
+        else if (arg == "--seed" && hasValue)
+            config.seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--apply")
+            config.apply = true;
+        else if (arg == "--grid" && hasValue)
+        {
+            string spec = argv[++i];
+            size_t x = spec.find('x');
+            config.gridWidth = atoi(spec.substr(0, x).c_str());
+            config.gridHeight = x == string::npos ? config.gridWidth : atoi(spec.substr(x + 1).c_str());
+        }
+    }
+    return config;
+}
+
+void MatchStats::add(const MatchStats& other)
+{
+    samples += other.samples;
+    matched += other.matched;
+    unmatched += other.unmatched;
+    breaks += other.breaks;
+    forced += other.forced;
+    transitions += other.transitions;
+    routeHits += other.routeHits;
+    routeMisses += other.routeMisses;
+    edgesEmitted += other.edgesEmitted;
+    busyNanos += other.busyNanos;
+}
+
+static Node* otherEnd(const Edge* edge, const Node* from)
+{
+    return edge->node1 == from ? edge->node2 : edge->node1;
+}
+
+// Distance from a point to the edge, and how far along it the closest point lies
+static float project(const Edge* edge, float x, float y, float& offset)
+{
+    float ax = edge->node1->x, ay = edge->node1->y;
+    float dx = edge->node2->x - ax, dy = edge->node2->y - ay;
+    float length2 = dx * dx + dy * dy;
+    offset = length2 > 0 ? min(1.0f, max(0.0f, ((x - ax) * dx + (y - ay) * dy) / length2)) : 0;
+    float px = ax + offset * dx - x, py = ay + offset * dy - y;
+    return sqrt(px * px + py * py);
+}
+
+MapMatcher::MapMatcher(const vector<Node*>& graph, MatchConfig config, ThreadPool& pool)
+    : config(config), pool(pool), nodes(graph), shards(max(1, pool.size()))
+{
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        int id = nodes[i]->id;
+        if (id < 0)
+        {
+            continue;
+        }
+        if (static_cast<size_t>(id) >= slotOfId.size())
+        {
+            slotOfId.resize(id + 1, -1);
+        }
+        slotOfId[id] = static_cast<int32_t>(i);
+    }
+
+    // One entry per road; the reverse direction is derived from it
+    GridBox bounds = { 0, 0, 0, 0 };
+    vector<GridBox> boxes;
+    for (Node* node : nodes)
+    {
+        for (Edge* edge : node->edges)
+        {
+            if (edge->node1 != node)
+            {
+                continue;
+            }
+            Edge* reverse = Node::findEdge(edge->node2, edge->node1);
+            if (reverse && edge->node2->id < node->id)
+            {
+                continue; // Listed from the other end
+            }
+            GridBox box = { min(edge->node1->x, edge->node2->x), min(edge->node1->y, edge->node2->y),
+                            max(edge->node1->x, edge->node2->x), max(edge->node1->y, edge->node2->y) };
+            bounds = boxes.empty() ? box : GridBox{ min(bounds.minX, box.minX), min(bounds.minY, box.minY),
+                                                    max(bounds.maxX, box.maxX), max(bounds.maxY, box.maxY) };
+            boxes.push_back(box);
+            roads.push_back(edge);
+            reverseRoads.push_back(reverse);
+        }
+    }
+    roadGrid.reset(bounds, boxes.size());
+    roadGrid.buildBoxes(boxes);
+}
+
+int MapMatcher::slotOf(const Node* node) const
+{
+    if (node->id < 0 || static_cast<size_t>(node->id) >= slotOfId.size())
+    {
+        return -1;
+    }
+    int32_t slot = slotOfId[node->id];
+    return slot >= 0 && nodes[slot] == node ? slot : -1;
+}
+
+size_t MapMatcher::shardOf(int vehicleId) const
+{
+    return (static_cast<uint32_t>(vehicleId) * 2654435761u) % shards.size();
+}
+
+void MapMatcher::push(const vector<GpsSample>& samples)
+{
+    for (const GpsSample& sample : samples)
+    {
+        shards[shardOf(sample.vehicleId)].inbox.push_back(sample);
+    }
+    TaskGroup group(pool);
+    for (Shard& shard : shards)
+    {
+        if (!shard.inbox.empty())
+        {
+            group.submit([this, &shard](int) { runShard(shard); });
+        }
+    }
+    group.wait();
+}
+
+void MapMatcher::runShard(Shard& shard)
+{
+    auto start = chrono::steady_clock::now();
+    for (const GpsSample& sample : shard.inbox)
+    {
+        step(shard, sample.vehicleId, shard.tracks[sample.vehicleId], sample);
+    }
+    shard.inbox.clear();
+    shard.stats.busyNanos += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+void MapMatcher::finish()
+{
+    TaskGroup group(pool);
+    for (Shard& shard : shards)
+    {
+        group.submit([this, &shard](int) {
+            for (auto& entry : shard.tracks)
+            {
+                closeChain(shard, entry.first, entry.second);
+            }
+        });
+    }
+    group.wait();
+}
+
+void MapMatcher::findCandidates(Shard& shard, const GpsSample& sample)
+{
+    float radius = static_cast<float>(config.searchRadius);
+    roadGrid.queryCells(GridBox{ sample.x - radius, sample.y - radius, sample.x + radius, sample.y + radius }, shard.roadIds);
+    sort(shard.roadIds.begin(), shard.roadIds.end());
+    shard.roadIds.erase(unique(shard.roadIds.begin(), shard.roadIds.end()), shard.roadIds.end());
+
+    shard.nearest.clear();
+    for (uint32_t road : shard.roadIds)
+    {
+        float offset;
+        float distance = project(roads[road], sample.x, sample.y, offset);
+        if (distance <= radius)
+        {
+            shard.nearest.push_back({ distance, road });
+        }
+    }
+    size_t kept = min(shard.nearest.size(), static_cast<size_t>(config.maxCandidates));
+    partial_sort(shard.nearest.begin(), shard.nearest.begin() + kept, shard.nearest.end());
+
+    shard.candidates.clear();
+    for (size_t i = 0; i < kept; i++)
+    {
+        uint32_t road = shard.nearest[i].second;
+        float offset;
+        float distance = project(roads[road], sample.x, sample.y, offset);
+        shard.candidates.push_back({ roads[road], offset, distance });
+        if (reverseRoads[road])
+        {
+            shard.candidates.push_back({ reverseRoads[road], 1 - offset, distance });
+        }
+    }
+}
+
+// Bounded Dijkstra by edge length from one node, cached per shard. The cache
+// is dropped wholesale when full: sources cluster around where the shard's
+// vehicles drive, so it refills with the ones still in use.
+const MapMatcher::RouteTree& MapMatcher::routeTree(Shard& shard, uint32_t source)
+{
+    auto found = shard.routes.find(source);
+    if (found != shard.routes.end())
+    {
+        shard.stats.routeHits++;
+        return found->second;
+    }
+    shard.stats.routeMisses++;
+    if (shard.routes.size() >= config.routeCacheEntries)
+    {
+        shard.routes.clear();
+    }
+
+    if (shard.scratchStamp.size() != nodes.size())
+    {
+        shard.scratchDistance.assign(nodes.size(), 0);
+        shard.scratchVia.assign(nodes.size(), nullptr);
+        shard.scratchStamp.assign(nodes.size(), 0);
+        shard.stamp = 0;
+    }
+    if (++shard.stamp == 0)
+    {
+        fill(shard.scratchStamp.begin(), shard.scratchStamp.end(), 0);
+        shard.stamp = 1;
+    }
+
+    float bound = static_cast<float>(config.maxRouteDistance);
+    shard.heap.clear();
+    shard.reached.clear();
+    shard.scratchStamp[source] = shard.stamp;
+    shard.scratchDistance[source] = 0;
+    shard.scratchVia[source] = nullptr;
+    shard.reached.push_back(source);
+    shard.heap.push_back({ 0.0f, source });
+    while (!shard.heap.empty())
+    {
+        pop_heap(shard.heap.begin(), shard.heap.end(), greater<>());
+        float distance = shard.heap.back().first;
+        uint32_t slot = shard.heap.back().second;
+        shard.heap.pop_back();
+        if (distance > shard.scratchDistance[slot])
+        {
+            continue;
+        }
+        Node* node = nodes[slot];
+        for (Edge* edge : node->edges)
+        {
+            int next = slotOf(otherEnd(edge, node));
+            float through = distance + edge->length;
+            if (next < 0 || through > bound)
+            {
+                continue;
+            }
+            if (shard.scratchStamp[next] != shard.stamp)
+            {
+                shard.scratchStamp[next] = shard.stamp;
+                shard.reached.push_back(next);
+            }
+            else if (through >= shard.scratchDistance[next])
+            {
+                continue;
+            }
+            shard.scratchDistance[next] = through;
+            shard.scratchVia[next] = edge;
+            shard.heap.push_back({ through, static_cast<uint32_t>(next) });
+            push_heap(shard.heap.begin(), shard.heap.end(), greater<>());
+        }
+    }
+
+    sort(shard.reached.begin(), shard.reached.end());
+    RouteTree tree;
+    tree.reserve(shard.reached.size());
+    for (uint32_t slot : shard.reached)
+    {
+        tree.push_back({ slot, shard.scratchDistance[slot], shard.scratchVia[slot] });
+    }
+    return shard.routes.emplace(source, move(tree)).first->second;
+}
+
+const MapMatcher::RouteStep* MapMatcher::findStep(const RouteTree& tree, uint32_t slot)
+{
+    auto found = lower_bound(tree.begin(), tree.end(), slot, [](const RouteStep& step, uint32_t node) { return step.node < node; });
+    return found != tree.end() && found->node == slot ? &*found : nullptr;
+}
+
+// Moving forward along one edge, or back by no more than the noise explains
+static bool sameTraversal(const Edge* fromEdge, float fromOffset, const Edge* toEdge, float toOffset, double sigma)
+{
+    return fromEdge == toEdge && (toOffset - fromOffset) * fromEdge->length >= -2 * sigma;
+}
+
+// Route length between two candidates. Most pairs are on one edge or on
+// consecutive edges and need no tree; `tree` keeps the one fetched for
+// `from` across the calls of a step.
+double MapMatcher::routeLength(Shard& shard, const Candidate& from, const Candidate& to, const RouteTree*& tree)
+{
+    if (sameTraversal(from.edge, from.offset, to.edge, to.offset, config.sigma))
+    {
+        return fabs(to.offset - from.offset) * from.edge->length;
+    }
+    double ends = (1 - from.offset) * from.edge->length + to.offset * to.edge->length;
+    if (from.edge->node2 == to.edge->node1)
+    {
+        return ends;
+    }
+    int source = slotOf(from.edge->node2);
+    int target = slotOf(to.edge->node1);
+    if (source < 0 || target < 0)
+    {
+        return unreachable;
+    }
+    if (!tree)
+    {
+        tree = &routeTree(shard, source);
+    }
+    const RouteStep* step = findStep(*tree, target);
+    return step ? ends + step->distance : unreachable;
+}
+
+// The edges driven between two decided candidates, exclusive of both
+void MapMatcher::routeBetween(Shard& shard, const Candidate& from, const Candidate& to, vector<Edge*>& edges)
+{
+    edges.clear();
+    int source = slotOf(from.edge->node2);
+    int target = slotOf(to.edge->node1);
+    if (source < 0 || target < 0)
+    {
+        return;
+    }
+    if (source == target)
+    {
+        return;
+    }
+    const RouteTree& tree = routeTree(shard, source);
+    uint32_t slot = static_cast<uint32_t>(target);
+    while (slot != static_cast<uint32_t>(source) && edges.size() <= tree.size())
+    {
+        const RouteStep* step = findStep(tree, slot);
+        if (!step || !step->via)
+        {
+            edges.clear(); // Beyond the bound
+            return;
+        }
+        edges.push_back(step->via);
+        slot = static_cast<uint32_t>(slotOf(step->via->node1));
+    }
+    reverse(edges.begin(), edges.end());
+}
+
+void MapMatcher::startChain(Shard& shard, Track& track, const GpsSample& sample)
+{
+    uint32_t first = static_cast<uint32_t>(track.states.size());
+    double best = -unreachable;
+    for (const Candidate& candidate : shard.candidates)
+    {
+        double emission = -0.5 * (candidate.distance / config.sigma) * (candidate.distance / config.sigma);
+        track.states.push_back({ candidate, emission, -1 });
+        best = max(best, emission);
+    }
+    for (size_t k = first; k < track.states.size(); k++)
+    {
+        track.states[k].score -= best;
+    }
+    track.columns.push_back({ sample.timestamp, sample.x, sample.y, first, static_cast<uint32_t>(shard.candidates.size()) });
+}
+
+void MapMatcher::step(Shard& shard, int vehicleId, Track& track, const GpsSample& sample)
+{
+    shard.stats.samples++;
+    track.lastSeen = sample.timestamp;
+    findCandidates(shard, sample);
+    if (shard.candidates.empty())
+    {
+        shard.stats.unmatched++;
+        return;
+    }
+    if (!track.columns.empty() && sample.timestamp - track.columns.back().timestamp > config.maxGapMillis)
+    {
+        shard.stats.breaks++;
+        closeChain(shard, vehicleId, track);
+    }
+    if (track.columns.empty())
+    {
+        startChain(shard, track, sample);
+        return;
+    }
+
+    // Viterbi step: each candidate keeps its best predecessor
+    const Column previous = track.columns.back();
+    double straight = hypot(sample.x - previous.x, sample.y - previous.y);
+    size_t count = shard.candidates.size();
+    shard.top.assign(count, -unreachable);
+    shard.topState.assign(count, -1);
+    for (uint32_t i = previous.first; i < previous.first + previous.count; i++)
+    {
+        const State& from = track.states[i];
+        const RouteTree* tree = nullptr;
+        for (size_t j = 0; j < count; j++)
+        {
+            double length = routeLength(shard, from.candidate, shard.candidates[j], tree);
+            if (length == unreachable)
+            {
+                continue;
+            }
+            double score = from.score - fabs(length - straight) / config.beta;
+            if (score > shard.top[j])
+            {
+                shard.top[j] = score;
+                shard.topState[j] = static_cast<int32_t>(i);
+            }
+        }
+    }
+    shard.stats.transitions += previous.count * count;
+
+    uint32_t first = static_cast<uint32_t>(track.states.size());
+    double best = -unreachable;
+    for (size_t j = 0; j < count; j++)
+    {
+        if (shard.topState[j] >= 0)
+        {
+            const Candidate& candidate = shard.candidates[j];
+            double emission = -0.5 * (candidate.distance / config.sigma) * (candidate.distance / config.sigma);
+            track.states.push_back({ candidate, shard.top[j] + emission, shard.topState[j] });
+            best = max(best, shard.top[j] + emission);
+        }
+    }
+    if (track.states.size() == first)
+    {
+        // No candidate can be driven to in time: end the chain here
+        shard.stats.breaks++;
+        closeChain(shard, vehicleId, track);
+        startChain(shard, track, sample);
+        return;
+    }
+    for (size_t k = first; k < track.states.size(); k++)
+    {
+        track.states[k].score -= best; // Keep scores near zero over long chains
+    }
+    track.columns.push_back({ sample.timestamp, sample.x, sample.y, first, static_cast<uint32_t>(track.states.size() - first) });
+
+    // The newest sample every surviving path runs through is settled
+    size_t newest = track.columns.size() - 1;
+    shard.frontier.clear();
+    for (uint32_t k = first; k < track.states.size(); k++)
+    {
+        shard.frontier.push_back(static_cast<int32_t>(k));
+    }
+    for (size_t column = newest + 1; column-- > 0;)
+    {
+        bool converged = all_of(shard.frontier.begin(), shard.frontier.end(), [&](int32_t state) { return state == shard.frontier[0]; });
+        if (converged)
+        {
+            decide(shard, vehicleId, track, shard.frontier[0], column + 1);
+            return;
+        }
+        bool chainStart = column == 0;
+        for (int32_t& state : shard.frontier)
+        {
+            state = chainStart ? -1 : track.states[state].back;
+            chainStart = chainStart || state < 0;
+        }
+        if (chainStart)
+        {
+            break;
+        }
+    }
+
+    if (track.columns.size() > static_cast<size_t>(config.maxLag))
+    {
+        // Settle the oldest sample on the path of today's best candidate
+        shard.stats.forced++;
+        int32_t state = first;
+        for (int32_t k = first; k < static_cast<int32_t>(track.states.size()); k++)
+        {
+            if (track.states[k].score > track.states[state].score)
+            {
+                state = k;
+            }
+        }
+        for (size_t column = newest; column > 0 && state >= 0; column--)
+        {
+            state = track.states[state].back;
+        }
+        decide(shard, vehicleId, track, state, 1);
+    }
+}
+
+// Emits the path ending in `upTo` over the oldest columnsDecided samples and
+// drops them from the lattice. Surviving states that pointed into the
+// decided part now start from lastDecided.
+void MapMatcher::decide(Shard& shard, int vehicleId, Track& track, int32_t upTo, size_t columnsDecided)
+{
+    shard.chosen.assign(columnsDecided, -1);
+    int32_t state = upTo;
+    for (size_t column = columnsDecided; column-- > 0 && state >= 0;)
+    {
+        shard.chosen[column] = state;
+        state = track.states[state].back;
+    }
+    for (size_t column = 0; column < columnsDecided; column++)
+    {
+        if (shard.chosen[column] >= 0)
+        {
+            emit(shard, vehicleId, track, track.states[shard.chosen[column]].candidate, track.columns[column].timestamp);
+        }
+    }
+
+    uint32_t offset = columnsDecided < track.columns.size() ? track.columns[columnsDecided].first : static_cast<uint32_t>(track.states.size());
+    track.states.erase(track.states.begin(), track.states.begin() + offset);
+    for (State& remaining : track.states)
+    {
+        remaining.back = remaining.back >= static_cast<int32_t>(offset) ? remaining.back - static_cast<int32_t>(offset) : -1;
+    }
+    track.columns.erase(track.columns.begin(), track.columns.begin() + columnsDecided);
+    for (Column& column : track.columns)
+    {
+        column.first -= offset;
+    }
+}
+
+void MapMatcher::closeChain(Shard& shard, int vehicleId, Track& track)
+{
+    if (!track.columns.empty())
+    {
+        const Column& last = track.columns.back();
+        int32_t best = last.first;
+        for (uint32_t k = last.first; k < last.first + last.count; k++)
+        {
+            if (track.states[k].score > track.states[best].score)
+            {
+                best = k;
+            }
+        }
+        decide(shard, vehicleId, track, best, track.columns.size());
+    }
+    track.hasDecided = false; // The next sample starts over
+}
+
+void MapMatcher::emit(Shard& shard, int vehicleId, Track& track, const Candidate& candidate, uint64_t timestamp)
+{
+    shard.stats.matched++;
+    if (config.keepPoints)
+    {
+        shard.points.push_back({ vehicleId, timestamp, candidate.edge, candidate.offset });
+    }
+    bool entered = !track.hasDecided;
+    if (track.hasDecided && !sameTraversal(track.lastDecided.edge, track.lastDecided.offset, candidate.edge, candidate.offset, config.sigma))
+    {
+        routeBetween(shard, track.lastDecided, candidate, shard.between);
+        for (Edge* edge : shard.between)
+        {
+            shard.matches.push_back({ vehicleId, edge, timestamp });
+        }
+        shard.stats.edgesEmitted += shard.between.size();
+        entered = true;
+    }
+    if (entered)
+    {
+        shard.matches.push_back({ vehicleId, candidate.edge, timestamp });
+        shard.stats.edgesEmitted++;
+    }
+    track.lastDecided = candidate;
+    track.hasDecided = true;
+    track.lastEdge = candidate.edge;
+}
+
+void MapMatcher::takeMatches(vector<MatchedEdge>& out)
+{
+    for (Shard& shard : shards)
+    {
+        out.insert(out.end(), shard.matches.begin(), shard.matches.end());
+        shard.matches.clear();
+    }
+}
+
+void MapMatcher::takePoints(vector<MatchedPoint>& out)
+{
+    for (Shard& shard : shards)
+    {
+        out.insert(out.end(), shard.points.begin(), shard.points.end());
+        shard.points.clear();
+    }
+}
+
+size_t MapMatcher::applyOccupancy(uint64_t newerThan)
+{
+    size_t placed = 0;
+    for (Shard& shard : shards)
+    {
+        for (auto& entry : shard.tracks)
+        {
+            Track& track = entry.second;
+            Edge* wanted = track.lastSeen >= newerThan ? track.lastEdge : nullptr;
+            if (wanted != track.appliedEdge)
+            {
+                Vehicle::updateEdgeAgentCount(track.appliedEdge, -1);
+                Vehicle::updateEdgeAgentCount(wanted, 1);
+                track.appliedEdge = wanted;
+            }
+            placed += wanted != nullptr;
+        }
+    }
+    return placed;
+}
+
+MatchStats MapMatcher::getStats() const
+{
+    MatchStats total;
+    for (const Shard& shard : shards)
+    {
+        total.add(shard.stats);
+    }
+    return total;
+}
+
+vector<GpsSample> loadTraceSamples(const string& path)
+{
+    vector<GpsSample> samples;
+    TripEventReader reader(path);
+    if (!reader.isOpen())
+    {
+        return samples;
+    }
+    TripQuery query;
+    query.types = 1u << static_cast<int>(TripEventType::Position);
+    reader.scan(query, [&samples](const TripEventRow& row) {
+        if (row.event.vehicleId >= 0)
+        {
+            samples.push_back({ row.event.vehicleId, row.event.timestamp, row.event.x, row.event.y });
+        }
+    });
+    return samples;
+}
+
+static uint64_t truthKey(int vehicleId, uint64_t timestamp)
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(vehicleId)) << 40) ^ timestamp;
+}
+
+vector<GpsSample> synthesizeTraces(const vector<Node*>& nodes, const MatchConfig& config, unordered_map<uint64_t, Edge*>* truth)
+{
+    vector<GpsSample> samples;
+    if (nodes.size() < 2)
+    {
+        return samples;
+    }
+    mt19937_64 random(config.seed);
+    normal_distribution<double> noise(0, config.noise);
+    uniform_int_distribution<size_t> pick(0, nodes.size() - 1);
+    auto plan = [&](Node* from) {
+        for (int attempt = 0; attempt < 8; attempt++)
+        {
+            Node* goal = nodes[pick(random)];
+            vector<Edge*> route = goal != from ? aStar(from, goal) : vector<Edge*>();
+            if (!route.empty())
+            {
+                return route;
+            }
+        }
+        return vector<Edge*>();
+    };
+
+    uint64_t stepMillis = static_cast<uint64_t>(config.sampleSeconds * 1000);
+    uint64_t endMillis = static_cast<uint64_t>(config.syntheticSeconds * 1000);
+    double stride = config.speed * config.sampleSeconds;
+    for (int vehicle = 1; vehicle <= config.syntheticVehicles; vehicle++)
+    {
+        Node* from = nodes[pick(random)];
+        vector<Edge*> path = plan(from);
+        size_t index = 0;
+        double along = 0;
+        for (uint64_t t = 0; t <= endMillis && !path.empty(); t += stepMillis)
+        {
+            for (double move = t > 0 ? stride : 0; move > 0 && !path.empty();)
+            {
+                double left = path[index]->length - along;
+                if (move < left)
+                {
+                    along += move;
+                    break;
+                }
+                move -= left;
+                along = 0;
+                from = otherEnd(path[index], from);
+                if (++index == path.size())
+                {
+                    path = plan(from); // Arrived: drive on somewhere else
+                    index = 0;
+                }
+            }
+            if (path.empty())
+            {
+                break;
+            }
+            Edge* edge = path[index];
+            Node* to = otherEnd(edge, from);
+            double share = edge->length > 0 ? along / edge->length : 0;
+            float x = static_cast<float>(from->x + (to->x - from->x) * share + noise(random));
+            float y = static_cast<float>(from->y + (to->y - from->y) * share + noise(random));
+            samples.push_back({ vehicle, t, x, y });
+            if (truth)
+            {
+                (*truth)[truthKey(vehicle, t)] = edge;
+            }
+        }
+    }
+    // Interleave vehicles the way a live feed would deliver them
+    stable_sort(samples.begin(), samples.end(), [](const GpsSample& a, const GpsSample& b) { return a.timestamp < b.timestamp; });
+    return samples;
+}
+
+int runMapMatch(int argc, char** argv, const vector<Node*>& nodes)
+{
+    MatchConfig config = MatchConfig::fromArgs(argc, argv);
+    GeneratedGraph grid;
+    if (config.gridWidth > 0 && config.gridHeight > 0)
+    {
+        grid = makeGridGraph(config.gridWidth, config.gridHeight);
+    }
+    const vector<Node*>& network = grid.nodes.empty() ? nodes : grid.nodes;
+
+    vector<GpsSample> samples;
+    unordered_map<uint64_t, Edge*> truth;
+    if (!config.tracePath.empty())
+    {
+        samples = loadTraceSamples(config.tracePath);
+        if (samples.empty())
+        {
+            cerr << "No position samples in " << config.tracePath << endl;
+            freeGraph(grid);
+            return 1;
+        }
+    }
+    else
+    {
+        config.syntheticVehicles = config.syntheticVehicles > 0 ? config.syntheticVehicles : 100;
+        config.keepPoints = true;
+        samples = synthesizeTraces(network, config, &truth);
+    }
+
+    MapMatcher matcher(network, config);
+    cout << "Map matching " << samples.size() << " samples onto " << matcher.getRoadCount() << " roads with "
+         << defaultThreadPool().size() << " workers" << endl;
+
+    auto start = chrono::steady_clock::now();
+    vector<GpsSample> batch;
+    for (size_t first = 0; first < samples.size(); first += config.batchSamples)
+    {
+        size_t last = min(samples.size(), first + config.batchSamples);
+        batch.assign(samples.begin() + first, samples.begin() + last);
+        matcher.push(batch);
+    }
+    matcher.finish();
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<MatchedEdge> matches;
+    vector<MatchedPoint> points;
+    matcher.takeMatches(matches);
+    matcher.takePoints(points);
+    MatchStats stats = matcher.getStats();
+    double busySeconds = stats.busyNanos / 1e9;
+    uint64_t lookups = stats.routeHits + stats.routeMisses;
+
+    cout << "-----------------------------------" << endl;
+    cout << "Samples: " << stats.samples << ", matched " << stats.matched << ", no road in reach " << stats.unmatched
+         << ", chain breaks " << stats.breaks << ", forced decisions " << stats.forced << endl;
+    cout << "Throughput: " << stats.samples / max(wallSeconds, 1e-9) << " samples/s, "
+         << stats.samples / max(busySeconds, 1e-9) << " samples/s per busy core" << endl;
+    cout << "Transitions: " << (stats.samples ? static_cast<double>(stats.transitions) / stats.samples : 0) << " per sample, route trees "
+         << (lookups ? 100.0 * stats.routeHits / lookups : 0) << "% cached (" << stats.routeMisses << " searched)" << endl;
+    cout << "Edges entered: " << matches.size() << endl;
+    if (!truth.empty())
+    {
+        size_t correct = 0;
+        for (const MatchedPoint& point : points)
+        {
+            auto expected = truth.find(truthKey(point.vehicleId, point.timestamp));
+            if (expected == truth.end())
+            {
+                continue;
+            }
+            Edge* real = expected->second;
+            correct += point.edge == real || (point.edge->node1 == real->node2 && point.edge->node2 == real->node1);
+        }
+        cout << "Accuracy: " << (points.empty() ? 0 : 100.0 * correct / points.size()) << "% of decided samples on the road driven" << endl;
+    }
+    if (config.apply)
+    {
+        size_t placed = matcher.applyOccupancy(0);
+        int busiest = 0;
+        for (Node* node : network)
+        {
+            for (Edge* edge : node->edges)
+            {
+                busiest = max(busiest, edge->no_of_agents);
+            }
+        }
+        cout << "Placed " << placed << " traced vehicles on their matched roads, busiest road now holds " << busiest << endl;
+    }
+    cout << "-----------------------------------" << endl;
+
+    freeGraph(grid);
+    return 0;
+}
@@ -0,0 +1,223 @@
+#ifndef MAPMATCH_H
+#define MAPMATCH_H
+
+#include "node.h"
+#include "spatialgrid.h"
+#include "threadpool.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// One position fix of a vehicle, e.g. a Position row of a trip event file
+struct GpsSample
+{
+    int vehicleId;
+    uint64_t timestamp; // Milliseconds
+    float x, y;
+};
+
+struct MatchConfig
+{
+    double sigma = 6;               // GPS noise (standard deviation), map units
+    double searchRadius = 30;       // Roads further from a sample are not candidates
+    int maxCandidates = 3;          // Nearest roads kept per sample, each in both directions
+    double beta = 10;               // Transition scale for |route length - straight distance|
+    double maxRouteDistance = 300;  // Bound on the shortest paths searched between samples
+    uint64_t maxGapMillis = 30000;  // A longer silence starts a new chain
+    int maxLag = 16;                // Samples held undecided before the best path is forced
+    size_t routeCacheEntries = 32768; // Route trees kept per shard
+    bool keepPoints = false;        // Also collect each decided sample (accuracy checks)
+
+    // Command line runs
+    string tracePath;               // Trip event file whose Position rows are matched
+    int syntheticVehicles = 0;      // Otherwise drive this many vehicles on random routes
+    double syntheticSeconds = 600;
+    double sampleSeconds = 1;
+    double noise = 5;               // Added to synthetic samples, map units
+    double speed = 14;              // Synthetic driving speed, map units per second
+    size_t batchSamples = 65536;    // Samples pushed per parallel round
+    bool apply = false;             // Put each vehicle's last matched edge into Edge::no_of_agents
+    unsigned long long seed = 42;
+    int gridWidth = 0;              // Run on a generated grid instead of the city
+    int gridHeight = 0;
+
+    // Parse --trace, --synthetic, --duration, --interval, --noise, --speed,
+    // --sigma, --radius, --candidates, --beta, --max-route, --lag, --batch,
+    // --seed, --grid <W>x<H> and --apply
+    static MatchConfig fromArgs(int argc, char** argv);
+};
+
+// A road the vehicle entered, in driving direction
+struct MatchedEdge
+{
+    int vehicleId;
+    Edge* edge;
+    uint64_t enteredAt; // First sample matched to it, or the next sample's time for edges only driven through
+};
+
+// A decided sample, snapped onto its edge
+struct MatchedPoint
+{
+    int vehicleId;
+    uint64_t timestamp;
+    Edge* edge;
+    float offset; // Share of the edge driven, 0 at node1
+};
+
+struct MatchStats
+{
+    uint64_t samples = 0;
+    uint64_t matched = 0;       // Decided onto an edge
+    uint64_t unmatched = 0;     // No road within the search radius, skipped
+    uint64_t breaks = 0;        // Chains cut by a gap or an impossible transition
+    uint64_t forced = 0;        // Decisions forced by maxLag rather than convergence
+    uint64_t transitions = 0;   // Candidate pairs scored
+    uint64_t routeHits = 0;
+    uint64_t routeMisses = 0;   // Bounded Dijkstra runs
+    uint64_t edgesEmitted = 0;
+    uint64_t busyNanos = 0;     // Summed over workers
+
+    void add(const MatchStats& other);
+};
+
+// Online HMM map matching (Newson and Krumm): the hidden state of a sample
+// is a directed edge and an offset along it. Emissions fall with the
+// Gaussian distance to the road; transitions with how far the route length
+// between two candidates strays from the straight line between the
+// samples. Candidates come from a SpatialGrid over the roads, route lengths
+// from bounded Dijkstra trees cached per source node.
+// Each vehicle keeps a Viterbi lattice of its undecided samples. A sample is
+// decided once the back pointers of every current candidate meet in it
+// (they can never diverge again), or when maxLag samples are pending.
+// Vehicles are sharded by id over the pool; a shard owns its tracks, caches
+// and output, so workers share only the read-only road index.
+class MapMatcher
+{
+public:
+    MapMatcher(const vector<Node*>& nodes, MatchConfig config, ThreadPool& pool = defaultThreadPool());
+
+    // Samples may mix vehicles; each vehicle's samples must come in time
+    // order, within a call and across calls
+    void push(const vector<GpsSample>& samples);
+
+    // Decides everything still pending, e.g. at the end of a trace file
+    void finish();
+
+    // Output decided since the last call, in decision order per vehicle
+    void takeMatches(vector<MatchedEdge>& out);
+    void takePoints(vector<MatchedPoint>& out);
+
+    // Moves one agent per vehicle seen since `newerThan` onto the edge it was
+    // last matched to, and off the one it was put on before. Tick thread only.
+    size_t applyOccupancy(uint64_t newerThan);
+
+    MatchStats getStats() const;
+    size_t getRoadCount() const { return roads.size(); }
+
+    MapMatcher(const MapMatcher&) = delete;
+    MapMatcher& operator=(const MapMatcher&) = delete;
+
+private:
+    struct Candidate
+    {
+        Edge* edge;
+        float offset;   // 0..1 along the edge from node1
+        float distance; // From the sample
+    };
+
+    struct State
+    {
+        Candidate candidate;
+        double score;   // Log probability of the best path ending here
+        int32_t back;   // Index of the predecessor in Track::states, -1 at a chain start
+    };
+
+    struct Column
+    {
+        uint64_t timestamp;
+        float x, y;
+        uint32_t first; // Into Track::states
+        uint32_t count;
+    };
+
+    struct Track
+    {
+        vector<Column> columns; // Undecided samples, oldest first
+        vector<State> states;   // States with back -1 follow lastDecided (or start a chain)
+        Candidate lastDecided;
+        bool hasDecided = false; // False at the start of a chain
+        Edge* lastEdge = nullptr;
+        uint64_t lastSeen = 0;
+        Edge* appliedEdge = nullptr; // Where applyOccupancy last counted the vehicle
+    };
+
+    // One node of a Dijkstra tree; a tree is its reached nodes sorted by slot
+    struct RouteStep
+    {
+        uint32_t node;
+        float distance;
+        Edge* via; // Edge into the node, nullptr at the source
+    };
+    using RouteTree = vector<RouteStep>;
+
+    struct Shard
+    {
+        unordered_map<int, Track> tracks;
+        vector<GpsSample> inbox;
+        unordered_map<uint32_t, RouteTree> routes;
+        vector<float> scratchDistance;  // Per node slot, stamped
+        vector<Edge*> scratchVia;
+        vector<uint32_t> scratchStamp;
+        vector<uint32_t> reached;
+        vector<double> top;         // Best score per current candidate
+        vector<int32_t> topState;
+        vector<pair<float, uint32_t>> heap;
+        uint32_t stamp = 0;
+        vector<uint32_t> roadIds;
+        vector<pair<float, uint32_t>> nearest; // Distance, road
+        vector<Candidate> candidates;
+        vector<int32_t> chosen, frontier;
+        vector<MatchedEdge> matches;
+        vector<MatchedPoint> points;
+        vector<Edge*> between;
+        MatchStats stats;
+    };
+
+    void runShard(Shard& shard);
+    void step(Shard& shard, int vehicleId, Track& track, const GpsSample& sample);
+    void findCandidates(Shard& shard, const GpsSample& sample);
+    const RouteTree& routeTree(Shard& shard, uint32_t source);
+    static const RouteStep* findStep(const RouteTree& tree, uint32_t slot);
+    double routeLength(Shard& shard, const Candidate& from, const Candidate& to, const RouteTree*& tree);
+    void routeBetween(Shard& shard, const Candidate& from, const Candidate& to, vector<Edge*>& edges);
+    void startChain(Shard& shard, Track& track, const GpsSample& sample);
+    void decide(Shard& shard, int vehicleId, Track& track, int32_t upTo, size_t columnsDecided);
+    void closeChain(Shard& shard, int vehicleId, Track& track);
+    void emit(Shard& shard, int vehicleId, Track& track, const Candidate& candidate, uint64_t timestamp);
+    int slotOf(const Node* node) const;
+    size_t shardOf(int vehicleId) const;
+
+    MatchConfig config;
+    ThreadPool& pool;
+    vector<Node*> nodes;
+    vector<int32_t> slotOfId;
+    vector<Edge*> roads;       // One direction of each road, indexed by the grid
+    vector<Edge*> reverseRoads; // The other direction, nullptr for one-way roads
+    SpatialGrid roadGrid;
+    vector<Shard> shards;
+};
+
+// Position samples of a trip event file, in file (time) order
+vector<GpsSample> loadTraceSamples(const string& path);
+
+// Vehicles driving shortest routes at a constant speed, sampled every
+// sampleSeconds with Gaussian noise; truth gets the edge under each sample
+vector<GpsSample> synthesizeTraces(const vector<Node*>& nodes, const MatchConfig& config, unordered_map<uint64_t, Edge*>* truth);
+
+// Entry point for "SmartRide --mapmatch ..."
+int runMapMatch(int argc, char** argv, const vector<Node*>& nodes);
+
+#endif
@@ -0,0 +1,371 @@
+#include "maprenderer.h"
+#include <rlgl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+static const float vehicleWidth = 25;
+static const float vehicleHeight = 30;
+static const size_t quadsPerBatch = 2048;  // Stays inside rlgl's default vertex buffer
+static const float labelZoom = 0.75f;      // Below this, congestion labels and names are hidden
+static const float overviewZoom = 0.35f;   // Below this, the overview: heatmap, no short roads
+static const float minimumRoadPixels = 4;  // Overview drops roads shorter than this on screen
+static const float viewMargin = 60;        // World units around the view, covers names and posts
+
+MapRenderer::MapRenderer(int offsetX, int offsetY)
+    : view{ 0, 0, 0, 0 }, viewChanged(true), nodes(nullptr), edges(nullptr), signals(nullptr), signalTexture{}, drawnVehicles(0), activeVehicles(0),
+      mapLayer{}, labelLayer{}, loaded(false), mapDirty(true), labelsDirty(true), mapRebuilds(0), labelRebuilds(0)
+{
+    camera.offset = Vector2{ 0, 0 };
+    camera.target = Vector2{ static_cast<float>(-offsetX), static_cast<float>(-offsetY) };
+    camera.rotation = 0;
+    camera.zoom = 1;
+}
+
+void MapRenderer::load(const vector<Node*>& nodes, const vector<Edge*>& edges, const vector<TrafficIntersection*>& signals, Texture2D signalTexture)
+{
+    unload();
+    this->nodes = &nodes;
+    this->edges = &edges;
+    this->signals = &signals;
+    this->signalTexture = signalTexture;
+
+    mapLayer = LoadRenderTexture(GetScreenWidth(), GetScreenHeight());
+    labelLayer = LoadRenderTexture(GetScreenWidth(), GetScreenHeight());
+    loaded = true;
+    mapDirty = true;
+    labelsDirty = true;
+    viewChanged = true;
+
+    GridBox bounds = { 0, 0, 0, 0 };
+    vector<GridBox> boxes;
+    boxes.reserve(edges.size());
+    labels.assign(edges.size(), EdgeLabel{});
+    for (size_t i = 0; i < edges.size(); i++)
+    {
+        const Edge* edge = edges[i];
+        GridBox box = { min(edge->node1->x, edge->node2->x), min(edge->node1->y, edge->node2->y),
+                        max(edge->node1->x, edge->node2->x), max(edge->node1->y, edge->node2->y) };
+        if (i == 0)
+        {
+            bounds = box;
+        }
+        bounds = GridBox{ min(bounds.minX, box.minX), min(bounds.minY, box.minY), max(bounds.maxX, box.maxX), max(bounds.maxY, box.maxY) };
+        boxes.push_back(box);
+
+        labels[i].shown = edge->no_of_agents;
+        snprintf(labels[i].text, sizeof(labels[i].text), "%d", labels[i].shown);
+    }
+    roadGrid.reset(bounds, boxes.size());
+    roadGrid.buildBoxes(boxes);
+    vehicleGrid.reset(bounds, boxes.size());
+}
+
+void MapRenderer::unload()
+{
+    if (loaded)
+    {
+        UnloadRenderTexture(mapLayer);
+        UnloadRenderTexture(labelLayer);
+        loaded = false;
+    }
+}
+
+MapDetail MapRenderer::getDetail() const
+{
+    if (camera.zoom >= labelZoom)
+    {
+        return MapDetail::Full;
+    }
+    return camera.zoom >= overviewZoom ? MapDetail::Roads : MapDetail::Overview;
+}
+
+void MapRenderer::handleInput(bool pointerFree)
+{
+    float wheel = GetMouseWheelMove();
+    if (wheel != 0)
+    {
+        // Keep the point under the cursor fixed while zooming
+        Vector2 mouse = GetMousePosition();
+        camera.target = GetScreenToWorld2D(mouse, camera);
+        camera.offset = mouse;
+        camera.zoom = min(8.0f, max(0.02f, camera.zoom * (1 + 0.125f * wheel)));
+    }
+    if (pointerFree && IsMouseButtonDown(MOUSE_LEFT_BUTTON))
+    {
+        Vector2 delta = GetMouseDelta();
+        camera.target.x -= delta.x / camera.zoom;
+        camera.target.y -= delta.y / camera.zoom;
+    }
+    if (IsKeyPressed(KEY_HOME))
+    {
+        fitMap();
+    }
+}
+
+void MapRenderer::fitMap()
+{
+    const GridBox& bounds = roadGrid.getBounds();
+    float width = max(bounds.maxX - bounds.minX, 1.0f) + 2 * viewMargin;
+    float height = max(bounds.maxY - bounds.minY, 1.0f) + 2 * viewMargin;
+    camera.zoom = min(GetScreenWidth() / width, GetScreenHeight() / height);
+    camera.offset = Vector2{ GetScreenWidth() / 2.0f, GetScreenHeight() / 2.0f };
+    camera.target = Vector2{ (bounds.minX + bounds.maxX) / 2, (bounds.minY + bounds.maxY) / 2 };
+}
+
+// Recomputes the visible area and road set when the camera moved
+void MapRenderer::updateView()
+{
+    GridBox area;
+    area.minX = camera.target.x - camera.offset.x / camera.zoom;
+    area.minY = camera.target.y - camera.offset.y / camera.zoom;
+    area.maxX = area.minX + GetScreenWidth() / camera.zoom;
+    area.maxY = area.minY + GetScreenHeight() / camera.zoom;
+    viewChanged = area.minX != view.minX || area.minY != view.minY || area.maxX != view.maxX || area.maxY != view.maxY;
+    if (!viewChanged)
+    {
+        return;
+    }
+    view = area;
+    roadGrid.query(GridBox{ view.minX - viewMargin, view.minY - viewMargin, view.maxX + viewMargin, view.maxY + viewMargin }, visibleEdges);
+    mapDirty = true;
+    labelsDirty = true;
+}
+
+// Render textures are stored upside down, so draw with a flipped source
+void MapRenderer::drawLayer(const RenderTexture2D& layer)
+{
+    DrawTextureRec(layer.texture, Rectangle{ 0, 0, static_cast<float>(layer.texture.width), -static_cast<float>(layer.texture.height) }, Vector2{ 0, 0 }, WHITE);
+}
+
+void MapRenderer::renderMap()
+{
+    MapDetail detail = getDetail();
+    auto inView = [&](float x, float y)
+    {
+        return x >= view.minX - viewMargin && x <= view.maxX + viewMargin && y >= view.minY - viewMargin && y <= view.maxY + viewMargin;
+    };
+
+    BeginTextureMode(mapLayer);
+    ClearBackground(BLANK);
+    BeginMode2D(camera);
+    if (detail != MapDetail::Overview)
+    {
+        for (const TrafficIntersection* signal : *signals)
+        {
+            if (inView(signal->x, signal->y))
+            {
+                DrawTextureEx(signalTexture, Vector2{ signal->x - 20, signal->y + 5 }, 0.0f, 0.09, WHITE);
+            }
+        }
+    }
+
+    // Zoomed out, short roads fold into their neighbourhood (and the heatmap)
+    float minimumLength = detail == MapDetail::Overview ? minimumRoadPixels / camera.zoom : 0;
+    for (uint32_t id : visibleEdges)
+    {
+        const Edge* edge = (*edges)[id];
+        float dx = edge->node2->x - edge->node1->x;
+        float dy = edge->node2->y - edge->node1->y;
+        if (dx * dx + dy * dy < minimumLength * minimumLength)
+        {
+            continue;
+        }
+        DrawLineV(Vector2{ edge->node1->x, edge->node1->y }, Vector2{ edge->node2->x, edge->node2->y }, RED);
+    }
+
+    if (detail != MapDetail::Overview)
+    {
+        for (const Node* node : *nodes)
+        {
+            if (!inView(node->x, node->y))
+            {
+                continue;
+            }
+            DrawCircleV(Vector2{ node->x, node->y }, 5, RED);
+            if (detail == MapDetail::Full)
+            {
+                DrawText(node->name.c_str(), node->x - 30, node->y - 20, 20, PINK);
+            }
+        }
+    }
+    EndMode2D();
+    EndTextureMode();
+    mapDirty = false;
+    mapRebuilds++;
+}
+
+void MapRenderer::drawMap()
+{
+    if (!loaded)
+    {
+        return;
+    }
+    updateView();
+    if (mapDirty)
+    {
+        renderMap();
+    }
+    drawLayer(mapLayer);
+}
+
+void MapRenderer::renderLabels()
+{
+    BeginTextureMode(labelLayer);
+    ClearBackground(BLANK);
+    BeginMode2D(camera);
+    for (uint32_t id : visibleEdges)
+    {
+        const Edge* edge = (*edges)[id];
+        DrawText(labels[id].text, (edge->node1->x + edge->node2->x) / 2.0f, (edge->node1->y + edge->node2->y) / 2.0f - 20, 25, BLACK);
+    }
+    EndMode2D();
+    EndTextureMode();
+    labelsDirty = false;
+    labelRebuilds++;
+}
+
+void MapRenderer::drawLabels()
+{
+    if (!loaded || getDetail() != MapDetail::Full)
+    {
+        return;
+    }
+    for (uint32_t id : visibleEdges)
+    {
+        EdgeLabel& label = labels[id];
+        int count = (*edges)[id]->no_of_agents;
+        if (count != label.shown)
+        {
+            label.shown = count;
+            snprintf(label.text, sizeof(label.text), "%d", count);
+            labelsDirty = true;
+        }
+    }
+    if (labelsDirty)
+    {
+        renderLabels();
+    }
+    drawLayer(labelLayer);
+}
+
+void MapRenderer::drawVehicles(const vector<Vehicle>& vehicles)
+{
+    if (!loaded)
+    {
+        return;
+    }
+
+    // Bucket the moving vehicles; point ids index vehicleSlots
+    vehiclePoints.clear();
+    visibleVehicles.clear();
+    vehicleSlots.clear();
+    for (uint32_t i = 0; i < vehicles.size(); i++)
+    {
+        if (!vehicles[i].hasReachedDestination)
+        {
+            vehiclePoints.push_back(GridPoint{ vehicles[i].x, vehicles[i].y });
+            vehicleSlots.push_back(i);
+        }
+    }
+    activeVehicles = vehiclePoints.size();
+    vehicleGrid.buildPoints(vehiclePoints);
+
+    BeginMode2D(camera);
+    if (getDetail() == MapDetail::Overview)
+    {
+        // One translucent cell per occupied grid square, scaled to the busiest
+        int x0, y0, x1, y1;
+        vehicleGrid.cellRange(view, x0, y0, x1, y1);
+        uint32_t busiest = 1;
+        for (int cy = y0; cy <= y1; cy++)
+        {
+            for (int cx = x0; cx <= x1; cx++)
+            {
+                busiest = max(busiest, vehicleGrid.cellItems(cx, cy));
+            }
+        }
+        drawnVehicles = 0;
+        for (int cy = y0; cy <= y1; cy++)
+        {
+            for (int cx = x0; cx <= x1; cx++)
+            {
+                uint32_t count = vehicleGrid.cellItems(cx, cy);
+                if (count == 0)
+                {
+                    continue;
+                }
+                GridBox cell = vehicleGrid.cellBox(cx, cy);
+                unsigned char alpha = static_cast<unsigned char>(60 + 195 * count / busiest);
+                DrawRectangleRec(Rectangle{ cell.minX, cell.minY, cell.maxX - cell.minX, cell.maxY - cell.minY }, Color{ 255, 64, 0, alpha });
+                drawnVehicles += count;
+            }
+        }
+        EndMode2D();
+        return;
+    }
+
+    vehicleGrid.query(GridBox{ view.minX - vehicleWidth, view.minY - vehicleHeight, view.maxX, view.maxY }, visibleVehicles);
+    drawnVehicles = visibleVehicles.size();
+    size_t next = 0;
+    while (next < visibleVehicles.size())
+    {
+        size_t end = min(visibleVehicles.size(), next + quadsPerBatch);
+        rlCheckRenderBatchLimit(static_cast<int>(4 * (end - next)));
+        rlBegin(RL_QUADS);
+        for (; next < end; next++)
+        {
+            const Vehicle& v = vehicles[vehicleSlots[visibleVehicles[next]]];
+            rlColor4ub(v.color.r, v.color.g, v.color.b, v.color.a);
+            rlVertex2f(v.x, v.y);
+            rlVertex2f(v.x, v.y + vehicleHeight);
+            rlVertex2f(v.x + vehicleWidth, v.y + vehicleHeight);
+            rlVertex2f(v.x + vehicleWidth, v.y);
+        }
+        rlEnd();
+    }
+    EndMode2D();
+}
+
+void MapRenderer::drawCongestion(const CongestionMap& map)
+{
+    if (!loaded || map.getColumns() == 0)
+    {
+        return;
+    }
+    float originX, originY, size;
+    map.cellBounds(0, 0, originX, originY, size);
+    int x0 = max(0, static_cast<int>(floor((view.minX - originX) / size)));
+    int y0 = max(0, static_cast<int>(floor((view.minY - originY) / size)));
+    int x1 = min(map.getColumns() - 1, static_cast<int>(floor((view.maxX - originX) / size)));
+    int y1 = min(map.getRows() - 1, static_cast<int>(floor((view.maxY - originY) / size)));
+
+    BeginMode2D(camera);
+    for (int cy = y0; cy <= y1; cy++)
+    {
+        for (int cx = x0; cx <= x1; cx++)
+        {
+            float level = map.cellAverage(cx, cy);
+            if (level <= 0)
+            {
+                continue;
+            }
+            // Green when free flowing, through yellow, to red at capacity
+            float t = min(level, 1.0f);
+            Color color = t < 0.5f ? Color{ static_cast<unsigned char>(510 * t), 200, 0, 110 }
+                                   : Color{ 255, static_cast<unsigned char>(200 * (2 - 2 * t)), 0, 110 };
+            DrawRectangleRec(Rectangle{ originX + cx * size, originY + cy * size, size, size }, color);
+        }
+    }
+    EndMode2D();
+    DrawText(TextFormat("congestion %.0f%% of capacity, average %.0f%%", 100 * map.networkRatio(), 100 * map.networkAverage()), 20, 1025, 18, DARKGRAY);
+}
+
+void MapRenderer::drawStatus(int x, int y) const
+{
+    static const char* detailNames[] = { "full", "roads", "overview" };
+    DrawText(TextFormat("zoom %.2f (%s)  roads %d/%d  vehicles %d/%d  [wheel zoom, drag pan, Home fit]", camera.zoom,
+                        detailNames[static_cast<int>(getDetail())], static_cast<int>(visibleEdges.size()), static_cast<int>(edges ? edges->size() : 0),
+                        static_cast<int>(drawnVehicles), static_cast<int>(activeVehicles)),
+             x, y, 18, DARKGRAY);
+}
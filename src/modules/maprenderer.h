@@ -0,0 +1,97 @@
+#ifndef MAPRENDERER_H
+#define MAPRENDERER_H
+
+#include "congestion.h"
+#include "edge.h"
+#include "node.h"
+#include "spatialgrid.h"
+#include "vehicle.h"
+#include <raylib.h>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Level of detail, picked from the camera zoom
+enum class MapDetail
+{
+    Full,     // Roads, node names, congestion labels, vehicles
+    Roads,    // Labels and names hidden
+    Overview  // Roads shorter than a few pixels dropped, vehicles as a density heatmap
+};
+
+// Draws the ride window through a pannable, zoomable camera in three layers:
+//   map       roads, node markers, names and signal posts, rendered into a
+//             texture and redrawn only when the camera moves or after markDirty()
+//   labels    per-edge congestion counts, kept in their own texture and
+//             redrawn only when the view or a visible count changes
+//   vehicles  one quad batch, or a heatmap of the vehicle grid when zoomed out
+// Roads and vehicles are bucketed in spatial grids so only what falls inside
+// the viewport is submitted. Textures need the window's GL context: load()
+// after InitWindow and unload() before CloseWindow.
+class MapRenderer
+{
+public:
+    MapRenderer(int offsetX, int offsetY); // Initial view: the map shifted by this offset at zoom 1
+
+    void load(const vector<Node*>& nodes, const vector<Edge*>& edges, const vector<TrafficIntersection*>& signals, Texture2D signalTexture);
+    void unload();
+
+    void markDirty() { mapDirty = true; }
+
+    // Wheel zooms around the cursor, dragging pans (when the pointer is not
+    // over a control), Home fits the whole map
+    void handleInput(bool pointerFree);
+    void fitMap();
+
+    void drawMap();
+    void drawLabels();
+    void drawVehicles(const vector<Vehicle>& vehicles);
+    void drawCongestion(const CongestionMap& map); // Heatmap of the averaged cell ratios
+    void drawStatus(int x, int y) const;
+
+    MapDetail getDetail() const;
+    uint64_t getMapRebuilds() const { return mapRebuilds; }
+    uint64_t getLabelRebuilds() const { return labelRebuilds; }
+
+private:
+    struct EdgeLabel
+    {
+        int shown;       // Count the text was formatted from
+        char text[12];
+    };
+
+    void updateView();
+    void renderMap();
+    void renderLabels();
+    static void drawLayer(const RenderTexture2D& layer);
+
+    Camera2D camera;
+    GridBox view;          // World area on screen
+    bool viewChanged;
+    const vector<Node*>* nodes;
+    const vector<Edge*>* edges;
+    const vector<TrafficIntersection*>* signals;
+    Texture2D signalTexture;
+
+    SpatialGrid roadGrid;
+    SpatialGrid vehicleGrid;
+    vector<uint32_t> visibleEdges;
+    vector<uint32_t> visibleVehicles;
+    vector<GridPoint> vehiclePoints;
+    vector<uint32_t> vehicleSlots;   // Vehicle index of each grid point
+    size_t drawnVehicles;
+    size_t activeVehicles;
+
+    RenderTexture2D mapLayer;
+    RenderTexture2D labelLayer;
+    bool loaded;
+    bool mapDirty;
+    bool labelsDirty;
+    vector<EdgeLabel> labels; // Parallel to edges
+
+    uint64_t mapRebuilds;
+    uint64_t labelRebuilds;
+};
+
+#endif
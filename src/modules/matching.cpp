@@ -0,0 +1,44 @@
+#include "matching.h"
+#include <queue>
+#include <algorithm>
+#include <functional>
+
+float calculateDistance(Node* node1, Node* node2) {
+    float dx = node1->x - node2->x;
+    float dy = node1->y - node2->y;
+    return sqrt(dx * dx + dy * dy);
+}
+
+Driver* findNearestDriver(Node* userLocation, const std::vector<Driver*>& drivers, VehicleClass vehicleClass) {
+    std::priority_queue<DriverDistance, std::vector<DriverDistance>, std::greater<DriverDistance>> driverQueue;
+
+    for (Driver* driver : drivers) {
+        if (driver->availability && driver->assignedVehicle->vehicleClass == vehicleClass) {
+            float distance = calculateDistance(userLocation, driver->assignedVehicle->currentNode);
+            driverQueue.push({driver, distance});
+        }
+    }
+
+    if (!driverQueue.empty()) {
+        return driverQueue.top().driver;
+    }
+
+    return nullptr; // No available drivers
+}
+
+vector<DriverDistance> findCandidateDrivers(Node* userLocation, const std::vector<Driver*>& drivers, VehicleClass vehicleClass, size_t maxCandidates) {
+    vector<DriverDistance> candidates;
+
+    for (Driver* driver : drivers) {
+        if (driver->availability && driver->assignedVehicle && driver->assignedVehicle->vehicleClass == vehicleClass) {
+            float distance = calculateDistance(userLocation, driver->assignedVehicle->currentNode);
+            candidates.push_back({driver, distance});
+        }
+    }
+
+    size_t keep = min(maxCandidates, candidates.size());
+    partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end(),
+                 [](const DriverDistance& a, const DriverDistance& b) { return a.distance < b.distance; });
+    candidates.resize(keep);
+    return candidates;
+}
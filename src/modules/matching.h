@@ -0,0 +1,30 @@
+#ifndef MATCHING_H
+#define MATCHING_H
+
+#include "driver.h"
+#include <vector>
+#include <string>
+
+using namespace std;
+
+// Find the nearest driver to the user
+struct DriverDistance {
+    Driver* driver;
+    float distance;
+
+    bool operator>(const DriverDistance& other) const {
+        return distance > other.distance;
+    }
+};
+
+float calculateDistance(Node* node1, Node* node2);
+
+// Either function takes the whole fleet or, cheaper, one FleetPartitions entry
+Driver* findNearestDriver(Node* userLocation, const std::vector<Driver*>& drivers, VehicleClass vehicleClass);
+
+// Up to maxCandidates available drivers of the given vehicle class, nearest
+// first. A driver may still be taken before the matcher claims it, so the
+// claim stays the final check.
+vector<DriverDistance> findCandidateDrivers(Node* userLocation, const std::vector<Driver*>& drivers, VehicleClass vehicleClass, size_t maxCandidates);
+
+#endif
@@ -0,0 +1,196 @@
+#include "metrics.h"
+#include <deque>
+#include <mutex>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+atomic<bool> metricsEnabled(true);
+
+static const char* metricNames[] = {
+    "astar", "move_vehicle", "update_edge_agent_count", "change_lights",
+    "simulation_tick", "render_frame", "persistence_save", "persistence_load"
+};
+
+static const char* counterNames[] = {
+    "route_cache_hits", "route_cache_misses", "route_cache_epoch_bumps", "vehicles_spawned", "routes_unreachable"
+};
+
+const char* metricName(Metric metric)
+{
+    return metricNames[static_cast<int>(metric)];
+}
+
+const char* counterName(Counter counter)
+{
+    return counterNames[static_cast<int>(counter)];
+}
+
+// Blocks live for the whole run so totals survive thread exit
+static mutex registryLock;
+static deque<ThreadMetrics> registry;
+
+ThreadMetrics& threadMetrics()
+{
+    thread_local ThreadMetrics* block = nullptr;
+    if (!block)
+    {
+        lock_guard<mutex> guard(registryLock);
+        registry.emplace_back();
+        block = &registry.back();
+    }
+    return *block;
+}
+
+bool ThreadMetrics::shouldSample(Metric metric)
+{
+    uint32_t& tick = sampleTick[static_cast<int>(metric)];
+    return tick++ % ScopedTimer::sampleInterval == 0;
+}
+
+void ThreadMetrics::record(Metric metric, uint64_t nanoseconds)
+{
+    Timer& timer = timers[static_cast<int>(metric)];
+    bump(timer.buckets[LatencyHistogram::bucketFor(nanoseconds)], 1);
+    bump(timer.samples, 1);
+    bump(timer.total, nanoseconds);
+    if (nanoseconds > timer.max.load(memory_order_relaxed))
+    {
+        timer.max.store(nanoseconds, memory_order_relaxed);
+    }
+}
+
+vector<MetricSnapshot> snapshotMetrics()
+{
+    vector<MetricSnapshot> snapshots(static_cast<int>(Metric::Count));
+    uint64_t buckets[ThreadMetrics::bucketCount];
+
+    lock_guard<mutex> guard(registryLock);
+    for (int m = 0; m < static_cast<int>(Metric::Count); m++)
+    {
+        MetricSnapshot& snapshot = snapshots[m];
+        snapshot.metric = static_cast<Metric>(m);
+        snapshot.calls = 0;
+
+        for (ThreadMetrics& block : registry)
+        {
+            const ThreadMetrics::Timer& timer = block.timers[m];
+            for (int b = 0; b < ThreadMetrics::bucketCount; b++)
+            {
+                buckets[b] = timer.buckets[b].load(memory_order_relaxed);
+            }
+            snapshot.latency.absorb(buckets, timer.samples.load(memory_order_relaxed),
+                                    timer.total.load(memory_order_relaxed), timer.max.load(memory_order_relaxed));
+            snapshot.calls += block.calls[m].load(memory_order_relaxed);
+        }
+    }
+    return snapshots;
+}
+
+uint64_t snapshotCounter(Counter counter)
+{
+    lock_guard<mutex> guard(registryLock);
+    uint64_t total = 0;
+    for (ThreadMetrics& block : registry)
+    {
+        total += block.counters[static_cast<int>(counter)].load(memory_order_relaxed);
+    }
+    return total;
+}
+
+void resetMetrics()
+{
+    // Owners keep writing with load/store, so a reset racing a record may lose
+    // that one sample; good enough for an operator-triggered reset
+    lock_guard<mutex> guard(registryLock);
+    for (ThreadMetrics& block : registry)
+    {
+        for (ThreadMetrics::Timer& timer : block.timers)
+        {
+            for (atomic<uint64_t>& bucket : timer.buckets)
+                bucket.store(0, memory_order_relaxed);
+            timer.samples.store(0, memory_order_relaxed);
+            timer.total.store(0, memory_order_relaxed);
+            timer.max.store(0, memory_order_relaxed);
+        }
+        for (atomic<uint64_t>& calls : block.calls)
+            calls.store(0, memory_order_relaxed);
+        for (atomic<uint64_t>& counter : block.counters)
+            counter.store(0, memory_order_relaxed);
+    }
+}
+
+string metricsToPrometheus()
+{
+    string text;
+    char line[256];
+    for (const MetricSnapshot& snapshot : snapshotMetrics())
+    {
+        const char* name = metricName(snapshot.metric);
+        const LatencyHistogram& latency = snapshot.latency;
+
+        snprintf(line, sizeof(line), "# TYPE smartride_%s_calls_total counter\nsmartride_%s_calls_total %llu\n",
+                 name, name, static_cast<unsigned long long>(snapshot.calls));
+        text += line;
+
+        snprintf(line, sizeof(line), "# TYPE smartride_%s_seconds summary\n", name);
+        text += line;
+        for (double quantile : { 0.5, 0.9, 0.99 })
+        {
+            snprintf(line, sizeof(line), "smartride_%s_seconds{quantile=\"%g\"} %.9f\n", name, quantile, latency.percentile(quantile * 100) / 1e9);
+            text += line;
+        }
+        snprintf(line, sizeof(line), "smartride_%s_seconds_sum %.9f\nsmartride_%s_seconds_count %llu\n",
+                 name, latency.getMean() * latency.getCount() / 1e9, name, static_cast<unsigned long long>(latency.getCount()));
+        text += line;
+    }
+    for (int c = 0; c < static_cast<int>(Counter::Count); c++)
+    {
+        const char* name = counterName(static_cast<Counter>(c));
+        snprintf(line, sizeof(line), "# TYPE smartride_%s_total counter\nsmartride_%s_total %llu\n",
+                 name, name, static_cast<unsigned long long>(snapshotCounter(static_cast<Counter>(c))));
+        text += line;
+    }
+    return text;
+}
+
+string metricsToJson()
+{
+    string json = "{\n  \"timers\": {";
+    char line[320];
+    bool first = true;
+    for (const MetricSnapshot& snapshot : snapshotMetrics())
+    {
+        const LatencyHistogram& latency = snapshot.latency;
+        snprintf(line, sizeof(line),
+                 "%s\n    \"%s\": {\"calls\": %llu, \"samples\": %llu, \"mean_ns\": %.1f, \"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu}",
+                 first ? "" : ",", metricName(snapshot.metric),
+                 static_cast<unsigned long long>(snapshot.calls), static_cast<unsigned long long>(latency.getCount()), latency.getMean(),
+                 static_cast<unsigned long long>(latency.percentile(50)), static_cast<unsigned long long>(latency.percentile(90)),
+                 static_cast<unsigned long long>(latency.percentile(99)), static_cast<unsigned long long>(latency.getMax()));
+        json += line;
+        first = false;
+    }
+    json += "\n  },\n  \"counters\": {";
+    for (int c = 0; c < static_cast<int>(Counter::Count); c++)
+    {
+        snprintf(line, sizeof(line), "%s\n    \"%s\": %llu", c ? "," : "", counterName(static_cast<Counter>(c)),
+                 static_cast<unsigned long long>(snapshotCounter(static_cast<Counter>(c))));
+        json += line;
+    }
+    json += "\n  }\n}\n";
+    return json;
+}
+
+bool writeMetricsFile(const string& path)
+{
+    bool prometheus = path.size() >= 5 && (path.compare(path.size() - 5, 5, ".prom") == 0 || path.compare(path.size() - 4, 4, ".txt") == 0);
+    ofstream file(path);
+    if (!file.is_open())
+    {
+        cerr << "Error opening " << path << " for writing." << endl;
+        return false;
+    }
+    file << (prometheus ? metricsToPrometheus() : metricsToJson());
+    return true;
+}
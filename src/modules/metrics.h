@@ -0,0 +1,157 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "histogram.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+// Timed hot paths. Ids index fixed arrays so recording is a TLS lookup and
+// a few relaxed stores.
+enum class Metric
+{
+    AStar,
+    MoveVehicle,
+    UpdateEdgeAgentCount,
+    ChangeLights,
+    SimulationTick,
+    RenderFrame,
+    PersistenceSave,
+    PersistenceLoad,
+    Count
+};
+
+enum class Counter
+{
+    RouteCacheHits,
+    RouteCacheMisses,
+    RouteCacheEpochBumps,
+    VehiclesSpawned,
+    RoutesUnreachable,
+    Count
+};
+
+const char* metricName(Metric metric);
+const char* counterName(Counter counter);
+
+// Merged view of one timer across every thread
+struct MetricSnapshot
+{
+    Metric metric;
+    uint64_t calls;             // Every call, timed or not
+    LatencyHistogram latency;   // Timed calls only
+};
+
+// Per-thread storage. Each thread writes only its own block with relaxed
+// load/store pairs (no locked read-modify-write); readers sum all blocks.
+class ThreadMetrics
+{
+public:
+    static const int bucketCount = LatencyHistogram::bucketCount;
+
+    void record(Metric metric, uint64_t nanoseconds);
+    void call(Metric metric) { bump(calls[static_cast<int>(metric)], 1); }
+    void count(Counter counter, uint64_t n) { bump(counters[static_cast<int>(counter)], n); }
+    bool shouldSample(Metric metric); // True for one call in sampleInterval
+
+    struct Timer
+    {
+        atomic<uint64_t> buckets[bucketCount];
+        atomic<uint64_t> samples;
+        atomic<uint64_t> total;
+        atomic<uint64_t> max;
+    };
+
+    Timer timers[static_cast<int>(Metric::Count)] = {};
+    atomic<uint64_t> calls[static_cast<int>(Metric::Count)] = {};
+    atomic<uint64_t> counters[static_cast<int>(Counter::Count)] = {};
+    uint32_t sampleTick[static_cast<int>(Metric::Count)] = {};
+
+private:
+    static void bump(atomic<uint64_t>& value, uint64_t n)
+    {
+        value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+    }
+};
+
+extern atomic<bool> metricsEnabled;
+
+// This thread's block, registered on first use
+ThreadMetrics& threadMetrics();
+
+inline void countMetric(Counter counter, uint64_t n = 1)
+{
+    if (metricsEnabled.load(memory_order_relaxed))
+    {
+        threadMetrics().count(counter, n);
+    }
+}
+
+// Times the enclosing scope. Sampled timers time one call in sampleInterval
+// and only count the rest, for paths that take tens of nanoseconds.
+class ScopedTimer
+{
+public:
+    static const uint32_t sampleInterval = 64;
+
+    ScopedTimer(Metric metric, bool sampled) : metric(metric), block(nullptr)
+    {
+        if (!metricsEnabled.load(memory_order_relaxed))
+        {
+            return;
+        }
+        ThreadMetrics& metrics = threadMetrics();
+        metrics.call(metric);
+        if (!sampled || metrics.shouldSample(metric))
+        {
+            block = &metrics;
+            start = chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedTimer()
+    {
+        stop();
+    }
+
+    // Record now instead of at scope exit
+    void stop()
+    {
+        if (block)
+        {
+            auto elapsed = chrono::steady_clock::now() - start;
+            block->record(metric, static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(elapsed).count()));
+            block = nullptr;
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Metric metric;
+    ThreadMetrics* block;
+    chrono::steady_clock::time_point start;
+};
+
+#define METRIC_CONCAT_INNER(a, b) a##b
+#define METRIC_CONCAT(a, b) METRIC_CONCAT_INNER(a, b)
+#define METRIC_SCOPE(metric) ScopedTimer METRIC_CONCAT(metricTimer, __LINE__)(metric, false)
+#define METRIC_SCOPE_SAMPLED(metric) ScopedTimer METRIC_CONCAT(metricTimer, __LINE__)(metric, true)
+
+// Aggregation and export
+vector<MetricSnapshot> snapshotMetrics();
+uint64_t snapshotCounter(Counter counter);
+void resetMetrics();
+
+string metricsToPrometheus();
+string metricsToJson();
+
+// Writes Prometheus text for *.prom / *.txt, JSON otherwise
+bool writeMetricsFile(const string& path);
+
+#endif
@@ -1,4 +1,6 @@
 #include "node.h"
+#include "metrics.h"
+#include "logger.h"
 
 // Constructor
 Node::Node(int nodeId, float xCoord, float yCoord, string nodeName)
@@ -71,13 +73,15 @@ void TrafficIntersection::initializeSignals(int intersectionType)
     }
     else
     {
-        cerr << "Invalid intersection type. Defaulting to 4-way." << endl;
+        LOG_WARN("Invalid intersection type %d. Defaulting to 4-way.", intersectionType);
         signals = vector<bool>(4, false); // Default to 4 signals
     }
 }
 
 void TrafficIntersection::changeLights()
 {
+    METRIC_SCOPE(Metric::ChangeLights);
+
     if (type == 4)
     {
         signals[lightRecord4] = false;
@@ -105,22 +109,28 @@ int Node::cost(Node* currentNode, Node* nextNode)
     {
         if ((edge->node1 == nextNode) || (edge->node2 == nextNode))
         {
-            float penalty = 0;
-            if(edge->no_of_agents < edge->max_traffic) {
-                penalty = 1 + (edge->no_of_agents / edge->max_traffic);
-            }
-            else {
-                penalty = 1000;
-
-            }
-            int congestionFactor = 100;
-            float congestionCost = congestionFactor * penalty;
-            return edge->length + congestionCost; // Include number of agents in cost
+            return cost(edge, edge->no_of_agents);
         }
     }
     return INT_MAX; // Indicates no edge found
 }
 
+// Cost of an edge carrying the given number of agents
+int Node::cost(const Edge* edge, int agents)
+{
+    float penalty = 0;
+    if(agents < edge->max_traffic) {
+        penalty = 1 + (agents / edge->max_traffic);
+    }
+    else {
+        penalty = 1000;
+
+    }
+    int congestionFactor = 100;
+    float congestionCost = congestionFactor * penalty;
+    return edge->length + congestionCost; // Include number of agents in cost
+}
+
 // Heuristic function (Euclidean distance)
 int Node::heuristic(Node* node, Node* goal)
 {
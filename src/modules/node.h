@@ -14,9 +14,11 @@ public:
     string name;              // Name of the node
     vector<Node*> neighbors;  // List of adjacent nodes
     vector<Edge*> edges;      // List of edges for the node (using pointers)
+    int snapshotIndex = -1;   // Position in the last snapshot's node table
 
     // Constructor
     Node(int nodeId, float xCoord, float yCoord, string nodeName);
+    virtual ~Node() {}
 
     // Method to add a neighbor and create the edge
     void addNeighbor(Node* neighbor);
@@ -30,6 +32,7 @@ public:
 
     static Edge* findEdge(Node* node1, Node* node2);
     static int cost(Node* currentNode, Node* nextNode);
+    static int cost(const Edge* edge, int agents); // With a count other than the live one (e.g. a snapshot)
     static int heuristic(Node* node, Node* goal);
 };
 
@@ -0,0 +1,118 @@
+#include "pathfinder.h"
+#include "metrics.h"
+#include "logger.h"
+#include "reachability.h"
+#include <algorithm>
+#include <functional>
+
+bool SearchWorkspace::seen(int id) const
+{
+    return id >= 0 && static_cast<size_t>(id) < visitStamp.size() && visitStamp[id] == stamp;
+}
+
+void SearchWorkspace::visit(int id)
+{
+    if (static_cast<size_t>(id) >= visitStamp.size())
+    {
+        size_t newSize = max<size_t>(static_cast<size_t>(id) + 1, visitStamp.size() * 2);
+        gScore.resize(newSize);
+        cameFromEdge.resize(newSize);
+        visitStamp.resize(newSize, 0);
+    }
+    visitStamp[id] = stamp;
+    cameFromEdge[id] = nullptr;
+}
+
+vector<Edge*> SearchWorkspace::search(Node* start, Node* goal, const vector<int>* roadAgents)
+{
+    METRIC_SCOPE(Metric::AStar);
+
+    if (!start || !goal) {
+        LOG_ERROR("Invalid start or goal node!");
+        return {};
+    }
+
+    // Goals on another island would otherwise cost a search of everything reachable
+    if (!reachability.reachable(start, goal)) {
+        countMetric(Counter::RoutesUnreachable);
+        LOG_DEBUG("No path can exist from %d to %d", start->id, goal->id);
+        return {};
+    }
+
+    searches++;
+    if (++stamp == 0) {
+        // Stamp wrapped around, old marks could alias the new generation
+        fill(visitStamp.begin(), visitStamp.end(), 0);
+        stamp = 1;
+    }
+    openSet.clear();
+
+    visit(start->id);
+    gScore[start->id] = 0;
+    openSet.push_back({ static_cast<float>(Node::heuristic(start, goal)), start });
+
+    while (!openSet.empty()) {
+        pop_heap(openSet.begin(), openSet.end(), greater<>());
+        Node* current = openSet.back().second;
+        openSet.pop_back();
+
+        if (current == goal) {
+            // Goal found, reconstruct path
+            vector<Edge*> path;
+            while (Edge* edge = cameFromEdge[current->id]) {
+                path.push_back(edge);
+                current = (edge->node1 == current) ? edge->node2 : edge->node1;
+            }
+            reverse(path.begin(), path.end());
+            return path; // Return the full path as a vector of edges
+        }
+
+        // Explore neighbors
+        for (size_t i = 0; i < current->neighbors.size(); ++i) {
+            Node* neighbor = current->neighbors[i];
+            Edge* edge = current->edges[i];
+            if (edge->closed) {
+                continue;
+            }
+            float step;
+            if (roadAgents) {
+                int slot = edge->congestionSlot;
+                step = Node::cost(edge, slot >= 0 && static_cast<size_t>(slot) < roadAgents->size() ? (*roadAgents)[slot] : 0);
+            } else {
+                step = Node::cost(current, neighbor);
+            }
+            float tentative_gScore = gScore[current->id] + step;
+
+            if (!seen(neighbor->id) || tentative_gScore < gScore[neighbor->id]) {
+                if (!seen(neighbor->id)) {
+                    visit(neighbor->id);
+                }
+                cameFromEdge[neighbor->id] = edge;
+                gScore[neighbor->id] = tentative_gScore;
+                float fScore = tentative_gScore + Node::heuristic(neighbor, goal);
+                openSet.push_back({ fScore, neighbor });
+                push_heap(openSet.begin(), openSet.end(), greater<>());
+            }
+        }
+    }
+
+    // If we reach here, no path was found
+    LOG_WARN("No path found from %d to %d!", start->id, goal->id);
+    return {}; // Return an empty path if no path exists
+}
+
+SearchWorkspace& threadWorkspace()
+{
+    thread_local SearchWorkspace workspace;
+    return workspace;
+}
+
+vector<Edge*> aStar(Node* start, Node* goal)
+{
+    return threadWorkspace().search(start, goal);
+}
+
+vector<Edge*> aStar(Node* start, Node* goal, SearchWorkspace& workspace)
+{
+    return workspace.search(start, goal);
+}
@@ -0,0 +1,46 @@
+#ifndef PATHFINDER_H
+#define PATHFINDER_H
+
+#include "node.h"
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+// Reusable scratch space for A* searches. Per-node state lives in arrays
+// indexed by node id and is invalidated with a generation stamp, so repeated
+// searches on the same thread do not allocate once the arrays have grown.
+class SearchWorkspace
+{
+public:
+    // With roadAgents, edges cost what their count in that table (indexed by
+    // Edge::congestionSlot) says instead of their live count
+    vector<Edge*> search(Node* start, Node* goal, const vector<int>* roadAgents = nullptr);
+
+    uint64_t getSearches() const { return searches; }
+
+private:
+    using QueueElement = pair<float, Node*>; // {f_score, Node*}
+
+    bool seen(int id) const;
+    void visit(int id);
+
+    vector<float> gScore;
+    vector<Edge*> cameFromEdge;
+    vector<uint32_t> visitStamp;
+    vector<QueueElement> openSet;
+    uint32_t stamp = 0;
+    uint64_t searches = 0;
+};
+
+// The calling thread's workspace, kept for the life of the thread so pool
+// workers reuse theirs across batches
+SearchWorkspace& threadWorkspace();
+
+// A* search using this thread's workspace
+vector<Edge*> aStar(Node* start, Node* goal);
+
+// A* search using an explicit workspace (one per worker thread)
+vector<Edge*> aStar(Node* start, Node* goal, SearchWorkspace& workspace);
+
+#endif
@@ -0,0 +1,309 @@
+#include "pooling.h"
+#include <algorithm>
+#include <queue>
+
+TravelTimes::TravelTimes(const vector<Node*>& nodes, double unitsPerSecond)
+    : nodes(nodes), unitsPerSecond(unitsPerSecond), adjacency(nodes.size()), rows(nodes.size()), built(new once_flag[nodes.size()])
+{
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        index[nodes[i]] = static_cast<int>(i);
+    }
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        for (const Edge* edge : nodes[i]->edges)
+        {
+            auto to = index.find(edge->node1 == nodes[i] ? edge->node2 : edge->node1);
+            if (to != index.end())
+            {
+                adjacency[i].push_back({ to->second, static_cast<float>(edge->length / unitsPerSecond) });
+            }
+        }
+    }
+}
+
+int TravelTimes::indexOf(const Node* node) const
+{
+    auto found = index.find(node);
+    return found != index.end() ? found->second : -1;
+}
+
+const float* TravelTimes::row(int from)
+{
+    call_once(built[from], [this, from]() {
+        size_t count = nodes.size();
+        unique_ptr<float[]> times(new float[count]);
+        fill(times.get(), times.get() + count, numeric_limits<float>::infinity());
+
+        using QueueElement = pair<float, int>;
+        priority_queue<QueueElement, vector<QueueElement>, greater<QueueElement>> open;
+        times[from] = 0;
+        open.push({ 0.0f, from });
+        while (!open.empty())
+        {
+            auto [time, node] = open.top();
+            open.pop();
+            if (time > times[node])
+            {
+                continue;
+            }
+            for (const auto& [next, cost] : adjacency[node])
+            {
+                if (time + cost < times[next])
+                {
+                    times[next] = time + cost;
+                    open.push({ times[next], next });
+                }
+            }
+        }
+        rows[from] = move(times);
+    });
+    return rows[from].get();
+}
+
+size_t TravelTimes::rowsBuilt() const
+{
+    size_t built = 0;
+    for (const auto& row : rows)
+    {
+        built += row != nullptr;
+    }
+    return built;
+}
+
+RidePool::RidePool(TravelTimes& times, PoolConfig config, ThreadPool& pool) : times(times), config(config), pool(pool) {}
+
+int RidePool::addVehicle(Node* at, VehicleClass vehicleClass)
+{
+    PoolVehicle vehicle;
+    vehicle.position = times.indexOf(at);
+    vehicle.readyAt = 0;
+    vehicle.capacity = classInfo(vehicleClass).seats;
+    vehicles.push_back(vehicle);
+    return static_cast<int>(vehicles.size()) - 1;
+}
+
+PoolRequest RidePool::makeRequest(uint32_t ride, Node* origin, Node* destination, double now)
+{
+    PoolRequest request;
+    request.ride = ride;
+    request.origin = times.indexOf(origin);
+    request.destination = times.indexOf(destination);
+    request.requestedAt = now;
+    request.directTime = request.origin < 0 || request.destination < 0 ? numeric_limits<float>::infinity() : times.get(request.origin, request.destination);
+    request.latestPickup = now + config.maxWait;
+    request.latestDropoff = request.latestPickup + request.directTime * (1 + config.maxDetour);
+    return request;
+}
+
+void RidePool::refresh(PoolVehicle& vehicle)
+{
+    size_t count = vehicle.stops.size();
+    vehicle.arrival.resize(count);
+    vehicle.slack.resize(count);
+    vehicle.load.resize(count);
+
+    int at = vehicle.position;
+    double time = vehicle.readyAt;
+    int load = vehicle.onboard;
+    for (size_t k = 0; k < count; k++)
+    {
+        const PoolStop& stop = vehicle.stops[k];
+        time += times.get(at, stop.node);
+        at = stop.node;
+        load += stop.kind == StopKind::Pickup ? 1 : -1;
+        vehicle.arrival[k] = time;
+        vehicle.load[k] = load;
+    }
+    double slack = numeric_limits<double>::infinity();
+    for (size_t k = count; k-- > 0;)
+    {
+        slack = min(slack, vehicle.stops[k].latest - vehicle.arrival[k]);
+        vehicle.slack[k] = slack;
+    }
+}
+
+void RidePool::setPosition(int vehicle, int node, double readyAt)
+{
+    PoolVehicle& state = vehicles[vehicle];
+    state.position = node;
+    state.readyAt = readyAt;
+    refresh(state);
+}
+
+// Cheapest insertion into one vehicle's plan. With P(k)/T(k)/L(k) the node,
+// time and load just before stop k (the vehicle itself for k = 0), a pickup
+// before stop i delays stops i.. by dp and a dropoff before stop j > i delays
+// stops j.. by a further dd. Both must fit in the slack of the stops they
+// delay; arrivals only grow along the plan, so a missed window ends the scan.
+Insertion RidePool::evaluate(int index, const PoolRequest& request, uint64_t& tried)
+{
+    const PoolVehicle& vehicle = vehicles[index];
+    Insertion best;
+    const int n = static_cast<int>(vehicle.stops.size());
+    const int o = request.origin;
+    const int d = request.destination;
+    const float originToDestination = request.directTime;
+
+    for (int i = 0; i <= n; i++)
+    {
+        int before = i == 0 ? vehicle.position : vehicle.stops[i - 1].node;
+        double beforeTime = i == 0 ? vehicle.readyAt : vehicle.arrival[i - 1];
+        int beforeLoad = i == 0 ? vehicle.onboard : vehicle.load[i - 1];
+        if (beforeTime > request.latestPickup)
+        {
+            break;
+        }
+        if (beforeLoad + 1 > vehicle.capacity)
+        {
+            continue;
+        }
+        const float* fromBefore = times.row(before);
+        double pickupTime = beforeTime + fromBefore[o];
+        if (pickupTime > request.latestPickup)
+        {
+            continue;
+        }
+        const float* fromOrigin = times.row(o);
+
+        // Dropoff right after the pickup
+        tried++;
+        if (pickupTime + originToDestination <= request.latestDropoff)
+        {
+            double added = fromBefore[o] + originToDestination;
+            bool fits = true;
+            if (i < n)
+            {
+                int next = vehicle.stops[i].node;
+                added += times.get(d, next) - fromBefore[next];
+                fits = added <= vehicle.slack[i];
+            }
+            if (fits && added < best.addedTime)
+            {
+                best = { index, i, i, added, pickupTime };
+            }
+        }
+        if (i == n)
+        {
+            continue;
+        }
+
+        // Dropoff after later stops: those in between carry one more rider
+        int next = vehicle.stops[i].node;
+        double pickupDelay = fromBefore[o] + fromOrigin[next] - fromBefore[next];
+        if (pickupDelay > vehicle.slack[i])
+        {
+            continue;
+        }
+        for (int j = i + 1; j <= n; j++)
+        {
+            if (vehicle.load[j - 1] + 1 > vehicle.capacity)
+            {
+                break;
+            }
+            int last = vehicle.stops[j - 1].node;
+            const float* fromLast = times.row(last);
+            double dropoffTime = vehicle.arrival[j - 1] + pickupDelay + fromLast[d];
+            if (dropoffTime > request.latestDropoff)
+            {
+                break;
+            }
+            tried++;
+            double added = pickupDelay + fromLast[d];
+            if (j < n)
+            {
+                int after = vehicle.stops[j].node;
+                added += times.get(d, after) - fromLast[after];
+                if (added > vehicle.slack[j])
+                {
+                    continue;
+                }
+            }
+            if (added < best.addedTime)
+            {
+                best = { index, i, j, added, pickupTime };
+            }
+        }
+    }
+    return best;
+}
+
+Insertion RidePool::bestInsertion(const PoolRequest& request, const vector<int>& candidates)
+{
+    Insertion best;
+    if (request.origin < 0 || request.destination < 0 || request.directTime == numeric_limits<float>::infinity())
+    {
+        return best;
+    }
+
+    size_t count = candidates.empty() ? vehicles.size() : candidates.size();
+    auto vehicleAt = [&](size_t k) { return candidates.empty() ? static_cast<int>(k) : candidates[k]; };
+
+    // Lower bound: straight to the pickup from where the vehicle is now
+    auto evaluateRange = [&](size_t first, size_t last, Insertion& result, uint64_t& tried) {
+        for (size_t k = first; k < last; k++)
+        {
+            int v = vehicleAt(k);
+            const PoolVehicle& vehicle = vehicles[v];
+            if (vehicle.readyAt + times.get(vehicle.position, request.origin) > request.latestPickup)
+            {
+                continue;
+            }
+            Insertion option = evaluate(v, request, tried);
+            if (option.addedTime < result.addedTime)
+            {
+                result = option;
+            }
+        }
+    };
+
+    if (count <= config.chunkSize)
+    {
+        evaluateRange(0, count, best, positionsTried);
+        return best;
+    }
+
+    size_t chunks = (count + config.chunkSize - 1) / config.chunkSize;
+    vector<Insertion> results(chunks);
+    vector<uint64_t> tried(chunks, 0);
+    TaskGroup group(pool);
+    for (size_t chunk = 0; chunk < chunks; chunk++)
+    {
+        group.submit([&, chunk](int) {
+            size_t first = chunk * config.chunkSize;
+            evaluateRange(first, min(count, first + config.chunkSize), results[chunk], tried[chunk]);
+        });
+    }
+    group.wait();
+
+    // Chunks are reduced in order, so the choice does not depend on timing
+    for (size_t chunk = 0; chunk < chunks; chunk++)
+    {
+        positionsTried += tried[chunk];
+        if (results[chunk].addedTime < best.addedTime)
+        {
+            best = results[chunk];
+        }
+    }
+    return best;
+}
+
+void RidePool::insert(const Insertion& insertion, const PoolRequest& request)
+{
+    PoolVehicle& vehicle = vehicles[insertion.vehicle];
+    vehicle.stops.insert(vehicle.stops.begin() + insertion.pickupAt, PoolStop{ request.origin, request.ride, StopKind::Pickup, request.latestPickup });
+    vehicle.stops.insert(vehicle.stops.begin() + insertion.dropoffAt + 1, PoolStop{ request.destination, request.ride, StopKind::Dropoff, request.latestDropoff });
+    refresh(vehicle);
+}
+
+PoolStop RidePool::completeStop(int vehicle, double now)
+{
+    PoolVehicle& state = vehicles[vehicle];
+    PoolStop stop = state.stops.front();
+    state.stops.erase(state.stops.begin());
+    state.onboard += stop.kind == StopKind::Pickup ? 1 : -1;
+    state.position = stop.node;
+    state.readyAt = now;
+    refresh(state);
+    return stop;
+}
@@ -0,0 +1,143 @@
+#ifndef POOLING_H
+#define POOLING_H
+
+#include "node.h"
+#include "vehicleclass.h"
+#include "threadpool.h"
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Free-flow travel times between nodes, in seconds. A row holds the times
+// from one node to every other and is computed (one Dijkstra) the first time
+// that node is asked about, then reused; rows are immutable once built, so
+// any number of threads can read them.
+class TravelTimes
+{
+public:
+    TravelTimes(const vector<Node*>& nodes, double unitsPerSecond);
+
+    int indexOf(const Node* node) const;
+    Node* nodeAt(int index) const { return nodes[index]; }
+
+    // Infinity when unreachable
+    float get(int from, int to) { return row(from)[to]; }
+    const float* row(int from);
+
+    size_t rowsBuilt() const;
+
+private:
+    const vector<Node*>& nodes;
+    double unitsPerSecond;
+    unordered_map<const Node*, int> index;
+    vector<vector<pair<int, float>>> adjacency;
+    vector<unique_ptr<float[]>> rows;
+    unique_ptr<once_flag[]> built;
+};
+
+enum class StopKind : uint8_t { Pickup, Dropoff };
+
+struct PoolStop
+{
+    int node;
+    uint32_t ride;
+    StopKind kind;
+    double latest;  // Time window end, simulated seconds
+};
+
+// One ride request, in TravelTimes indices
+struct PoolRequest
+{
+    uint32_t ride = 0;
+    int origin = -1;
+    int destination = -1;
+    double requestedAt = 0;
+    double latestPickup = 0;
+    double latestDropoff = 0;
+    float directTime = 0;
+};
+
+// Where a request goes in a vehicle's plan: the pickup before stop
+// pickupAt and the dropoff before (original) stop dropoffAt
+struct Insertion
+{
+    int vehicle = -1;
+    int pickupAt = 0;
+    int dropoffAt = 0;
+    double addedTime = numeric_limits<double>::infinity();
+    double pickupTime = 0;
+};
+
+struct PoolConfig
+{
+    double maxWait = 300;     // Seconds from request to pickup
+    double maxDetour = 0.5;   // Extra ride time allowed, as a share of the direct trip
+    size_t chunkSize = 16;    // Vehicles per parallel task; smaller fleets run inline
+};
+
+// Shared rides: every vehicle carries an ordered list of pickup and dropoff
+// stops. A new request is tried at every pickup/dropoff position of every
+// candidate vehicle (cheapest insertion). Each try is O(1) from values kept
+// per stop: planned arrival, slack (how late it may get before some later
+// window breaks) and load. Positions are pruned as soon as the pickup or
+// dropoff window can no longer be met, and vehicles whose shortest way to
+// the pickup already misses it are skipped. Candidates are evaluated in
+// parallel; changing plans is single threaded.
+class RidePool
+{
+public:
+    RidePool(TravelTimes& times, PoolConfig config = PoolConfig(), ThreadPool& pool = defaultThreadPool());
+
+    int addVehicle(Node* at, VehicleClass vehicleClass);
+    size_t vehicleCount() const { return vehicles.size(); }
+
+    PoolRequest makeRequest(uint32_t ride, Node* origin, Node* destination, double now);
+
+    // Cheapest feasible insertion among the candidates (all vehicles when
+    // empty); vehicle is -1 when none can take the request
+    Insertion bestInsertion(const PoolRequest& request, const vector<int>& candidates = {});
+    void insert(const Insertion& insertion, const PoolRequest& request);
+
+    // The vehicle will be at node (its next node) at time readyAt
+    void setPosition(int vehicle, int node, double readyAt);
+
+    const vector<PoolStop>& stopsOf(int vehicle) const { return vehicles[vehicle].stops; }
+    int onboard(int vehicle) const { return vehicles[vehicle].onboard; }
+    int capacity(int vehicle) const { return vehicles[vehicle].capacity; }
+
+    // The vehicle is at its first stop: removes and returns it
+    PoolStop completeStop(int vehicle, double now);
+
+    uint64_t getPositionsTried() const { return positionsTried; }
+
+private:
+    struct PoolVehicle
+    {
+        int position;          // Node it is at or reaching next
+        double readyAt;        // When it is there
+        int capacity;
+        int onboard = 0;
+        vector<PoolStop> stops;
+        // Per stop, rebuilt whenever the plan changes
+        vector<double> arrival;
+        vector<double> slack;  // Min over this and later stops of latest - arrival
+        vector<int> load;      // Riders aboard after the stop
+    };
+
+    void refresh(PoolVehicle& vehicle);
+    Insertion evaluate(int index, const PoolRequest& request, uint64_t& tried);
+
+    TravelTimes& times;
+    PoolConfig config;
+    ThreadPool& pool;
+    vector<PoolVehicle> vehicles;
+    uint64_t positionsTried = 0;
+};
+
+#endif
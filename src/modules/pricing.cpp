@@ -0,0 +1,123 @@
+#include "pricing.h"
+#include <algorithm>
+#include <cmath>
+
+SurgePricing pricing;
+
+SurgePricing::SurgePricing(PricingConfig config)
+    : config(config), clock(0), nextUpdate(config.updateSeconds)
+{
+}
+
+void SurgePricing::attach(const vector<Node*>& nodes)
+{
+    grid = ZoneGrid(nodes, config.zoneCount > 0 ? config.zoneCount : max(1, static_cast<int>(nodes.size() / 4)));
+    zones.assign(grid.size(), Zone());
+    clock = 0;
+    nextUpdate = config.updateSeconds;
+    stats = PricingStats();
+}
+
+void SurgePricing::requestOpened(const Node* origin)
+{
+    int z = grid.zoneOf(origin);
+    if (z >= 0)
+    {
+        zones[z].open++;
+        zones[z].arrivals++;
+    }
+}
+
+void SurgePricing::requestClosed(const Node* origin)
+{
+    int z = grid.zoneOf(origin);
+    if (z >= 0 && zones[z].open > 0)
+    {
+        zones[z].open--;
+    }
+}
+
+void SurgePricing::driverIdle(const Node* at)
+{
+    int z = grid.zoneOf(at);
+    if (z >= 0)
+    {
+        zones[z].idle++;
+    }
+}
+
+void SurgePricing::driverBusy(const Node* at)
+{
+    int z = grid.zoneOf(at);
+    if (z >= 0 && zones[z].idle > 0)
+    {
+        zones[z].idle--;
+    }
+}
+
+void SurgePricing::driverMoved(const Node* from, const Node* to)
+{
+    if (grid.zoneOf(from) != grid.zoneOf(to))
+    {
+        driverBusy(from);
+        driverIdle(to);
+    }
+}
+
+void SurgePricing::advance(double seconds)
+{
+    clock += seconds;
+    while (clock >= nextUpdate)
+    {
+        update();
+        nextUpdate += config.updateSeconds;
+    }
+}
+
+// A decayed count settles at rate * halfLife / ln 2, so demand * ln 2 /
+// halfLife is the recent request rate
+void SurgePricing::update()
+{
+    stats.updates++;
+    double decay = exp2(-config.updateSeconds / config.demandHalfLife);
+    double perHorizon = log(2.0) / config.demandHalfLife * config.horizon;
+    for (Zone& zone : zones)
+    {
+        zone.demand = zone.demand * decay + zone.arrivals;
+        zone.arrivals = 0;
+
+        double pressure = (zone.open + zone.demand * perHorizon) / max(zone.idle, 1);
+        double target = min(config.maxMultiplier, 1 + config.sensitivity * max(0.0, pressure - 1));
+        zone.multiplier += static_cast<float>(config.smoothing * (target - zone.multiplier));
+        stats.peakMultiplier = max(stats.peakMultiplier, zone.multiplier);
+    }
+}
+
+float SurgePricing::multiplier(const Node* origin) const
+{
+    int z = grid.zoneOf(origin);
+    return z >= 0 ? zones[z].multiplier : 1.0f;
+}
+
+FareQuote SurgePricing::quote(const Node* origin, const Node* destination, VehicleClass vehicleClass)
+{
+    stats.quotes++;
+    FareQuote quote;
+    quote.zone = grid.zoneOf(origin);
+    quote.multiplier = quote.zone >= 0 ? zones[quote.zone].multiplier : 1.0f;
+    if (origin && destination)
+    {
+        float dx = destination->x - origin->x;
+        float dy = destination->y - origin->y;
+        quote.distance = static_cast<float>(sqrt(dx * dx + dy * dy) * config.detourFactor);
+        quote.seconds = static_cast<float>(quote.distance / config.quoteSpeed);
+    }
+    quote.fare = fare(quote, quote.distance, quote.seconds, vehicleClass);
+    return quote;
+}
+
+float SurgePricing::fare(const FareQuote& quote, double distance, double seconds, VehicleClass vehicleClass) const
+{
+    double metered = (config.baseFare + config.perUnit * distance + config.perSecond * seconds) * classInfo(vehicleClass).fareRate;
+    return static_cast<float>(max(config.minimumFare, metered) * quote.multiplier);
+}
@@ -0,0 +1,110 @@
+#ifndef PRICING_H
+#define PRICING_H
+
+#include "node.h"
+#include "vehicleclass.h"
+#include "zonegrid.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct PricingConfig
+{
+    int zoneCount = 0;           // Grid zones to aim for, 0 picks about four nodes each
+    double baseFare = 30;
+    double perUnit = 0.05;       // Per map unit driven
+    double perSecond = 0.2;      // Per second of ride time
+    double minimumFare = 40;
+    double updateSeconds = 5;    // Multipliers are recomputed this often
+    double demandHalfLife = 300; // Seconds for a request to count half as much
+    double horizon = 60;         // Seconds of recent demand set against idle supply
+    double sensitivity = 0.5;    // Surge added per request beyond one per idle driver
+    double smoothing = 0.3;      // Share of the new target taken each update
+    double maxMultiplier = 3;
+    double detourFactor = 1.3;   // Road distance over straight-line distance, for quotes
+    double quoteSpeed = 35;      // Map units per second, for quotes
+};
+
+// A price offered at request time. The multiplier is locked in: the final
+// fare is charged at it whatever surge does during the ride.
+struct FareQuote
+{
+    float fare = 0;
+    float multiplier = 1;
+    float distance = 0;  // Estimated, map units
+    float seconds = 0;   // Estimated
+    int zone = -1;       // Origin zone
+};
+
+struct PricingStats
+{
+    uint64_t quotes = 0;
+    uint64_t updates = 0;
+    float peakMultiplier = 1;
+};
+
+// Zone surge pricing. Each grid zone keeps counters of open requests and
+// idle drivers, moved one step by each request, accept and dropoff, plus the
+// number of requests since the last update. Every updateSeconds of
+// simulated time the zones (never the drivers or requests) are swept: demand
+// decays, the target multiplier is 1 + sensitivity * (pressure - 1) with
+// pressure = (open + recent demand over the horizon) / idle, and the live
+// multiplier moves part of the way toward it. A quote reads the origin's
+// zone from its coordinates and prices a straight-line estimate, so it is
+// O(1). Simulation thread only.
+class SurgePricing
+{
+public:
+    SurgePricing(PricingConfig config = PricingConfig());
+
+    // Zones over a graph; counters and multipliers start afresh
+    void attach(const vector<Node*>& nodes);
+
+    // Events. Callers pass the same node for a driver going idle and busy
+    // again (or moving while idle) so its zone's count stays balanced.
+    void requestOpened(const Node* origin);
+    void requestClosed(const Node* origin); // Accepted, or given up
+    void driverIdle(const Node* at);
+    void driverBusy(const Node* at);
+    void driverMoved(const Node* from, const Node* to);
+
+    // Simulated time passed; recomputes the multipliers when one is due
+    void advance(double seconds);
+
+    float multiplier(const Node* origin) const;
+    FareQuote quote(const Node* origin, const Node* destination, VehicleClass vehicleClass);
+    // Charged from the distance actually driven and the ride time
+    float fare(const FareQuote& quote, double distance, double seconds, VehicleClass vehicleClass) const;
+
+    int zoneOf(const Node* node) const { return grid.zoneOf(node); }
+    size_t zoneCount() const { return zones.size(); }
+    int openRequests(int zone) const { return zones[zone].open; }
+    int idleDrivers(int zone) const { return zones[zone].idle; }
+
+    const PricingStats& getStats() const { return stats; }
+
+private:
+    struct Zone
+    {
+        int open = 0;
+        int idle = 0;
+        int arrivals = 0;        // Requests since the last update
+        double demand = 0;       // Decayed request count
+        float multiplier = 1;
+    };
+
+    void update();
+
+    PricingConfig config;
+    ZoneGrid grid;
+    vector<Zone> zones;
+    double clock;
+    double nextUpdate;
+    PricingStats stats;
+};
+
+extern SurgePricing pricing;
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef QUIETCONSOLE_H
+#define QUIETCONSOLE_H
+
+#include <iostream>
+#include <streambuf>
+#include "logger.h"
+
+using namespace std;
+
+// Swallows everything written to cout/cerr and mutes the logger while alive,
+// used by headless runs (load tests, benchmarks) that drive code which prints
+class QuietConsole
+{
+public:
+    QuietConsole() : savedOut(cout.rdbuf(&sink)), savedErr(cerr.rdbuf(&sink)), savedLevel(getLogLevel())
+    {
+        setLogLevel(LogLevel::Off);
+    }
+    ~QuietConsole()
+    {
+        setLogLevel(savedLevel);
+        cout.rdbuf(savedOut);
+        cerr.rdbuf(savedErr);
+    }
+
+    QuietConsole(const QuietConsole&) = delete;
+    QuietConsole& operator=(const QuietConsole&) = delete;
+
+private:
+    struct NullBuffer : streambuf
+    {
+        int overflow(int c) override { return c; }
+        streamsize xsputn(const char*, streamsize n) override { return n; }
+    };
+
+    NullBuffer sink;
+    streambuf* savedOut;
+    streambuf* savedErr;
+    LogLevel savedLevel;
+};
+
+#endif
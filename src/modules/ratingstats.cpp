@@ -0,0 +1,92 @@
+#include "ratingstats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+RatingStats::RatingStats() : count(0), mean(0), m2(0), windowSum(0), windowHead(0), windowCount(0)
+{
+    memset(window, 0, sizeof(window));
+    memset(histogram, 0, sizeof(histogram));
+}
+
+void RatingStats::add(double rating)
+{
+    count++;
+    double delta = rating - mean;
+    mean += delta / static_cast<double>(count);
+    m2 += delta * (rating - mean);
+
+    push(static_cast<uint8_t>(min(max(lround(rating * 10), 0L), static_cast<long>(bins - 1))));
+}
+
+void RatingStats::push(uint8_t tenths)
+{
+    if (windowCount == windowSize)
+    {
+        uint8_t evicted = window[windowHead];
+        histogram[evicted]--;
+        windowSum -= evicted;
+    }
+    else
+    {
+        windowCount++;
+    }
+    window[windowHead] = tenths;
+    histogram[tenths]++;
+    windowSum += tenths;
+    windowHead = static_cast<uint16_t>((windowHead + 1) % windowSize);
+}
+
+double RatingStats::getVariance() const
+{
+    return count > 1 ? m2 / static_cast<double>(count - 1) : 0;
+}
+
+double RatingStats::getStdDev() const
+{
+    return sqrt(getVariance());
+}
+
+double RatingStats::getWindowMean() const
+{
+    return windowCount ? windowSum / (10.0 * windowCount) : 0;
+}
+
+double RatingStats::windowPercentile(double p) const
+{
+    if (windowCount == 0)
+    {
+        return 0;
+    }
+    uint32_t rank = static_cast<uint32_t>(ceil(min(max(p, 0.0), 100.0) / 100.0 * windowCount));
+    rank = max(rank, 1u);
+    uint32_t seen = 0;
+    for (int bin = 0; bin < bins; bin++)
+    {
+        seen += histogram[bin];
+        if (seen >= rank)
+        {
+            return bin / 10.0;
+        }
+    }
+    return (bins - 1) / 10.0;
+}
+
+uint8_t RatingStats::windowTenths(size_t i) const
+{
+    // The oldest rating sits at the head once the ring has wrapped
+    size_t start = windowCount == windowSize ? windowHead : 0;
+    return window[(start + i) % windowSize];
+}
+
+void RatingStats::restore(uint64_t count, double mean, double m2, const uint8_t* tenths, size_t n)
+{
+    *this = RatingStats();
+    for (size_t i = n > windowSize ? n - windowSize : 0; i < n; i++)
+    {
+        push(min(tenths[i], static_cast<uint8_t>(bins - 1)));
+    }
+    this->count = count;
+    this->mean = mean;
+    this->m2 = m2;
+}
@@ -0,0 +1,55 @@
+#ifndef RATINGSTATS_H
+#define RATINGSTATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+// Running rating aggregate of one driver, O(1) per rating and fixed size
+// however many rides are rated:
+//   lifetime  count, mean and variance (Welford's update)
+//   recent    the last windowSize ratings in a ring, with their sum and a
+//             histogram of tenths for the recent mean and percentiles
+// Window ratings are kept in tenths of a star, the input precision of the app.
+class RatingStats
+{
+public:
+    static const int windowSize = 500;
+    static const int bins = 51; // 0.0 to 5.0 in tenths
+
+    RatingStats();
+
+    void add(double rating);
+
+    uint64_t getCount() const { return count; }
+    double getMean() const { return mean; }
+    double getVariance() const; // Sample variance, 0 below two ratings
+    double getStdDev() const;
+
+    size_t getWindowCount() const { return windowCount; }
+    double getWindowMean() const;
+
+    // Rating at or below which p percent (0..100) of the recent ratings fall
+    double windowPercentile(double p) const;
+
+    // Persistence: the lifetime moments plus the window, oldest first
+    double getM2() const { return m2; }
+    uint8_t windowTenths(size_t i) const;
+    void restore(uint64_t count, double mean, double m2, const uint8_t* tenths, size_t n);
+
+private:
+    void push(uint8_t tenths);
+
+    uint64_t count;
+    double mean;
+    double m2;        // Sum of squared deviations from the mean
+
+    uint8_t window[windowSize];
+    uint16_t histogram[bins];
+    uint32_t windowSum;
+    uint16_t windowHead;  // Next slot to write
+    uint16_t windowCount;
+};
+
+#endif
@@ -0,0 +1,388 @@
+#include "reachability.h"
+#include "routecache.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+
+ReachabilityIndex reachability;
+
+static const uint32_t unassigned = UINT32_MAX;
+
+static Node* otherEnd(const Edge* edge, const Node* from)
+{
+    return edge->node1 == from ? edge->node2 : edge->node1;
+}
+
+void ReachabilityIndex::attach(const vector<Node*>& graph)
+{
+    unique_lock<shared_mutex> guard(lock);
+    nodes = graph;
+    slotOfId.clear();
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        int id = nodes[i]->id;
+        if (id < 0)
+        {
+            continue;
+        }
+        if (static_cast<size_t>(id) >= slotOfId.size())
+        {
+            slotOfId.resize(id + 1, -1);
+        }
+        slotOfId[id] = static_cast<int32_t>(i);
+    }
+    stats = ReachabilityStats();
+    stats.nodes = nodes.size();
+    rebuild();
+}
+
+void ReachabilityIndex::detach()
+{
+    unique_lock<shared_mutex> guard(lock);
+    nodes.clear();
+    slotOfId.clear();
+    component.clear();
+    componentSize.clear();
+    closure.clear();
+    closureValid = false;
+    stats = ReachabilityStats();
+}
+
+int ReachabilityIndex::slotOf(const Node* node) const
+{
+    if (!node || node->id < 0 || static_cast<size_t>(node->id) >= slotOfId.size())
+    {
+        return -1;
+    }
+    int32_t slot = slotOfId[node->id];
+    return slot >= 0 && nodes[slot] == node ? slot : -1;
+}
+
+bool ReachabilityIndex::reachableSlots(uint32_t from, uint32_t to) const
+{
+    uint32_t source = component[from];
+    uint32_t target = component[to];
+    if (source == target || !closureValid)
+    {
+        return true;
+    }
+    return (closure[source * rowWords + target / 64] >> (target % 64)) & 1;
+}
+
+bool ReachabilityIndex::reachable(const Node* from, const Node* to) const
+{
+    shared_lock<shared_mutex> guard(lock);
+    int source = slotOf(from);
+    int target = slotOf(to);
+    if (source < 0 || target < 0)
+    {
+        return true;
+    }
+    return reachableSlots(source, target);
+}
+
+int ReachabilityIndex::componentOf(const Node* node) const
+{
+    shared_lock<shared_mutex> guard(lock);
+    int slot = slotOf(node);
+    return slot < 0 ? -1 : static_cast<int>(component[slot]);
+}
+
+// Breadth-first search over open edges for another way from one node to
+// another, so a detour around the block is found before the far side of the
+// city. Nodes the index already rules out are skipped: closing an edge only
+// ever removes paths.
+bool ReachabilityIndex::searchAround(uint32_t from, uint32_t to)
+{
+    if (visitStamp.size() != nodes.size())
+    {
+        visitStamp.assign(nodes.size(), 0);
+        stamp = 0;
+    }
+    if (++stamp == 0)
+    {
+        fill(visitStamp.begin(), visitStamp.end(), 0);
+        stamp = 1;
+    }
+
+    stack.clear(); // Used as a queue
+    stack.push_back(from);
+    visitStamp[from] = stamp;
+    for (size_t head = 0; head < stack.size(); head++)
+    {
+        uint32_t slot = stack[head];
+        Node* node = nodes[slot];
+        for (Edge* edge : node->edges)
+        {
+            int next = edge->closed ? -1 : slotOf(otherEnd(edge, node));
+            if (next < 0 || visitStamp[next] == stamp || !reachableSlots(next, to))
+            {
+                continue;
+            }
+            if (static_cast<uint32_t>(next) == to)
+            {
+                return true;
+            }
+            visitStamp[next] = stamp;
+            stack.push_back(next);
+        }
+    }
+    return false;
+}
+
+bool ReachabilityIndex::closeEdge(Edge* edge)
+{
+    unique_lock<shared_mutex> guard(lock);
+    if (!edge || edge->closed)
+    {
+        return false;
+    }
+    edge->closed = true;
+    routeCache.bumpEpoch(); // Cached routes may use the edge
+
+    int from = slotOf(edge->node1);
+    int to = slotOf(edge->node2);
+    if (from < 0 || to < 0)
+    {
+        return true;
+    }
+    if (searchAround(from, to))
+    {
+        stats.localChecks++; // Every path through the edge has a detour
+        return true;
+    }
+    rebuild();
+    return true;
+}
+
+bool ReachabilityIndex::openEdge(Edge* edge)
+{
+    unique_lock<shared_mutex> guard(lock);
+    if (!edge || !edge->closed)
+    {
+        return false;
+    }
+    edge->closed = false;
+    routeCache.bumpEpoch(); // Routes planned around the closure may now be longer than needed
+
+    int from = slotOf(edge->node1);
+    int to = slotOf(edge->node2);
+    if (from < 0 || to < 0 || component[from] == component[to])
+    {
+        return true;
+    }
+
+    uint32_t source = component[from];
+    uint32_t target = component[to];
+    auto reaches = [this](uint32_t a, uint32_t b) { return (closure[a * rowWords + b / 64] >> (b % 64)) & 1; };
+    if (closureValid && reaches(source, target))
+    {
+        return true;
+    }
+    if (closureValid && !reaches(target, source))
+    {
+        // Still a DAG: whoever reaches the edge's start now reaches all the end reaches
+        const uint64_t* added = &closure[target * rowWords];
+        for (size_t c = 0; c < componentSize.size(); c++)
+        {
+            uint64_t* row = &closure[c * rowWords];
+            if ((row[source / 64] >> (source % 64)) & 1)
+            {
+                for (size_t w = 0; w < rowWords; w++)
+                {
+                    row[w] |= added[w];
+                }
+            }
+        }
+        stats.closurePatches++;
+        return true;
+    }
+    rebuild(); // A cycle through the edge merges components
+    return true;
+}
+
+bool ReachabilityIndex::closeRoad(Node* a, Node* b)
+{
+    Edge* forward = Node::findEdge(a, b);
+    Edge* backward = Node::findEdge(b, a);
+    if (!forward && !backward)
+    {
+        return false;
+    }
+    closeEdge(forward);
+    closeEdge(backward);
+    return true;
+}
+
+bool ReachabilityIndex::openRoad(Node* a, Node* b)
+{
+    Edge* forward = Node::findEdge(a, b);
+    Edge* backward = Node::findEdge(b, a);
+    if (!forward && !backward)
+    {
+        return false;
+    }
+    openEdge(forward);
+    openEdge(backward);
+    return true;
+}
+
+void ReachabilityIndex::rebuild()
+{
+    auto start = chrono::steady_clock::now();
+    findComponents();
+    buildClosure();
+    stats.rebuilds++;
+    stats.buildNanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    stats.components = componentSize.size();
+    stats.largestComponent = componentSize.empty() ? 0 : *max_element(componentSize.begin(), componentSize.end());
+}
+
+// Tarjan's algorithm without recursion, so a long chain of roads cannot
+// overflow the call stack. Components come out in reverse topological
+// order: each one after every component it reaches.
+void ReachabilityIndex::findComponents()
+{
+    size_t n = nodes.size();
+    order.assign(n, 0);
+    lowLink.assign(n, 0);
+    component.assign(n, unassigned);
+    componentSize.clear();
+    stack.clear();
+    uint32_t counter = 0;
+
+    for (uint32_t root = 0; root < n; root++)
+    {
+        if (order[root] != 0)
+        {
+            continue;
+        }
+        order[root] = lowLink[root] = ++counter;
+        stack.push_back(root);
+        frames.push_back({ root, 0 });
+
+        while (!frames.empty())
+        {
+            uint32_t slot = frames.back().first;
+            uint32_t next = frames.back().second;
+            Node* node = nodes[slot];
+            if (next < node->edges.size())
+            {
+                frames.back().second++;
+                Edge* edge = node->edges[next];
+                int target = edge->closed ? -1 : slotOf(otherEnd(edge, node));
+                if (target < 0)
+                {
+                    continue;
+                }
+                if (order[target] == 0)
+                {
+                    order[target] = lowLink[target] = ++counter;
+                    stack.push_back(target);
+                    frames.push_back({ static_cast<uint32_t>(target), 0 });
+                }
+                else if (component[target] == unassigned)
+                {
+                    lowLink[slot] = min(lowLink[slot], order[target]); // Still on the stack
+                }
+                continue;
+            }
+
+            if (lowLink[slot] == order[slot])
+            {
+                uint32_t id = static_cast<uint32_t>(componentSize.size());
+                uint32_t size = 0;
+                uint32_t member;
+                do
+                {
+                    member = stack.back();
+                    stack.pop_back();
+                    component[member] = id;
+                    size++;
+                } while (member != slot);
+                componentSize.push_back(size);
+            }
+            frames.pop_back();
+            if (!frames.empty())
+            {
+                uint32_t parent = frames.back().first;
+                lowLink[parent] = min(lowLink[parent], lowLink[slot]);
+            }
+        }
+    }
+}
+
+// Rows are filled in component order, which is reverse topological, so every
+// successor's row is final before it is merged. A successor whose bit is
+// already set needs no merge: its row is contained in the current one.
+void ReachabilityIndex::buildClosure()
+{
+    size_t count = componentSize.size();
+    closure.clear();
+    closureValid = count <= maxClosureComponents;
+    if (!closureValid)
+    {
+        rowWords = 0;
+        return;
+    }
+    rowWords = (count + 63) / 64;
+    closure.assign(count * rowWords, 0);
+
+    // Slots grouped by component, reusing the Tarjan scratch
+    vector<uint32_t>& first = lowLink;
+    vector<uint32_t>& members = order;
+    first.assign(count + 1, 0);
+    for (uint32_t c = 0; c < count; c++)
+    {
+        first[c + 1] = first[c] + componentSize[c];
+    }
+    stack.assign(first.begin(), first.end() - 1);
+    members.assign(nodes.size(), 0);
+    for (uint32_t slot = 0; slot < nodes.size(); slot++)
+    {
+        members[stack[component[slot]]++] = slot;
+    }
+
+    for (uint32_t c = 0; c < count; c++)
+    {
+        uint64_t* row = &closure[c * rowWords];
+        row[c / 64] |= uint64_t(1) << (c % 64);
+        for (uint32_t m = first[c]; m < first[c + 1]; m++)
+        {
+            Node* node = nodes[members[m]];
+            for (Edge* edge : node->edges)
+            {
+                int target = edge->closed ? -1 : slotOf(otherEnd(edge, node));
+                if (target < 0)
+                {
+                    continue;
+                }
+                uint32_t d = component[target];
+                if ((row[d / 64] >> (d % 64)) & 1)
+                {
+                    continue;
+                }
+                const uint64_t* successor = &closure[d * rowWords];
+                for (size_t w = 0; w < rowWords; w++)
+                {
+                    row[w] |= successor[w];
+                }
+            }
+        }
+    }
+}
+
+ReachabilityStats ReachabilityIndex::getStats() const
+{
+    shared_lock<shared_mutex> guard(lock);
+    return stats;
+}
+
+void ReachabilityIndex::display() const
+{
+    ReachabilityStats current = getStats();
+    cout << "Reachability: " << current.nodes << " nodes in " << current.components << " components (largest "
+         << current.largestComponent << "), " << current.rebuilds << " rebuilds, " << current.closurePatches
+         << " patches, " << current.localChecks << " local checks, last build " << current.buildNanos / 1e6 << " ms" << endl;
+}
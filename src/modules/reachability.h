@@ -0,0 +1,82 @@
+#ifndef REACHABILITY_H
+#define REACHABILITY_H
+
+#include "node.h"
+#include <cstdint>
+#include <shared_mutex>
+#include <vector>
+
+using namespace std;
+
+struct ReachabilityStats
+{
+    size_t nodes = 0;
+    size_t components = 0;
+    size_t largestComponent = 0;
+    uint64_t rebuilds = 0;        // Full SCC + closure passes
+    uint64_t closurePatches = 0;  // Reopened edges folded into the closure in place
+    uint64_t localChecks = 0;     // Closures settled by a search around the edge
+    uint64_t buildNanos = 0;      // Last full rebuild
+};
+
+// Strongly connected components of the road graph over open edges, plus the
+// transitive closure of their condensation as one bit row per component, so
+// "can any route lead from a to b" costs two lookups and a bit test instead
+// of an A* search that exhausts everything reachable from a.
+// Closing an edge first searches for another way from its start to its end;
+// when there is one nothing changes, otherwise the index is rebuilt.
+// Reopening an edge whose ends were already connected is free, one that adds
+// a DAG edge patches the closure rows, and only one that merges components
+// rebuilds.
+class ReachabilityIndex
+{
+public:
+    static const size_t maxClosureComponents = 8192; // 8 MB of closure bits
+
+    void attach(const vector<Node*>& nodes);
+    void detach();
+
+    // False only when no path can exist. Nodes outside the attached graph
+    // count as reachable and are left to the search.
+    bool reachable(const Node* from, const Node* to) const;
+
+    // Close or reopen one direction; false if it was already in that state
+    bool closeEdge(Edge* edge);
+    bool openEdge(Edge* edge);
+
+    // Both directions of the road between two nodes; false if there is none
+    bool closeRoad(Node* a, Node* b);
+    bool openRoad(Node* a, Node* b);
+
+    int componentOf(const Node* node) const;
+    ReachabilityStats getStats() const;
+    void display() const;
+
+private:
+    int slotOf(const Node* node) const;
+    bool reachableSlots(uint32_t from, uint32_t to) const;
+    bool searchAround(uint32_t from, uint32_t to);
+    void rebuild();
+    void findComponents();
+    void buildClosure();
+
+    vector<Node*> nodes;
+    vector<int32_t> slotOfId;      // Node id -> position in nodes, -1 when absent
+    vector<uint32_t> component;    // Per slot
+    vector<uint32_t> componentSize;
+    vector<uint64_t> closure;      // components x rowWords, bit d of row c: c reaches d
+    size_t rowWords = 0;
+    bool closureValid = false;     // False past maxClosureComponents: only equal components are known
+
+    // Scratch for the component and local searches
+    vector<uint32_t> order, lowLink, stack, visitStamp;
+    vector<pair<uint32_t, uint32_t>> frames;
+    uint32_t stamp = 0;
+
+    ReachabilityStats stats;
+    mutable shared_mutex lock;
+};
+
+extern ReachabilityIndex reachability;
+
+#endif
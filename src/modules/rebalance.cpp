@@ -0,0 +1,312 @@
+#include "rebalance.h"
+#include "routebatch.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+FleetRebalancer::FleetRebalancer(const vector<Node*>& nodes, RebalanceConfig config, ThreadPool& pool)
+    : nodes(nodes), config(config), pool(pool),
+      grid(nodes, config.zoneCount > 0 ? config.zoneCount : max(1, static_cast<int>(nodes.size() / 4)))
+{
+    zones.resize(grid.size());
+    vector<pair<uint32_t, uint32_t>> links = grid.neighbourLinks();
+    arcs.reserve(links.size());
+    for (size_t i = 0; i < links.size(); i++)
+    {
+        Zone& from = zones[links[i].first];
+        if (from.arcCount == 0)
+        {
+            from.firstArc = static_cast<uint32_t>(i);
+        }
+        from.arcCount++;
+        const GridZone& a = grid.zone(links[i].first);
+        const GridZone& b = grid.zone(links[i].second);
+        float cost = sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+        arcs.push_back({ links[i].second, max(cost, 1e-3f) });
+    }
+    reverseArc.resize(arcs.size());
+    for (size_t i = 0; i < links.size(); i++)
+    {
+        auto found = lower_bound(links.begin(), links.end(), make_pair(links[i].second, links[i].first));
+        reverseArc[i] = static_cast<uint32_t>(found - links.begin());
+    }
+
+    size_t count = zones.size();
+    surplus.assign(count, 0);
+    deficit.assign(count, 0);
+    flow.assign(arcs.size(), 0);
+    potential.assign(count, 0);
+    distance.assign(count, 0);
+    viaArc.assign(count, -1);
+    visitStamp.assign(count, 0);
+}
+
+double FleetRebalancer::decayedDemand(const Zone& zone, double now) const
+{
+    return zone.demand * exp2(-(now - zone.demandStamp) / config.demandHalfLife);
+}
+
+void FleetRebalancer::noteRequest(const Node* origin, double now)
+{
+    int z = zoneOf(origin);
+    if (z < 0)
+    {
+        return;
+    }
+    Zone& zone = zones[z];
+    zone.demand = decayedDemand(zone, now) + 1;
+    zone.demandStamp = now;
+}
+
+// A decayed count settles at rate * halfLife / ln 2, so this is the rate
+// scaled to the horizon
+double FleetRebalancer::forecast(int zone, double now) const
+{
+    return decayedDemand(zones[zone], now) * log(2.0) / config.demandHalfLife * config.horizon;
+}
+
+vector<Reposition> FleetRebalancer::plan(const vector<IdleVehicle>& idle, double now)
+{
+    auto started = chrono::steady_clock::now();
+    auto elapsedMillis = [&started]() { return chrono::duration<double, milli>(chrono::steady_clock::now() - started).count(); };
+    stats.rounds++;
+    vector<Reposition> moves;
+    size_t count = zones.size();
+    if (count == 0 || idle.empty())
+    {
+        return moves;
+    }
+
+    // Supply and targets: each zone should hold its expected requests over
+    // the horizon, scaled down when the idle fleet cannot cover them all
+    vector<vector<int>> idleIn(count);
+    for (size_t i = 0; i < idle.size(); i++)
+    {
+        int z = zoneOf(idle[i].at);
+        if (z >= 0)
+        {
+            idleIn[z].push_back(static_cast<int>(i));
+        }
+    }
+    vector<double> expected(count);
+    double totalExpected = 0;
+    for (size_t z = 0; z < count; z++)
+    {
+        expected[z] = forecast(static_cast<int>(z), now);
+        totalExpected += expected[z];
+    }
+    if (totalExpected <= 0)
+    {
+        return moves;
+    }
+    double scale = min(1.0, idle.size() / totalExpected);
+    int sources = 0, sinks = 0;
+    for (size_t z = 0; z < count; z++)
+    {
+        double target = expected[z] * scale;
+        int have = static_cast<int>(idleIn[z].size());
+        surplus[z] = max(0, static_cast<int>(floor(have - target)) - config.deadband);
+        deficit[z] = max(0, static_cast<int>(floor(target - have + 0.5)));
+        sources += surplus[z];
+        sinks += deficit[z];
+    }
+    vector<int> sent(surplus.begin(), surplus.end());
+    vector<int> received(deficit.begin(), deficit.end());
+    fill(flow.begin(), flow.end(), 0);
+    fill(potential.begin(), potential.end(), 0.0);
+
+    // Successive shortest paths from every zone with surplus at once (the
+    // super source) to the nearest zone still short, on reduced costs
+    size_t moved = 0;
+    double maxDistance = config.maxDistance > 0 ? config.maxDistance : numeric_limits<double>::infinity();
+    using QueueElement = pair<double, uint32_t>;
+    vector<QueueElement> heap;
+    auto later = [](const QueueElement& a, const QueueElement& b) { return a.first > b.first; };
+    while (sources > 0 && sinks > 0 && moved < config.maxMoves)
+    {
+        if (elapsedMillis() > config.budgetMillis)
+        {
+            stats.budgetHits++;
+            break;
+        }
+        uint32_t round = ++stamp;
+        heap.clear();
+        for (size_t z = 0; z < count; z++)
+        {
+            if (surplus[z] > 0)
+            {
+                visitStamp[z] = round;
+                distance[z] = 0;
+                viaArc[z] = -1;
+                heap.push_back({ 0.0, static_cast<uint32_t>(z) });
+            }
+        }
+        make_heap(heap.begin(), heap.end(), later);
+
+        int sink = -1;
+        double reach = 0;
+        while (!heap.empty())
+        {
+            pop_heap(heap.begin(), heap.end(), later);
+            auto [d, u] = heap.back();
+            heap.pop_back();
+            if (d > distance[u])
+            {
+                continue;
+            }
+            if (deficit[u] > 0)
+            {
+                sink = static_cast<int>(u);
+                reach = d;
+                break;
+            }
+            const Zone& zone = zones[u];
+            for (uint32_t a = zone.firstArc; a < zone.firstArc + zone.arcCount; a++)
+            {
+                uint32_t v = arcs[a].to;
+                // Forward along the arc, or cheaper: undo flow sent v -> u
+                uint32_t back = reverseArc[a];
+                double cost = flow[back] > 0 ? -arcs[back].cost : arcs[a].cost;
+                double candidate = d + cost + potential[u] - potential[v];
+                if (visitStamp[v] != round || candidate < distance[v])
+                {
+                    visitStamp[v] = round;
+                    distance[v] = candidate;
+                    viaArc[v] = static_cast<int>(a);
+                    heap.push_back({ candidate, v });
+                    push_heap(heap.begin(), heap.end(), later);
+                }
+            }
+        }
+        if (sink < 0)
+        {
+            break; // Nothing short is reachable
+        }
+
+        // Actual length and bottleneck of the path
+        double length = 0;
+        int amount = deficit[sink];
+        int start = sink;
+        for (int v = sink; viaArc[v] >= 0;)
+        {
+            uint32_t a = static_cast<uint32_t>(viaArc[v]);
+            uint32_t back = reverseArc[a];
+            uint32_t u = arcs[back].to;
+            if (flow[back] > 0)
+            {
+                length -= arcs[back].cost;
+                amount = min(amount, flow[back]);
+            }
+            else
+            {
+                length += arcs[a].cost;
+            }
+            v = static_cast<int>(u);
+            start = v;
+        }
+        if (length > maxDistance)
+        {
+            break; // Paths only get longer from here
+        }
+        amount = min({ amount, surplus[start], static_cast<int>(config.maxMoves - moved) });
+
+        for (int v = sink; viaArc[v] >= 0;)
+        {
+            uint32_t a = static_cast<uint32_t>(viaArc[v]);
+            uint32_t back = reverseArc[a];
+            if (flow[back] > 0)
+                flow[back] -= amount;
+            else
+                flow[a] += amount;
+            v = static_cast<int>(arcs[back].to);
+        }
+        surplus[start] -= amount;
+        deficit[sink] -= amount;
+        sources -= amount;
+        sinks -= amount;
+        moved += amount;
+
+        for (size_t z = 0; z < count; z++)
+        {
+            if (visitStamp[z] == round)
+            {
+                potential[z] += min(distance[z], reach);
+            }
+            else
+            {
+                potential[z] += reach;
+            }
+        }
+    }
+
+    // Break the flow into zone-to-zone moves, then pick vehicles and route
+    // them together
+    RouteBatch batch(pool);
+    for (size_t z = 0; z < count; z++)
+    {
+        sent[z] -= surplus[z];
+        received[z] -= deficit[z];
+    }
+    for (size_t z = 0; z < count; z++)
+    {
+        while (sent[z] > 0)
+        {
+            int u = static_cast<int>(z);
+            int amount = sent[z];
+            vector<uint32_t> walk;
+            while (received[u] == 0)
+            {
+                const Zone& zone = zones[u];
+                uint32_t next = zone.firstArc;
+                while (next < zone.firstArc + zone.arcCount && flow[next] == 0)
+                {
+                    next++;
+                }
+                if (next == zone.firstArc + zone.arcCount)
+                {
+                    break;
+                }
+                amount = min(amount, flow[next]);
+                walk.push_back(next);
+                u = static_cast<int>(arcs[next].to);
+            }
+            if (received[u] == 0)
+            {
+                break; // Flow is conserved, so this does not happen
+            }
+            amount = min(amount, received[u]);
+            for (uint32_t a : walk)
+            {
+                flow[a] -= amount;
+            }
+            sent[z] -= amount;
+            received[u] -= amount;
+
+            Node* target = grid.zone(u).anchor;
+            for (int k = 0; k < amount && !idleIn[z].empty(); k++)
+            {
+                const IdleVehicle& vehicle = idle[idleIn[z].back()];
+                idleIn[z].pop_back();
+                if (vehicle.at != target)
+                {
+                    moves.push_back({ vehicle.id, target, {} });
+                    batch.add(vehicle.at, target);
+                }
+            }
+        }
+    }
+
+    double solveMillis = elapsedMillis();
+    vector<vector<Edge*>> paths = batch.solve();
+    for (size_t i = 0; i < moves.size(); i++)
+    {
+        moves[i].path = move(paths[i]);
+    }
+    moves.erase(remove_if(moves.begin(), moves.end(), [](const Reposition& move) { return move.path.empty(); }), moves.end());
+
+    stats.moves += moves.size();
+    stats.lastSolveMillis = solveMillis;
+    stats.totalSolveMillis += solveMillis;
+    return moves;
+}
@@ -0,0 +1,105 @@
+#ifndef REBALANCE_H
+#define REBALANCE_H
+
+#include "node.h"
+#include "threadpool.h"
+#include "zonegrid.h"
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+struct RebalanceConfig
+{
+    int zoneCount = 0;           // Grid zones to aim for, 0 picks about four nodes each
+    double demandHalfLife = 600; // Seconds for a request to count half as much in the forecast
+    double horizon = 600;        // Seconds of forecast demand idle supply is matched to
+    int deadband = 1;            // Surplus a zone keeps before sending vehicles away
+    double maxDistance = 0;      // Longest move in map units, 0 for no limit
+    size_t maxMoves = 1000;      // Per round
+    double budgetMillis = 2;     // Wall time a round may spend solving
+};
+
+struct IdleVehicle
+{
+    int id;     // Caller's handle, returned in the moves
+    Node* at;
+};
+
+struct Reposition
+{
+    int id;
+    Node* target;
+    vector<Edge*> path;
+};
+
+struct RebalanceStats
+{
+    uint64_t rounds = 0;
+    uint64_t moves = 0;
+    uint64_t budgetHits = 0;     // Rounds cut short by the time budget
+    double lastSolveMillis = 0;
+    double totalSolveMillis = 0;
+};
+
+// Repositions idle vehicles toward where requests are expected. The map is
+// cut into grid zones; each zone's forecast is a decayed count of its
+// requests and its target supply the matching share of the idle fleet.
+// Zones above target send vehicles to zones below it along a min-cost flow
+// over neighbouring zones (cost: distance between zone centres), solved by
+// successive shortest paths. Every augmentation leaves a valid partial plan,
+// so a round that runs out of budget still returns its cheapest moves. The
+// moves are routed together as one RouteBatch.
+class FleetRebalancer
+{
+public:
+    FleetRebalancer(const vector<Node*>& nodes, RebalanceConfig config = RebalanceConfig(), ThreadPool& pool = defaultThreadPool());
+
+    void noteRequest(const Node* origin, double now);
+
+    // One round: which of the idle vehicles should move, and where
+    vector<Reposition> plan(const vector<IdleVehicle>& idle, double now);
+
+    int zoneOf(const Node* node) const { return grid.zoneOf(node); }
+    size_t zoneCount() const { return zones.size(); }
+    double forecast(int zone, double now) const;
+
+    const RebalanceStats& getStats() const { return stats; }
+
+private:
+    struct Zone
+    {
+        double demand = 0;    // Decayed request count as of demandStamp
+        double demandStamp = 0;
+        uint32_t firstArc = 0, arcCount = 0;
+    };
+
+    struct Arc
+    {
+        uint32_t to;
+        float cost;
+    };
+
+    double decayedDemand(const Zone& zone, double now) const;
+
+    const vector<Node*>& nodes;
+    RebalanceConfig config;
+    ThreadPool& pool;
+
+    ZoneGrid grid;            // Moves go to each zone's anchor node
+    vector<Zone> zones;
+    vector<Arc> arcs;
+    vector<uint32_t> reverseArc; // Arc index of the opposite direction
+
+    // Solver scratch, reused between rounds
+    vector<int> surplus, deficit;
+    vector<int> flow;            // Per arc
+    vector<double> potential, distance;
+    vector<int> viaArc;          // Arc into the zone on the current path, -1 for a start
+    vector<uint32_t> visitStamp;
+    uint32_t stamp = 0;
+
+    RebalanceStats stats;
+};
+
+#endif
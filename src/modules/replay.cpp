@@ -0,0 +1,269 @@
+#include "replay.h"
+#include "logger.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+static const char replayMagic[4] = {'S', 'R', 'R', 'P'};
+static const uint32_t replayVersion = 1;
+
+// Encoding helpers
+
+static void putVarint(string& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+static bool readVarint(const string& in, size_t& at, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && at < in.size(); shift += 7)
+    {
+        unsigned char byte = static_cast<unsigned char>(in[at++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Console
+
+streambuf::int_type ConsoleTee::underflow()
+{
+    // Hand out one line at a time so nothing is read ahead of the program
+    line.clear();
+    int_type c;
+    while ((c = source->sbumpc()) != traits_type::eof())
+    {
+        line += traits_type::to_char_type(c);
+        if (c == '\n')
+        {
+            break;
+        }
+    }
+    if (line.empty())
+    {
+        return traits_type::eof();
+    }
+    sink += line;
+    setg(&line[0], &line[0], &line[0] + line.size());
+    return traits_type::to_int_type(line[0]);
+}
+
+// Recorder
+
+InputRecorder::InputRecorder()
+    : recording(false), replaying(false), seed(0), tick(0), nextEvent(0), originalConsole(nullptr), checkpoints(0), mismatches(0) {}
+
+InputRecorder::~InputRecorder()
+{
+    finish();
+}
+
+bool InputRecorder::record(const string& path, uint64_t seed)
+{
+    ofstream probe(path, ios::binary | ios::trunc);
+    if (!probe)
+    {
+        LOG_ERROR("Cannot create recording %s", path.c_str());
+        return false;
+    }
+    this->path = path;
+    this->seed = seed;
+    recording = true;
+    consoleBuffer.reset(new ConsoleTee(cin.rdbuf(), console));
+    originalConsole = cin.rdbuf(consoleBuffer.get());
+    return true;
+}
+
+bool InputRecorder::replay(const string& path, string& error)
+{
+    ifstream file(path, ios::binary);
+    if (!file)
+    {
+        error = "cannot open file";
+        return false;
+    }
+    string bytes((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+
+    size_t at = sizeof(replayMagic) + sizeof(uint32_t) + sizeof(uint64_t);
+    uint32_t version = 0;
+    if (bytes.size() < at || memcmp(bytes.data(), replayMagic, sizeof(replayMagic)) != 0)
+    {
+        error = "not a recording";
+        return false;
+    }
+    memcpy(&version, bytes.data() + sizeof(replayMagic), sizeof(version));
+    if (version != replayVersion)
+    {
+        error = "unsupported version " + to_string(version);
+        return false;
+    }
+    memcpy(&seed, bytes.data() + sizeof(replayMagic) + sizeof(version), sizeof(seed));
+
+    uint64_t consoleLength = 0;
+    uint64_t eventCount = 0;
+    if (!readVarint(bytes, at, consoleLength) || consoleLength > bytes.size() - at)
+    {
+        error = "truncated console input";
+        return false;
+    }
+    console = bytes.substr(at, consoleLength);
+    at += consoleLength;
+
+    bool ok = readVarint(bytes, at, eventCount);
+    uint64_t eventTick = 0;
+    for (uint64_t e = 0; ok && e < eventCount; e++)
+    {
+        uint64_t delta = 0;
+        uint64_t value = 0;
+        ok = readVarint(bytes, at, delta) && at < bytes.size();
+        if (!ok)
+        {
+            break;
+        }
+        uint8_t kind = static_cast<uint8_t>(bytes[at++]);
+        ok = kind < static_cast<uint8_t>(InputKind::Count) && readVarint(bytes, at, value);
+        eventTick += delta;
+        events.push_back({ eventTick, static_cast<InputKind>(kind), value });
+    }
+    if (!ok)
+    {
+        error = "truncated input events";
+        events.clear();
+        return false;
+    }
+
+    this->path = path;
+    replaying = true;
+    consoleBuffer.reset(new stringbuf(console, ios::in));
+    originalConsole = cin.rdbuf(consoleBuffer.get());
+    startedAt = chrono::steady_clock::now();
+    return true;
+}
+
+const InputEvent* InputRecorder::pendingEvent(InputKind kind) const
+{
+    if (nextEvent < events.size() && events[nextEvent].tick == tick && events[nextEvent].kind == kind)
+    {
+        return &events[nextEvent];
+    }
+    return nullptr;
+}
+
+int InputRecorder::addCars(int requested)
+{
+    if (replaying)
+    {
+        const InputEvent* event = pendingEvent(InputKind::AddCars);
+        if (!event)
+        {
+            return 0;
+        }
+        nextEvent++;
+        return static_cast<int>(event->value);
+    }
+    if (recording && requested > 0)
+    {
+        events.push_back({ tick, InputKind::AddCars, static_cast<uint64_t>(requested) });
+    }
+    return requested;
+}
+
+bool InputRecorder::closeDue() const
+{
+    // A recording cut short ends the window rather than spinning forever
+    return nextEvent >= events.size() || pendingEvent(InputKind::CloseWindow) != nullptr;
+}
+
+void InputRecorder::windowClosed(uint32_t digest)
+{
+    if (recording)
+    {
+        events.push_back({ tick, InputKind::CloseWindow, digest });
+    }
+    else if (replaying)
+    {
+        const InputEvent* event = pendingEvent(InputKind::CloseWindow);
+        checkpoints++;
+        if (!event || event->value != digest)
+        {
+            mismatches++;
+            LOG_WARN("Replay diverged at tick %llu: digest %08x, recorded %08llx", static_cast<unsigned long long>(tick), digest,
+                     event ? static_cast<unsigned long long>(event->value) : 0ULL);
+        }
+        if (event)
+        {
+            nextEvent++;
+        }
+    }
+}
+
+void InputRecorder::finish()
+{
+    if (originalConsole)
+    {
+        cin.rdbuf(originalConsole);
+        originalConsole = nullptr;
+    }
+
+    if (recording)
+    {
+        recording = false;
+        string bytes(replayMagic, sizeof(replayMagic));
+        bytes.append(reinterpret_cast<const char*>(&replayVersion), sizeof(replayVersion));
+        bytes.append(reinterpret_cast<const char*>(&seed), sizeof(seed));
+        putVarint(bytes, console.size());
+        bytes += console;
+        putVarint(bytes, events.size());
+        uint64_t previousTick = 0;
+        for (const InputEvent& event : events)
+        {
+            putVarint(bytes, event.tick - previousTick);
+            bytes += static_cast<char>(event.kind);
+            putVarint(bytes, event.value);
+            previousTick = event.tick;
+        }
+
+        string temporary = path + ".tmp";
+        ofstream file(temporary, ios::binary | ios::trunc);
+        file.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+        file.close();
+        error_code error;
+        if (file)
+        {
+            filesystem::rename(temporary, path, error);
+        }
+        if (!file || error)
+        {
+            LOG_ERROR("Could not write recording %s", path.c_str());
+            return;
+        }
+        LOG_INFO("Recorded %zu inputs over %llu ticks to %s (%zu bytes)", events.size(), static_cast<unsigned long long>(tick), path.c_str(), bytes.size());
+    }
+    else if (replaying)
+    {
+        replaying = false;
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - startedAt).count();
+        cout << "Replayed " << tick << " ticks from " << path << " in " << seconds * 1000 << " ms (" << (seconds > 0 ? tick / seconds : 0)
+             << " ticks/s), " << (checkpoints - mismatches) << "/" << checkpoints << " checkpoints matched" << endl;
+    }
+}
+
+uint32_t worldDigest(const WorldRefs& world)
+{
+    static vector<char> buffer;
+    captureWorld(world, buffer);
+    sealSnapshot(buffer);
+    return reinterpret_cast<const SnapshotHeader*>(buffer.data())->checksum;
+}
@@ -0,0 +1,110 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "snapshot.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// External inputs that change the simulation. Key toggles that only affect
+// drawing (metrics overlay) are not recorded.
+enum class InputKind : uint8_t
+{
+    AddCars,     // "Add car" button, value is the number of cars
+    CloseWindow, // End of a ride window, value is the world digest at that tick
+    Count
+};
+
+struct InputEvent
+{
+    uint64_t tick;
+    InputKind kind;
+    uint64_t value;
+};
+
+// Copies every line the program reads from the console into a string
+class ConsoleTee : public streambuf
+{
+public:
+    ConsoleTee(streambuf* source, string& sink) : source(source), sink(sink) {}
+
+protected:
+    int_type underflow() override;
+
+private:
+    streambuf* source;
+    string& sink;
+    string line;
+};
+
+// Records a run's external inputs, or feeds them back for a replay:
+//   file  = "SRRP" version seed, console text, events
+//   event = varint tick delta, kind byte, varint value
+// With the seed (see simrandom.h), the console answers and the per-tick
+// inputs, a replay takes the same decisions and reaches the same world state,
+// which the recorded digests check at the end of every ride window. Replays
+// run headless, as fast as the simulation steps.
+class InputRecorder
+{
+public:
+    InputRecorder();
+    ~InputRecorder(); // Writes the recording
+
+    // Starts teeing the console; the file is written by finish()
+    bool record(const string& path, uint64_t seed);
+
+    // Loads a recording and makes it the console input
+    bool replay(const string& path, string& error);
+
+    bool isRecording() const { return recording; }
+    bool isReplaying() const { return replaying; }
+    uint64_t getSeed() const { return seed; }
+
+    // Cars to add this tick: the live request when recording, the recorded
+    // one when replaying
+    int addCars(int requested);
+
+    // Replay only: the recorded window closes at this tick
+    bool closeDue() const;
+
+    // End of a ride window. Records the digest, or checks it on replay.
+    void windowClosed(uint32_t digest);
+
+    void endTick() { tick++; }
+
+    void finish();
+
+    InputRecorder(const InputRecorder&) = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+
+private:
+    const InputEvent* pendingEvent(InputKind kind) const;
+
+    bool recording;
+    bool replaying;
+    string path;
+    uint64_t seed;
+    uint64_t tick;
+
+    string console;
+    vector<InputEvent> events;
+    size_t nextEvent;          // Replay cursor into events
+
+    streambuf* originalConsole;
+    unique_ptr<streambuf> consoleBuffer;
+
+    int checkpoints;
+    int mismatches;
+    chrono::steady_clock::time_point startedAt;
+};
+
+// Checksum of the simulation state (graph occupancy, signals, vehicles,
+// drivers), taken through the snapshot encoder
+uint32_t worldDigest(const WorldRefs& world);
+
+#endif
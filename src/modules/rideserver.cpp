@@ -0,0 +1,1134 @@
+#include "rideserver.h"
+#include "matching.h"
+#include "metrics.h"
+#include "quietconsole.h"
+#include "routecache.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+static atomic<bool> stopRequested{ false };
+
+ServerConfig ServerConfig::fromArgs(int argc, char** argv)
+{
+    ServerConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--port" && hasValue)
+            config.port = atoi(argv[++i]);
+        else if (arg == "--fleet" && hasValue)
+            config.fleetSize = max(1, atoi(argv[++i]));
+        else if (arg == "--tick-rate" && hasValue)
+            config.tickRate = max(1.0, atof(argv[++i]));
+        else if (arg == "--max-wait" && hasValue)
+            config.maxWait = max(0.0, atof(argv[++i]));
+        else if (arg == "--duration" && hasValue)
+            config.duration = atof(argv[++i]);
+        else if (arg == "--max-connections" && hasValue)
+            config.maxConnections = max(1, atoi(argv[++i]));
+        else if (arg == "--users" && hasValue)
+            config.usersPath = argv[++i];
+        else if (arg == "--seed" && hasValue)
+            config.seed = strtoull(argv[++i], nullptr, 10);
+    }
+    return config;
+}
+
+const char* ridePhaseName(RidePhase phase)
+{
+    static const char* names[] = { "requested", "unmatched", "to_pickup", "on_trip", "completed" };
+    return names[static_cast<int>(phase)];
+}
+
+// Simulation
+
+static const double tickSeconds = 1.0 / 60; // Simulated time per tick, as in the window and the load test
+
+RideSimulation::RideSimulation(const vector<Node*>& nodes, const ServerConfig& config) : nodes(nodes), config(config)
+{
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+RideSimulation::~RideSimulation()
+{
+    stop();
+    for (FleetMember& member : fleet)
+    {
+        if (member.driver->assignedVehicle)
+        {
+            member.driver->assignedVehicle->leaveEdge();
+        }
+        delete member.driver->assignedVehicle;
+        delete member.driver;
+    }
+    if (wakeFd >= 0)
+    {
+        close(wakeFd);
+    }
+}
+
+void RideSimulation::createFleet()
+{
+    mt19937_64 random(config.seed);
+    uniform_int_distribution<size_t> uniform(0, nodes.size() - 1);
+    surge.attach(nodes);
+    for (int i = 0; i < config.fleetSize; i++)
+    {
+        string type = vehicleClassName(static_cast<VehicleClass>(i % 4)); // Rickshaw, car, bike, bus as in the menu
+        Node* start = nodes[uniform(random)];
+        Driver* driver = new Driver(30, "Driver " + to_string(i + 1), "driver" + to_string(i + 1) + "@server", true, "", "", 1, type, start);
+        driver->assignedVehicle = new Vehicle(i + 1, type, start, start, {}); // Parked, no path
+        fleetByClass.add(driver);
+        memberOf[driver] = fleet.size();
+
+        FleetMember member;
+        member.driver = driver;
+        member.idleAt = start;
+        fleet.push_back(member);
+        surge.driverIdle(start);
+    }
+}
+
+bool RideSimulation::start()
+{
+    if (running || wakeFd < 0 || nodes.empty())
+    {
+        return running;
+    }
+    createFleet();
+    running = true;
+    worker = thread(&RideSimulation::run, this);
+    return true;
+}
+
+void RideSimulation::stop()
+{
+    if (running.exchange(false))
+    {
+        worker.join();
+    }
+}
+
+void RideSimulation::submit(RideCommand command)
+{
+    lock_guard<mutex> guard(lock);
+    commands.push_back(move(command));
+}
+
+void RideSimulation::takeUpdates(vector<RideUpdate>& out)
+{
+    uint64_t drained;
+    if (read(wakeFd, &drained, sizeof(drained)) < 0 && errno != EAGAIN)
+    {
+        return;
+    }
+    lock_guard<mutex> guard(lock);
+    out.swap(updates);
+}
+
+void RideSimulation::publish(const RideUpdate& update)
+{
+    outgoing.push_back(update);
+}
+
+void RideSimulation::publish(const FleetMember& member)
+{
+    RideUpdate update;
+    update.rideId = member.rideId;
+    update.phase = member.phase;
+    update.driverName = member.driver->name;
+    update.vehicleClass = member.driver->vehicleClass;
+    update.x = member.driver->assignedVehicle ? member.driver->assignedVehicle->x : 0;
+    update.y = member.driver->assignedVehicle ? member.driver->assignedVehicle->y : 0;
+    update.quote = member.quote.fare;
+    update.surge = member.quote.multiplier;
+    update.eta = member.phase >= RidePhase::OnTrip ? member.pickedUpAt - member.acceptedAt : -1;
+    publish(update);
+}
+
+void RideSimulation::handle(RideCommand& command)
+{
+    if (command.kind == RideCommand::Kind::Rate)
+    {
+        auto member = memberOfRide.find(command.rideId);
+        if (member != memberOfRide.end())
+        {
+            fleet[member->second].driver->takeRating(command.rating);
+            memberOfRide.erase(member);
+        }
+        return;
+    }
+
+    Node* origin = command.rider.currentLocation;
+    surge.requestOpened(origin);
+    FareQuote quote = surge.quote(origin, command.rider.goalLocation, command.vehicleClass);
+    PendingRide ride{ move(command), quote, now };
+    if (!tryMatch(ride))
+    {
+        RideUpdate update;
+        update.rideId = ride.command.rideId;
+        update.vehicleClass = ride.command.vehicleClass;
+        update.quote = ride.quote.fare;
+        update.surge = ride.quote.multiplier;
+        publish(update);
+        pending.push_back(move(ride));
+    }
+}
+
+// Same path as the load test: nearest free driver of the class, who plans
+// the pickup route on acceptance
+bool RideSimulation::tryMatch(PendingRide& ride)
+{
+    const User& rider = ride.command.rider;
+    Driver* driver = findNearestDriver(rider.currentLocation, fleetByClass.of(ride.command.vehicleClass), ride.command.vehicleClass);
+    Vehicle* parked = driver ? driver->assignedVehicle : nullptr;
+    Vehicle* vehicle = driver ? driver->acceptRide(rider) : nullptr;
+    if (!vehicle)
+    {
+        return false;
+    }
+    vehicle->speed = parked->speed;
+    parked->leaveEdge();
+    delete parked;
+    surge.requestClosed(rider.currentLocation);
+
+    FleetMember& member = fleet[memberOf[driver]];
+    member.phase = RidePhase::ToPickup;
+    member.rideId = ride.command.rideId;
+    member.rider = rider;
+    member.quote = ride.quote;
+    member.acceptedAt = now;
+    surge.driverBusy(member.idleAt);
+    member.idleAt = nullptr;
+    memberOfRide[member.rideId] = memberOf[driver];
+    publish(member);
+    return true;
+}
+
+void RideSimulation::advanceFleet()
+{
+    for (FleetMember& member : fleet)
+    {
+        if (member.phase != RidePhase::ToPickup && member.phase != RidePhase::OnTrip)
+        {
+            continue;
+        }
+        Driver* driver = member.driver;
+        Vehicle* vehicle = driver->assignedVehicle;
+        bool arrived = vehicle->moveVehicle() || (!vehicle->currentEdge && vehicle->path.empty());
+        if (!arrived)
+        {
+            continue;
+        }
+
+        driver->currentNode = vehicle->currentNode;
+        if (member.phase == RidePhase::ToPickup)
+        {
+            member.pickedUpAt = now;
+            Vehicle* trip = new Vehicle(vehicle->id, driver->vehicleType, member.rider.currentLocation, member.rider.goalLocation,
+                                        routeCache.findRoute(member.rider.currentLocation, member.rider.goalLocation));
+            trip->speed = vehicle->speed;
+            delete vehicle;
+            driver->assignedVehicle = trip;
+            member.phase = RidePhase::OnTrip;
+            publish(member);
+        }
+        else
+        {
+            member.phase = RidePhase::Completed;
+            publish(member);
+            outgoing.back().fare = surge.fare(member.quote, vehicle->odometer, now - member.pickedUpAt, driver->vehicleClass);
+            driver->availability = true;
+            member.idleAt = vehicle->currentNode;
+            surge.driverIdle(member.idleAt);
+            driverFreed = true;
+        }
+    }
+}
+
+void RideSimulation::run()
+{
+    QuietConsole quiet; // Matching and routing print for the console flow
+    auto period = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1.0 / config.tickRate));
+    auto next = chrono::steady_clock::now();
+    long long positionTicks = 30; // Vehicles on the way report twice a simulated second
+    vector<RideCommand> work;
+    while (running.load(memory_order_relaxed))
+    {
+        auto started = chrono::steady_clock::now();
+        {
+            lock_guard<mutex> guard(lock);
+            work.swap(commands);
+        }
+        for (RideCommand& command : work)
+        {
+            handle(command);
+        }
+        work.clear();
+
+        surge.advance(tickSeconds);
+        advanceFleet();
+
+        // Waiting requests retry when a driver frees up and give up after maxWait
+        size_t kept = 0;
+        for (size_t i = 0; i < pending.size(); i++)
+        {
+            PendingRide& ride = pending[i];
+            if (driverFreed && tryMatch(ride))
+            {
+                continue;
+            }
+            if (now - ride.requestedAt >= config.maxWait)
+            {
+                surge.requestClosed(ride.command.rider.currentLocation);
+                RideUpdate update;
+                update.rideId = ride.command.rideId;
+                update.phase = RidePhase::Unmatched;
+                update.vehicleClass = ride.command.vehicleClass;
+                publish(update);
+                continue;
+            }
+            if (kept != i)
+            {
+                pending[kept] = move(ride);
+            }
+            kept++;
+        }
+        pending.resize(kept);
+        driverFreed = false;
+
+        uint64_t tick = ticks.fetch_add(1, memory_order_relaxed) + 1;
+        if (tick % positionTicks == 0)
+        {
+            for (const FleetMember& member : fleet)
+            {
+                if (member.phase == RidePhase::ToPickup || member.phase == RidePhase::OnTrip)
+                {
+                    publish(member);
+                }
+            }
+        }
+        now += tickSeconds;
+
+        if (!outgoing.empty())
+        {
+            {
+                lock_guard<mutex> guard(lock);
+                if (updates.empty())
+                {
+                    updates.swap(outgoing);
+                }
+                else
+                {
+                    move(outgoing.begin(), outgoing.end(), back_inserter(updates));
+                }
+            }
+            outgoing.clear();
+            uint64_t one = 1;
+            ssize_t written = write(wakeFd, &one, sizeof(one));
+            (void)written; // A full counter still wakes the server
+        }
+
+        auto finished = chrono::steady_clock::now();
+        tickLatency.record(chrono::duration_cast<chrono::nanoseconds>(finished - started).count());
+        next += period;
+        if (finished > next + period * 4)
+        {
+            overruns.fetch_add(1, memory_order_relaxed); // Far behind: drop the backlog rather than burst
+            next = finished;
+        }
+        this_thread::sleep_until(next);
+    }
+}
+
+// HTTP
+
+static const char* statusText(int status)
+{
+    switch (status)
+    {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 202: return "Accepted";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 413: return "Payload Too Large";
+    default: return "Internal Server Error";
+    }
+}
+
+static void appendResponse(string& out, int status, const string& body, bool keepAlive)
+{
+    char header[160];
+    int length = snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n%s\r\n",
+                          status, statusText(status), body.size(), keepAlive ? "" : "Connection: close\r\n");
+    out.append(header, length);
+    out.append(body);
+}
+
+static bool headerIs(const char* at, size_t length, const char* name)
+{
+    size_t nameLength = strlen(name);
+    return length == nameLength && strncasecmp(at, name, nameLength) == 0;
+}
+
+static json errorBody(const char* message)
+{
+    return json{ { "error", message } };
+}
+
+// Reads an optional string field; false when it is present with another type
+static bool stringField(const json& body, const char* key, const char* fallback, string& out)
+{
+    auto field = body.find(key);
+    if (field == body.end())
+    {
+        out = fallback;
+        return true;
+    }
+    if (!field->is_string())
+    {
+        return false;
+    }
+    out = field->get<string>();
+    return true;
+}
+
+RideServer::RideServer(const vector<Node*>& nodes, ServerConfig config) : nodes(nodes), config(config), simulation(nodes, config)
+{
+    random_device entropy;
+    tokenState = (static_cast<uint64_t>(entropy()) << 32) ^ entropy() ^ static_cast<uint64_t>(chrono::steady_clock::now().time_since_epoch().count());
+    for (Node* node : nodes)
+    {
+        nodeById[node->id] = node;
+    }
+}
+
+RideServer::~RideServer()
+{
+    for (size_t fd = 0; fd < connections.size(); fd++)
+    {
+        if (connections[fd].open)
+        {
+            close(static_cast<int>(fd));
+        }
+    }
+    if (listenFd >= 0)
+    {
+        close(listenFd);
+    }
+    if (epollFd >= 0)
+    {
+        close(epollFd);
+    }
+}
+
+void RideServer::requestStop()
+{
+    stopRequested = true;
+}
+
+bool RideServer::start()
+{
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int on = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(config.port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, SOMAXCONN) != 0)
+    {
+        LOG_ERROR("Cannot listen on 127.0.0.1:%d: %s", config.port, strerror(errno));
+        return false;
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.fd = simulation.getWakeFd();
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, simulation.getWakeFd(), &event);
+
+    loadUsers();
+    return simulation.start();
+}
+
+void RideServer::acceptAll()
+{
+    for (;;)
+    {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return; // EAGAIN: backlog drained; anything else is retried on the next wakeup
+        }
+        if (stats.open >= config.maxConnections)
+        {
+            stats.rejected++;
+            close(fd);
+            continue;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        if (static_cast<size_t>(fd) >= connections.size())
+        {
+            connections.resize(fd + 1);
+        }
+        connections[fd] = Connection();
+        connections[fd].open = true;
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        stats.accepted++;
+        stats.peakOpen = max(stats.peakOpen, ++stats.open);
+    }
+}
+
+void RideServer::closeConnection(int fd)
+{
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections[fd] = Connection(); // Frees the buffers
+    stats.open--;
+}
+
+void RideServer::onReadable(int fd)
+{
+    Connection& connection = connections[fd];
+    char buffer[16384];
+    for (;;)
+    {
+        ssize_t got = recv(fd, buffer, sizeof(buffer), 0);
+        if (got > 0)
+        {
+            connection.in.append(buffer, got);
+            if (connection.in.size() > config.maxRequestBytes * 4)
+            {
+                closeConnection(fd); // Pipelining far ahead of the responses
+                return;
+            }
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        // Peer closed (or failed): answer what is complete, then go
+        connection.closeAfterWrite = true;
+        break;
+    }
+    handleInput(fd);
+    if (connections[fd].open && flushOutput(fd) && connections[fd].closeAfterWrite)
+    {
+        closeConnection(fd);
+    }
+}
+
+void RideServer::onWritable(int fd)
+{
+    if (flushOutput(fd) && connections[fd].closeAfterWrite)
+    {
+        closeConnection(fd);
+    }
+}
+
+// Sends what the socket takes; true once everything is out
+bool RideServer::flushOutput(int fd)
+{
+    Connection& connection = connections[fd];
+    while (connection.sent < connection.out.size())
+    {
+        ssize_t written = send(fd, connection.out.data() + connection.sent, connection.out.size() - connection.sent, MSG_NOSIGNAL);
+        if (written > 0)
+        {
+            connection.sent += written;
+            continue;
+        }
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            if (!connection.writing)
+            {
+                epoll_event event{};
+                event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+                event.data.fd = fd;
+                epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+                connection.writing = true;
+            }
+            return false;
+        }
+        connection.closeAfterWrite = true; // Peer gone
+        connection.out.clear();
+        connection.sent = 0;
+        return true;
+    }
+    connection.out.clear();
+    connection.sent = 0;
+    if (connection.writing)
+    {
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+        connection.writing = false;
+    }
+    return true;
+}
+
+// Answers every complete request in the input buffer, in order
+void RideServer::handleInput(int fd)
+{
+    Connection& connection = connections[fd];
+    size_t consumed = 0;
+    for (;;)
+    {
+        size_t headerEnd = connection.in.find("\r\n\r\n", consumed);
+        if (headerEnd == string::npos)
+        {
+            if (connection.in.size() - consumed > config.maxRequestBytes)
+            {
+                appendResponse(connection.out, 413, errorBody("request too large").dump(), false);
+                connection.closeAfterWrite = true;
+                consumed = connection.in.size();
+            }
+            break;
+        }
+
+        auto started = chrono::steady_clock::now();
+        Request request;
+        const char* at = connection.in.data() + consumed;
+        const char* end = connection.in.data() + headerEnd;
+        const char* lineEnd = static_cast<const char*>(memchr(at, '\r', end - at));
+        lineEnd = lineEnd ? lineEnd : end;
+        const char* space = static_cast<const char*>(memchr(at, ' ', lineEnd - at));
+        const char* pathEnd = space ? static_cast<const char*>(memchr(space + 1, ' ', lineEnd - space - 1)) : nullptr;
+        bool valid = space && pathEnd;
+        if (valid)
+        {
+            request.method.assign(at, space);
+            request.path.assign(space + 1, pathEnd);
+            request.path = request.path.substr(0, request.path.find('?'));
+            request.keepAlive = !(lineEnd - pathEnd >= 9 && strncmp(pathEnd + 1, "HTTP/1.0", 8) == 0);
+        }
+
+        size_t contentLength = 0;
+        for (const char* line = lineEnd + 2; line < end;)
+        {
+            const char* next = static_cast<const char*>(memchr(line, '\r', end - line));
+            next = next ? next : end;
+            const char* colon = static_cast<const char*>(memchr(line, ':', next - line));
+            if (colon)
+            {
+                const char* value = colon + 1;
+                while (value < next && *value == ' ')
+                {
+                    value++;
+                }
+                size_t nameLength = colon - line;
+                if (headerIs(line, nameLength, "content-length"))
+                {
+                    contentLength = strtoul(string(value, next).c_str(), nullptr, 10);
+                }
+                else if (headerIs(line, nameLength, "authorization") && next - value > 7 && strncasecmp(value, "Bearer ", 7) == 0)
+                {
+                    request.token.assign(value + 7, next);
+                }
+                else if (headerIs(line, nameLength, "connection"))
+                {
+                    string option(value, next);
+                    request.keepAlive = strncasecmp(option.c_str(), "close", 5) != 0 &&
+                                        (request.keepAlive || strncasecmp(option.c_str(), "keep-alive", 10) == 0);
+                }
+            }
+            line = next + 2;
+        }
+
+        size_t bodyStart = headerEnd + 4;
+        bool tooLarge = contentLength > config.maxRequestBytes;
+        contentLength = tooLarge ? 0 : contentLength;
+        if (connection.in.size() - bodyStart < contentLength)
+        {
+            break; // Body still arriving
+        }
+        request.body.assign(connection.in, bodyStart, contentLength);
+        consumed = bodyStart + contentLength;
+
+        Response response;
+        if (valid && !tooLarge)
+        {
+            // A handler that still trips over a body must not take the server down
+            try
+            {
+                dispatch(request, response);
+            }
+            catch (const json::exception&)
+            {
+                response = Response{ 400, errorBody("malformed request body").dump() };
+            }
+        }
+        else
+        {
+            // The rest of the stream cannot be framed any more
+            response = Response{ tooLarge ? 413 : 400, errorBody(tooLarge ? "request too large" : "malformed request").dump() };
+            request.keepAlive = false;
+        }
+        stats.requests++;
+        stats.errors += response.status >= 400;
+        appendResponse(connection.out, response.status, response.body, request.keepAlive);
+        if (!request.keepAlive)
+        {
+            connection.closeAfterWrite = true;
+            consumed = connection.in.size();
+        }
+        requestLatency.record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count());
+    }
+    connection.in.erase(0, consumed);
+}
+
+// Endpoints
+
+void RideServer::dispatch(const Request& request, Response& response)
+{
+    const string& path = request.path;
+    bool post = request.method == "POST";
+    bool get = request.method == "GET";
+    if (path == "/register" || path == "/signin" || path == "/rides")
+    {
+        if (!post)
+            response = Response{ 405, errorBody("use POST").dump() };
+        else if (path == "/register")
+            registerUser(request, response);
+        else if (path == "/signin")
+            signIn(request, response);
+        else
+            requestRide(request, response);
+        return;
+    }
+    if (path == "/stats")
+    {
+        serverStatus(response);
+        return;
+    }
+    if (path.compare(0, 7, "/rides/") == 0)
+    {
+        char* idEnd = nullptr;
+        unsigned long rideId = strtoul(path.c_str() + 7, &idEnd, 10);
+        string rest = idEnd;
+        if (rideId > 0 && rest.empty() && get)
+        {
+            rideStatus(static_cast<uint32_t>(rideId), request, response);
+            return;
+        }
+        if (rideId > 0 && rest == "/rating" && post)
+        {
+            rateRide(static_cast<uint32_t>(rideId), request, response);
+            return;
+        }
+    }
+    response = Response{ 404, errorBody("no such endpoint").dump() };
+}
+
+const string* RideServer::userOf(const Request& request) const
+{
+    auto session = sessions.find(request.token);
+    return request.token.empty() || session == sessions.end() ? nullptr : &session->second;
+}
+
+void RideServer::registerUser(const Request& request, Response& response)
+{
+    stats.registered++;
+    json body = json::parse(request.body, nullptr, false);
+    if (body.is_discarded() || !body.is_object() || !body.contains("email") || !body["email"].is_string() || body["email"].get<string>().empty())
+    {
+        response = Response{ 400, errorBody("email required").dump() };
+        return;
+    }
+    string email = body["email"];
+    if (users.count(email))
+    {
+        response = Response{ 409, errorBody("already registered").dump() };
+        return;
+    }
+    string gender, name, phone;
+    if (!stringField(body, "gender", "M", gender) || !stringField(body, "name", "", name) || !stringField(body, "phone", "", phone) ||
+        (body.contains("age") && !body["age"].is_number_integer()))
+    {
+        response = Response{ 400, errorBody("name, gender and phone must be strings, age an integer").dump() };
+        return;
+    }
+    int age = body.contains("age") ? body["age"].get<int>() : 0;
+    users.emplace(email, User(age, name, email, gender != "F" && gender != "f", phone));
+    usersDirty = true;
+    response = Response{ 201, json{ { "email", email } }.dump() };
+}
+
+void RideServer::signIn(const Request& request, Response& response)
+{
+    stats.signIns++;
+    json body = json::parse(request.body, nullptr, false);
+    string email = !body.is_discarded() && body.is_object() && body.contains("email") && body["email"].is_string() ? body["email"].get<string>() : "";
+    auto user = users.find(email);
+    if (user == users.end())
+    {
+        response = Response{ 404, errorBody("user not found, register first").dump() };
+        return;
+    }
+    // splitmix64: sessions only need to be unguessable to other local clients
+    char token[33];
+    uint64_t words[2];
+    for (uint64_t& word : words)
+    {
+        uint64_t z = (tokenState += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        word = z ^ (z >> 31);
+    }
+    snprintf(token, sizeof(token), "%016llx%016llx", static_cast<unsigned long long>(words[0]), static_cast<unsigned long long>(words[1]));
+    sessions[token] = email;
+    response = Response{ 200, json{ { "token", token }, { "name", user->second.name } }.dump() };
+}
+
+void RideServer::requestRide(const Request& request, Response& response)
+{
+    stats.rideRequests++;
+    const string* email = userOf(request);
+    if (!email)
+    {
+        response = Response{ 401, errorBody("sign in first").dump() };
+        return;
+    }
+    json body = json::parse(request.body, nullptr, false);
+    auto nodeOf = [&](const char* key) -> Node* {
+        if (body.is_discarded() || !body.is_object() || !body.contains(key) || !body[key].is_number_integer())
+        {
+            return nullptr;
+        }
+        auto found = nodeById.find(body[key].get<int>());
+        return found != nodeById.end() ? found->second : nullptr;
+    };
+    Node* from = nodeOf("from");
+    Node* to = nodeOf("to");
+    if (!from || !to || from == to)
+    {
+        response = Response{ 400, errorBody("from and to must be the ids of two different nodes of the map").dump() };
+        return;
+    }
+    bool known = false;
+    string vehicle;
+    VehicleClass vehicleClass = VehicleClass::Car;
+    if (stringField(body, "vehicle", "Car", vehicle))
+    {
+        vehicleClass = vehicleClassOf(vehicle, &known);
+    }
+    if (!known)
+    {
+        response = Response{ 400, errorBody("vehicle must be Rickshaw, Car, Bike or Bus").dump() };
+        return;
+    }
+    if (activeRide.count(*email))
+    {
+        response = Response{ 409, json{ { "error", "a ride is already in progress" }, { "ride", activeRide[*email] } }.dump() };
+        return;
+    }
+
+    User& user = users[*email];
+    RideCommand command;
+    command.rideId = ++lastRide;
+    command.rider = user;
+    command.rider.requestRide(from, to);
+    command.vehicleClass = vehicleClass;
+    user.setRideState(RideState::Requested);
+    simulation.submit(move(command));
+
+    RideRecord& record = rides[lastRide];
+    record.email = *email;
+    record.latest.rideId = lastRide;
+    record.latest.vehicleClass = vehicleClass;
+    activeRide[*email] = lastRide;
+    response = Response{ 202, json{ { "ride", lastRide }, { "state", ridePhaseName(RidePhase::Requested) } }.dump() };
+}
+
+void RideServer::rideStatus(uint32_t rideId, const Request& request, Response& response)
+{
+    stats.statusQueries++;
+    const string* email = userOf(request);
+    auto ride = rides.find(rideId);
+    if (!email)
+    {
+        response = Response{ 401, errorBody("sign in first").dump() };
+        return;
+    }
+    if (ride == rides.end() || ride->second.email != *email)
+    {
+        response = Response{ 404, errorBody("no such ride").dump() };
+        return;
+    }
+    const RideUpdate& latest = ride->second.latest;
+    json body = { { "ride", rideId }, { "state", ridePhaseName(latest.phase) }, { "vehicle", vehicleClassName(latest.vehicleClass) },
+                  { "quote", latest.quote }, { "surge", latest.surge } };
+    if (latest.phase >= RidePhase::ToPickup)
+    {
+        body["driver"] = latest.driverName;
+        body["position"] = { latest.x, latest.y };
+    }
+    if (latest.eta >= 0)
+    {
+        body["pickup_seconds"] = latest.eta;
+    }
+    if (latest.phase == RidePhase::Completed)
+    {
+        body["fare"] = latest.fare;
+        body["rated"] = ride->second.rated;
+    }
+    response = Response{ 200, body.dump() };
+}
+
+void RideServer::rateRide(uint32_t rideId, const Request& request, Response& response)
+{
+    stats.ratings++;
+    const string* email = userOf(request);
+    auto ride = rides.find(rideId);
+    json body = json::parse(request.body, nullptr, false);
+    if (!email)
+    {
+        response = Response{ 401, errorBody("sign in first").dump() };
+        return;
+    }
+    if (ride == rides.end() || ride->second.email != *email)
+    {
+        response = Response{ 404, errorBody("no such ride").dump() };
+        return;
+    }
+    if (body.is_discarded() || !body.is_object() || !body.contains("rating") || !body["rating"].is_number() ||
+        body["rating"].get<double>() < 0 || body["rating"].get<double>() > 5)
+    {
+        response = Response{ 400, errorBody("rating must be between 0 and 5").dump() };
+        return;
+    }
+    if (ride->second.latest.phase != RidePhase::Completed || ride->second.rated)
+    {
+        response = Response{ 409, errorBody(ride->second.rated ? "already rated" : "ride not completed").dump() };
+        return;
+    }
+    ride->second.rated = true;
+    RideCommand command;
+    command.kind = RideCommand::Kind::Rate;
+    command.rideId = rideId;
+    command.rating = body["rating"].get<float>();
+    simulation.submit(move(command));
+    response = Response{ 200, json{ { "ride", rideId }, { "rated", true } }.dump() };
+}
+
+void RideServer::serverStatus(Response& response)
+{
+    json body = { { "connections", stats.open },     { "requests", stats.requests }, { "users", users.size() },
+                  { "rides", rides.size() },         { "active_rides", activeRide.size() },
+                  { "ticks", simulation.getTicks() }, { "tick_overruns", simulation.getOverruns() } };
+    response = Response{ 200, body.dump() };
+}
+
+// Folds the simulation's ride changes into the table the endpoints read
+void RideServer::applyUpdates()
+{
+    simulation.takeUpdates(incoming);
+    for (RideUpdate& update : incoming)
+    {
+        auto ride = rides.find(update.rideId);
+        if (ride == rides.end())
+        {
+            continue;
+        }
+        ride->second.latest = move(update);
+        RidePhase phase = ride->second.latest.phase;
+        if (phase == RidePhase::Completed || phase == RidePhase::Unmatched)
+        {
+            activeRide.erase(ride->second.email);
+            auto user = users.find(ride->second.email);
+            if (user != users.end())
+            {
+                user->second.setRideState(RideState::None);
+            }
+        }
+    }
+    incoming.clear();
+}
+
+// users.json as User::saveUser writes it, keyed by email
+
+void RideServer::loadUsers()
+{
+    ifstream file(config.usersPath);
+    if (!file.is_open() || file.peek() == ifstream::traits_type::eof())
+    {
+        return;
+    }
+    json stored = json::parse(file, nullptr, false);
+    if (stored.is_discarded() || !stored.is_object())
+    {
+        LOG_WARN("%s is not a user table, starting without users", config.usersPath.c_str());
+        return;
+    }
+    for (auto& item : stored.items())
+    {
+        const json& fields = item.value();
+        users.emplace(item.key(), User(fields.value("age", 0), fields.value("name", ""), item.key(), fields.value("gender", false), fields.value("phone", "")));
+    }
+}
+
+void RideServer::saveUsers()
+{
+    METRIC_SCOPE(Metric::PersistenceSave);
+    json stored = json::object();
+    for (const auto& entry : users)
+    {
+        const User& user = entry.second;
+        stored[user.email] = { { "name", user.name }, { "gender", user.gender }, { "phone", user.phoneNumber }, { "age", user.age } };
+    }
+    string temporary = config.usersPath + ".tmp";
+    ofstream file(temporary);
+    if (!file.is_open())
+    {
+        LOG_ERROR("Error opening %s for writing.", temporary.c_str());
+        return;
+    }
+    file << stored.dump(4) << endl;
+    file.close();
+    if (rename(temporary.c_str(), config.usersPath.c_str()) != 0)
+    {
+        LOG_ERROR("Error replacing %s", config.usersPath.c_str());
+        return;
+    }
+    usersDirty = false;
+}
+
+void RideServer::run()
+{
+    const int maxEvents = 512;
+    epoll_event events[maxEvents];
+    auto started = chrono::steady_clock::now();
+    auto nextFlush = started + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(config.flushSeconds));
+    while (!stopRequested)
+    {
+        int ready = epoll_wait(epollFd, events, maxEvents, 200);
+        if (ready < 0 && errno != EINTR)
+        {
+            LOG_ERROR("epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+        for (int e = 0; e < ready; e++)
+        {
+            int fd = events[e].data.fd;
+            if (fd == listenFd)
+            {
+                acceptAll();
+            }
+            else if (fd == simulation.getWakeFd())
+            {
+                applyUpdates();
+            }
+            else if (static_cast<size_t>(fd) < connections.size() && connections[fd].open)
+            {
+                if (events[e].events & (EPOLLERR | EPOLLHUP))
+                {
+                    closeConnection(fd);
+                    continue;
+                }
+                if (events[e].events & EPOLLOUT)
+                {
+                    onWritable(fd);
+                }
+                if (connections[fd].open && (events[e].events & (EPOLLIN | EPOLLRDHUP)))
+                {
+                    onReadable(fd);
+                }
+            }
+        }
+
+        auto now = chrono::steady_clock::now();
+        if (usersDirty && now >= nextFlush)
+        {
+            saveUsers();
+            nextFlush = now + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(config.flushSeconds));
+        }
+        if (config.duration > 0 && chrono::duration<double>(now - started).count() >= config.duration)
+        {
+            break;
+        }
+    }
+    simulation.stop();
+    applyUpdates();
+    if (usersDirty)
+    {
+        saveUsers();
+    }
+}
+
+static void onStopSignal(int)
+{
+    RideServer::requestStop();
+}
+
+int runServer(int argc, char** argv, const vector<Node*>& nodes)
+{
+    ServerConfig config = ServerConfig::fromArgs(argc, argv);
+    RideServer server(nodes, config);
+    if (!server.start())
+    {
+        cerr << "Cannot start the server on port " << config.port << endl;
+        return 1;
+    }
+    signal(SIGINT, onStopSignal);
+    signal(SIGTERM, onStopSignal);
+    cout << "Serving on http://127.0.0.1:" << config.port << " with a fleet of " << config.fleetSize << ", ticking "
+         << config.tickRate << " times a second" << endl;
+
+    auto started = chrono::steady_clock::now();
+    server.run();
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+    ServerStats stats = server.getStats();
+    cout << "-----------------------------------" << endl;
+    cout << "Connections: " << stats.accepted << " accepted, peak " << stats.peakOpen << " open, " << stats.rejected << " rejected" << endl;
+    cout << "Requests: " << stats.requests << " in " << wallSeconds << " s (" << stats.requests / max(wallSeconds, 1e-9) << "/s), "
+         << stats.errors << " errors" << endl;
+    cout << "  register " << stats.registered << ", sign in " << stats.signIns << ", ride " << stats.rideRequests << ", status "
+         << stats.statusQueries << ", rating " << stats.ratings << endl;
+    cout << "Handling: " << server.requestLatency.summary() << endl;
+    const RideSimulation& simulation = server.getSimulation();
+    cout << "Simulation: " << simulation.getTicks() << " ticks (" << simulation.getTicks() / max(wallSeconds, 1e-9) << "/s), "
+         << simulation.getOverruns() << " overruns, tick " << simulation.tickLatency.summary() << endl;
+    cout << "-----------------------------------" << endl;
+    return 0;
+}
@@ -0,0 +1,268 @@
+#ifndef RIDESERVER_H
+#define RIDESERVER_H
+
+#include "driver.h"
+#include "histogram.h"
+#include "pricing.h"
+#include "user.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+struct ServerConfig
+{
+    int port = 8080;               // Bound on 127.0.0.1 only
+    int fleetSize = 50;            // Simulated drivers, vehicle types spread evenly
+    double tickRate = 60;          // Simulation ticks per wall second, each 1/60 s of driving
+    double maxWait = 60;           // Simulated seconds a request waits for a free driver
+    double duration = 0;           // Wall seconds to serve, 0 until SIGINT/SIGTERM
+    size_t maxConnections = 16384;
+    size_t maxRequestBytes = 65536; // Headers plus body
+    double flushSeconds = 5;       // Registered users are written to usersPath this often
+    string usersPath = "users.json";
+    unsigned long long seed = 42;
+
+    // Parse --port, --fleet, --tick-rate, --max-wait, --duration,
+    // --max-connections, --users and --seed
+    static ServerConfig fromArgs(int argc, char** argv);
+};
+
+enum class RidePhase : uint8_t
+{
+    Requested, // Waiting for a free driver
+    Unmatched, // No driver within maxWait
+    ToPickup,
+    OnTrip,
+    Completed
+};
+
+const char* ridePhaseName(RidePhase phase);
+
+// What the simulation reports about a ride; the server keeps the latest
+struct RideUpdate
+{
+    uint32_t rideId = 0;
+    RidePhase phase = RidePhase::Requested;
+    string driverName;   // Set from acceptance on
+    VehicleClass vehicleClass = VehicleClass::Car;
+    float x = 0, y = 0;  // Vehicle position while it is on the way
+    float quote = 0;     // Estimated fare at request time
+    float surge = 1;
+    float fare = 0;      // Charged on completion
+    double eta = -1;     // Simulated seconds from acceptance to pickup, once picked up
+};
+
+// A request or rating from the server to the simulation
+struct RideCommand
+{
+    enum class Kind : uint8_t { Request, Rate } kind = Kind::Request;
+    uint32_t rideId = 0;
+    User rider;           // Request: location and goal already set
+    VehicleClass vehicleClass = VehicleClass::Car;
+    float rating = 0;     // Rate
+};
+
+// Simulated fleet on its own thread, ticking at a fixed rate whatever the
+// server is doing. Commands queue up between ticks and are handled at the
+// start of the next one; ride changes are handed back in bulk, and the
+// server is woken through an eventfd.
+class RideSimulation
+{
+public:
+    RideSimulation(const vector<Node*>& nodes, const ServerConfig& config);
+    ~RideSimulation();
+
+    bool start();
+    void stop();
+
+    // Server thread
+    void submit(RideCommand command);
+    void takeUpdates(vector<RideUpdate>& out);
+    int getWakeFd() const { return wakeFd; }
+
+    uint64_t getTicks() const { return ticks.load(memory_order_relaxed); }
+    uint64_t getOverruns() const { return overruns.load(memory_order_relaxed); }
+    LatencyHistogram tickLatency;
+
+    RideSimulation(const RideSimulation&) = delete;
+    RideSimulation& operator=(const RideSimulation&) = delete;
+
+private:
+    struct FleetMember
+    {
+        Driver* driver;
+        RidePhase phase = RidePhase::Completed; // Completed: idle
+        uint32_t rideId = 0;
+        User rider;
+        FareQuote quote;
+        Node* idleAt = nullptr;
+        double acceptedAt = 0;
+        double pickedUpAt = 0;
+    };
+
+    struct PendingRide
+    {
+        RideCommand command;
+        FareQuote quote;
+        double requestedAt;
+    };
+
+    void run();
+    void createFleet();
+    void handle(RideCommand& command);
+    bool tryMatch(PendingRide& pending);
+    void advanceFleet();
+    void publish(const FleetMember& member);
+    void publish(const RideUpdate& update);
+
+    const vector<Node*>& nodes;
+    ServerConfig config;
+    vector<FleetMember> fleet;
+    unordered_map<Driver*, size_t> memberOf;
+    unordered_map<uint32_t, size_t> memberOfRide; // Accepted rides until they are rated
+    FleetPartitions fleetByClass;
+    SurgePricing surge;
+    vector<PendingRide> pending;
+    bool driverFreed = false;
+    double now = 0;                 // Simulated seconds
+
+    mutex lock;                     // Guards commands and updates
+    vector<RideCommand> commands;
+    vector<RideUpdate> updates;
+    vector<RideUpdate> outgoing;    // Sim thread scratch, swapped out under the lock
+    int wakeFd = -1;
+
+    thread worker;
+    atomic<bool> running{ false };
+    atomic<uint64_t> ticks{ 0 };
+    atomic<uint64_t> overruns{ 0 };
+};
+
+struct ServerStats
+{
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;      // Over maxConnections
+    size_t open = 0;
+    size_t peakOpen = 0;
+    uint64_t requests = 0;
+    uint64_t errors = 0;        // 4xx and 5xx responses
+    uint64_t registered = 0;
+    uint64_t signIns = 0;
+    uint64_t rideRequests = 0;
+    uint64_t statusQueries = 0;
+    uint64_t ratings = 0;
+};
+
+// Single-threaded epoll server for the rider flow the console menu offers:
+//   POST /register            {"name", "email", "gender": "M"|"F", "phone", "age"}
+//   POST /signin              {"email"} -> {"token"}
+//   POST /rides               {"from": nodeId, "to": nodeId, "vehicle": "Car"}
+//   GET  /rides/<id>
+//   POST /rides/<id>/rating   {"rating": 0..5}
+//   GET  /stats
+// HTTP/1.1 with keep-alive and pipelining, JSON bodies, and the token from
+// sign-in as "Authorization: Bearer <token>" on the ride endpoints.
+// Sockets are non-blocking and level-triggered; a connection only asks for
+// EPOLLOUT while it has unsent output. Users live in memory and are written
+// to users.json (the format User::saveUser uses) every flushSeconds.
+class RideServer
+{
+public:
+    RideServer(const vector<Node*>& nodes, ServerConfig config);
+    ~RideServer();
+
+    bool start();
+    void run();
+
+    // Async-signal-safe
+    static void requestStop();
+
+    ServerStats getStats() const { return stats; }
+    const RideSimulation& getSimulation() const { return simulation; }
+    LatencyHistogram requestLatency;
+
+    RideServer(const RideServer&) = delete;
+    RideServer& operator=(const RideServer&) = delete;
+
+private:
+    struct Connection
+    {
+        bool open = false;
+        string in;
+        string out;
+        size_t sent = 0;
+        bool writing = false;       // EPOLLOUT registered
+        bool closeAfterWrite = false;
+    };
+
+    struct Request
+    {
+        string method;
+        string path;
+        string token;
+        string body;
+        bool keepAlive = true;
+    };
+
+    struct Response
+    {
+        int status = 200;
+        string body;
+    };
+
+    struct RideRecord
+    {
+        string email;
+        RideUpdate latest;
+        bool rated = false;
+    };
+
+    void acceptAll();
+    void onReadable(int fd);
+    void onWritable(int fd);
+    void closeConnection(int fd);
+    bool flushOutput(int fd);
+    void handleInput(int fd);
+    void dispatch(const Request& request, Response& response);
+    void applyUpdates();
+
+    void registerUser(const Request& request, Response& response);
+    void signIn(const Request& request, Response& response);
+    void requestRide(const Request& request, Response& response);
+    void rideStatus(uint32_t rideId, const Request& request, Response& response);
+    void rateRide(uint32_t rideId, const Request& request, Response& response);
+    void serverStatus(Response& response);
+    const string* userOf(const Request& request) const;
+
+    void loadUsers();
+    void saveUsers();
+
+    const vector<Node*>& nodes;
+    ServerConfig config;
+    RideSimulation simulation;
+    int listenFd = -1;
+    int epollFd = -1;
+    vector<Connection> connections; // Indexed by fd
+
+    unordered_map<string, User> users;       // By email
+    unordered_map<string, string> sessions;  // Token -> email
+    unordered_map<string, uint32_t> activeRide; // Email -> ride not yet finished
+    unordered_map<uint32_t, RideRecord> rides;
+    unordered_map<int, Node*> nodeById;
+    uint32_t lastRide = 0;
+    bool usersDirty = false;
+    uint64_t tokenState;
+    vector<RideUpdate> incoming;
+    ServerStats stats;
+};
+
+// Entry point for "SmartRide --serve ..."
+int runServer(int argc, char** argv, const vector<Node*>& nodes);
+
+#endif
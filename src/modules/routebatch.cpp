@@ -0,0 +1,59 @@
+#include "routebatch.h"
+#include "routecache.h"
+#include <algorithm>
+
+RouteBatch::RouteBatch(ThreadPool& pool, bool useCache) : pool(pool), useCache(useCache) {}
+
+void RouteBatch::add(Node* start, Node* goal)
+{
+    requests.push_back({ start, goal });
+}
+
+void RouteBatch::reserve(size_t count)
+{
+    requests.reserve(count);
+}
+
+void RouteBatch::clear()
+{
+    requests.clear();
+}
+
+vector<vector<Edge*>> RouteBatch::solve()
+{
+    vector<vector<Edge*>> paths(requests.size());
+
+    // Waits for this batch only; other callers may share the pool
+    TaskGroup group(pool);
+    for (size_t first = 0; first < requests.size(); first += chunkSize)
+    {
+        size_t last = min(first + chunkSize, requests.size());
+        group.submit([this, &paths, first, last](int)
+        {
+            SearchWorkspace& workspace = threadWorkspace();
+            for (size_t i = first; i < last; i++)
+            {
+                Node* start = requests[i].first;
+                Node* goal = requests[i].second;
+                if (occupancy)
+                {
+                    paths[i] = workspace.search(start, goal, occupancy);
+                }
+                else
+                {
+                    paths[i] = useCache ? routeCache.findRoute(start, goal, &workspace) : aStar(start, goal, workspace);
+                }
+            }
+        });
+    }
+    group.wait();
+
+    return paths;
+}
+
+vector<vector<Edge*>> RouteBatch::solveAll(const vector<pair<Node*, Node*>>& pairs, ThreadPool& pool)
+{
+    RouteBatch batch(pool);
+    batch.requests = pairs;
+    return batch.solve();
+}
@@ -0,0 +1,46 @@
+#ifndef ROUTEBATCH_H
+#define ROUTEBATCH_H
+
+#include "node.h"
+#include "pathfinder.h"
+#include "threadpool.h"
+#include <vector>
+
+using namespace std;
+
+// Routes many (start, goal) pairs at once on a thread pool. Each worker
+// searches with its thread's SearchWorkspace, which outlives the batch, so
+// batches built per spawn still reuse warm workspaces. Results come back in
+// the order the pairs were added. Edge occupancy is only read while
+// solving, so callers must not move vehicles until solve() returns, or route
+// against a copy of the counts given to setOccupancy().
+class RouteBatch
+{
+public:
+    explicit RouteBatch(ThreadPool& pool = defaultThreadPool(), bool useCache = true);
+
+    void add(Node* start, Node* goal);
+    void reserve(size_t count);
+    void clear();
+    size_t size() const { return requests.size(); }
+
+    // Route against these per-road agent counts (CongestionMap::copyAgents)
+    // instead of the live edges; the route cache is bypassed. nullptr: live.
+    void setOccupancy(const vector<int>* roadAgents) { occupancy = roadAgents; }
+
+    // Solve every queued pair; paths[i] belongs to the i-th add()
+    vector<vector<Edge*>> solve();
+
+    // Route a whole list of pairs in one call
+    static vector<vector<Edge*>> solveAll(const vector<pair<Node*, Node*>>& pairs, ThreadPool& pool = defaultThreadPool());
+
+private:
+    static const size_t chunkSize = 16; // Pairs per task, keeps stealing granularity reasonable
+
+    ThreadPool& pool;
+    bool useCache;
+    vector<pair<Node*, Node*>> requests;
+    const vector<int>* occupancy = nullptr;
+};
+
+#endif
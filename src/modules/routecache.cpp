@@ -0,0 +1,161 @@
+#include "routecache.h"
+#include "metrics.h"
+#include <cstdlib>
+
+RouteCache routeCache;
+
+RouteCache::RouteCache(size_t capacity, int tolerance)
+    : capacity(capacity), tolerance(tolerance), epoch(0), hits(0), misses(0) {}
+
+vector<Edge*> RouteCache::findRoute(Node* start, Node* goal, SearchWorkspace* workspace)
+{
+    if (!start || !goal)
+    {
+        return aStar(start, goal);
+    }
+
+    Key key{ start->id, goal->id, getEpoch() };
+    {
+        lock_guard<mutex> guard(lock);
+        auto it = index.find(key);
+        if (it != index.end())
+        {
+            entries.splice(entries.begin(), entries, it->second); // Mark as most recently used
+            hits.fetch_add(1, memory_order_relaxed);
+            countMetric(Counter::RouteCacheHits);
+            if (!it->second->found)
+            {
+                return {};
+            }
+            return decode(start, it->second->hops);
+        }
+    }
+
+    misses.fetch_add(1, memory_order_relaxed);
+    countMetric(Counter::RouteCacheMisses);
+    vector<Edge*> path = workspace ? aStar(start, goal, *workspace) : aStar(start, goal);
+
+    vector<uint8_t> hops;
+    if (encode(start, path, hops))
+    {
+        insert(key, !path.empty() || start == goal, move(hops));
+    }
+    return path;
+}
+
+void RouteCache::noteOccupancyChange(Edge* edge, int delta)
+{
+    if (!edge)
+    {
+        return;
+    }
+
+    uint64_t current = getEpoch();
+    if (edge->epochStamp != current)
+    {
+        // First change seen in this epoch: the routes cached so far were computed
+        // with the occupancy from before this delta
+        edge->epochStamp = current;
+        edge->epochAgents = edge->no_of_agents - delta;
+    }
+
+    if (abs(edge->no_of_agents - edge->epochAgents) > tolerance)
+    {
+        bumpEpoch();
+    }
+}
+
+void RouteCache::bumpEpoch()
+{
+    epoch.fetch_add(1, memory_order_relaxed);
+    countMetric(Counter::RouteCacheEpochBumps);
+}
+
+void RouteCache::clear()
+{
+    lock_guard<mutex> guard(lock);
+    entries.clear();
+    index.clear();
+}
+
+void RouteCache::setCapacity(size_t newCapacity)
+{
+    lock_guard<mutex> guard(lock);
+    capacity = newCapacity;
+    while (entries.size() > capacity)
+    {
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+}
+
+size_t RouteCache::size() const
+{
+    lock_guard<mutex> guard(lock);
+    return entries.size();
+}
+
+void RouteCache::display() const
+{
+    uint64_t h = getHits();
+    uint64_t m = getMisses();
+    double hitRate = (h + m) ? 100.0 * h / (h + m) : 0.0;
+    cout << "Route cache: " << size() << " entries, epoch " << getEpoch()
+         << ", hits " << h << ", misses " << m << " (" << hitRate << "% hit rate)" << endl;
+}
+
+// Encode a path as the edge index taken at each node, fails if a node has more
+// edges than fit in a byte
+bool RouteCache::encode(Node* start, const vector<Edge*>& path, vector<uint8_t>& hops)
+{
+    hops.clear();
+    hops.reserve(path.size());
+    Node* current = start;
+    for (Edge* edge : path)
+    {
+        size_t i = 0;
+        while (i < current->edges.size() && current->edges[i] != edge)
+        {
+            i++;
+        }
+        if (i == current->edges.size() || i > UINT8_MAX)
+        {
+            return false;
+        }
+        hops.push_back(static_cast<uint8_t>(i));
+        current = (edge->node1 == current) ? edge->node2 : edge->node1;
+    }
+    return true;
+}
+
+vector<Edge*> RouteCache::decode(Node* start, const vector<uint8_t>& hops)
+{
+    vector<Edge*> path;
+    path.reserve(hops.size());
+    Node* current = start;
+    for (uint8_t hop : hops)
+    {
+        Edge* edge = current->edges[hop];
+        path.push_back(edge);
+        current = (edge->node1 == current) ? edge->node2 : edge->node1;
+    }
+    return path;
+}
+
+void RouteCache::insert(const Key& key, bool found, vector<uint8_t>&& hops)
+{
+    lock_guard<mutex> guard(lock);
+    if (capacity == 0 || index.count(key))
+    {
+        return;
+    }
+
+    entries.push_front(Entry{ key, found, move(hops) });
+    index[key] = entries.begin();
+
+    while (entries.size() > capacity)
+    {
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef ROUTECACHE_H
+#define ROUTECACHE_H
+
+#include "node.h"
+#include "pathfinder.h"
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+
+using namespace std;
+
+// LRU cache of A* results keyed by (origin, destination, congestion epoch).
+// Paths are stored compactly as one byte per hop: the index of the edge taken
+// in the current node's edge list. The epoch is bumped whenever an edge's
+// occupancy drifts more than `tolerance` agents away from the value it had
+// when the epoch started, so stale routes simply age out of the LRU.
+class RouteCache
+{
+public:
+    RouteCache(size_t capacity = 4096, int tolerance = 2);
+
+    // Return the cached path if present, otherwise run A* and remember it.
+    // A workspace may be passed by worker threads that own one.
+    vector<Edge*> findRoute(Node* start, Node* goal, SearchWorkspace* workspace = nullptr);
+
+    // Called after an edge's agent count changed by delta
+    void noteOccupancyChange(Edge* edge, int delta);
+
+    // Invalidate every cached route (e.g. after bulk occupancy changes)
+    void bumpEpoch();
+
+    void clear();
+    void setCapacity(size_t newCapacity);
+
+    uint64_t getEpoch() const { return epoch.load(memory_order_relaxed); }
+    uint64_t getHits() const { return hits.load(memory_order_relaxed); }
+    uint64_t getMisses() const { return misses.load(memory_order_relaxed); }
+    size_t size() const;
+
+    void display() const;
+
+private:
+    struct Key
+    {
+        int origin;
+        int destination;
+        uint64_t epoch;
+
+        bool operator==(const Key& other) const
+        {
+            return origin == other.origin && destination == other.destination && epoch == other.epoch;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            uint64_t h = (static_cast<uint64_t>(static_cast<uint32_t>(key.origin)) << 32) | static_cast<uint32_t>(key.destination);
+            h ^= key.epoch * 0x9E3779B97F4A7C15ULL;
+            h ^= h >> 29;
+            return static_cast<size_t>(h * 0xBF58476D1CE4E5B9ULL);
+        }
+    };
+
+    struct Entry
+    {
+        Key key;
+        bool found;           // False caches a "no path" answer
+        vector<uint8_t> hops; // Edge index taken at each node along the path
+    };
+
+    static bool encode(Node* start, const vector<Edge*>& path, vector<uint8_t>& hops);
+    static vector<Edge*> decode(Node* start, const vector<uint8_t>& hops);
+
+    void insert(const Key& key, bool found, vector<uint8_t>&& hops);
+
+    size_t capacity;
+    int tolerance;
+    list<Entry> entries; // Most recently used at the front
+    unordered_map<Key, list<Entry>::iterator, KeyHash> index;
+    mutable mutex lock;
+
+    atomic<uint64_t> epoch;
+    atomic<uint64_t> hits;
+    atomic<uint64_t> misses;
+};
+
+extern RouteCache routeCache;
+
+#endif
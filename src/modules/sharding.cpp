@@ -0,0 +1,718 @@
+#include "sharding.h"
+#include "graphgen.h"
+#include "dispatch.h"
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+
+ShardConfig ShardConfig::fromArgs(int argc, char** argv)
+{
+    ShardConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--regions" && hasValue)
+            config.regions = max(1, atoi(argv[++i]));
+        else if (arg == "--processes")
+            config.processes = true;
+        else if (arg == "--transport" && hasValue)
+            config.localTransport = string(argv[++i]) == "local";
+        else if (arg == "--tick" && hasValue)
+            config.tickSeconds = atof(argv[++i]);
+        else if (arg == "--duration" && hasValue)
+            config.duration = atof(argv[++i]);
+        else if (arg == "--spawn-rate" && hasValue)
+            config.spawnRate = atof(argv[++i]);
+        else if (arg == "--ring" && hasValue)
+            config.ringCapacity = max(2, atoi(argv[++i]));
+        else if (arg == "--seed" && hasValue)
+            config.seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--grid" && hasValue)
+        {
+            string spec = argv[++i];
+            size_t x = spec.find('x');
+            config.gridWidth = atoi(spec.substr(0, x).c_str());
+            config.gridHeight = x == string::npos ? config.gridWidth : atoi(spec.substr(x + 1).c_str());
+        }
+    }
+    return config;
+}
+
+ShardGraph::ShardGraph(const vector<Node*>& nodes, int regions, const ShardConfig& config)
+{
+    unordered_map<const Node*, uint32_t> nodeIndex;
+    nodeIndex.reserve(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        nodeIndex[nodes[i]] = static_cast<uint32_t>(i);
+        x.push_back(nodes[i]->x);
+        y.push_back(nodes[i]->y);
+    }
+
+    firstOut.assign(nodes.size() + 1, 0);
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        firstOut[i] = static_cast<uint32_t>(edges.size());
+        for (const Edge* edge : nodes[i]->edges)
+        {
+            auto to = nodeIndex.find(edge->node2);
+            if (edge->node1 != nodes[i] || to == nodeIndex.end())
+            {
+                continue;
+            }
+            double lanes = max(1.0, round(edge->width / config.laneWidth));
+            float length = max(1.0f, edge->length);
+            float capacity = static_cast<float>(max(1.0, config.jamDensity * lanes * length));
+            edges.push_back({ static_cast<uint32_t>(i), to->second, length, capacity, 0 });
+        }
+    }
+    firstOut[nodes.size()] = static_cast<uint32_t>(edges.size());
+
+    regions = max(1, min(regions, static_cast<int>(max<size_t>(nodes.size(), 1))));
+    regionOf.assign(nodes.size(), 0);
+    regionNodes.assign(regions, {});
+    regionEdges.assign(regions, {});
+    vector<uint32_t> ids(nodes.size());
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        ids[i] = static_cast<uint32_t>(i);
+    }
+    bisect(ids, 0, ids.size(), 0, regions);
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        regionNodes[regionOf[i]].push_back(static_cast<uint32_t>(i));
+    }
+
+    adjacent.assign(static_cast<size_t>(regions) * regions, 0);
+    for (size_t e = 0; e < edges.size(); e++)
+    {
+        ShardEdge& edge = edges[e];
+        int from = regionOf[edge.from];
+        int to = regionOf[edge.to];
+        edge.slot = static_cast<uint32_t>(regionEdges[from].size());
+        regionEdges[from].push_back(static_cast<uint32_t>(e));
+        if (from != to)
+        {
+            cutEdges++;
+            adjacent[static_cast<size_t>(from) * regions + to] = 1;
+        }
+    }
+}
+
+void ShardGraph::bisect(vector<uint32_t>& ids, size_t begin, size_t end, int firstRegion, int regions)
+{
+    if (regions == 1 || end - begin <= 1)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            regionOf[ids[i]] = firstRegion;
+        }
+        return;
+    }
+
+    float minX = x[ids[begin]], maxX = minX, minY = y[ids[begin]], maxY = minY;
+    for (size_t i = begin; i < end; i++)
+    {
+        minX = min(minX, x[ids[i]]);
+        maxX = max(maxX, x[ids[i]]);
+        minY = min(minY, y[ids[i]]);
+        maxY = max(maxY, y[ids[i]]);
+    }
+    const vector<float>& axis = maxX - minX >= maxY - minY ? x : y;
+    int left = regions / 2;
+    size_t middle = begin + (end - begin) * left / regions;
+    nth_element(ids.begin() + begin, ids.begin() + middle, ids.begin() + end,
+                [&axis](uint32_t a, uint32_t b) { return axis[a] < axis[b] || (axis[a] == axis[b] && a < b); });
+    bisect(ids, begin, middle, firstRegion, left);
+    bisect(ids, middle, end, firstRegion + left, regions - left);
+}
+
+SharedArena::SharedArena(size_t bytes) : base(nullptr), size(bytes), used(0)
+{
+    void* mapping = mmap(nullptr, max<size_t>(bytes, 1), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping != MAP_FAILED)
+    {
+        base = static_cast<char*>(mapping);
+    }
+}
+
+SharedArena::~SharedArena()
+{
+    if (base)
+    {
+        munmap(base, max<size_t>(size, 1));
+    }
+}
+
+static size_t ringCapacityFor(size_t requested)
+{
+    size_t capacity = 2;
+    while (capacity < requested)
+    {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+size_t SharedRingTransport::bytesNeeded(const vector<char>& adjacent, size_t capacity)
+{
+    size_t count = count_if(adjacent.begin(), adjacent.end(), [](char linked) { return linked != 0; });
+    return SharedArena::bytesFor<Ring>(count) + SharedArena::bytesFor<ShardVehicle>(count * ringCapacityFor(capacity));
+}
+
+SharedRingTransport::SharedRingTransport(SharedArena& arena, const vector<char>& adjacent, int regions, size_t capacity)
+    : regions(regions), capacity(ringCapacityFor(capacity)), ringOf(adjacent.size(), -1), rings(nullptr), slots(nullptr)
+{
+    int count = 0;
+    for (size_t pair = 0; pair < adjacent.size(); pair++)
+    {
+        if (adjacent[pair])
+        {
+            ringOf[pair] = count++;
+        }
+    }
+    rings = arena.allocate<Ring>(count);
+    slots = arena.allocate<ShardVehicle>(static_cast<size_t>(count) * this->capacity);
+}
+
+bool SharedRingTransport::send(int from, int to, const ShardVehicle& vehicle)
+{
+    int index = ringOf[static_cast<size_t>(from) * regions + to];
+    if (index < 0 || !rings)
+    {
+        return false;
+    }
+    Ring& ring = rings[index];
+    uint64_t tail = ring.tail.load(memory_order_relaxed);
+    if (tail - ring.head.load(memory_order_acquire) == capacity)
+    {
+        return false; // Full
+    }
+    slots[index * capacity + (tail & (capacity - 1))] = vehicle;
+    ring.tail.store(tail + 1, memory_order_release);
+    return true;
+}
+
+void SharedRingTransport::receive(int from, int to, vector<ShardVehicle>& into)
+{
+    int index = ringOf[static_cast<size_t>(from) * regions + to];
+    if (index < 0 || !rings)
+    {
+        return;
+    }
+    Ring& ring = rings[index];
+    uint64_t head = ring.head.load(memory_order_relaxed);
+    uint64_t tail = ring.tail.load(memory_order_acquire);
+    for (; head != tail; head++)
+    {
+        into.push_back(slots[index * capacity + (head & (capacity - 1))]);
+    }
+    ring.head.store(head, memory_order_release);
+}
+
+LocalTransport::LocalTransport(int regions) : regions(regions), mailboxes(static_cast<size_t>(regions) * regions) {}
+
+bool LocalTransport::send(int from, int to, const ShardVehicle& vehicle)
+{
+    mailboxes[static_cast<size_t>(from) * regions + to].push_back(vehicle);
+    return true;
+}
+
+void LocalTransport::receive(int from, int to, vector<ShardVehicle>& into)
+{
+    vector<ShardVehicle>& mailbox = mailboxes[static_cast<size_t>(from) * regions + to];
+    into.insert(into.end(), mailbox.begin(), mailbox.end());
+    mailbox.clear();
+}
+
+bool ShardBarrier::init(int parties)
+{
+    pthread_barrierattr_t attributes;
+    pthread_barrierattr_init(&attributes);
+    pthread_barrierattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    bool ok = pthread_barrier_init(&barrier, &attributes, static_cast<unsigned>(parties)) == 0;
+    pthread_barrierattr_destroy(&attributes);
+    return ok;
+}
+
+void ShardBarrier::wait()
+{
+    pthread_barrier_wait(&barrier);
+}
+
+void ShardBarrier::destroy()
+{
+    pthread_barrier_destroy(&barrier);
+}
+
+void ShardReport::display() const
+{
+    RegionStats total;
+    double busiest = 0, meanBusy = 0, maxTick = 0;
+    for (const RegionStats& region : regionStats)
+    {
+        total.spawned += region.spawned;
+        total.arrived += region.arrived;
+        total.handedOut += region.handedOut;
+        total.handedIn += region.handedIn;
+        total.ringFull += region.ringFull;
+        total.unroutable += region.unroutable;
+        total.active += region.active;
+        total.distance += region.distance;
+        total.tripSeconds += region.tripSeconds;
+        busiest = max(busiest, region.busyNanos / 1e9);
+        meanBusy += region.busyNanos / 1e9 / max<size_t>(regionStats.size(), 1);
+        maxTick = max(maxTick, region.maxTickNanos / 1e6);
+    }
+
+    cout << "-----------------------------------" << endl;
+    cout << "Sharded simulation report" << endl;
+    if (failed)
+    {
+        cout << "A region failed; the figures below are incomplete" << endl;
+    }
+    cout << "Network: " << nodes << " nodes, " << edges << " edges in " << regions << " regions ("
+         << (processes ? "processes" : "threads") << ", " << (localTransport ? "local" : "shared-memory") << " transport), "
+         << cutEdges << " edges cross a boundary" << endl;
+    cout << "Simulated time: " << simulatedSeconds << " s in " << ticks << " ticks, wall time: " << wallSeconds << " s ("
+         << (wallSeconds > 0 ? ticks / wallSeconds : 0) << " ticks/s)" << endl;
+    cout << "Vehicles: " << total.spawned << " spawned, " << total.arrived << " arrived, " << total.active << " still driving, "
+         << total.unroutable << " unroutable" << endl;
+    cout << "Handoffs: " << total.handedOut << " sent, " << total.handedIn << " received, " << total.ringFull << " retried on a full ring" << endl;
+    if (total.arrived > 0)
+    {
+        cout << "Trips: " << total.tripSeconds / total.arrived << " s and " << total.distance / total.arrived << " units on average" << endl;
+    }
+    cout << "Region work: busiest " << busiest << " s, mean " << meanBusy << " s (imbalance " << (meanBusy > 0 ? busiest / meanBusy : 1)
+         << "x), slowest tick " << maxTick << " ms" << endl;
+    for (size_t r = 0; r < regionStats.size(); r++)
+    {
+        const RegionStats& region = regionStats[r];
+        cout << "  region " << r << ": " << regionNodes[r] << " nodes, " << region.spawned << " spawned, " << region.arrived << " arrived, "
+             << region.handedOut << " out, " << region.handedIn << " in, " << region.busyNanos / 1e9 << " s busy" << endl;
+    }
+    // Nothing may be lost at a boundary
+    bool balanced = total.spawned == total.arrived + total.unroutable + total.active && total.handedOut == total.handedIn;
+    cout << "Conservation: " << (balanced ? "ok" : "MISMATCH") << endl;
+    cout << "-----------------------------------" << endl;
+}
+
+ShardedSimulation::ShardedSimulation(const vector<Node*>& nodes, ShardConfig config)
+    : config(config), graph(nodes, config.regions, config),
+      tickCount(static_cast<uint64_t>(max(0.0, ceil(config.duration / config.tickSeconds)))),
+      arena(SharedArena::bytesFor<ShardBarrier>(1) + SharedArena::bytesFor<RegionStats>(graph.regionCount()) +
+            2 * SharedArena::bytesFor<atomic<int32_t>>(graph.edges.size()) +
+            (config.localTransport ? 0 : SharedRingTransport::bytesNeeded(graph.adjacent, config.ringCapacity))),
+      barrier(nullptr), stats(nullptr), view{ nullptr, nullptr }, barrierReady(false)
+{
+    this->config.regions = graph.regionCount();
+    if (this->config.localTransport)
+    {
+        this->config.processes = false; // Mailboxes live on the heap of one process
+    }
+    barrier = arena.allocate<ShardBarrier>(1);
+    stats = arena.allocate<RegionStats>(graph.regionCount());
+    view[0] = arena.allocate<atomic<int32_t>>(graph.edges.size());
+    view[1] = arena.allocate<atomic<int32_t>>(graph.edges.size());
+    if (this->config.localTransport)
+    {
+        transport.reset(new LocalTransport(graph.regionCount()));
+    }
+    else
+    {
+        transport.reset(new SharedRingTransport(arena, graph.adjacent, graph.regionCount(), config.ringCapacity));
+    }
+    barrierReady = barrier && barrier->init(graph.regionCount());
+
+    regions.resize(graph.regionCount());
+    for (int r = 0; r < graph.regionCount(); r++)
+    {
+        Region& region = regions[r];
+        region.index = r;
+        region.counts.assign(graph.regionEdges[r].size(), 0);
+        region.random.seed(config.seed + 0x9E3779B97F4A7C15ULL * (r + 1));
+        region.cost.assign(graph.nodeCount(), 0);
+        region.via.assign(graph.nodeCount(), 0);
+        region.visited.assign(graph.nodeCount(), 0);
+    }
+}
+
+ShardedSimulation::~ShardedSimulation()
+{
+    if (barrierReady)
+    {
+        barrier->destroy();
+    }
+}
+
+// Greenshields: speed falls linearly with density, floored so a full edge
+// still drains
+float ShardedSimulation::speedOn(const ShardEdge& edge, int32_t count) const
+{
+    double share = max(config.minSpeedShare, 1.0 - count / edge.capacity);
+    return static_cast<float>(config.freeSpeed * share);
+}
+
+// A* on expected travel time under the occupancy view; the straight line at
+// free speed never overestimates
+bool ShardedSimulation::route(Region& region, uint32_t from, uint32_t to, const atomic<int32_t>* counts, vector<uint32_t>& path)
+{
+    path.clear();
+    if (from == to)
+    {
+        return true;
+    }
+    // visited holds stamp once a node is reached and stamp + 1 once settled
+    if (region.stamp > UINT32_MAX - 4)
+    {
+        fill(region.visited.begin(), region.visited.end(), 0);
+        region.stamp = 0;
+    }
+    uint32_t stamp = region.stamp + 1;
+    region.stamp += 2;
+    auto estimate = [&](uint32_t node) {
+        float dx = graph.x[node] - graph.x[to];
+        float dy = graph.y[node] - graph.y[to];
+        return static_cast<float>(sqrt(dx * dx + dy * dy) / config.freeSpeed);
+    };
+
+    using Entry = pair<float, uint32_t>;
+    priority_queue<Entry, vector<Entry>, greater<Entry>> open;
+    region.cost[from] = 0;
+    region.visited[from] = stamp;
+    open.push({ estimate(from), from });
+    while (!open.empty())
+    {
+        uint32_t node = open.top().second;
+        open.pop();
+        if (region.visited[node] == stamp + 1)
+        {
+            continue;
+        }
+        region.visited[node] = stamp + 1;
+        if (node == to)
+        {
+            break;
+        }
+        for (uint32_t e = graph.firstOut[node]; e < graph.firstOut[node + 1]; e++)
+        {
+            const ShardEdge& edge = graph.edges[e];
+            float cost = region.cost[node] + edge.length / speedOn(edge, counts[e].load(memory_order_relaxed));
+            uint32_t mark = region.visited[edge.to];
+            if (mark == stamp + 1 || (mark == stamp && cost >= region.cost[edge.to]))
+            {
+                continue;
+            }
+            region.visited[edge.to] = stamp;
+            region.cost[edge.to] = cost;
+            region.via[edge.to] = e;
+            open.push({ cost + estimate(edge.to), edge.to });
+        }
+    }
+    if (region.visited[to] != stamp + 1)
+    {
+        return false;
+    }
+    for (uint32_t node = to; node != from; node = graph.edges[region.via[node]].from)
+    {
+        path.push_back(region.via[node]);
+    }
+    reverse(path.begin(), path.end());
+    return true;
+}
+
+void ShardedSimulation::handOff(Region& region, int to, const ShardVehicle& vehicle)
+{
+    RegionStats& own = stats[region.index];
+    if (transport->send(region.index, to, vehicle))
+    {
+        own.handedOut++;
+    }
+    else
+    {
+        own.ringFull++;
+        region.outbox.push_back({ to, vehicle });
+    }
+}
+
+void ShardedSimulation::moveRegion(Region& region, uint64_t tick)
+{
+    RegionStats& own = stats[region.index];
+    const atomic<int32_t>* current = view[tick & 1]; // Published by every region last tick
+    const vector<uint32_t>& ownedNodes = graph.regionNodes[region.index];
+    const vector<uint32_t>& ownedEdges = graph.regionEdges[region.index];
+
+    // Handoffs a full ring refused last tick go first, in order
+    vector<pair<int, ShardVehicle>> refused;
+    refused.swap(region.outbox);
+    for (const pair<int, ShardVehicle>& waiting : refused)
+    {
+        handOff(region, waiting.first, waiting.second);
+    }
+
+    // New trips from this region's nodes to anywhere
+    double mean = config.spawnRate * config.tickSeconds * ownedNodes.size() / max<size_t>(graph.nodeCount(), 1);
+    int spawns = mean > 0 ? poisson_distribution<int>(mean)(region.random) : 0;
+    uniform_int_distribution<size_t> anyNode(0, graph.nodeCount() - 1);
+    uniform_int_distribution<size_t> ownNode(0, ownedNodes.empty() ? 0 : ownedNodes.size() - 1);
+    for (int s = 0; s < spawns && !ownedNodes.empty() && graph.nodeCount() > 1; s++)
+    {
+        Moving vehicle;
+        vehicle.record.id = (own.spawned++ << 16) | static_cast<uint64_t>(region.index);
+        vehicle.record.spawnTick = tick;
+        vehicle.record.node = ownedNodes[ownNode(region.random)];
+        do
+        {
+            vehicle.record.destination = static_cast<uint32_t>(anyNode(region.random));
+        } while (vehicle.record.destination == vehicle.record.node);
+        vehicle.record.distance = 0;
+        vehicle.record.handoffs = 0;
+        if (!route(region, vehicle.record.node, vehicle.record.destination, current, vehicle.route) || vehicle.route.empty())
+        {
+            own.unroutable++;
+            continue;
+        }
+        region.vehicles.push_back(move(vehicle));
+    }
+
+    // Drive; a vehicle may pass several nodes in one tick on short edges
+    for (size_t i = 0; i < region.vehicles.size();)
+    {
+        Moving& vehicle = region.vehicles[i];
+        float remaining = static_cast<float>(config.tickSeconds);
+        bool gone = false;
+        while (remaining > 0)
+        {
+            if (vehicle.edge == atNode)
+            {
+                uint32_t next = vehicle.route[vehicle.step];
+                const ShardEdge& edge = graph.edges[next];
+                if (region.counts[edge.slot] >= edge.capacity)
+                {
+                    break; // Wait for room
+                }
+                region.counts[edge.slot]++;
+                vehicle.edge = next;
+                vehicle.position = 0;
+                vehicle.step++;
+            }
+
+            const ShardEdge& edge = graph.edges[vehicle.edge];
+            float speed = speedOn(edge, region.counts[edge.slot]);
+            float left = edge.length - vehicle.position;
+            if (speed * remaining < left)
+            {
+                vehicle.position += speed * remaining;
+                break;
+            }
+            remaining -= left / speed;
+            region.counts[edge.slot]--;
+            vehicle.record.distance += edge.length;
+            vehicle.record.node = edge.to;
+            vehicle.edge = atNode;
+
+            if (edge.to == vehicle.record.destination)
+            {
+                own.arrived++;
+                own.distance += vehicle.record.distance;
+                own.tripSeconds += (tick + 1 - vehicle.record.spawnTick) * config.tickSeconds - remaining;
+                gone = true;
+                break;
+            }
+            int owner = graph.regionOf[edge.to];
+            if (owner != region.index)
+            {
+                vehicle.record.handoffs++;
+                handOff(region, owner, vehicle.record);
+                gone = true;
+                break;
+            }
+        }
+
+        if (gone)
+        {
+            if (i + 1 != region.vehicles.size())
+            {
+                region.vehicles[i] = move(region.vehicles.back());
+            }
+            region.vehicles.pop_back();
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    // Publish for everyone's routing in the exchange phase and next tick
+    atomic<int32_t>* next = view[(tick + 1) & 1];
+    for (size_t slot = 0; slot < ownedEdges.size(); slot++)
+    {
+        next[ownedEdges[slot]].store(region.counts[slot], memory_order_relaxed);
+    }
+}
+
+void ShardedSimulation::exchangeRegion(Region& region, uint64_t tick)
+{
+    RegionStats& own = stats[region.index];
+    const atomic<int32_t>* current = view[(tick + 1) & 1];
+    region.inbox.clear();
+    for (int from = 0; from < graph.regionCount(); from++)
+    {
+        if (graph.adjacent[static_cast<size_t>(from) * graph.regionCount() + region.index])
+        {
+            transport->receive(from, region.index, region.inbox);
+        }
+    }
+
+    // Routes are planned here with the whole network's latest counts
+    for (const ShardVehicle& record : region.inbox)
+    {
+        own.handedIn++;
+        Moving vehicle;
+        vehicle.record = record;
+        if (!route(region, record.node, record.destination, current, vehicle.route) || vehicle.route.empty())
+        {
+            own.unroutable++;
+            continue;
+        }
+        region.vehicles.push_back(move(vehicle));
+    }
+}
+
+void ShardedSimulation::runRegion(int index)
+{
+    Region& region = regions[index];
+    RegionStats& own = stats[index];
+    for (uint64_t tick = 0; tick < tickCount; tick++)
+    {
+        uint64_t started = nowNanoseconds();
+        moveRegion(region, tick);
+        uint64_t moved = nowNanoseconds();
+        barrier->wait();
+        uint64_t exchanging = nowNanoseconds();
+        exchangeRegion(region, tick);
+        uint64_t finished = nowNanoseconds();
+        barrier->wait();
+
+        uint64_t work = (moved - started) + (finished - exchanging);
+        own.busyNanos += work;
+        own.maxTickNanos = max(own.maxTickNanos, work);
+    }
+    own.active = region.vehicles.size() + region.outbox.size();
+}
+
+ShardReport ShardedSimulation::run()
+{
+    ShardReport report;
+    report.regions = graph.regionCount();
+    report.processes = config.processes;
+    report.localTransport = config.localTransport;
+    report.nodes = graph.nodeCount();
+    report.edges = graph.edges.size();
+    report.cutEdges = graph.cutEdges;
+    report.ticks = tickCount;
+    report.simulatedSeconds = tickCount * config.tickSeconds;
+    for (const vector<uint32_t>& owned : graph.regionNodes)
+    {
+        report.regionNodes.push_back(owned.size());
+    }
+    if (!arena.isValid() || !barrierReady || !stats || !view[0] || !view[1])
+    {
+        cerr << "Could not set up shared memory for the regions" << endl;
+        report.failed = true;
+        return report;
+    }
+
+    auto wallStart = chrono::steady_clock::now();
+    if (config.processes)
+    {
+        // Children only touch the arena and their own region, then leave
+        // without running destructors or flushing the parent's streams
+        cout.flush();
+        vector<pid_t> children;
+        for (int r = 0; r < graph.regionCount(); r++)
+        {
+            pid_t child = fork();
+            if (child == 0)
+            {
+                runRegion(r);
+                _exit(0);
+            }
+            if (child < 0)
+            {
+                report.failed = true;
+                break;
+            }
+            children.push_back(child);
+        }
+        if (report.failed)
+        {
+            // The barrier can never fill now
+            for (pid_t child : children)
+            {
+                kill(child, SIGKILL);
+            }
+        }
+        for (size_t done = 0; done < children.size(); done++)
+        {
+            int status = 0;
+            pid_t child = wait(&status);
+            if (child > 0 && (!WIFEXITED(status) || WEXITSTATUS(status) != 0) && !report.failed)
+            {
+                report.failed = true;
+                for (pid_t other : children)
+                {
+                    kill(other, SIGKILL);
+                }
+            }
+        }
+    }
+    else
+    {
+        vector<thread> workers;
+        for (int r = 0; r < graph.regionCount(); r++)
+        {
+            workers.emplace_back(&ShardedSimulation::runRegion, this, r);
+        }
+        for (thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+    report.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+    report.regionStats.assign(stats, stats + graph.regionCount());
+    return report;
+}
+
+int runShardedSim(int argc, char** argv, const vector<Node*>& nodes)
+{
+    ShardConfig config = ShardConfig::fromArgs(argc, argv);
+    GeneratedGraph grid;
+    if (config.gridWidth > 0 && config.gridHeight > 0)
+    {
+        grid = makeGridGraph(config.gridWidth, config.gridHeight);
+    }
+    const vector<Node*>& network = grid.nodes.empty() ? nodes : grid.nodes;
+    cout << "Running sharded simulation: " << network.size() << " nodes, " << config.regions << " regions, " << config.duration << " s in "
+         << config.tickSeconds << " s ticks" << endl;
+
+    ShardReport report;
+    {
+        ShardedSimulation simulation(network, config);
+        report = simulation.run();
+    }
+    report.display();
+
+    freeGraph(grid);
+    return report.failed ? 1 : 0;
+}
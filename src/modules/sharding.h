@@ -0,0 +1,295 @@
+#ifndef SHARDING_H
+#define SHARDING_H
+
+#include "node.h"
+#include <pthread.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct ShardConfig
+{
+    int regions = 4;
+    bool processes = false;        // One forked process per region instead of one thread
+    bool localTransport = false;   // In-process mailboxes instead of shared-memory rings (threads only)
+    double tickSeconds = 0.5;
+    double duration = 600;         // Simulated seconds
+    double spawnRate = 2;          // Vehicles per simulated second over the whole network
+    size_t ringCapacity = 1024;    // Handoffs per region pair per tick before senders retry
+    double freeSpeed = 13.9;       // Map units (read as meters) per second
+    double jamDensity = 0.15;      // Vehicles per map unit per lane
+    double laneWidth = 3.2;        // Edge::width of one lane
+    double minSpeedShare = 0.05;   // Speed on a full edge, share of free speed
+    unsigned long long seed = 42;
+    int gridWidth = 0;             // Run on a generated grid instead of the city
+    int gridHeight = 0;
+
+    // Parse --regions, --processes, --transport shm|local, --tick, --duration,
+    // --spawn-rate, --ring, --seed and --grid <W>x<H>
+    static ShardConfig fromArgs(int argc, char** argv);
+};
+
+struct ShardEdge
+{
+    uint32_t from, to;
+    float length;
+    float capacity;  // Vehicles at jam density
+    uint32_t slot;   // Index among the edges of the owning region
+};
+
+// The road graph flattened to indices and cut into regions by recursive
+// coordinate bisection: the longer side of each box is split so both halves
+// get nodes in proportion to the regions they will hold. A directed edge
+// belongs to the region of its start node, so a vehicle is simulated by the
+// region it is driving out of and changes hands on reaching another
+// region's node.
+struct ShardGraph
+{
+    vector<float> x, y;
+    vector<uint32_t> firstOut;       // CSR over edges, nodeCount + 1 entries
+    vector<ShardEdge> edges;
+    vector<int> regionOf;            // Per node
+    vector<vector<uint32_t>> regionNodes;
+    vector<vector<uint32_t>> regionEdges;
+    vector<char> adjacent;           // regions x regions: some edge crosses from row to column
+    size_t cutEdges = 0;
+
+    ShardGraph(const vector<Node*>& nodes, int regions, const ShardConfig& config);
+
+    size_t nodeCount() const { return x.size(); }
+    int regionCount() const { return static_cast<int>(regionNodes.size()); }
+
+private:
+    void bisect(vector<uint32_t>& ids, size_t begin, size_t end, int firstRegion, int regions);
+};
+
+// A vehicle as it crosses a boundary: fixed size and pointer free so it can
+// be copied through shared memory. The receiving region plans its own route.
+struct ShardVehicle
+{
+    uint64_t id;
+    uint64_t spawnTick;
+    uint32_t node;         // Where it was handed over
+    uint32_t destination;
+    float distance;        // Driven so far
+    uint32_t handoffs;
+};
+
+// Moves vehicles between regions. Sends happen in the movement phase and
+// receives in the exchange phase of a tick, never both on one pair at once.
+class HandoffTransport
+{
+public:
+    virtual ~HandoffTransport() {}
+
+    // False when the pair's buffer is full; the sender retries next tick
+    virtual bool send(int from, int to, const ShardVehicle& vehicle) = 0;
+    // Appends everything from `from` waiting for `to`
+    virtual void receive(int from, int to, vector<ShardVehicle>& into) = 0;
+};
+
+// One anonymous MAP_SHARED mapping carved up front; forked children inherit
+// it at the same address, so pointers into it stay valid across processes
+class SharedArena
+{
+public:
+    explicit SharedArena(size_t bytes);
+    ~SharedArena();
+
+    bool isValid() const { return base != nullptr; }
+
+    template <typename T>
+    static size_t bytesFor(size_t count) { return (sizeof(T) * count + 63) / 64 * 64; }
+
+    // Default-constructed in place; nullptr when the arena is exhausted
+    template <typename T>
+    T* allocate(size_t count)
+    {
+        size_t bytes = bytesFor<T>(count);
+        if (!base || used + bytes > size)
+        {
+            return nullptr;
+        }
+        T* items = reinterpret_cast<T*>(base + used);
+        used += bytes;
+        for (size_t i = 0; i < count; i++)
+        {
+            new (items + i) T();
+        }
+        return items;
+    }
+
+    SharedArena(const SharedArena&) = delete;
+    SharedArena& operator=(const SharedArena&) = delete;
+
+private:
+    char* base;
+    size_t size;
+    size_t used;
+};
+
+// Single-producer/single-consumer rings in a SharedArena, one per pair of
+// adjacent regions, like SpscQueue but laid out without heap pointers
+class SharedRingTransport : public HandoffTransport
+{
+public:
+    struct Ring
+    {
+        alignas(64) atomic<uint64_t> head{ 0 }; // Next slot to read
+        alignas(64) atomic<uint64_t> tail{ 0 }; // Next slot to write
+    };
+
+    static size_t bytesNeeded(const vector<char>& adjacent, size_t capacity);
+
+    SharedRingTransport(SharedArena& arena, const vector<char>& adjacent, int regions, size_t capacity);
+
+    bool send(int from, int to, const ShardVehicle& vehicle) override;
+    void receive(int from, int to, vector<ShardVehicle>& into) override;
+
+private:
+    int regions;
+    size_t capacity;                  // Power of two
+    vector<int> ringOf;               // Per ordered pair, -1 when not adjacent
+    Ring* rings;
+    ShardVehicle* slots;              // capacity per ring
+};
+
+// Stand-in for tests and single-process runs: plain vectors per pair, safe
+// because the barrier separates the phases that send and receive
+class LocalTransport : public HandoffTransport
+{
+public:
+    explicit LocalTransport(int regions);
+
+    bool send(int from, int to, const ShardVehicle& vehicle) override;
+    void receive(int from, int to, vector<ShardVehicle>& into) override;
+
+private:
+    int regions;
+    vector<vector<ShardVehicle>> mailboxes;
+};
+
+// pthread barrier marked process-shared, so it works between threads and
+// between forked processes alike when it lives in a SharedArena
+class ShardBarrier
+{
+public:
+    bool init(int parties);
+    void wait();
+    void destroy();
+
+private:
+    pthread_barrier_t barrier;
+};
+
+// Written only by the region's own thread or process, read after the run
+struct alignas(64) RegionStats
+{
+    uint64_t spawned = 0;
+    uint64_t arrived = 0;
+    uint64_t handedOut = 0;    // Accepted by the transport
+    uint64_t handedIn = 0;
+    uint64_t ringFull = 0;     // Sends refused, retried on the next tick
+    uint64_t unroutable = 0;   // Dropped for want of a path
+    uint64_t active = 0;       // On the road, waiting, or refused by a ring at the end
+    uint64_t busyNanos = 0;    // Working, barrier waits excluded
+    uint64_t maxTickNanos = 0;
+    double distance = 0;       // Of arrived vehicles
+    double tripSeconds = 0;
+};
+
+struct ShardReport
+{
+    int regions = 0;
+    bool processes = false;
+    bool localTransport = false;
+    bool failed = false;
+    size_t nodes = 0;
+    size_t edges = 0;
+    size_t cutEdges = 0;
+    uint64_t ticks = 0;
+    double simulatedSeconds = 0;
+    double wallSeconds = 0;
+    vector<size_t> regionNodes;
+    vector<RegionStats> regionStats;
+
+    void display() const;
+};
+
+// Microsimulation split over regions that run in lockstep, each on its own
+// thread or process. Vehicles move edge to edge at a speed falling with the
+// edge's occupancy (Greenshields) and wait at a node while the next edge is
+// full. Each tick has two phases separated by barriers:
+//   move      spawn, drive owned edges, send vehicles that reached another
+//             region's node, publish owned edge counts to the occupancy view
+//   exchange  take in handed-over vehicles and route them onward
+// The occupancy view is double buffered by tick parity: regions read the
+// buffer published last phase while writing the other, so routing sees the
+// whole network's counts and a run does not depend on thread timing.
+class ShardedSimulation
+{
+public:
+    ShardedSimulation(const vector<Node*>& nodes, ShardConfig config);
+    ~ShardedSimulation();
+
+    ShardReport run();
+
+    ShardedSimulation(const ShardedSimulation&) = delete;
+    ShardedSimulation& operator=(const ShardedSimulation&) = delete;
+
+private:
+    static const uint32_t atNode = UINT32_MAX;
+
+    struct Moving
+    {
+        ShardVehicle record;
+        uint32_t edge = atNode;    // Waiting at record.node when atNode
+        float position = 0;
+        vector<uint32_t> route;    // Edges from record.node
+        uint32_t step = 0;
+    };
+
+    struct Region
+    {
+        int index = 0;
+        vector<int32_t> counts;        // Per owned edge slot
+        vector<Moving> vehicles;
+        vector<pair<int, ShardVehicle>> outbox; // Refused by a full ring
+        vector<ShardVehicle> inbox;
+        mt19937_64 random;
+
+        // A* scratch, stamped instead of cleared
+        vector<float> cost;
+        vector<uint32_t> via;
+        vector<uint32_t> visited;
+        uint32_t stamp = 0;
+    };
+
+    void runRegion(int index);
+    void moveRegion(Region& region, uint64_t tick);
+    void exchangeRegion(Region& region, uint64_t tick);
+    void handOff(Region& region, int to, const ShardVehicle& vehicle);
+    bool route(Region& region, uint32_t from, uint32_t to, const atomic<int32_t>* view, vector<uint32_t>& path);
+    float speedOn(const ShardEdge& edge, int32_t count) const;
+
+    ShardConfig config;
+    ShardGraph graph;
+    uint64_t tickCount;
+    SharedArena arena;
+    unique_ptr<HandoffTransport> transport;
+    ShardBarrier* barrier;
+    RegionStats* stats;
+    atomic<int32_t>* view[2];  // Edge counts by tick parity
+    vector<Region> regions;
+    bool barrierReady;
+};
+
+// Entry point for "SmartRide --sharded ..."
+int runShardedSim(int argc, char** argv, const vector<Node*>& nodes);
+
+#endif
@@ -0,0 +1,37 @@
+#include "simrandom.h"
+#include <chrono>
+
+SimRandom simRandom;
+
+// SplitMix64 step, spreads the run seed into unrelated stream seeds
+static uint64_t mixSeed(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+SimRandom::SimRandom(uint64_t seed)
+{
+    this->seed(seed);
+}
+
+void SimRandom::seed(uint64_t newSeed)
+{
+    seedValue = newSeed;
+    for (int s = 0; s < static_cast<int>(RandomStream::Count); s++)
+    {
+        streams[s].seed(mixSeed(newSeed + static_cast<uint64_t>(s) * 0xD1B54A32D192ED03ULL));
+    }
+}
+
+size_t SimRandom::index(RandomStream stream, size_t count)
+{
+    return count ? static_cast<size_t>(generator(stream)() % count) : 0;
+}
+
+uint64_t freshSeed()
+{
+    return mixSeed(static_cast<uint64_t>(chrono::system_clock::now().time_since_epoch().count()));
+}
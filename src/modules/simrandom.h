@@ -0,0 +1,47 @@
+#ifndef SIMRANDOM_H
+#define SIMRANDOM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+using namespace std;
+
+// Independent random streams, one per subsystem, so adding a draw in one
+// place does not shift every other sequence of the run
+enum class RandomStream
+{
+    Drivers,   // Starting nodes of generated drivers
+    Vehicles,  // Ids, types, origins and goals of spawned vehicles
+    Occupancy, // Initial edge congestion
+    Count
+};
+
+// Seeded random number service of the simulation. Every stream is derived
+// from the one run seed, so a seed (plus the recorded inputs, see replay.h)
+// reproduces a run exactly. Not thread safe: draw from the simulation thread.
+class SimRandom
+{
+public:
+    explicit SimRandom(uint64_t seed = 1);
+
+    void seed(uint64_t newSeed);
+    uint64_t getSeed() const { return seedValue; }
+
+    // Uniform in [0, count). Plain modulo rather than a standard distribution,
+    // whose output differs between library implementations.
+    size_t index(RandomStream stream, size_t count);
+
+    mt19937_64& generator(RandomStream stream) { return streams[static_cast<int>(stream)]; }
+
+private:
+    uint64_t seedValue;
+    mt19937_64 streams[static_cast<int>(RandomStream::Count)];
+};
+
+extern SimRandom simRandom;
+
+// A seed for runs that did not ask for one
+uint64_t freshSeed();
+
+#endif
@@ -0,0 +1,762 @@
+#include "snapshot.h"
+#include "routecache.h"
+#include "trafficqueue.h"
+#include "logger.h"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char snapshotMagic[8] = {'S', 'R', 'S', 'N', 'A', 'P', 0, 1};
+
+static_assert(sizeof(SnapshotHeader) == 40, "snapshot layout");
+static_assert(sizeof(SnapshotSection) == 24, "snapshot layout");
+static_assert(sizeof(WorldRecord) == 16, "snapshot layout");
+static_assert(sizeof(NodeRecord) == 56, "snapshot layout");
+static_assert(sizeof(EdgeRecord) == 24, "snapshot layout");
+static_assert(sizeof(VehicleRecord) == 64, "snapshot layout");
+static_assert(sizeof(DriverRecord) == 80, "snapshot layout");
+static_assert(sizeof(RatingRecord) == 536, "snapshot layout");
+
+static const uint32_t knownRecordSizes[] = {
+    sizeof(WorldRecord), sizeof(NodeRecord), sizeof(EdgeRecord), sizeof(VehicleRecord),
+    sizeof(DriverRecord), sizeof(uint32_t), sizeof(RatingRecord), sizeof(char)
+};
+
+static uint32_t fnv1a(const char* data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+static size_t alignUp(size_t value)
+{
+    return (value + 7) & ~static_cast<size_t>(7);
+}
+
+// Capture
+
+void captureWorld(const WorldRefs& world, vector<char>& buffer)
+{
+    // Number nodes and edges in place (snapshotIndex) so turning the many
+    // pointers in vehicle paths into indices is a field read, not a lookup.
+    // An index only counts if the table slot points back at the object.
+    vector<Node*> allNodes(world.nodes.begin(), world.nodes.end());
+    size_t graphNodes = allNodes.size();
+    for (size_t i = 0; i < allNodes.size(); i++)
+    {
+        allNodes[i]->snapshotIndex = static_cast<int>(i);
+    }
+    for (TrafficIntersection* intersection : world.intersections)
+    {
+        int index = intersection->snapshotIndex;
+        if (index < 0 || index >= static_cast<int>(allNodes.size()) || allNodes[index] != intersection)
+        {
+            intersection->snapshotIndex = static_cast<int>(allNodes.size());
+            allNodes.push_back(intersection);
+        }
+    }
+
+    vector<const Edge*> edgeTable;
+    vector<EdgeRecord> edges;
+    vector<NodeRecord> nodes;
+    string strings;
+    nodes.reserve(allNodes.size());
+
+    auto addString = [&](const string& text, uint32_t& offset, uint32_t& length)
+    {
+        offset = static_cast<uint32_t>(strings.size());
+        length = static_cast<uint32_t>(text.size());
+        strings += text;
+    };
+    auto indexOf = [&](const Node* node) -> int32_t
+    {
+        bool listed = node && node->snapshotIndex >= 0 && node->snapshotIndex < static_cast<int>(allNodes.size()) &&
+                      allNodes[node->snapshotIndex] == node;
+        return listed ? node->snapshotIndex : -1;
+    };
+    auto edgeOf = [&](const Edge* edge) -> int32_t
+    {
+        bool listed = edge && edge->snapshotIndex >= 0 && edge->snapshotIndex < static_cast<int>(edgeTable.size()) &&
+                      edgeTable[edge->snapshotIndex] == edge;
+        return listed ? edge->snapshotIndex : -1;
+    };
+
+    for (size_t i = 0; i < allNodes.size(); i++)
+    {
+        Node* node = allNodes[i];
+        NodeRecord record = {};
+        record.id = node->id;
+        record.x = node->x;
+        record.y = node->y;
+        addString(node->name, record.nameOffset, record.nameLength);
+        record.role = i < graphNodes ? 0 : 1;
+        if (TrafficIntersection* intersection = dynamic_cast<TrafficIntersection*>(node))
+        {
+            record.intersectionType = intersection->type;
+            record.lightRecord4 = intersection->lightRecord4;
+            record.lightRecord3 = intersection->lightRecord3;
+            for (size_t s = 0; s < intersection->signals.size() && s < 32; s++)
+            {
+                record.signalBits |= intersection->signals[s] ? 1u << s : 0;
+            }
+        }
+
+        record.firstEdge = static_cast<uint32_t>(edges.size());
+        for (Edge* edge : node->edges)
+        {
+            // An edge pointing outside the snapshot cannot be restored
+            if (indexOf(edge->node1) < 0 || indexOf(edge->node2) < 0)
+            {
+                continue;
+            }
+            edge->snapshotIndex = static_cast<int>(edges.size());
+            edgeTable.push_back(edge);
+            edges.push_back({ static_cast<uint32_t>(indexOf(edge->node1)), static_cast<uint32_t>(indexOf(edge->node2)),
+                              edge->length, edge->width, edge->no_of_agents, edge->max_traffic });
+        }
+        record.edgeCount = static_cast<uint32_t>(edges.size()) - record.firstEdge;
+        nodes.push_back(record);
+    }
+
+    vector<VehicleRecord> vehicles;
+    vector<uint32_t> pathEdges;
+    auto addVehicle = [&](const Vehicle& vehicle)
+    {
+        VehicleRecord record = {};
+        record.id = vehicle.id;
+        addString(vehicle.type, record.typeOffset, record.typeLength);
+        record.length = vehicle.length;
+        record.x = vehicle.x;
+        record.y = vehicle.y;
+        record.speed = vehicle.speed;
+        record.currentNode = indexOf(vehicle.currentNode);
+        record.goalNode = indexOf(vehicle.goalNode);
+        record.currentEdge = edgeOf(vehicle.currentEdge);
+        record.nodeToReach = indexOf(vehicle.currentNodeToReach);
+        record.userGoalNode = indexOf(vehicle.userGoalNode);
+        record.pathOffset = static_cast<uint32_t>(pathEdges.size());
+        for (Edge* edge : vehicle.path)
+        {
+            int32_t index = edgeOf(edge);
+            if (index >= 0)
+            {
+                pathEdges.push_back(static_cast<uint32_t>(index));
+            }
+        }
+        record.pathCount = static_cast<uint32_t>(pathEdges.size()) - record.pathOffset;
+        record.reached = vehicle.hasReachedDestination;
+        record.pickingUp = vehicle.pickingUp;
+        record.color[0] = vehicle.color.r;
+        record.color[1] = vehicle.color.g;
+        record.color[2] = vehicle.color.b;
+        record.color[3] = vehicle.color.a;
+        vehicles.push_back(record);
+        return static_cast<int32_t>(vehicles.size() - 1);
+    };
+
+    vehicles.reserve(world.vehicles.size() + world.drivers.size());
+    for (const Vehicle& vehicle : world.vehicles)
+    {
+        addVehicle(vehicle);
+    }
+
+    vector<DriverRecord> drivers;
+    vector<RatingRecord> ratings;
+    for (const Driver* driver : world.drivers)
+    {
+        DriverRecord record = {};
+        addString(driver->name, record.nameOffset, record.nameLength);
+        addString(driver->email, record.emailOffset, record.emailLength);
+        addString(driver->phoneNumber, record.phoneOffset, record.phoneLength);
+        addString(driver->licenseNumber, record.licenseOffset, record.licenseLength);
+        addString(driver->vehicleType, record.typeOffset, record.typeLength);
+        record.age = driver->age;
+        record.gender = driver->gender;
+        record.availability = driver->availability;
+        record.reachedDestination = driver->reachedDestination;
+        record.yearsOfExperience = driver->yearsOfExperience;
+        record.ridesCompleted = driver->numberOfRidesCompleted;
+        record.averageRating = driver->averageRating;
+        record.currentNode = indexOf(driver->currentNode);
+        // Drivers own a copy of their vehicle, stored after the world's
+        record.vehicle = driver->assignedVehicle ? addVehicle(*driver->assignedVehicle) : -1;
+        record.ratingsOffset = static_cast<uint32_t>(ratings.size());
+        record.ratingsCount = 1;
+        RatingRecord rating = {};
+        rating.count = driver->ratings.getCount();
+        rating.mean = driver->ratings.getMean();
+        rating.m2 = driver->ratings.getM2();
+        rating.windowCount = static_cast<uint32_t>(driver->ratings.getWindowCount());
+        for (uint32_t r = 0; r < rating.windowCount; r++)
+        {
+            rating.window[r] = driver->ratings.windowTenths(r);
+        }
+        ratings.push_back(rating);
+        drivers.push_back(record);
+    }
+
+    WorldRecord worldRecord = {};
+    worldRecord.lightTick = world.lightTick;
+    worldRecord.worldVehicleCount = static_cast<uint32_t>(world.vehicles.size());
+
+    struct Part
+    {
+        SnapshotSectionId id;
+        const void* data;
+        uint32_t recordSize;
+        uint64_t count;
+    };
+    const Part parts[] = {
+        { SnapshotSectionId::World, &worldRecord, sizeof(WorldRecord), 1 },
+        { SnapshotSectionId::Nodes, nodes.data(), sizeof(NodeRecord), nodes.size() },
+        { SnapshotSectionId::Edges, edges.data(), sizeof(EdgeRecord), edges.size() },
+        { SnapshotSectionId::Vehicles, vehicles.data(), sizeof(VehicleRecord), vehicles.size() },
+        { SnapshotSectionId::Drivers, drivers.data(), sizeof(DriverRecord), drivers.size() },
+        { SnapshotSectionId::PathEdges, pathEdges.data(), sizeof(uint32_t), pathEdges.size() },
+        { SnapshotSectionId::Ratings, ratings.data(), sizeof(RatingRecord), ratings.size() },
+        { SnapshotSectionId::Strings, strings.data(), sizeof(char), strings.size() },
+    };
+    const uint32_t sectionCount = sizeof(parts) / sizeof(parts[0]);
+
+    size_t offset = alignUp(sizeof(SnapshotHeader) + sectionCount * sizeof(SnapshotSection));
+    SnapshotSection table[sectionCount];
+    for (uint32_t i = 0; i < sectionCount; i++)
+    {
+        table[i] = { static_cast<uint32_t>(parts[i].id), parts[i].recordSize, offset, parts[i].count };
+        offset = alignUp(offset + parts[i].recordSize * parts[i].count);
+    }
+
+    buffer.assign(offset, 0);
+    SnapshotHeader header = {};
+    memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+    header.version = snapshotVersion;
+    header.sectionCount = sectionCount;
+    header.createdAt = static_cast<uint64_t>(chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count());
+    header.fileBytes = offset;
+    header.headerBytes = sizeof(SnapshotHeader);
+    memcpy(buffer.data(), &header, sizeof(header));
+    memcpy(buffer.data() + sizeof(header), table, sizeof(table));
+    for (uint32_t i = 0; i < sectionCount; i++)
+    {
+        if (parts[i].count > 0)
+        {
+            memcpy(buffer.data() + table[i].offset, parts[i].data, parts[i].recordSize * parts[i].count);
+        }
+    }
+}
+
+void sealSnapshot(vector<char>& buffer)
+{
+    SnapshotHeader* header = reinterpret_cast<SnapshotHeader*>(buffer.data());
+    header->checksum = fnv1a(buffer.data() + sizeof(SnapshotHeader), buffer.size() - sizeof(SnapshotHeader));
+}
+
+// Loading
+
+SnapshotFile::SnapshotFile(const string& path) : data(nullptr), size(0), mapped(false), header(nullptr), valid(false)
+{
+#ifndef _WIN32
+    int descriptor = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (descriptor >= 0 && fstat(descriptor, &info) == 0 && info.st_size > 0)
+    {
+        void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (address != MAP_FAILED)
+        {
+            data = static_cast<const char*>(address);
+            size = static_cast<size_t>(info.st_size);
+            mapped = true;
+        }
+    }
+    if (descriptor >= 0)
+    {
+        close(descriptor);
+    }
+#endif
+    if (!mapped)
+    {
+        ifstream file(path, ios::binary);
+        if (file)
+        {
+            copy.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+            data = copy.data();
+            size = copy.size();
+        }
+    }
+
+    if (!data)
+    {
+        error = "cannot open " + path;
+        return;
+    }
+    valid = validate();
+}
+
+SnapshotFile::~SnapshotFile()
+{
+#ifndef _WIN32
+    if (mapped)
+    {
+        munmap(const_cast<char*>(data), size);
+    }
+#endif
+}
+
+bool SnapshotFile::validate()
+{
+    if (size < sizeof(SnapshotHeader) || memcmp(data, snapshotMagic, sizeof(snapshotMagic)) != 0)
+    {
+        error = "not a snapshot file";
+        return false;
+    }
+    header = reinterpret_cast<const SnapshotHeader*>(data);
+    if (header->version == 0 || header->version > snapshotVersion)
+    {
+        error = "unsupported snapshot version " + to_string(header->version);
+        return false;
+    }
+    if (header->fileBytes != size || header->headerBytes < sizeof(SnapshotHeader) ||
+        header->headerBytes + static_cast<uint64_t>(header->sectionCount) * sizeof(SnapshotSection) > size)
+    {
+        error = "truncated snapshot";
+        return false;
+    }
+    if (fnv1a(data + sizeof(SnapshotHeader), size - sizeof(SnapshotHeader)) != header->checksum)
+    {
+        error = "snapshot checksum mismatch";
+        return false;
+    }
+
+    const SnapshotSection* table = reinterpret_cast<const SnapshotSection*>(data + header->headerBytes);
+    for (uint32_t i = 0; i < header->sectionCount; i++)
+    {
+        const SnapshotSection& entry = table[i];
+        bool known = entry.id < static_cast<uint32_t>(SnapshotSectionId::Count);
+        bool legacyRatings = header->version < 2 && entry.id == static_cast<uint32_t>(SnapshotSectionId::Ratings);
+        uint32_t minimumSize = known ? (legacyRatings ? sizeof(double) : knownRecordSizes[entry.id]) : 0;
+        if (entry.offset % 8 != 0 || entry.offset > size || (entry.recordSize && entry.count > (size - entry.offset) / entry.recordSize) ||
+            entry.recordSize < minimumSize)
+        {
+            error = "corrupt section table";
+            return false;
+        }
+    }
+    return true;
+}
+
+const char* SnapshotFile::section(SnapshotSectionId id, uint64_t& count, uint32_t& recordSize) const
+{
+    count = 0;
+    recordSize = 0;
+    if (!valid)
+    {
+        return nullptr;
+    }
+    const SnapshotSection* table = reinterpret_cast<const SnapshotSection*>(data + header->headerBytes);
+    for (uint32_t i = 0; i < header->sectionCount; i++)
+    {
+        if (table[i].id == static_cast<uint32_t>(id))
+        {
+            count = table[i].count;
+            recordSize = table[i].recordSize;
+            return data + table[i].offset;
+        }
+    }
+    return nullptr;
+}
+
+// Typed, stride-aware view of one section
+template <typename T>
+struct SectionView
+{
+    const char* base = nullptr;
+    uint64_t count = 0;
+    uint32_t stride = 0;
+
+    const T& operator[](uint64_t i) const { return *reinterpret_cast<const T*>(base + i * stride); }
+};
+
+template <typename T>
+static SectionView<T> viewOf(const SnapshotFile& snapshot, SnapshotSectionId id)
+{
+    SectionView<T> view;
+    view.base = snapshot.section(id, view.count, view.stride);
+    return view;
+}
+
+bool restoreWorld(const SnapshotFile& snapshot, WorldRefs& world, string& error)
+{
+    if (!snapshot.isValid())
+    {
+        error = snapshot.getError();
+        return false;
+    }
+
+    SectionView<WorldRecord> worldSection = viewOf<WorldRecord>(snapshot, SnapshotSectionId::World);
+    SectionView<NodeRecord> nodeRecords = viewOf<NodeRecord>(snapshot, SnapshotSectionId::Nodes);
+    SectionView<EdgeRecord> edgeRecords = viewOf<EdgeRecord>(snapshot, SnapshotSectionId::Edges);
+    SectionView<VehicleRecord> vehicleRecords = viewOf<VehicleRecord>(snapshot, SnapshotSectionId::Vehicles);
+    SectionView<DriverRecord> driverRecords = viewOf<DriverRecord>(snapshot, SnapshotSectionId::Drivers);
+    SectionView<uint32_t> pathEdges = viewOf<uint32_t>(snapshot, SnapshotSectionId::PathEdges);
+    SectionView<RatingRecord> ratings = viewOf<RatingRecord>(snapshot, SnapshotSectionId::Ratings);
+    SectionView<double> legacyRatings = viewOf<double>(snapshot, SnapshotSectionId::Ratings); // Version 1: every rating
+    SectionView<char> strings = viewOf<char>(snapshot, SnapshotSectionId::Strings);
+    if (worldSection.count != 1 || !nodeRecords.base || !edgeRecords.base || !vehicleRecords.base || !driverRecords.base ||
+        !pathEdges.base || !ratings.base || !strings.base)
+    {
+        error = "snapshot is missing sections";
+        return false;
+    }
+    const WorldRecord& worldRecord = worldSection[0];
+
+    // Validate every index up front so a bad file never leaves a half-restored world
+    bool indicesOk = worldRecord.worldVehicleCount <= vehicleRecords.count;
+    auto text = [&](uint32_t offset, uint32_t length) -> string
+    {
+        if (static_cast<uint64_t>(offset) + length > strings.count)
+        {
+            indicesOk = false;
+            return string();
+        }
+        return string(strings.base + offset, length);
+    };
+    auto nodeOk = [&](int32_t index) { return index >= -1 && index < static_cast<int64_t>(nodeRecords.count); };
+    auto edgeOk = [&](int32_t index) { return index >= -1 && index < static_cast<int64_t>(edgeRecords.count); };
+    for (uint64_t i = 0; i < nodeRecords.count; i++)
+    {
+        const NodeRecord& node = nodeRecords[i];
+        indicesOk = indicesOk && static_cast<uint64_t>(node.firstEdge) + node.edgeCount <= edgeRecords.count;
+        text(node.nameOffset, node.nameLength);
+    }
+    for (uint64_t i = 0; i < edgeRecords.count; i++)
+    {
+        indicesOk = indicesOk && edgeRecords[i].node1 < nodeRecords.count && edgeRecords[i].node2 < nodeRecords.count;
+    }
+    for (uint64_t i = 0; i < vehicleRecords.count; i++)
+    {
+        const VehicleRecord& vehicle = vehicleRecords[i];
+        indicesOk = indicesOk && nodeOk(vehicle.currentNode) && nodeOk(vehicle.goalNode) && nodeOk(vehicle.nodeToReach) &&
+                    nodeOk(vehicle.userGoalNode) && edgeOk(vehicle.currentEdge) &&
+                    static_cast<uint64_t>(vehicle.pathOffset) + vehicle.pathCount <= pathEdges.count;
+    }
+    for (uint64_t i = 0; i < pathEdges.count; i++)
+    {
+        indicesOk = indicesOk && pathEdges[i] < edgeRecords.count;
+    }
+    for (uint64_t i = 0; i < driverRecords.count; i++)
+    {
+        const DriverRecord& driver = driverRecords[i];
+        indicesOk = indicesOk && nodeOk(driver.currentNode) && driver.vehicle >= -1 && driver.vehicle < static_cast<int64_t>(vehicleRecords.count) &&
+                    static_cast<uint64_t>(driver.ratingsOffset) + driver.ratingsCount <= ratings.count;
+        text(driver.emailOffset, driver.emailLength);
+    }
+    if (!indicesOk)
+    {
+        error = "snapshot references out of range";
+        return false;
+    }
+
+    // Resolve nodes and edges, building them if the world is empty
+    vector<Node*> nodes(nodeRecords.count, nullptr);
+    vector<Edge*> edges(edgeRecords.count, nullptr);
+    bool rebuild = world.nodes.empty() && world.intersections.empty();
+    if (rebuild)
+    {
+        for (uint64_t i = 0; i < nodeRecords.count; i++)
+        {
+            const NodeRecord& record = nodeRecords[i];
+            string name = text(record.nameOffset, record.nameLength);
+            if (record.intersectionType != 0)
+            {
+                nodes[i] = new TrafficIntersection(record.id, record.x, record.y, name, record.intersectionType);
+            }
+            else
+            {
+                nodes[i] = new Node(record.id, record.x, record.y, name);
+            }
+        }
+        for (uint64_t i = 0; i < nodeRecords.count; i++)
+        {
+            const NodeRecord& record = nodeRecords[i];
+            for (uint32_t e = record.firstEdge; e < record.firstEdge + record.edgeCount; e++)
+            {
+                const EdgeRecord& edgeRecord = edgeRecords[e];
+                Node* other = nodes[edgeRecord.node1 == i ? edgeRecord.node2 : edgeRecord.node1];
+                edges[e] = new Edge(nodes[edgeRecord.node1], nodes[edgeRecord.node2], edgeRecord.width);
+                nodes[i]->edges.push_back(edges[e]);
+                nodes[i]->neighbors.push_back(other);
+            }
+        }
+    }
+    else
+    {
+        unordered_map<int, Node*> graphById, signalById;
+        for (Node* node : world.nodes)
+        {
+            graphById[node->id] = node;
+        }
+        for (TrafficIntersection* intersection : world.intersections)
+        {
+            signalById[intersection->id] = intersection;
+        }
+        for (uint64_t i = 0; i < nodeRecords.count; i++)
+        {
+            const NodeRecord& record = nodeRecords[i];
+            unordered_map<int, Node*>& byId = record.role == 0 ? graphById : signalById;
+            auto found = byId.find(record.id);
+            if (found == byId.end() || found->second->edges.size() != record.edgeCount)
+            {
+                error = "snapshot map differs from the current one at node " + to_string(record.id);
+                return false;
+            }
+            nodes[i] = found->second;
+        }
+        for (uint64_t i = 0; i < nodeRecords.count; i++)
+        {
+            const NodeRecord& record = nodeRecords[i];
+            for (uint32_t k = 0; k < record.edgeCount; k++)
+            {
+                const EdgeRecord& edgeRecord = edgeRecords[record.firstEdge + k];
+                Edge* edge = nodes[i]->edges[k];
+                if (edge->node1 != nodes[edgeRecord.node1] || edge->node2 != nodes[edgeRecord.node2])
+                {
+                    error = "snapshot map differs from the current one at an edge of node " + to_string(record.id);
+                    return false;
+                }
+                edges[record.firstEdge + k] = edge;
+            }
+        }
+    }
+    for (Edge* edge : edges)
+    {
+        if (!edge)
+        {
+            error = "snapshot has an edge no node owns";
+            return false;
+        }
+    }
+
+    // From here on the world is overwritten
+    if (rebuild)
+    {
+        for (uint64_t i = 0; i < nodeRecords.count; i++)
+        {
+            if (nodeRecords[i].role == 0)
+            {
+                world.nodes.push_back(nodes[i]);
+            }
+            else if (TrafficIntersection* intersection = dynamic_cast<TrafficIntersection*>(nodes[i]))
+            {
+                world.intersections.push_back(intersection);
+            }
+        }
+    }
+
+    for (uint64_t i = 0; i < nodeRecords.count; i++)
+    {
+        const NodeRecord& record = nodeRecords[i];
+        if (TrafficIntersection* intersection = dynamic_cast<TrafficIntersection*>(nodes[i]))
+        {
+            intersection->lightRecord4 = record.lightRecord4;
+            intersection->lightRecord3 = record.lightRecord3;
+            for (size_t s = 0; s < intersection->signals.size() && s < 32; s++)
+            {
+                intersection->signals[s] = (record.signalBits >> s) & 1;
+            }
+        }
+    }
+    for (uint64_t e = 0; e < edgeRecords.count; e++)
+    {
+        const EdgeRecord& record = edgeRecords[e];
+        edges[e]->length = record.length;
+        edges[e]->width = record.width;
+        edges[e]->no_of_agents = record.agents;
+        edges[e]->max_traffic = record.maxTraffic;
+    }
+
+    auto nodeAt = [&](int32_t index) { return index < 0 ? nullptr : nodes[index]; };
+    vector<Vehicle> vehicles(vehicleRecords.count);
+    for (uint64_t i = 0; i < vehicleRecords.count; i++)
+    {
+        const VehicleRecord& record = vehicleRecords[i];
+        Vehicle& vehicle = vehicles[i];
+        vehicle.id = record.id;
+        vehicle.type = text(record.typeOffset, record.typeLength);
+        vehicle.vehicleClass = vehicleClassOf(vehicle.type);
+        vehicle.length = record.length;
+        vehicle.x = record.x;
+        vehicle.y = record.y;
+        vehicle.speed = record.speed;
+        vehicle.currentNode = nodeAt(record.currentNode);
+        vehicle.goalNode = nodeAt(record.goalNode);
+        vehicle.currentEdge = record.currentEdge < 0 ? nullptr : edges[record.currentEdge];
+        vehicle.currentNodeToReach = nodeAt(record.nodeToReach);
+        vehicle.userGoalNode = nodeAt(record.userGoalNode);
+        vehicle.path.reserve(record.pathCount);
+        for (uint32_t p = 0; p < record.pathCount; p++)
+        {
+            vehicle.path.push_back(edges[pathEdges[record.pathOffset + p]]);
+        }
+        vehicle.hasReachedDestination = record.reached;
+        vehicle.pickingUp = record.pickingUp;
+        vehicle.color = Color{ record.color[0], record.color[1], record.color[2], record.color[3] };
+    }
+    // Restored vehicles rejoin their edge queues on their next move
+    traffic.clear();
+    world.vehicles.assign(vehicles.begin(), vehicles.begin() + worldRecord.worldVehicleCount);
+
+    unordered_map<string, Driver*> driversByEmail;
+    for (Driver* driver : world.drivers)
+    {
+        driversByEmail[driver->email] = driver;
+    }
+    for (uint64_t i = 0; i < driverRecords.count; i++)
+    {
+        const DriverRecord& record = driverRecords[i];
+        string email = text(record.emailOffset, record.emailLength);
+        Driver*& driver = driversByEmail[email];
+        if (!driver)
+        {
+            driver = new Driver();
+            world.drivers.push_back(driver);
+        }
+        driver->name = text(record.nameOffset, record.nameLength);
+        driver->email = email;
+        driver->phoneNumber = text(record.phoneOffset, record.phoneLength);
+        driver->licenseNumber = text(record.licenseOffset, record.licenseLength);
+        driver->vehicleType = text(record.typeOffset, record.typeLength);
+        driver->vehicleClass = vehicleClassOf(driver->vehicleType);
+        driver->age = record.age;
+        driver->gender = record.gender;
+        driver->availability = record.availability;
+        driver->reachedDestination = record.reachedDestination;
+        driver->yearsOfExperience = record.yearsOfExperience;
+        driver->numberOfRidesCompleted = record.ridesCompleted;
+        driver->averageRating = record.averageRating;
+        driver->currentNode = nodeAt(record.currentNode);
+        if (snapshot.getVersion() < 2)
+        {
+            driver->ratings = RatingStats();
+            for (uint32_t r = 0; r < record.ratingsCount; r++)
+            {
+                driver->ratings.add(legacyRatings[record.ratingsOffset + r]);
+            }
+        }
+        else if (record.ratingsCount > 0)
+        {
+            const RatingRecord& rating = ratings[record.ratingsOffset];
+            size_t windowCount = min<size_t>(rating.windowCount, RatingStats::windowSize);
+            driver->ratings.restore(rating.count, rating.mean, rating.m2, rating.window, windowCount);
+        }
+        driver->assignedVehicle = record.vehicle < 0 ? nullptr : new Vehicle(vehicles[record.vehicle]);
+    }
+
+    world.lightTick = worldRecord.lightTick;
+    routeCache.bumpEpoch(); // Occupancy changed wholesale
+    return true;
+}
+
+// Background writer
+
+SnapshotWriter::SnapshotWriter() : busy(false), running(true), saved(0), lastCapture(0)
+{
+    worker = thread(&SnapshotWriter::run, this);
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        running = false;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+bool SnapshotWriter::save(const WorldRefs& world, const string& path)
+{
+    {
+        lock_guard<mutex> guard(lock);
+        if (busy)
+        {
+            return false;
+        }
+    }
+
+    // Only the capture runs here; the spare buffer is not touched by the
+    // writer while it is idle
+    auto started = chrono::steady_clock::now();
+    captureWorld(world, spare);
+    lastCapture = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - started).count());
+
+    {
+        lock_guard<mutex> guard(lock);
+        buffer.swap(spare);
+        pendingPath = path;
+        busy = true;
+    }
+    wake.notify_one();
+    return true;
+}
+
+void SnapshotWriter::waitIdle()
+{
+    unique_lock<mutex> guard(lock);
+    idle.wait(guard, [this] { return !busy; });
+}
+
+void SnapshotWriter::run()
+{
+    unique_lock<mutex> guard(lock);
+    while (true)
+    {
+        wake.wait(guard, [this] { return busy || !running; });
+        if (!busy)
+        {
+            break;
+        }
+        string path = pendingPath;
+        guard.unlock();
+
+        // Write beside the target and rename, so a crash never leaves a torn snapshot
+        sealSnapshot(buffer);
+        string temporary = path + ".tmp";
+        bool written = false;
+        {
+            ofstream file(temporary, ios::binary | ios::trunc);
+            file.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+            written = static_cast<bool>(file);
+        }
+        error_code error;
+        if (written)
+        {
+            filesystem::rename(temporary, path, error);
+        }
+        if (!written || error)
+        {
+            LOG_ERROR("Error writing snapshot %s", path.c_str());
+        }
+        else
+        {
+            LOG_INFO("Snapshot %s written, %zu bytes, captured in %.1f us", path.c_str(), buffer.size(), lastCapture.load() / 1000.0);
+            saved++;
+        }
+
+        guard.lock();
+        busy = false;
+        idle.notify_all();
+    }
+}
@@ -0,0 +1,209 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "driver.h"
+#include "node.h"
+#include "vehicle.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Everything a snapshot covers. Signal-only intersections are drawn but not
+// part of the routing graph, so they are listed separately.
+struct WorldRefs
+{
+    vector<Node*>& nodes;
+    vector<TrafficIntersection*>& intersections;
+    vector<Vehicle>& vehicles;
+    vector<Driver*>& drivers;
+    int lightTick = 0; // Frames since the last signal change
+};
+
+// File layout, all little endian and 8-byte aligned so a mapped file can be
+// read in place:
+//   SnapshotHeader
+//   SnapshotSection[sectionCount]   id, record size, offset, count
+//   sections                        arrays of the fixed-size records below
+// Pointers are stored as indices into the node, edge and vehicle arrays
+// (-1 for null). Readers step through sections by the stored record size,
+// so a later version can append fields without breaking old files.
+// Version 2 stores ratings as one RatingRecord per driver; version 1 files
+// (a list of every rating) are still read.
+const uint32_t snapshotVersion = 2;
+
+enum class SnapshotSectionId : uint32_t
+{
+    World,
+    Nodes,
+    Edges,
+    Vehicles,
+    Drivers,
+    PathEdges, // uint32 edge indices, sliced per vehicle
+    Ratings,   // RatingRecord, one per driver
+    Strings,   // char, sliced by offset/length pairs
+    Count
+};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t createdAt;   // Milliseconds since the Unix epoch
+    uint64_t fileBytes;
+    uint32_t checksum;    // FNV-1a over everything after the header
+    uint32_t headerBytes;
+};
+
+struct SnapshotSection
+{
+    uint32_t id;
+    uint32_t recordSize;
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct WorldRecord
+{
+    int32_t lightTick;
+    uint32_t worldVehicleCount; // Vehicles after these belong to drivers only
+    uint64_t reserved;
+};
+
+struct NodeRecord
+{
+    int32_t id;
+    float x, y;
+    uint32_t nameOffset, nameLength;
+    int32_t role;             // 0 routing graph, 1 signal-only intersection
+    int32_t intersectionType; // 0 for a plain node, otherwise 3 or 4
+    int32_t lightRecord4, lightRecord3;
+    uint32_t signalBits;
+    uint32_t firstEdge, edgeCount; // This node's outgoing edges, in order
+    uint32_t reserved[2];
+};
+
+struct EdgeRecord
+{
+    uint32_t node1, node2;
+    float length, width;
+    int32_t agents, maxTraffic;
+};
+
+struct VehicleRecord
+{
+    int32_t id;
+    uint32_t typeOffset, typeLength;
+    float length, x, y, speed;
+    int32_t currentNode, goalNode, currentEdge, nodeToReach, userGoalNode;
+    uint32_t pathOffset, pathCount;
+    uint8_t reached, pickingUp, reserved[2];
+    uint8_t color[4];
+};
+
+struct DriverRecord
+{
+    uint32_t nameOffset, nameLength;
+    uint32_t emailOffset, emailLength;
+    uint32_t phoneOffset, phoneLength;
+    uint32_t licenseOffset, licenseLength;
+    uint32_t typeOffset, typeLength;
+    int32_t age;
+    uint8_t gender, availability, reachedDestination, reserved;
+    int32_t yearsOfExperience, ridesCompleted;
+    double averageRating;
+    int32_t currentNode, vehicle;
+    uint32_t ratingsOffset, ratingsCount; // Record index and 1 (version 1: a slice of doubles)
+};
+
+// A driver's RatingStats: lifetime moments and the recent window, oldest first
+struct RatingRecord
+{
+    uint64_t count;
+    double mean, m2;
+    uint32_t windowCount;
+    uint8_t window[RatingStats::windowSize];
+    uint8_t reserved[4];
+};
+
+// Flattens the world into one buffer. This is the only part that runs on the
+// tick thread: a linear copy with no I/O, reusing the buffer's capacity.
+void captureWorld(const WorldRefs& world, vector<char>& buffer);
+
+// Fills in the header checksum; done by the writer, off the tick thread
+void sealSnapshot(vector<char>& buffer);
+
+// A snapshot file mapped (or read) into memory and validated
+class SnapshotFile
+{
+public:
+    explicit SnapshotFile(const string& path);
+    ~SnapshotFile();
+
+    bool isValid() const { return valid; }
+    const string& getError() const { return error; }
+    uint64_t getCreatedAt() const { return header ? header->createdAt : 0; }
+    uint32_t getVersion() const { return header ? header->version : 0; }
+
+    // Start of a section and its record count/stride, nullptr if absent
+    const char* section(SnapshotSectionId id, uint64_t& count, uint32_t& recordSize) const;
+
+    SnapshotFile(const SnapshotFile&) = delete;
+    SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+private:
+    bool validate();
+
+    const char* data;
+    size_t size;
+    bool mapped;
+    vector<char> copy; // Used where mmap is unavailable
+    const SnapshotHeader* header;
+    bool valid;
+    string error;
+};
+
+// Applies a snapshot. With empty node lists the graph is rebuilt from the
+// file; otherwise the current graph must have the same topology and only its
+// state (occupancy, signals) is overwritten. Vehicles are replaced, drivers
+// are updated by email and unknown ones added.
+bool restoreWorld(const SnapshotFile& snapshot, WorldRefs& world, string& error);
+
+// Writes snapshots on a background thread. save() captures and returns at
+// once; a save requested while the previous one is still being written is
+// skipped rather than queued.
+class SnapshotWriter
+{
+public:
+    SnapshotWriter();
+    ~SnapshotWriter();
+
+    bool save(const WorldRefs& world, const string& path);
+    void waitIdle();
+
+    uint64_t getSaved() const { return saved.load(); }
+    uint64_t getLastCaptureNanoseconds() const { return lastCapture.load(); }
+
+private:
+    void run();
+
+    mutex lock;
+    condition_variable wake;
+    condition_variable idle;
+    vector<char> buffer;     // Being written
+    vector<char> spare;      // Capacity kept for the next capture
+    string pendingPath;
+    bool busy;
+    bool running;
+    atomic<uint64_t> saved;
+    atomic<uint64_t> lastCapture;
+    thread worker;
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include "spatialgrid.h"
+#include <algorithm>
+#include <cmath>
+
+SpatialGrid::SpatialGrid() : bounds{ 0, 0, 1, 1 }, cellSize(1), columns(1), rows(1), cellStart(2, 0), stamp(0), boxes(false) {}
+
+void SpatialGrid::reset(const GridBox& area, size_t itemCount, double targetPerCell)
+{
+    bounds = area;
+    float width = max(area.maxX - area.minX, 1.0f);
+    float height = max(area.maxY - area.minY, 1.0f);
+    double cells = max(1.0, static_cast<double>(itemCount) / targetPerCell);
+    cellSize = static_cast<float>(sqrt(static_cast<double>(width) * height / cells));
+    cellSize = max(cellSize, max(width, height) / 1024.0f); // At most 1024 cells a side
+    columns = max(1, static_cast<int>(ceil(width / cellSize)));
+    rows = max(1, static_cast<int>(ceil(height / cellSize)));
+    cellStart.assign(static_cast<size_t>(columns) * rows + 1, 0);
+    items.clear();
+}
+
+int SpatialGrid::cellX(float x) const
+{
+    return min(columns - 1, max(0, static_cast<int>((x - bounds.minX) / cellSize)));
+}
+
+int SpatialGrid::cellY(float y) const
+{
+    return min(rows - 1, max(0, static_cast<int>((y - bounds.minY) / cellSize)));
+}
+
+void SpatialGrid::buildBoxes(const vector<GridBox>& list)
+{
+    boxes = true;
+    fill(cellStart.begin(), cellStart.end(), 0);
+    for (const GridBox& box : list)
+    {
+        for (int cy = cellY(box.minY); cy <= cellY(box.maxY); cy++)
+        {
+            for (int cx = cellX(box.minX); cx <= cellX(box.maxX); cx++)
+            {
+                cellStart[static_cast<size_t>(cy) * columns + cx + 1]++;
+            }
+        }
+    }
+    for (size_t c = 1; c < cellStart.size(); c++)
+    {
+        cellStart[c] += cellStart[c - 1];
+    }
+    items.resize(cellStart.back());
+    vector<uint32_t> cursor(cellStart.begin(), cellStart.end() - 1);
+    for (uint32_t id = 0; id < list.size(); id++)
+    {
+        const GridBox& box = list[id];
+        for (int cy = cellY(box.minY); cy <= cellY(box.maxY); cy++)
+        {
+            for (int cx = cellX(box.minX); cx <= cellX(box.maxX); cx++)
+            {
+                items[cursor[static_cast<size_t>(cy) * columns + cx]++] = id;
+            }
+        }
+    }
+    seen.assign(list.size(), 0);
+    stamp = 0;
+}
+
+void SpatialGrid::buildPoints(const vector<GridPoint>& points)
+{
+    boxes = false;
+    fill(cellStart.begin(), cellStart.end(), 0);
+    for (const GridPoint& point : points)
+    {
+        cellStart[static_cast<size_t>(cellY(point.y)) * columns + cellX(point.x) + 1]++;
+    }
+    for (size_t c = 1; c < cellStart.size(); c++)
+    {
+        cellStart[c] += cellStart[c - 1];
+    }
+    items.resize(points.size());
+    // Fill back to front so each cell keeps its points in id order
+    for (size_t id = points.size(); id-- > 0;)
+    {
+        size_t cell = static_cast<size_t>(cellY(points[id].y)) * columns + cellX(points[id].x);
+        items[--cellStart[cell + 1]] = static_cast<uint32_t>(id);
+    }
+    // The decrements left each entry at its cell's start; shift back into offsets
+    for (size_t c = 0; c + 1 < cellStart.size(); c++)
+    {
+        cellStart[c] = cellStart[c + 1];
+    }
+    cellStart.back() = static_cast<uint32_t>(points.size());
+}
+
+void SpatialGrid::cellRange(const GridBox& area, int& x0, int& y0, int& x1, int& y1) const
+{
+    x0 = cellX(area.minX);
+    y0 = cellY(area.minY);
+    x1 = cellX(area.maxX);
+    y1 = cellY(area.maxY);
+}
+
+void SpatialGrid::query(const GridBox& area, vector<uint32_t>& out)
+{
+    out.clear();
+    if (area.maxX < bounds.minX || area.minX > bounds.maxX || area.maxY < bounds.minY || area.minY > bounds.maxY)
+    {
+        return;
+    }
+    if (boxes && ++stamp == 0)
+    {
+        fill(seen.begin(), seen.end(), 0);
+        stamp = 1;
+    }
+    int x0, y0, x1, y1;
+    cellRange(area, x0, y0, x1, y1);
+    for (int cy = y0; cy <= y1; cy++)
+    {
+        for (int cx = x0; cx <= x1; cx++)
+        {
+            size_t cell = static_cast<size_t>(cy) * columns + cx;
+            for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; i++)
+            {
+                uint32_t id = items[i];
+                if (boxes)
+                {
+                    if (seen[id] == stamp)
+                    {
+                        continue;
+                    }
+                    seen[id] = stamp;
+                }
+                out.push_back(id);
+            }
+        }
+    }
+}
+
+void SpatialGrid::queryCells(const GridBox& area, vector<uint32_t>& out) const
+{
+    out.clear();
+    if (area.maxX < bounds.minX || area.minX > bounds.maxX || area.maxY < bounds.minY || area.minY > bounds.maxY)
+    {
+        return;
+    }
+    int x0, y0, x1, y1;
+    cellRange(area, x0, y0, x1, y1);
+    for (int cy = y0; cy <= y1; cy++)
+    {
+        for (int cx = x0; cx <= x1; cx++)
+        {
+            size_t cell = static_cast<size_t>(cy) * columns + cx;
+            out.insert(out.end(), items.begin() + cellStart[cell], items.begin() + cellStart[cell + 1]);
+        }
+    }
+}
+
+uint32_t SpatialGrid::cellItems(int cx, int cy) const
+{
+    size_t cell = static_cast<size_t>(cy) * columns + cx;
+    return cellStart[cell + 1] - cellStart[cell];
+}
+
+GridBox SpatialGrid::cellBox(int cx, int cy) const
+{
+    float x = bounds.minX + cx * cellSize;
+    float y = bounds.minY + cy * cellSize;
+    return GridBox{ x, y, x + cellSize, y + cellSize };
+}
@@ -0,0 +1,68 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+struct GridBox
+{
+    float minX, minY, maxX, maxY;
+};
+
+struct GridPoint
+{
+    float x, y;
+};
+
+// Uniform grid over a fixed area. Items are bucketed per cell into one flat
+// array (cell start offsets plus item ids), built with a counting sort, so a
+// rebuild is two linear passes and allocates nothing once warmed up. Boxes
+// (roads) are listed in every cell they touch; points (vehicles) in one.
+class SpatialGrid
+{
+public:
+    SpatialGrid();
+
+    // Picks about targetPerCell items per cell for the given item count
+    void reset(const GridBox& bounds, size_t itemCount, double targetPerCell = 2);
+
+    void buildBoxes(const vector<GridBox>& boxes);
+    void buildPoints(const vector<GridPoint>& points);
+
+    // Ids of the items in cells overlapping the area, each once, in id order
+    // per cell. Callers wanting exact overlap test the items themselves.
+    void query(const GridBox& area, vector<uint32_t>& out);
+
+    // Const version for concurrent readers: nothing is stamped, so a box
+    // touching several of the cells is listed once per cell
+    void queryCells(const GridBox& area, vector<uint32_t>& out) const;
+
+    // Cells overlapping the area, clamped to the grid
+    void cellRange(const GridBox& area, int& x0, int& y0, int& x1, int& y1) const;
+    uint32_t cellItems(int cx, int cy) const;
+    GridBox cellBox(int cx, int cy) const;
+
+    int getColumns() const { return columns; }
+    int getRows() const { return rows; }
+    float getCellSize() const { return cellSize; }
+    const GridBox& getBounds() const { return bounds; }
+
+private:
+    int cellX(float x) const;
+    int cellY(float y) const;
+
+    GridBox bounds;
+    float cellSize;
+    int columns;
+    int rows;
+    vector<uint32_t> cellStart; // columns * rows + 1 offsets into items
+    vector<uint32_t> items;
+    vector<uint32_t> seen;      // Query stamp per item, removes duplicate boxes
+    uint32_t stamp;
+    bool boxes;
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+// Bounded lock-free single-producer/single-consumer ring buffer. tryPush fails
+// when the ring is full, which is how pipeline stages apply backpressure to
+// the stage in front of them. Capacity is rounded up to a power of two.
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t requestedCapacity)
+    {
+        size_t capacity = 2;
+        while (capacity < requestedCapacity)
+        {
+            capacity <<= 1;
+        }
+        slots.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    // Producer side
+    bool tryPush(T&& item)
+    {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t - headCache == slots.size())
+        {
+            headCache = head.load(memory_order_acquire);
+            if (t - headCache == slots.size())
+            {
+                return false; // Full
+            }
+        }
+        slots[t & mask] = move(item);
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool tryPop(T& item)
+    {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == tailCache)
+        {
+            tailCache = tail.load(memory_order_acquire);
+            if (h == tailCache)
+            {
+                return false; // Empty
+            }
+        }
+        item = move(slots[h & mask]);
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+    size_t sizeApprox() const
+    {
+        return tail.load(memory_order_acquire) - head.load(memory_order_acquire);
+    }
+
+    size_t capacity() const { return slots.size(); }
+
+private:
+    vector<T> slots;
+    size_t mask;
+
+    alignas(64) atomic<size_t> head{ 0 }; // Next slot to read, written by the consumer
+    size_t tailCache = 0;                 // Consumer's last view of tail
+    alignas(64) atomic<size_t> tail{ 0 }; // Next slot to write, written by the producer
+    size_t headCache = 0;                 // Producer's last view of head
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "threadpool.h"
+
+static thread_local int workerIndexOfThread = -1;
+
+ThreadPool::ThreadPool(int workerCount) : queues(workerCount > 0 ? workerCount : max(1u, thread::hardware_concurrency())), pending(0), queued(0), nextQueue(0)
+{
+    for (size_t i = 0; i < queues.size(); i++)
+    {
+        workers.emplace_back(&ThreadPool::workerLoop, this, static_cast<int>(i));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    waitIdle();
+    {
+        lock_guard<mutex> guard(sleepLock);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(Task task)
+{
+    submitTo(static_cast<int>(nextQueue.fetch_add(1, memory_order_relaxed) % queues.size()), move(task));
+}
+
+void ThreadPool::submitTo(int workerIndex, Task task)
+{
+    pending.fetch_add(1, memory_order_acq_rel);
+    {
+        WorkerQueue& queue = queues[workerIndex % queues.size()];
+        lock_guard<mutex> guard(queue.lock);
+        queue.tasks.push_back(move(task));
+        queued.fetch_add(1, memory_order_release);
+    }
+    {
+        // Taking the sleep lock orders this wake-up after a worker's emptiness check
+        lock_guard<mutex> guard(sleepLock);
+    }
+    wakeUp.notify_all();
+    idle.notify_all(); // Workers waiting on a group help with new work
+}
+
+void ThreadPool::waitIdle()
+{
+    unique_lock<mutex> guard(sleepLock);
+    idle.wait(guard, [this] { return pending.load(memory_order_acquire) == 0; });
+}
+
+void ThreadPool::run(int index, Task& task)
+{
+    task(index);
+    task = nullptr;
+    if (pending.fetch_sub(1, memory_order_acq_rel) == 1)
+    {
+        lock_guard<mutex> guard(sleepLock);
+        idle.notify_all();
+    }
+}
+
+void ThreadPool::groupFinished()
+{
+    lock_guard<mutex> guard(sleepLock);
+    idle.notify_all();
+}
+
+void ThreadPool::waitFor(const atomic<size_t>& remaining)
+{
+    int self = currentWorker();
+    Task task;
+    while (remaining.load(memory_order_acquire) > 0)
+    {
+        // A worker blocking here would hold back the very tasks it waits on
+        if (self >= 0 && (popLocal(self, task) || steal(self, task)))
+        {
+            run(self, task);
+            continue;
+        }
+        unique_lock<mutex> guard(sleepLock);
+        idle.wait(guard, [&] {
+            return remaining.load(memory_order_acquire) == 0 || (self >= 0 && queued.load(memory_order_acquire) > 0);
+        });
+    }
+}
+
+void TaskGroup::submit(ThreadPool::Task task)
+{
+    remaining.fetch_add(1, memory_order_acq_rel);
+    ThreadPool& owner = pool;
+    atomic<size_t>& count = remaining;
+    pool.submit([&owner, &count, task = move(task)](int workerIndex) {
+        task(workerIndex);
+        // The group may be gone once its count reaches zero: only the pool is touched after
+        if (count.fetch_sub(1, memory_order_acq_rel) == 1)
+        {
+            owner.groupFinished();
+        }
+    });
+}
+
+void TaskGroup::wait()
+{
+    pool.waitFor(remaining);
+}
+
+int ThreadPool::currentWorker()
+{
+    return workerIndexOfThread;
+}
+
+bool ThreadPool::popLocal(int index, Task& task)
+{
+    WorkerQueue& queue = queues[index];
+    lock_guard<mutex> guard(queue.lock);
+    if (queue.tasks.empty())
+    {
+        return false;
+    }
+    task = move(queue.tasks.back());
+    queue.tasks.pop_back();
+    queued.fetch_sub(1, memory_order_relaxed);
+    return true;
+}
+
+bool ThreadPool::steal(int thief, Task& task)
+{
+    size_t count = queues.size();
+    for (size_t offset = 1; offset < count; offset++)
+    {
+        WorkerQueue& victim = queues[(thief + offset) % count];
+        unique_lock<mutex> guard(victim.lock, try_to_lock);
+        if (guard.owns_lock() && !victim.tasks.empty())
+        {
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1, memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(int index)
+{
+    workerIndexOfThread = index;
+    Task task;
+    while (true)
+    {
+        if (popLocal(index, task) || steal(index, task))
+        {
+            run(index, task);
+            continue;
+        }
+
+        unique_lock<mutex> guard(sleepLock);
+        if (stopping)
+        {
+            return;
+        }
+        // Re-check under the lock; submitters take it before notifying
+        wakeUp.wait(guard, [this] { return stopping || queued.load(memory_order_acquire) > 0; });
+    }
+}
+
+ThreadPool& defaultThreadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
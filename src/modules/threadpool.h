@@ -0,0 +1,89 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+using namespace std;
+
+// Work-stealing thread pool. Every worker owns a deque: it pops its own work
+// from the back and, when empty, steals from the front of the other workers'
+// deques. Tasks receive the index of the worker running them so callers can
+// keep per-worker state (search workspaces, buffers) without locking.
+class ThreadPool
+{
+public:
+    using Task = function<void(int workerIndex)>;
+
+    explicit ThreadPool(int workerCount = 0); // 0 picks hardware concurrency
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(Task task);                   // Spread across workers round-robin
+    void submitTo(int workerIndex, Task task);
+    void waitIdle();                          // Block until every submitted task finished, whoever submitted it
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    // Index of the pool worker running the caller, -1 outside the pool
+    static int currentWorker();
+
+private:
+    friend class TaskGroup;
+
+    struct WorkerQueue
+    {
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    void workerLoop(int index);
+    bool popLocal(int index, Task& task);
+    bool steal(int thief, Task& task);
+    void run(int index, Task& task);
+    void groupFinished();
+    void waitFor(const atomic<size_t>& remaining);
+
+    vector<thread> workers;
+    vector<WorkerQueue> queues;
+
+    mutex sleepLock;
+    condition_variable wakeUp;
+    condition_variable idle;
+    atomic<size_t> pending;   // Submitted but not yet finished
+    atomic<size_t> queued;    // Sitting in a deque, not yet picked up
+    atomic<unsigned> nextQueue;
+    bool stopping = false;
+};
+
+// The tasks of one caller on a shared pool. wait() returns once these are
+// done, however busy the pool is with other callers' work. Waiting on a pool
+// worker runs queued tasks meanwhile, so a task may submit and wait itself.
+class TaskGroup
+{
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool(pool), remaining(0) {}
+    ~TaskGroup() { wait(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void submit(ThreadPool::Task task);
+    void wait();
+
+private:
+    ThreadPool& pool;
+    atomic<size_t> remaining;
+};
+
+// Shared pool used by the batch router and other parallel stages
+ThreadPool& defaultThreadPool();
+
+#endif
@@ -0,0 +1,184 @@
+#include "trafficqueue.h"
+#include <algorithm>
+
+TrafficQueues traffic;
+
+int TrafficQueues::laneOf(Edge* edge)
+{
+    if (edge->laneSlot < 0 || edge->laneSlot >= static_cast<int>(lanes.size()))
+    {
+        edge->laneSlot = static_cast<int>(lanes.size());
+        lanes.emplace_back();
+        lanes.back().length = edge->length;
+    }
+    return edge->laneSlot;
+}
+
+int TrafficQueues::allocate(int lane, float position, float length, float speed)
+{
+    int entry;
+    if (!freeEntries.empty())
+    {
+        entry = freeEntries.back();
+        freeEntries.pop_back();
+    }
+    else
+    {
+        entry = static_cast<int>(entries.size());
+        entries.emplace_back();
+    }
+    entries[entry] = { position, speed, length, -1, -1, lane };
+    lanes[lane].count++;
+    return entry;
+}
+
+bool TrafficQueues::hasRoom(Edge* edge) const
+{
+    if (edge->laneSlot < 0 || edge->laneSlot >= static_cast<int>(lanes.size()))
+    {
+        return true;
+    }
+    const Lane& lane = lanes[edge->laneSlot];
+    if (lane.back < 0)
+    {
+        return true;
+    }
+    const LaneEntry& last = entries[lane.back];
+    return last.position - last.length >= model.minimumGap;
+}
+
+int TrafficQueues::enter(Edge* edge, float length, float speed)
+{
+    int lane = laneOf(edge);
+    int entry = allocate(lane, 0, length, speed);
+    Lane& queue = lanes[lane];
+    entries[entry].ahead = queue.back;
+    if (queue.back >= 0)
+    {
+        entries[queue.back].behind = entry;
+    }
+    else
+    {
+        queue.front = entry;
+    }
+    queue.back = entry;
+    return entry;
+}
+
+int TrafficQueues::join(Edge* edge, float position, float length, float speed)
+{
+    int lane = laneOf(edge);
+    Lane& queue = lanes[lane];
+    position = min(max(position, 0.0f), queue.length);
+
+    // First vehicle from the back that is ahead of this one
+    int ahead = queue.back;
+    while (ahead >= 0 && entries[ahead].position < position)
+    {
+        ahead = entries[ahead].ahead;
+    }
+    int behind = ahead >= 0 ? entries[ahead].behind : queue.front;
+
+    int entry = allocate(lane, position, length, speed);
+    entries[entry].ahead = ahead;
+    entries[entry].behind = behind;
+    if (ahead >= 0)
+        entries[ahead].behind = entry;
+    else
+        queue.front = entry;
+    if (behind >= 0)
+        entries[behind].ahead = entry;
+    else
+        queue.back = entry;
+    return entry;
+}
+
+float TrafficQueues::leave(int entry)
+{
+    if (entry < 0 || entry >= static_cast<int>(entries.size()) || entries[entry].lane < 0)
+    {
+        return 0;
+    }
+    LaneEntry& leaving = entries[entry];
+    Lane& queue = lanes[leaving.lane];
+    if (leaving.ahead >= 0)
+        entries[leaving.ahead].behind = leaving.behind;
+    else
+        queue.front = leaving.behind;
+    if (leaving.behind >= 0)
+        entries[leaving.behind].ahead = leaving.ahead;
+    else
+        queue.back = leaving.ahead;
+    queue.count--;
+    leaving.lane = -1;
+    freeEntries.push_back(entry);
+    return leaving.speed;
+}
+
+float TrafficQueues::follow(int entry, float desiredSpeed, Edge* nextEdge)
+{
+    LaneEntry& self = entries[entry];
+    const Lane& queue = lanes[self.lane];
+
+    // Leader on this edge, or the back of the next one seen across the node
+    const LaneEntry* leader = nullptr;
+    float gap = 0;
+    if (self.ahead >= 0)
+    {
+        leader = &entries[self.ahead];
+        gap = leader->position - leader->length - self.position;
+    }
+    else if (nextEdge && nextEdge->laneSlot >= 0 && nextEdge->laneSlot < static_cast<int>(lanes.size()) && lanes[nextEdge->laneSlot].back >= 0)
+    {
+        leader = &entries[lanes[nextEdge->laneSlot].back];
+        gap = queue.length - self.position + leader->position - leader->length;
+    }
+
+    float v = self.speed;
+    float ratio = desiredSpeed > 0 ? v / desiredSpeed : 1;
+    float acceleration = model.maxAcceleration * (1 - ratio * ratio * ratio * ratio);
+    if (leader)
+    {
+        float closing = v - leader->speed;
+        float desiredGap = model.minimumGap + max(0.0f, v * model.timeHeadway + v * closing / (2 * sqrt(model.maxAcceleration * model.comfortableBraking)));
+        float s = max(gap, 0.01f);
+        acceleration -= model.maxAcceleration * (desiredGap / s) * (desiredGap / s);
+    }
+
+    float next = max(0.0f, v + acceleration);
+    float position = self.position + (v + next) / 2;
+
+    // Never into the leader, whatever the discretization did
+    if (leader)
+    {
+        float limit = self.position + max(0.0f, gap - model.minimumGap * 0.5f);
+        if (position > limit)
+        {
+            position = max(self.position, limit);
+            next = min(next, leader->speed);
+        }
+    }
+    self.position = position;
+    self.speed = next;
+    return position;
+}
+
+int TrafficQueues::vehiclesOn(const Edge* edge) const
+{
+    if (edge->laneSlot < 0 || edge->laneSlot >= static_cast<int>(lanes.size()))
+    {
+        return 0;
+    }
+    return lanes[edge->laneSlot].count;
+}
+
+void TrafficQueues::clear()
+{
+    for (Lane& lane : lanes)
+    {
+        lane.front = lane.back = -1;
+        lane.count = 0;
+    }
+    entries.clear();
+    freeEntries.clear();
+}
@@ -0,0 +1,84 @@
+#ifndef TRAFFICQUEUE_H
+#define TRAFFICQUEUE_H
+
+#include "edge.h"
+#include <vector>
+
+using namespace std;
+
+// Intelligent Driver Model parameters, in map units and simulation ticks
+struct FollowingModel
+{
+    float maxAcceleration = 0.02f;   // a
+    float comfortableBraking = 0.04f; // b
+    float minimumGap = 2.0f;         // s0, bumper to bumper when stopped
+    float timeHeadway = 30.0f;       // T, ticks of gap kept at speed
+};
+
+// One vehicle in a lane queue
+struct LaneEntry
+{
+    float position; // Front bumper, distance from the start of the edge
+    float speed;    // Units per tick
+    float length;
+    int ahead;      // Leader's entry, -1 at the front of the lane
+    int behind;     // Follower's entry, -1 at the back
+    int lane;       // -1 while the entry is free
+};
+
+// Vehicles on every directed edge, ordered by position. Each lane is a list
+// linked through entry indices, so a vehicle's leader is one lookup and a
+// tick stays linear in the fleet size. Vehicles hold only their entry index,
+// which survives vehicles being copied or their vector reallocating.
+// Vehicles join at the back and leave from the front, which keeps the order
+// without sorting since the model never lets them overtake. Simulation
+// thread only.
+class TrafficQueues
+{
+public:
+    FollowingModel model;
+
+    // Whether a vehicle can join the back of the edge without overlapping
+    bool hasRoom(Edge* edge) const;
+
+    // Adds a vehicle at the start of the edge, returns its entry
+    int enter(Edge* edge, float length, float speed);
+
+    // Adds a vehicle part way along the edge (restored mid-edge), walking
+    // the lane to keep it ordered
+    int join(Edge* edge, float position, float length, float speed);
+
+    // Removes a vehicle, returns its speed to carry onto the next edge
+    float leave(int entry);
+
+    // One IDM step for the vehicle toward desiredSpeed. Its leader is the
+    // vehicle ahead on the edge, or else the back of nextEdge (nullptr when
+    // the vehicle stops at the end of this one). Returns the new position.
+    float follow(int entry, float desiredSpeed, Edge* nextEdge);
+
+    const LaneEntry& get(int entry) const { return entries[entry]; }
+    int vehiclesOn(const Edge* edge) const;
+
+    // Forgets every vehicle (the world was replaced); held entries are void
+    void clear();
+
+private:
+    struct Lane
+    {
+        int front = -1;
+        int back = -1;
+        int count = 0;
+        float length = 0;
+    };
+
+    int laneOf(Edge* edge);
+    int allocate(int lane, float position, float length, float speed);
+
+    vector<Lane> lanes;
+    vector<LaneEntry> entries;
+    vector<int> freeEntries;
+};
+
+extern TrafficQueues traffic;
+
+#endif
@@ -0,0 +1,650 @@
+#include "tripevents.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <map>
+
+static const char fileMagic[4] = {'S', 'R', 'T', 'E'};
+static const uint32_t fileVersion = 1;
+static const uint32_t blockMagic = 0x42545253; // "SRTB"
+static const long fileHeaderBytes = 8;
+static const int columnCount = 10;
+
+// Fixed-size, written as raw bytes in host order
+struct TripBlockHeader
+{
+    uint32_t magic;
+    uint32_t rows;
+    uint64_t minTime;
+    uint64_t maxTime;
+    uint32_t maxTripId;
+    uint32_t typeMask;
+    uint32_t dictionaryBytes;
+    uint32_t columnBytes;
+    uint32_t checksum; // FNV-1a over dictionary and columns
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TripBlockHeader) == 48, "TripBlockHeader layout is part of the file format");
+
+const char* tripEventName(TripEventType type)
+{
+    static const char* names[] = {"requested", "accepted", "pickup", "dropoff", "rating", "position"};
+    return names[static_cast<int>(type)];
+}
+
+uint64_t tripClockMillis()
+{
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// Encoding helpers
+
+static void putVarint(string& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+static uint64_t zigzag(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+static uint32_t fnv1a(const string& bytes, uint32_t hash = 2166136261u)
+{
+    for (unsigned char c : bytes)
+    {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+// Positions are stored in 1/16 units, values in hundredths
+static int64_t quantize(float value, float scale)
+{
+    return llround(static_cast<double>(value) * scale);
+}
+
+struct ByteCursor
+{
+    const unsigned char* at;
+    const unsigned char* end;
+    bool ok = true;
+
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (at >= end)
+            {
+                ok = false;
+                return 0;
+            }
+            unsigned char byte = *at++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t signedVarint() { return unzigzag(varint()); }
+
+    // Splits off the next length-prefixed section
+    ByteCursor section()
+    {
+        uint64_t length = varint();
+        if (!ok || length > static_cast<uint64_t>(end - at))
+        {
+            ok = false;
+            return ByteCursor{end, end, false};
+        }
+        ByteCursor inner{at, at + length};
+        at += length;
+        return inner;
+    }
+};
+
+// Writer
+
+TripEventLog::TripEventLog(const string& path, size_t blockRows, int flushMillis)
+    : path(path), blockRows(max<size_t>(blockRows, 1)), flushMillis(flushMillis), file(nullptr), recorded(0), persisted(0),
+      flushRequested(false), running(false), names(1), lastTripId(0), eventsWritten(0), bytesWritten(0), dropped(0)
+{
+}
+
+TripEventLog::~TripEventLog()
+{
+    stop();
+}
+
+bool TripEventLog::openForAppend()
+{
+    // Keep every complete block already in the file and cut off a torn tail
+    error_code error;
+    uint64_t size = filesystem::exists(path, error) ? filesystem::file_size(path, error) : 0;
+    uint64_t validEnd = 0;
+    if (size > 0)
+    {
+        FILE* existing = fopen(path.c_str(), "rb");
+        char magic[4];
+        uint32_t version = 0;
+        if (existing && fread(magic, 1, 4, existing) == 4 && memcmp(magic, fileMagic, 4) == 0 &&
+            fread(&version, sizeof(version), 1, existing) == 1 && version == fileVersion)
+        {
+            validEnd = fileHeaderBytes;
+            TripBlockHeader header;
+            while (fread(&header, sizeof(header), 1, existing) == 1 && header.magic == blockMagic)
+            {
+                uint64_t payload = static_cast<uint64_t>(header.dictionaryBytes) + header.columnBytes;
+                if (validEnd + sizeof(header) + payload > size || fseek(existing, static_cast<long>(payload), SEEK_CUR) != 0)
+                {
+                    break;
+                }
+                validEnd += sizeof(header) + payload;
+                lastTripId = max(lastTripId.load(), header.maxTripId);
+            }
+        }
+        if (existing)
+        {
+            fclose(existing);
+        }
+
+        if (validEnd == 0)
+        {
+            LOG_ERROR("%s is not a trip event file, not overwriting it", path.c_str());
+            return false;
+        }
+        if (validEnd < size)
+        {
+            LOG_WARN("Dropping %llu bytes of incomplete trip events at the end of %s", static_cast<unsigned long long>(size - validEnd), path.c_str());
+            filesystem::resize_file(path, validEnd, error);
+        }
+    }
+
+    file = fopen(path.c_str(), validEnd > 0 ? "ab" : "wb");
+    if (!file)
+    {
+        LOG_ERROR("Error opening %s for writing.", path.c_str());
+        return false;
+    }
+    if (validEnd == 0)
+    {
+        fwrite(fileMagic, 1, 4, file);
+        fwrite(&fileVersion, sizeof(fileVersion), 1, file);
+        fflush(file);
+    }
+    return true;
+}
+
+bool TripEventLog::start()
+{
+    if (running || !openForAppend())
+    {
+        return running;
+    }
+    running = true;
+    worker = thread(&TripEventLog::run, this);
+    return true;
+}
+
+void TripEventLog::stop()
+{
+    {
+        lock_guard<mutex> guard(pendingLock);
+        if (!running)
+        {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_one();
+    worker.join();
+    fclose(file);
+    file = nullptr;
+}
+
+uint32_t TripEventLog::intern(const string& email)
+{
+    if (email.empty())
+    {
+        return 0;
+    }
+    lock_guard<mutex> guard(namesLock);
+    auto inserted = nameIds.emplace(email, static_cast<uint32_t>(names.size()));
+    if (inserted.second)
+    {
+        names.push_back(email);
+    }
+    return inserted.first->second;
+}
+
+void TripEventLog::record(const TripEvent& event)
+{
+    bool full;
+    {
+        lock_guard<mutex> guard(pendingLock);
+        if (!running)
+        {
+            return;
+        }
+        // Bound memory if the disk cannot keep up
+        if (pending.size() >= blockRows * 8)
+        {
+            dropped++;
+            return;
+        }
+        pending.push_back(event);
+        recorded++;
+        full = pending.size() >= blockRows;
+    }
+    if (full)
+    {
+        wake.notify_one();
+    }
+}
+
+void TripEventLog::record(const vector<TripEvent>& events)
+{
+    bool full;
+    {
+        lock_guard<mutex> guard(pendingLock);
+        if (!running)
+        {
+            return;
+        }
+        size_t room = blockRows * 8 > pending.size() ? blockRows * 8 - pending.size() : 0;
+        size_t taken = min(room, events.size());
+        pending.insert(pending.end(), events.begin(), events.begin() + taken);
+        recorded += taken;
+        dropped += events.size() - taken;
+        full = pending.size() >= blockRows;
+    }
+    if (full)
+    {
+        wake.notify_one();
+    }
+}
+
+void TripEventLog::flush()
+{
+    unique_lock<mutex> lock(pendingLock);
+    uint64_t target = recorded;
+    flushRequested = true;
+    wake.notify_one();
+    persistedChanged.wait(lock, [&] { return persisted >= target || !running; });
+}
+
+void TripEventLog::run()
+{
+    vector<TripEvent> batch;
+    unique_lock<mutex> lock(pendingLock);
+    while (true)
+    {
+        wake.wait_for(lock, chrono::milliseconds(flushMillis), [this] { return !running || flushRequested || pending.size() >= blockRows; });
+        bool stopping = !running;
+        uint64_t target = recorded;
+        flushRequested = false;
+        batch.swap(pending);
+        lock.unlock();
+
+        for (size_t first = 0; first < batch.size(); first += blockRows)
+        {
+            writeBlock(&batch[first], min(blockRows, batch.size() - first));
+        }
+        batch.clear();
+
+        lock.lock();
+        persisted = target;
+        persistedChanged.notify_all();
+        if (stopping && pending.empty())
+        {
+            break;
+        }
+    }
+}
+
+void TripEventLog::writeBlock(const TripEvent* events, size_t count)
+{
+    // Block-local dictionary so the people columns hold small indices
+    unordered_map<uint32_t, uint32_t> localIds;
+    vector<uint32_t> dictionaryOrder;
+    auto localId = [&](uint32_t id) -> uint32_t
+    {
+        if (id == 0)
+        {
+            return 0;
+        }
+        auto inserted = localIds.emplace(id, static_cast<uint32_t>(dictionaryOrder.size() + 1));
+        if (inserted.second)
+        {
+            dictionaryOrder.push_back(id);
+        }
+        return inserted.first->second;
+    };
+
+    TripBlockHeader header = {};
+    header.magic = blockMagic;
+    header.rows = static_cast<uint32_t>(count);
+    header.minTime = UINT64_MAX;
+
+    string column[columnCount];
+    string& times = column[0];
+    string& types = column[1];
+    string& trips = column[2];
+    string& vehicles = column[3];
+    string& nodes = column[4];
+    string& drivers = column[5];
+    string& users = column[6];
+    string& xs = column[7];
+    string& ys = column[8];
+    string& values = column[9];
+
+    int64_t previousTime = 0, previousTrip = 0, previousVehicle = 0, previousNode = 0, previousX = 0, previousY = 0;
+    int runType = -1;
+    uint64_t runLength = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const TripEvent& event = events[i];
+        header.minTime = min(header.minTime, event.timestamp);
+        header.maxTime = max(header.maxTime, event.timestamp);
+        header.maxTripId = max(header.maxTripId, event.tripId);
+        header.typeMask |= 1u << static_cast<int>(event.type);
+
+        putVarint(times, zigzag(static_cast<int64_t>(event.timestamp) - previousTime));
+        previousTime = static_cast<int64_t>(event.timestamp);
+
+        // Types come in long runs (position sweeps), so run-length encode them
+        if (static_cast<int>(event.type) == runType)
+        {
+            runLength++;
+        }
+        else
+        {
+            if (runLength > 0)
+            {
+                types += static_cast<char>(runType);
+                putVarint(types, runLength);
+            }
+            runType = static_cast<int>(event.type);
+            runLength = 1;
+        }
+
+        putVarint(trips, zigzag(static_cast<int64_t>(event.tripId) - previousTrip));
+        previousTrip = event.tripId;
+        putVarint(vehicles, zigzag(event.vehicleId - previousVehicle));
+        previousVehicle = event.vehicleId;
+        putVarint(nodes, zigzag(event.nodeId - previousNode));
+        previousNode = event.nodeId;
+
+        putVarint(drivers, localId(event.driver));
+        putVarint(users, localId(event.user));
+
+        int64_t x = quantize(event.x, 16), y = quantize(event.y, 16);
+        putVarint(xs, zigzag(x - previousX));
+        putVarint(ys, zigzag(y - previousY));
+        previousX = x;
+        previousY = y;
+        putVarint(values, zigzag(quantize(event.value, 100)));
+    }
+    if (runLength > 0)
+    {
+        types += static_cast<char>(runType);
+        putVarint(types, runLength);
+    }
+
+    string dictionary;
+    putVarint(dictionary, dictionaryOrder.size());
+    {
+        lock_guard<mutex> guard(namesLock);
+        for (uint32_t id : dictionaryOrder)
+        {
+            putVarint(dictionary, names[id].size());
+            dictionary += names[id];
+        }
+    }
+
+    string columns;
+    for (const string& data : column)
+    {
+        putVarint(columns, data.size());
+        columns += data;
+    }
+
+    header.dictionaryBytes = static_cast<uint32_t>(dictionary.size());
+    header.columnBytes = static_cast<uint32_t>(columns.size());
+    header.checksum = fnv1a(columns, fnv1a(dictionary));
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(dictionary.data(), 1, dictionary.size(), file);
+    fwrite(columns.data(), 1, columns.size(), file);
+    if (fflush(file) != 0)
+    {
+        LOG_ERROR("Error writing trip events to %s", path.c_str());
+    }
+
+    eventsWritten += count;
+    bytesWritten += sizeof(header) + dictionary.size() + columns.size();
+}
+
+// Reader
+
+TripEventReader::TripEventReader(const string& path) : file(fopen(path.c_str(), "rb")), blocksRead(0), blocksSkipped(0)
+{
+    char magic[4];
+    uint32_t version = 0;
+    if (file && (fread(magic, 1, 4, file) != 4 || memcmp(magic, fileMagic, 4) != 0 ||
+                 fread(&version, sizeof(version), 1, file) != 1 || version != fileVersion))
+    {
+        LOG_ERROR("%s is not a trip event file", path.c_str());
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+TripEventReader::~TripEventReader()
+{
+    if (file)
+    {
+        fclose(file);
+    }
+}
+
+size_t TripEventReader::scan(const TripQuery& query, const function<void(const TripEventRow&)>& visit)
+{
+    if (!file)
+    {
+        return 0;
+    }
+    fseek(file, fileHeaderBytes, SEEK_SET);
+
+    size_t matched = 0;
+    string dictionary, columns;
+    vector<string> blockNames;
+    TripBlockHeader header;
+    while (fread(&header, sizeof(header), 1, file) == 1 && header.magic == blockMagic)
+    {
+        // The header alone rules out most blocks of a selective query
+        if (header.maxTime < query.from || header.minTime > query.to || !(header.typeMask & query.types))
+        {
+            fseek(file, static_cast<long>(header.dictionaryBytes) + header.columnBytes, SEEK_CUR);
+            blocksSkipped++;
+            continue;
+        }
+
+        dictionary.resize(header.dictionaryBytes);
+        if (fread(&dictionary[0], 1, dictionary.size(), file) != dictionary.size())
+        {
+            break;
+        }
+        ByteCursor names{reinterpret_cast<const unsigned char*>(dictionary.data()),
+                         reinterpret_cast<const unsigned char*>(dictionary.data()) + dictionary.size()};
+        uint64_t nameCount = names.varint();
+        blockNames.assign(1, string());
+        for (uint64_t i = 0; i < nameCount && names.ok; i++)
+        {
+            ByteCursor name = names.section();
+            blockNames.emplace_back(reinterpret_cast<const char*>(name.at), name.end - name.at);
+        }
+
+        // Then the dictionary: a person absent from it has no rows here
+        uint64_t driverIndex = 0, userIndex = 0;
+        bool present = true;
+        if (!query.driver.empty())
+        {
+            auto found = find(blockNames.begin() + 1, blockNames.end(), query.driver);
+            present = found != blockNames.end();
+            driverIndex = found - blockNames.begin();
+        }
+        if (present && !query.user.empty())
+        {
+            auto found = find(blockNames.begin() + 1, blockNames.end(), query.user);
+            present = found != blockNames.end();
+            userIndex = found - blockNames.begin();
+        }
+        if (!present)
+        {
+            fseek(file, header.columnBytes, SEEK_CUR);
+            blocksSkipped++;
+            continue;
+        }
+
+        columns.resize(header.columnBytes);
+        if (fread(&columns[0], 1, columns.size(), file) != columns.size())
+        {
+            break;
+        }
+        if (fnv1a(columns, fnv1a(dictionary)) != header.checksum)
+        {
+            LOG_WARN("Corrupt trip event block after %zu blocks, stopping the scan", blocksRead + blocksSkipped);
+            break;
+        }
+        blocksRead++;
+
+        ByteCursor all{reinterpret_cast<const unsigned char*>(columns.data()),
+                       reinterpret_cast<const unsigned char*>(columns.data()) + columns.size()};
+        ByteCursor column[columnCount];
+        for (ByteCursor& slice : column)
+        {
+            slice = all.section();
+        }
+
+        TripEvent event;
+        int64_t time = 0, trip = 0, vehicle = 0, node = 0, x = 0, y = 0;
+        uint64_t runLeft = 0;
+        int runType = 0;
+        for (uint32_t row = 0; row < header.rows; row++)
+        {
+            time += column[0].signedVarint();
+            if (runLeft == 0 && column[1].at < column[1].end)
+            {
+                runType = *column[1].at++;
+                runLeft = column[1].varint();
+            }
+            runLeft--;
+            trip += column[2].signedVarint();
+            vehicle += column[3].signedVarint();
+            node += column[4].signedVarint();
+            uint64_t driver = column[5].varint();
+            uint64_t user = column[6].varint();
+            x += column[7].signedVarint();
+            y += column[8].signedVarint();
+            int64_t value = column[9].signedVarint();
+
+            event.timestamp = static_cast<uint64_t>(time);
+            event.type = static_cast<TripEventType>(runType);
+            if (event.timestamp < query.from || event.timestamp > query.to || !(query.types & (1u << runType)) ||
+                (!query.driver.empty() && driver != driverIndex) || (!query.user.empty() && user != userIndex) ||
+                driver >= blockNames.size() || user >= blockNames.size())
+            {
+                continue;
+            }
+            event.tripId = static_cast<uint32_t>(trip);
+            event.vehicleId = static_cast<int>(vehicle);
+            event.nodeId = static_cast<int>(node);
+            event.x = x / 16.0f;
+            event.y = y / 16.0f;
+            event.value = value / 100.0f;
+            visit(TripEventRow{event, blockNames[driver], blockNames[user]});
+            matched++;
+        }
+    }
+    return matched;
+}
+
+vector<TripSummary> summarizeTrips(const string& path, TripQuery query)
+{
+    query.types &= ~(1u << static_cast<int>(TripEventType::Position));
+
+    map<uint32_t, TripSummary> trips;
+    TripEventReader reader(path);
+    reader.scan(query, [&](const TripEventRow& row)
+    {
+        const TripEvent& event = row.event;
+        if (event.tripId == 0)
+        {
+            return;
+        }
+        TripSummary& trip = trips[event.tripId];
+        trip.tripId = event.tripId;
+        if (!row.driver.empty())
+        {
+            trip.driver = row.driver;
+        }
+        if (!row.user.empty())
+        {
+            trip.user = row.user;
+        }
+        switch (event.type)
+        {
+        case TripEventType::Requested:
+            trip.requestedAt = event.timestamp;
+            trip.originNode = event.nodeId;
+            break;
+        case TripEventType::Accepted:
+            if (trip.originNode < 0)
+            {
+                trip.originNode = event.nodeId;
+            }
+            break;
+        case TripEventType::Pickup:
+            trip.pickupAt = event.timestamp;
+            break;
+        case TripEventType::Dropoff:
+            trip.dropoffAt = event.timestamp;
+            trip.destinationNode = event.nodeId;
+            trip.fare = event.value;
+            break;
+        case TripEventType::Rating:
+            trip.rating = event.value;
+            break;
+        default:
+            break;
+        }
+    });
+
+    vector<TripSummary> ordered;
+    ordered.reserve(trips.size());
+    for (auto& entry : trips)
+    {
+        ordered.push_back(move(entry.second));
+    }
+    return ordered;
+}
@@ -0,0 +1,177 @@
+#ifndef TRIPEVENTS_H
+#define TRIPEVENTS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+enum class TripEventType : uint8_t
+{
+    Requested,
+    Accepted,
+    Pickup,
+    Dropoff,
+    Rating,
+    Position, // Periodic vehicle sample
+    Count
+};
+
+const uint32_t allTripEventTypes = (1u << static_cast<int>(TripEventType::Count)) - 1;
+
+const char* tripEventName(TripEventType type);
+
+// Milliseconds since the Unix epoch, the timestamp unit of the stream
+uint64_t tripClockMillis();
+
+// One row of the stream. People are interned ids (see TripEventLog::intern)
+// so recording never copies strings; 0 means nobody.
+struct TripEvent
+{
+    uint64_t timestamp = 0;
+    TripEventType type = TripEventType::Position;
+    uint32_t tripId = 0;  // 0 for samples outside a trip
+    int vehicleId = -1;
+    int nodeId = -1;      // -1 when between nodes
+    float x = 0;
+    float y = 0;
+    float value = 0;      // Rating, or fare on dropoff
+    uint32_t driver = 0;
+    uint32_t user = 0;
+};
+
+// Append-only writer. Events are buffered in memory and a background thread
+// encodes them into column blocks:
+//   file   = "SRTE" version, then blocks back to back
+//   block  = TripBlockHeader, email dictionary, columns
+//   column = varint byte length, then delta/zigzag varints (types RLE)
+// Each header carries the block's time range and type mask so readers skip
+// whole blocks without decoding them. A torn block at the end of the file
+// (crash mid-write) is cut off when the file is reopened.
+class TripEventLog
+{
+public:
+    TripEventLog(const string& path, size_t blockRows = 32768, int flushMillis = 2000);
+    ~TripEventLog();
+
+    bool start();
+    void stop(); // Writes everything still buffered
+
+    uint32_t intern(const string& email);
+    uint32_t nextTripId() { return ++lastTripId; }
+
+    void record(const TripEvent& event);
+    void record(const vector<TripEvent>& events);
+
+    // Blocks until everything recorded so far is on disk
+    void flush();
+
+    uint64_t getEventsWritten() const { return eventsWritten.load(); }
+    uint64_t getBytesWritten() const { return bytesWritten.load(); }
+    uint64_t getDropped() const { return dropped.load(); }
+
+    TripEventLog(const TripEventLog&) = delete;
+    TripEventLog& operator=(const TripEventLog&) = delete;
+
+private:
+    void run();
+    void writeBlock(const TripEvent* events, size_t count);
+    bool openForAppend();
+
+    string path;
+    size_t blockRows;
+    int flushMillis;
+    FILE* file;
+
+    mutex pendingLock;
+    condition_variable wake;
+    vector<TripEvent> pending;
+    uint64_t recorded;   // Guarded by pendingLock
+    uint64_t persisted;  // Guarded by pendingLock
+    bool flushRequested;
+    condition_variable persistedChanged;
+    bool running;
+    thread worker;
+
+    mutex namesLock;
+    vector<string> names; // Index 0 is the empty name
+    unordered_map<string, uint32_t> nameIds;
+
+    atomic<uint32_t> lastTripId;
+    atomic<uint64_t> eventsWritten;
+    atomic<uint64_t> bytesWritten;
+    atomic<uint64_t> dropped;
+};
+
+// Filters for TripEventReader::scan; defaults match everything
+struct TripQuery
+{
+    uint64_t from = 0;
+    uint64_t to = UINT64_MAX;
+    string driver;             // Email, empty for any
+    string user;               // Email, empty for any
+    uint32_t types = allTripEventTypes;
+};
+
+// A decoded row; the names stay valid for the duration of the callback
+struct TripEventRow
+{
+    const TripEvent& event;
+    const string& driver;
+    const string& user;
+};
+
+// Streams a trip event file one block at a time, so memory stays bounded by
+// the block size however large the file is
+class TripEventReader
+{
+public:
+    explicit TripEventReader(const string& path);
+    ~TripEventReader();
+
+    bool isOpen() const { return file != nullptr; }
+
+    // Calls visit for every matching row in file order, returns the count
+    size_t scan(const TripQuery& query, const function<void(const TripEventRow&)>& visit);
+
+    size_t getBlocksRead() const { return blocksRead; }
+    size_t getBlocksSkipped() const { return blocksSkipped; }
+
+    TripEventReader(const TripEventReader&) = delete;
+    TripEventReader& operator=(const TripEventReader&) = delete;
+
+private:
+    FILE* file;
+    size_t blocksRead;
+    size_t blocksSkipped;
+};
+
+// One trip folded from its lifecycle events
+struct TripSummary
+{
+    uint32_t tripId = 0;
+    string driver;
+    string user;
+    uint64_t requestedAt = 0;
+    uint64_t pickupAt = 0;
+    uint64_t dropoffAt = 0;
+    int originNode = -1;
+    int destinationNode = -1;
+    float fare = 0;
+    float rating = -1; // -1 when not rated
+};
+
+// Folds the lifecycle events of the matching trips, ordered by trip id.
+// Filtering by driver leaves out the request row, so the origin comes from
+// the acceptance instead.
+vector<TripSummary> summarizeTrips(const string& path, TripQuery query);
+
+#endif
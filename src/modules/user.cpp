@@ -1,18 +1,18 @@
 #include "user.h"
 #include "node.h"
+#include "metrics.h"
+#include "logger.h"
 #include <fstream>
 #include <nlohmann/json.hpp>
 
-string rideStatus; // None, Requested, Active
-
 User::User(int age, string name, string email, bool gender, string phoneNumber)
-    : Person(age, name, email, gender, phoneNumber), rideStatus("None"), currentLocation(nullptr) {}
+    : Person(age, name, email, gender, phoneNumber), currentLocation(nullptr) {}
 
-User::User() : Person(), rideStatus("None") {}
+User::User() : Person() {}
 
 bool User::requestRide(Node* currentLocation, Node* goalLocation) 
 {
-    rideStatus = "Requested";
+    rideState = RideState::Requested;
     this->currentLocation = currentLocation;
     this->goalLocation = goalLocation;
 
@@ -21,12 +21,12 @@ bool User::requestRide(Node* currentLocation, Node* goalLocation)
     return true;                // return true
 }
 
-void User::setRideStatus(string newRideStatus) { rideStatus = newRideStatus; }
+void User::setRideState(RideState newRideState) { rideState = newRideState; }
 
 void User::display() const
 {
     Person::display();
-    cout << "Ride Status: " << rideStatus << endl;
+    cout << "Ride Status: " << rideStateName(rideState) << endl;
     cout << "-----------------------------------" << endl;
 }
 
@@ -34,6 +34,8 @@ void User::display() const
 using json = nlohmann::json;
 
 void User::saveUser() const {
+    METRIC_SCOPE(Metric::PersistenceSave);
+
     std::ifstream inputFile("users.json");
     json usersJson;
 
@@ -62,15 +64,17 @@ void User::saveUser() const {
         outputFile << usersJson.dump(4) << std::endl; // Pretty print with 4 spaces
         outputFile.close();
     } else {
-        std::cerr << "Error opening file for writing." << std::endl;
+        LOG_ERROR("Error opening users.json for writing.");
     }
 }
 
 User User::loadUser(const std::string& email) {
+    METRIC_SCOPE(Metric::PersistenceLoad);
+
     User user;
     std::ifstream file("users.json");
     if (file.is_open()) {
-        cout << "Opened file" << endl;
+        LOG_DEBUG("Opened users.json");
         json j;
         file >> j;
         if (j.contains(email)) {
@@ -83,11 +87,11 @@ User User::loadUser(const std::string& email) {
 
         }
         else {
-            cout << "User not found" << endl;
+            LOG_DEBUG("User %s not found", email.c_str());
         }
         file.close();
     } else {
-        std::cerr << "Error opening file for reading." << std::endl;
+        LOG_ERROR("Error opening users.json for reading.");
     }
     return user; // Return an empty user if not found
 }
@@ -3,11 +3,12 @@
 
 #include "person.h"
 #include "node.h"
+#include "vehicleclass.h"
 
 // User class inheriting from Person
 class User : public Person {
 public: 
-    string rideStatus; // None, Requested, Active
+    RideState rideState = RideState::None;
     Node* currentLocation;
     Node* goalLocation;
 
@@ -16,7 +17,7 @@ public:
 
     bool requestRide(Node* currentLocation, Node* goalLocation);
 
-    void setRideStatus(string newRideStatus);
+    void setRideState(RideState newRideState);
 
     void display() const override;
 
@@ -1,206 +1,252 @@
 #include "vehicle.h"
-
-string Vehicle::vehicleTypes[4] = {"Car", "Truck", "Bus", "Bike"};
+#include "routecache.h"
+#include "metrics.h"
+#include "logger.h"
+#include "simrandom.h"
+#include "congestion.h"
+#include "trafficqueue.h"
+#include <algorithm>
+
+// Empty vehicle, every field set by the caller
+Vehicle::Vehicle()
+    : id(-1), length(0), currentNode(nullptr), goalNode(nullptr), currentEdge(nullptr), x(0), y(0)
+{
+}
 
 // Constructor
 Vehicle::Vehicle(int id, string type, Node* startNode, Node* goalNode)
     : id(id), type(type), currentNode(startNode), goalNode(goalNode), currentEdge(nullptr), x(startNode->x), y(startNode->y)
 {
-    cout << "Called A* search on vehicle" << id << endl;
-    this->path = aStar(currentNode, goalNode);
-    if (this->path.empty())
-    {
-        cerr << "No path found for the vehicle from start to goal." << endl;
-        return;
-    }
-
-    this->currentEdge = this->path.front();
-    this->path.erase(this->path.begin());
-
-    // Set the next node to reach
-    if (currentEdge->node1 == currentNode)
-    {
-        this->currentNodeToReach = currentEdge->node2;
-    }
-    else
-    {
-        this->currentNodeToReach = currentEdge->node1;
-    }
-
-    setLengthByType();
+    LOG_DEBUG("Called A* search on vehicle %d", id);
+    this->path = routeCache.findRoute(currentNode, goalNode);
+    setClassByType();
+    beginPath();
 }
 
 // constructor with random start and goal nodes if not provided
 Vehicle::Vehicle(int id, string type, vector<Node*> nodes)
-    : id(id), type(type), currentNode(nodes[rand() % nodes.size()]), goalNode(nodes[rand() % nodes.size()]), currentEdge(nullptr), x(currentNode->x), y(currentNode->y)
+    : id(id), type(type), currentNode(nodes[simRandom.index(RandomStream::Vehicles, nodes.size())]), goalNode(nodes[simRandom.index(RandomStream::Vehicles, nodes.size())]), currentEdge(nullptr), x(currentNode->x), y(currentNode->y)
 {
     while (currentNode == goalNode)
     {
-        goalNode = nodes[rand() % nodes.size()];
+        goalNode = nodes[simRandom.index(RandomStream::Vehicles, nodes.size())];
     }
     // Initialize the path using A* search
-    this->path = aStar(currentNode, goalNode);
+    this->path = routeCache.findRoute(currentNode, goalNode);
+    setClassByType();
+    beginPath();
+}
+
+// Constructor for a vehicle whose path was already computed
+Vehicle::Vehicle(int id, string type, Node* startNode, Node* goalNode, vector<Edge*> plannedPath)
+    : id(id), type(type), currentNode(startNode), goalNode(goalNode), currentEdge(nullptr), path(move(plannedPath)), x(startNode->x), y(startNode->y)
+{
+    setClassByType();
+    beginPath();
+}
+
+// Aim for the first edge of the planned path; it is taken on the first move
+bool Vehicle::beginPath()
+{
     if (this->path.empty())
     {
-        cerr << "No path found for the vehicle from start to goal." << endl;
-        return;
+        // A vehicle parked at its goal has nothing to route
+        if (currentNode != goalNode)
+        {
+            LOG_WARN("No path found for vehicle %d from start to goal.", id);
+        }
+        return false;
     }
 
     this->currentEdge = this->path.front();
-    this->path.erase(this->path.begin());
+    this->currentNodeToReach = (currentEdge->node1 == currentNode) ? currentEdge->node2 : currentEdge->node1;
+    return true;
+}
 
-    // Set the next node to reach
-    if (currentEdge->node1 == currentNode)
-    {
-        this->currentNodeToReach = currentEdge->node2;
-    }
-    else
+// The directed edge from a node along a road, whose queue a vehicle joins
+static Edge* laneFrom(Edge* edge, Node* from)
+{
+    if (edge->node1 == from)
     {
-        this->currentNodeToReach = currentEdge->node1;
+        return edge;
     }
-
-    setLengthByType();
+    Edge* reverse = Node::findEdge(from, edge->node1 == from ? edge->node2 : edge->node1);
+    return reverse ? reverse : edge;
 }
 
-// Set vehicle length based on type
-void Vehicle::setLengthByType()
+// Set the class, and with it length, desired speed, seats and fare rate, from the type name
+void Vehicle::setClassByType()
 {
-    static unordered_map<string, float> averageLengths = {
-        {"Car", 4.5}, {"Truck", 12.0}, {"Bus", 10.5}, {"Bike", 2.0}, {"Rickshaw", 1.8}};
-
-    if (averageLengths.find(type) != averageLengths.end())
-    {
-        length = averageLengths[type];
-    }
-    else
+    bool known = false;
+    vehicleClass = vehicleClassOf(type, &known);
+    if (!known)
     {
-        cerr << "Unknown vehicle type: " << type << ". Assigning default length of 4.5 meters." << endl;
-        length = 4.5;
+        LOG_WARN("Unknown vehicle type: %s. Treating it as a car.", type.c_str());
     }
+    length = classInfo(vehicleClass).length;
+    speed = classInfo(vehicleClass).speed;
 }
 
 // Move the vehicle
 bool Vehicle::moveVehicle()
 {
+    METRIC_SCOPE_SAMPLED(Metric::MoveVehicle);
+
     // If the vehicle has reached its goal
-    // if (this->x == goalNode->x && this->y == goalNode->y)
     if (currentNode == goalNode)
     {
-        if (currentEdge)
-        {
-            updateEdgeAgentCount(currentEdge, -1); // Decrement agent count on the edge
-        }
-        
+        leaveEdge();
         hasReachedDestination = true;
         return true;
     }
 
-    // If at the current node
-    if (this->x == currentNode->x && this->y == currentNode->y)
+    if (laneEntry < 0)
     {
-        if (this->path.empty())
-        {
-            this->path = aStar(currentNode, this->goalNode); // Recompute the path if necessary
-            if (this->path.empty())
-            {
-                cerr << "No path found to the goal!" << endl;
-                return false;
-            }
-        }
-
-        this->currentEdge = this->path.front(); // Take the first edge
-        this->path.erase(this->path.begin());
-
-        // Determine the next node to reach
-        if (currentEdge->node1 == currentNode)
+        // Restored part way along an edge: rejoin its queue where it stands
+        if (currentEdge && currentNodeToReach && (this->x != currentNode->x || this->y != currentNode->y))
         {
-            this->currentNodeToReach = currentEdge->node2;
+            float position = sqrt(pow(this->x - currentNode->x, 2) + pow(this->y - currentNode->y, 2));
+            laneEntry = traffic.join(laneFrom(currentEdge, currentNode), position, length, currentSpeed);
         }
-        else
+        else if (!enterNextEdge())
         {
-            this->currentNodeToReach = currentEdge->node1;
+            return false; // Waiting at the node
         }
-
-        updateEdgeAgentCount(currentEdge, 1); // Increment agent count on the new edge
-        changeCoordinates();                 // Start moving toward the next node
     }
-    else if (this->x == currentNodeToReach->x && this->y == currentNodeToReach->y)
-    {
-        // Reached the intermediate node
-        currentNode = currentNodeToReach;
 
-        // Decrement agents on the current edge
-        updateEdgeAgentCount(currentEdge, -1);
+    // Follow the vehicle ahead, looking across the next node when this edge
+    // is clear so it slows for a queue it is about to join
+    Edge* nextEdge = nullptr;
+    if (!this->path.empty() && currentNodeToReach != goalNode)
+    {
+        nextEdge = laneFrom(this->path.front(), currentNodeToReach);
+    }
+    traffic.follow(laneEntry, speed, nextEdge);
+    changeCoordinates();
+    return false;
+}
 
-        // If path is not empty, take the next edge
-        if (!this->path.empty())
+// Take the next edge of the path if its queue has room at the back
+bool Vehicle::enterNextEdge()
+{
+    Edge* next = this->path.empty() ? nullptr : this->path.front();
+    if (!next || (next->node1 != currentNode && next->node2 != currentNode))
+    {
+        this->path = routeCache.findRoute(currentNode, this->goalNode); // Recompute the path if necessary
+        if (this->path.empty())
         {
-            this->currentEdge = this->path.front();
-            this->path.erase(this->path.begin());
-            this->currentNodeToReach = (currentEdge->node1 == currentNode) ? currentEdge->node2 : currentEdge->node1;
+            LOG_WARN("No path found to the goal for vehicle %d!", id);
+            return false;
         }
+        next = this->path.front();
     }
-    else
+
+    Edge* lane = laneFrom(next, currentNode);
+    if (!traffic.hasRoom(lane))
     {
-        // Continue moving toward the next node
-        changeCoordinates();
+        currentSpeed = 0;
+        return false;
     }
-    return false;
+
+    this->path.erase(this->path.begin());
+    this->currentEdge = next;
+    this->currentNodeToReach = (currentEdge->node1 == currentNode) ? currentEdge->node2 : currentEdge->node1;
+    laneEntry = traffic.enter(lane, length, currentSpeed);
+    updateEdgeAgentCount(currentEdge, 1); // Increment agent count on the new edge
+    return true;
+}
+
+// Leave the current edge's queue and count
+void Vehicle::leaveEdge()
+{
+    if (laneEntry < 0)
+    {
+        return;
+    }
+    currentSpeed = traffic.leave(laneEntry);
+    laneEntry = -1;
+    updateEdgeAgentCount(currentEdge, -1);
 }
 
 // Update the number of agents on an edge
 void Vehicle::updateEdgeAgentCount(Edge* edge, int delta)
 {
+    METRIC_SCOPE_SAMPLED(Metric::UpdateEdgeAgentCount);
+
     if (edge)
     {
         Edge* forwardEdge = Node::findEdge(edge->node1, edge->node2);
         Edge* backwardEdge = Node::findEdge(edge->node2, edge->node1);
 
+        // Counts never go negative: a negative count would make the congestion
+        // penalty in Node::cost negative and let A* loop on negative cycles
+        Edge* tracked = forwardEdge ? forwardEdge : backwardEdge;
+        int before = tracked ? tracked->no_of_agents : 0;
+
         if (forwardEdge)
-            forwardEdge->no_of_agents += delta;
+            forwardEdge->no_of_agents = max(0, forwardEdge->no_of_agents + delta);
 
         if (backwardEdge)
-            backwardEdge->no_of_agents += delta;
+            backwardEdge->no_of_agents = max(0, backwardEdge->no_of_agents + delta);
+
+        // Both directions share the count, so tracking one is enough
+        if (tracked)
+        {
+            routeCache.noteOccupancyChange(tracked, tracked->no_of_agents - before);
+            congestion.noteOccupancyChange(tracked, tracked->no_of_agents - before);
+        }
     }
 }
 
-// Move the vehicle's coordinates
+// Place the vehicle along its edge from its queue position
 void Vehicle::changeCoordinates()
 {
-    float dx = currentNodeToReach->x - this->x;
-    float dy = currentNodeToReach->y - this->y;
-
-    // Distance to the next node
-    float distanceToNextNode = sqrt(dx * dx + dy * dy);
+    const LaneEntry& entry = traffic.get(laneEntry);
+    float dx = currentNodeToReach->x - currentNode->x;
+    float dy = currentNodeToReach->y - currentNode->y;
+    float edgeLength = sqrt(dx * dx + dy * dy);
 
-    if (distanceToNextNode <= 5.0f)
+    if (entry.position >= edgeLength)
     {
-        // Snap to the next node if within range
+        // Reached the next node; the next edge is taken on the following move
         this->x = currentNodeToReach->x;
         this->y = currentNodeToReach->y;
+        odometer += currentEdge->length;
+        leaveEdge();
+        currentNode = currentNodeToReach;
     }
     else
     {
-        // Calculate movement direction
-        float directionX = dx / distanceToNextNode;
-        float directionY = dy / distanceToNextNode;
-
-        // Move based on speed
-        this->x += directionX * speed;
-        this->y += directionY * speed;
+        this->x = currentNode->x + dx * entry.position / edgeLength;
+        this->y = currentNode->y + dy * entry.position / edgeLength;
     }
 }
 
-// Update destination
+// Update destination, planning from the node the vehicle is at or, while on
+// an edge, the one it reaches next
 void Vehicle::updateDestination(Node* nextDestination)
 {
     this->goalNode = nextDestination;
     this->hasReachedDestination = false;
-    this->path = aStar(currentNode, nextDestination);
+    Node* from = laneEntry >= 0 ? currentNodeToReach : currentNode;
+    this->path.clear();
+    if (from == nextDestination)
+    {
+        return;
+    }
+    this->path = routeCache.findRoute(from, nextDestination);
     if (this->path.empty())
     {
-        cerr << "No path found for the vehicle" << id<< " from start to goal." << endl;
+        LOG_WARN("No path found for vehicle %d from start to goal.", id);
         return;
     }
 }
 
+// Update destination with a path planned elsewhere, from the same node the
+// overload above would plan from
+void Vehicle::updateDestination(Node* nextDestination, vector<Edge*> plannedPath)
+{
+    this->goalNode = nextDestination;
+    this->hasReachedDestination = false;
+    this->path = move(plannedPath);
+}
\ No newline at end of file
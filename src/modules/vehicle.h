@@ -3,18 +3,19 @@
 
 #include "edge.h"
 #include "node.h"
+#include "pathfinder.h"
+#include "vehicleclass.h"
 #include <unordered_map>
 #include <raylib.h>
 
 using namespace std;
 
-vector<Edge*> aStar(Node* start, Node* goal);
-
 class Vehicle
 {
 public:
     int id;                    // Unique ID for the vehicle
     string type;               // Vehicle type (car, truck, bus, motorcycle, etc.)
+    VehicleClass vehicleClass = VehicleClass::Car; // Parsed from type once; indexes the class tables
     float length;              // Length of the vehicle in meters
     Node* currentNode;         // Current node the vehicle is at
     Node* goalNode;            // Goal node for the vehicle
@@ -22,36 +23,45 @@ public:
     std::vector<Edge*> path;   // Planned path for the vehicle
     float x;                   // Current x-coordinate of the vehicle
     float y;                   // Current y-coordinate of the vehicle
-    float speed = 0.7;         // Speed of the vehicle
-    Node* currentNodeToReach;  // Node the vehicle is currently heading toward
+    float speed = 0.7;         // Desired (free road) speed of the vehicle
+    float currentSpeed = 0;    // Car-following speed, at most speed
+    int laneEntry = -1;        // Place in the traffic queue of currentEdge, -1 at a node
+    float odometer = 0;        // Length of the edges driven to their end, what fares are metered on
+    Node* currentNodeToReach = nullptr; // Node the vehicle is currently heading toward
     bool hasReachedDestination = false; // Destination reached status
     bool pickingUp = false;    // Picking up a passenger status
-    Node* userGoalNode;        // Goal node for the user
+    Node* userGoalNode = nullptr; // Goal node for the user
     Color color = RED;        // Color of the vehicle
 
-    // Vehicle types
-    static string vehicleTypes[4];
-
     // Constructor
+    Vehicle(); // Empty vehicle, filled in field by field (snapshot restore)
     Vehicle(int id, string type, Node* startNode, Node* goalNode);
     Vehicle(int id, string type, vector<Node*> nodes);
+    Vehicle(int id, string type, Node* startNode, Node* goalNode, vector<Edge*> plannedPath); // Path already routed (e.g. by a RouteBatch)
 
+    // Set the vehicle class from the type name: length, desired speed, seats and fare rate
+    void setClassByType();
 
-    // Set vehicle length based on type
-    void setLengthByType();
+    // Aim for the first edge of the planned path; a vehicle parked at its goal has none
+    bool beginPath();
 
     // Move the vehicle
     bool moveVehicle();
     void moveToNextNode();
 
-    // Update the number of agents on an edge
-    void updateEdgeAgentCount(Edge* edge, int delta);
+    // Join the queue of the next path edge, false while it has no room
+    bool enterNextEdge();
+    void leaveEdge();
+
+    // Update the number of agents on an edge (both directions share the count)
+    static void updateEdgeAgentCount(Edge* edge, int delta);
 
-    // Move the vehicle's coordinates
+    // Place the vehicle along its edge from its queue position
     void changeCoordinates();
 
     // Update destination
     void updateDestination(Node* nextDestination);
+    void updateDestination(Node* nextDestination, vector<Edge*> plannedPath); // Path already routed (e.g. by a RouteBatch)
 
 };
 
@@ -0,0 +1,37 @@
+#include "vehicleclass.h"
+#include "driver.h"
+
+VehicleClass vehicleClassOf(const string& name, bool* known)
+{
+    for (size_t i = 0; i < vehicleClassCount; i++)
+    {
+        if (name == vehicleClassTable[i].name)
+        {
+            if (known)
+                *known = true;
+            return static_cast<VehicleClass>(i);
+        }
+    }
+    if (known)
+        *known = false;
+    return VehicleClass::Car;
+}
+
+void FleetPartitions::assign(const vector<Driver*>& drivers)
+{
+    for (vector<Driver*>& partition : partitions)
+    {
+        partition.clear();
+    }
+    count = 0;
+    for (Driver* driver : drivers)
+    {
+        add(driver);
+    }
+}
+
+void FleetPartitions::add(Driver* driver)
+{
+    partitions[static_cast<size_t>(driver->vehicleClass)].push_back(driver);
+    count++;
+}
@@ -0,0 +1,95 @@
+#ifndef VEHICLECLASS_H
+#define VEHICLECLASS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class Driver;
+
+// The first four are the classes random traffic is drawn from
+enum class VehicleClass : uint8_t
+{
+    Car,
+    Truck,
+    Bus,
+    Bike,
+    Rickshaw,
+    Count
+};
+
+const size_t vehicleClassCount = static_cast<size_t>(VehicleClass::Count);
+
+struct VehicleClassInfo
+{
+    const char* name;
+    float length;        // Meters
+    float speed;         // Desired free road speed, map units per tick
+    int seats;           // Riders at once when pooling
+    float fareRate;      // Multiplies metered fares
+    float minRoadWidth;  // Narrowest Edge::width the class may drive on
+};
+
+constexpr VehicleClassInfo vehicleClassTable[vehicleClassCount] = {
+    { "Car", 4.5f, 0.7f, 4, 1.0f, 2.5f },
+    { "Truck", 12.0f, 0.55f, 2, 1.5f, 3.0f },
+    { "Bus", 10.5f, 0.6f, 12, 0.5f, 3.0f },
+    { "Bike", 2.0f, 0.8f, 1, 0.6f, 1.0f },
+    { "Rickshaw", 1.8f, 0.5f, 3, 0.8f, 1.5f },
+};
+
+constexpr const VehicleClassInfo& classInfo(VehicleClass vehicleClass)
+{
+    return vehicleClassTable[static_cast<size_t>(vehicleClass)];
+}
+
+constexpr const char* vehicleClassName(VehicleClass vehicleClass)
+{
+    return classInfo(vehicleClass).name;
+}
+
+constexpr bool canUseRoad(VehicleClass vehicleClass, float roadWidth)
+{
+    return roadWidth >= classInfo(vehicleClass).minRoadWidth;
+}
+
+// Parses a type name at the edges (console, JSON, snapshots, CSV); unknown
+// names fall back to Car and set known to false
+VehicleClass vehicleClassOf(const string& name, bool* known = nullptr);
+
+enum class RideState : uint8_t
+{
+    None,
+    Requested,
+    Active,
+    Count
+};
+
+constexpr const char* rideStateNames[static_cast<size_t>(RideState::Count)] = { "None", "Requested", "Active" };
+
+constexpr const char* rideStateName(RideState state)
+{
+    return rideStateNames[static_cast<size_t>(state)];
+}
+
+// Drivers grouped by the class of their vehicle, so matching scans only the
+// requested class. Membership follows Driver::vehicleClass at assign/add time.
+class FleetPartitions
+{
+public:
+    void assign(const vector<Driver*>& drivers);
+    void add(Driver* driver);
+
+    const vector<Driver*>& of(VehicleClass vehicleClass) const { return partitions[static_cast<size_t>(vehicleClass)]; }
+    size_t driverCount() const { return count; }
+
+private:
+    array<vector<Driver*>, vehicleClassCount> partitions;
+    size_t count = 0;
+};
+
+#endif
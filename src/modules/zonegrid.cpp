@@ -0,0 +1,120 @@
+#include "zonegrid.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+ZoneGrid::ZoneGrid(const vector<Node*>& nodes, int wantedZones)
+{
+    if (nodes.empty())
+    {
+        return;
+    }
+
+    float maxX = nodes[0]->x, maxY = nodes[0]->y;
+    minX = nodes[0]->x;
+    minY = nodes[0]->y;
+    for (Node* node : nodes)
+    {
+        minX = min(minX, node->x);
+        minY = min(minY, node->y);
+        maxX = max(maxX, node->x);
+        maxY = max(maxY, node->y);
+    }
+
+    // Square cells sized for the requested zone count
+    int wanted = max(1, wantedZones);
+    float width = max(maxX - minX, 1.0f);
+    float height = max(maxY - minY, 1.0f);
+    cellSize = sqrt(width * height / wanted) * 1.0001f;
+    columns = max(1, static_cast<int>(ceil(width / cellSize)));
+    rows = max(1, static_cast<int>(ceil(height / cellSize)));
+    zoneOfCell.assign(static_cast<size_t>(columns) * rows, -1);
+
+    vector<vector<Node*>> members;
+    for (Node* node : nodes)
+    {
+        int& zone = zoneOfCell[cellOf(node->x, node->y)];
+        if (zone < 0)
+        {
+            zone = static_cast<int>(zones.size());
+            zones.push_back({ 0, 0, nullptr, 0 });
+            members.emplace_back();
+        }
+        members[zone].push_back(node);
+    }
+    for (size_t z = 0; z < zones.size(); z++)
+    {
+        GridZone& zone = zones[z];
+        zone.nodeCount = static_cast<int>(members[z].size());
+        for (Node* node : members[z])
+        {
+            zone.x += node->x / members[z].size();
+            zone.y += node->y / members[z].size();
+        }
+        float best = numeric_limits<float>::max();
+        for (Node* node : members[z])
+        {
+            float d = (node->x - zone.x) * (node->x - zone.x) + (node->y - zone.y) * (node->y - zone.y);
+            if (d < best)
+            {
+                best = d;
+                zone.anchor = node;
+            }
+        }
+    }
+}
+
+int ZoneGrid::cellOf(float x, float y) const
+{
+    int cx = min(columns - 1, static_cast<int>((x - minX) / cellSize));
+    int cy = min(rows - 1, static_cast<int>((y - minY) / cellSize));
+    return cy * columns + cx;
+}
+
+int ZoneGrid::zoneAt(float x, float y) const
+{
+    if (zones.empty() || x < minX || y < minY || x > minX + columns * cellSize || y > minY + rows * cellSize)
+    {
+        return -1;
+    }
+    return zoneOfCell[cellOf(x, y)];
+}
+
+vector<pair<uint32_t, uint32_t>> ZoneGrid::neighbourLinks() const
+{
+    vector<pair<uint32_t, uint32_t>> links;
+    for (int cy = 0; cy < rows; cy++)
+    {
+        for (int cx = 0; cx < columns; cx++)
+        {
+            int zone = zoneOfCell[static_cast<size_t>(cy) * columns + cx];
+            if (zone < 0)
+            {
+                continue;
+            }
+            for (int radius = 1; radius <= 3; radius++)
+            {
+                size_t before = links.size();
+                for (int ny = max(0, cy - radius); ny <= min(rows - 1, cy + radius); ny++)
+                {
+                    for (int nx = max(0, cx - radius); nx <= min(columns - 1, cx + radius); nx++)
+                    {
+                        int other = zoneOfCell[static_cast<size_t>(ny) * columns + nx];
+                        if (other >= 0 && other != zone)
+                        {
+                            links.push_back({ static_cast<uint32_t>(zone), static_cast<uint32_t>(other) });
+                            links.push_back({ static_cast<uint32_t>(other), static_cast<uint32_t>(zone) });
+                        }
+                    }
+                }
+                if (links.size() > before)
+                {
+                    break;
+                }
+            }
+        }
+    }
+    sort(links.begin(), links.end());
+    links.erase(unique(links.begin(), links.end()), links.end());
+    return links;
+}
@@ -0,0 +1,47 @@
+#ifndef ZONEGRID_H
+#define ZONEGRID_H
+
+#include "node.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+struct GridZone
+{
+    float x, y;    // Centre of its nodes
+    Node* anchor;  // Node closest to the centre
+    int nodeCount;
+};
+
+// Square grid cells over the bounding box of a node set; only cells holding
+// nodes become zones. A point's zone is plain arithmetic on its coordinates,
+// so lookups are O(1) without hashing.
+class ZoneGrid
+{
+public:
+    ZoneGrid() = default;
+    ZoneGrid(const vector<Node*>& nodes, int wantedZones);
+
+    // Zone of the cell under a point, -1 for an empty cell or outside the grid
+    int zoneAt(float x, float y) const;
+    int zoneOf(const Node* node) const { return node ? zoneAt(node->x, node->y) : -1; }
+
+    size_t size() const { return zones.size(); }
+    const GridZone& zone(int index) const { return zones[index]; }
+
+    // Both directions of each pair of neighbouring zones, sorted. The ring
+    // widens over empty cells so sparse areas stay connected.
+    vector<pair<uint32_t, uint32_t>> neighbourLinks() const;
+
+private:
+    int cellOf(float x, float y) const;
+
+    float minX = 0, minY = 0, cellSize = 1;
+    int columns = 0, rows = 0;
+    vector<int> zoneOfCell; // -1 for cells without nodes
+    vector<GridZone> zones;
+};
+
+#endif